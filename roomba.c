@@ -6,6 +6,8 @@
 
 #include "roomba.h"
 
+#include "roomba_build.h"
+
 //#include "sensor_struct.h"
 
 /*
@@ -84,8 +86,96 @@ int get_command_data_bytes (ROOMBA_OP_CODE command) {
 
   switch(command) {
 
+    case ROOMBA_RESET: return 0;
+
+    case ROOMBA_START: return 0;
+
+    case ROOMBA_BAUD: return 1;
+
+    case ROOMBA_CONTROL: return 0;
+
+    case ROOMBA_SAFE: return 0;
+
+    case ROOMBA_FULL: return 0;
+
+    case ROOMBA_POWER: return 0;
+
+    case ROOMBA_SPOT: return 0;
+
+#if ROOMBA_INTERFACE_VERSION==1
+
+    case ROOMBA_COVER: return 0;
+
+    case ROOMBA_DEMO: return 1;
+
+#elif ROOMBA_INTERFACE_VERSION==2
+
+    case ROOMBA_CLEAN: return 0;
+
+    case ROOMBA_MAX: return 0;
+
+#endif
+
     case ROOMBA_DRIVE: return 4;
 
+    case ROOMBA_MOTORS: return 1;
+
+    case ROOMBA_LEDS: return 3;
+
+    case ROOMBA_PLAY: return 1;
+
+    case ROOMBA_SENSORS: return 1;
+
+    case ROOMBA_SEEK_DOCK: return 0;
+
+    case ROOMBA_PWM_MOTORS: return 3;
+
+    case ROOMBA_DRIVE_DIRECT: return 4;
+
+    case ROOMBA_DRIVE_PWM: return 4;
+
+    case ROOMBA_PAUSE_RESUME_STREAM: return 1;
+
+#if ROOMBA_INTERFACE_VERSION==1
+
+    case DIGITAL_OUTPUTS: return 1;
+
+    case SEND_IR: return 1;
+
+    case PLAY_SCRIPT: return 0;
+
+    case SHOW_SCRIPT: return 0;
+
+    case WAIT_TIME: return 1;
+
+    case WAIT_DISTANCE: return 2;
+
+    case WAIT_ANGLE: return 2;
+
+    case WAIT_EVENT: return 1;
+
+#endif
+
+#if ROOMBA_INTERFACE_VERSION==2
+
+    case ROOMBA_SCHEDULING_LEDS: return 2;
+
+    case ROOMBA_DIGIT_LEDS_RAW: return 4;
+
+    case ROOMBA_DIGIT_LEDS_ASCII: return 4;
+
+    case ROOMBA_BUTTONS_CMD: return 1;
+
+    case ROOMBA_SCHEDULE: return 15;
+
+    case ROOMBA_SET_DAY_TIME: return 3;
+
+    case ROOMBA_STOP: return 0;
+
+#endif
+
+    /* Song, Stream, Query List and Script depend on their length byte */
+
     default: return -1;
 
   }
@@ -94,30 +184,271 @@ int get_command_data_bytes (ROOMBA_OP_CODE command) {
 
 
 
+/* signed 16 bit data value, high byte first */
+
+static int16_t command_word (uint8_t command[], uint8_t i) {
+
+  return (int16_t)(command[i]<<8|command[i+1]);
+
+}
+
+/* [opcode][count][count bytes], each a valid packet id if packets is set */
+
+static int valid_list (uint8_t command[], uint16_t size, uint8_t max,
+
+  bool packets) {
+
+  if (size < 2 || command[1] > max || size != 2 + command[1]) return false;
+
+  for (uint8_t i = 0; packets && i < command[1]; i++) {
+
+    if (!ROOMBA_VALID_PACKET(command[2 + i])) return false;
+
+  }
+
+  return true;
+
+}
+
+
+
+#if ROOMBA_INTERFACE_VERSION==2
+
+static int all_in_range (uint8_t command[], uint16_t size, uint8_t lo,
+
+  uint8_t hi) {
+
+  for (uint16_t i = 1; i < size; i++) {
+
+    if (command[i] < lo || command[i] > hi) return false;
+
+  }
+
+  return true;
+
+}
+
+#endif
+
+
+
 int is_valid_roomba_command (uint8_t command[], uint16_t size) {
 
-  switch (command[0]) {
+  int data_bytes;
 
-    case ROOMBA_RESET: return size==1;
+  if (size == 0) return false;
+
+  switch (command[0]) {
 
     case ROOMBA_DRIVE:
 
       return (size==5) &&
 
-      ((command[1]<<8|command[2]) >= -500 &&
+      (command_word(command, 1) >= -500 &&
+
+       command_word(command, 1) <= 500) &&
+
+      ((command_word(command, 3) >= -2000 &&
+
+        command_word(command, 3) <= 2000)||
+
+        command_word(command, 3)==(int16_t)ROOMBA_RADIUS_STRAIGHT_POSITIVE ||
+
+        command_word(command, 3)==(int16_t)ROOMBA_RADIUS_STRAIGHT_NEGATIVE);
+
+    case ROOMBA_DRIVE_DIRECT:
+
+      return (size==5) &&
+
+      (command_word(command, 1) >= -500 &&
+
+       command_word(command, 1) <= 500) &&
+
+      (command_word(command, 3) >= -500 &&
+
+       command_word(command, 3) <= 500);
+
+    case ROOMBA_DRIVE_PWM:
+
+      return (size==5) &&
+
+      (command_word(command, 1) >= -255 &&
+
+       command_word(command, 1) <= 255) &&
+
+      (command_word(command, 3) >= -255 &&
+
+       command_word(command, 3) <= 255);
+
+    /* notes outside 31 - 127 are rests, any duration is fine */
+
+    case ROOMBA_SONG:
+
+      return size >= 3 && command[1] < ROOMBA_SONG_NUMBERS &&
+
+        command[2] >= 1 && command[2] <= 16 && size == 3 + 2 * command[2];
+
+    case ROOMBA_STREAM:
+
+    case ROOMBA_QUERY_LIST:
+
+      return valid_list(command, size, 255, true) && command[1] > 0;
+
+#if ROOMBA_INTERFACE_VERSION==1
+
+    case SCRIPT: return valid_list(command, size, 100, false);
+
+#endif
+
+    default: break;
+
+  }
+
+  /* the rest have a fixed size, some a range for their data bytes */
+
+  data_bytes = get_command_data_bytes((ROOMBA_OP_CODE)command[0]);
+
+  if (data_bytes < 0 || size != 1 + data_bytes) return false;
+
+  switch (command[0]) {
+
+    case ROOMBA_BAUD: return command[1] <= 11;
+
+    case ROOMBA_MOTORS: return command[1] <= 31;
+
+    case ROOMBA_PLAY: return command[1] < ROOMBA_SONG_NUMBERS;
+
+    case ROOMBA_SENSORS: return ROOMBA_VALID_PACKET(command[1]);
+
+    case ROOMBA_PAUSE_RESUME_STREAM: return command[1] <= 1;
+
+    /* brushes -127 - 127, vacuum 0 - 127 */
+
+    case ROOMBA_PWM_MOTORS:
+
+      return command[1] != 0x80 && command[2] != 0x80 && command[3] <= 127;
+
+#if ROOMBA_INTERFACE_VERSION==2
+
+    case ROOMBA_SCHEDULING_LEDS: return command[1] <= 127 && command[2] <= 31;
+
+    case ROOMBA_DIGIT_LEDS_RAW: return all_in_range(command, size, 0, 127);
+
+    case ROOMBA_DIGIT_LEDS_ASCII: return all_in_range(command, size, 32, 126);
+
+    case ROOMBA_SET_DAY_TIME:
+
+      return command[1] <= 6 && command[2] <= 23 && command[3] <= 59;
+
+    case ROOMBA_SCHEDULE:
+
+      if (command[1] > 127) return false;
+
+      for (uint8_t i = 2; i < 16; i += 2) {
+
+        if (command[i] > 23 || command[i + 1] > 59) return false;
+
+      }
+
+      return true;
+
+#else
+
+    case ROOMBA_DEMO:
+
+      return (int8_t)command[1] >= -1 && (int8_t)command[1] <= 9;
+
+    case DIGITAL_OUTPUTS: return command[1] <= 7;
+
+    case WAIT_EVENT:
 
-       (command[1]<<8|command[2]) <= 500) &&
+      return (int8_t)command[1] != 0 && (int8_t)command[1] >= -22 &&
 
-      (((command[3]<<8|command[4]) >= -2000 &&
+        (int8_t)command[1] <= 22;
 
-        (command[3]<<8|command[4]) <= 2000)||
+#endif
 
-        (command[3]<<8|command[4])==ROOMBA_RADIUS_STRAIGHT_POSITIVE ||
+    default: return true;
 
-        (command[3]<<8|command[4])==ROOMBA_RADIUS_STRAIGHT_NEGATIVE);
+  }
+
+}
+
+
+
+
+
+
+
+int get_packet_data_bytes (uint8_t packet) {
+
+  /* single value packets 7 - 58 */
+
+  static const uint8_t sizes[] = {
+
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 1, 2, 2, 1, 2, 2,
+
+    2, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 1, 2,
+
+    2, 2, 2, 2, 2, 1, 1, 2, 2, 2, 2, 1,
+
+  };
+
+  switch (packet) {
+
+    case G0: return 26;
+
+    case G1: return 10;
+
+    case G2: return 6;
+
+    case G3: return 10;
+
+    case G4: return 14;
+
+    case G5: return 12;
+
+    case G6: return 52;
 
-    default: return false;
+    case ALL_PACKETS: return 80;
+
+    case G101: return 28;
+
+    case G106: return 12;
+
+    case G107: return 9;
+
+    default:
+
+      if (packet >= ROOMBA_BUMPS_WHEELDROPS && packet <= ROOMBA_STASIS)
+
+        return sizes[packet - ROOMBA_BUMPS_WHEELDROPS];
+
+      return -1;
 
   }
 
 }
+
+
+
+
+
+
+
+uint32_t get_bitrate_bps (ROOMBA_BITRATE bitrate) {
+
+  static const uint32_t rates[] = {
+
+    300, 600, 1200, 2400, 4800, 9600, 14400, 19200, 28800, 38400, 57600,
+
+    115200,
+
+  };
+
+  if (bitrate > ROOMBA_115200BPS) return 0;
+
+  return rates[bitrate];
+
+}
+
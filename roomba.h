@@ -21,6 +21,17 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/*
+ * ROOMBA_NO_HEAP: every object is static or provided by the caller, see
+ * roomba_pool.h. Any use of the heap after this point fails to compile.
+ * <stdlib.h> is read first, so files including it after this one still
+ * build as long as they do not call the allocator.
+ */
+#ifdef ROOMBA_NO_HEAP
+  #include <stdlib.h>
+  #pragma GCC poison malloc calloc realloc free
+#endif
+
 /**@{*/
 
 /*******************************************************************************
@@ -2102,6 +2113,15 @@ typedef struct _pkt_group_107 {
   uint8_t stasis;
 } ROOMBA_PACKET_GROUP_107;
 
+/**
+ * Byte sink towards the robot. write must queue or send all size bytes
+ * before returning; context is passed back unchanged.
+ */
+typedef struct _roomba_transport {
+  void (*write)(void *context, const uint8_t data[], uint16_t size);
+  void *context;
+} ROOMBA_TRANSPORT;
+
 /*******************************************************************************
  MACROS
 *******************************************************************************/
@@ -2119,8 +2139,40 @@ typedef struct _pkt_group_107 {
  * Function
  ******************************************************************************/
 
+/**
+ * Checks a complete command, opcode first: its size, including the length
+ * byte of Song, Stream, Query List and Script, and the ranges of its data
+ * bytes where the OI documents one.
+ *
+ * @return true if the robot would accept the command as is
+ */
 int is_valid_roomba_command (uint8_t command[], uint16_t size);
 
+/**
+ * @return number of data bytes following the opcode, -1 if unknown or
+ * variable
+ */
+int get_command_data_bytes (ROOMBA_OP_CODE command);
+
+/**
+ * @param packet a ROOMBA_PACKET_CODE or ROOMBA_PACKET_GROUP
+ * @return number of data bytes the robot sends for the packet, -1 if unknown
+ */
+int get_packet_data_bytes (uint8_t packet);
+
+/**
+ * @return bits per second of a baud code, 0 if the code is out of range
+ */
+uint32_t get_bitrate_bps (ROOMBA_BITRATE bitrate);
+
+/**
+ * @return true once now_ms has reached deadline_ms, both wrapping millisecond
+ * counts less than 2^31 apart
+ */
+static inline bool roomba_expired(uint32_t now_ms, uint32_t deadline_ms) {
+  return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
 /**
  * @param uart_send_byte_callback_function a function that sends a uart byte to
  * the roomba set to a baud rate of 19200.
@@ -0,0 +1,134 @@
+/**
+ * @file roomba_arena.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_arena.h> @endcode
+ *
+ * @brief Bump allocator for objects that live for one 15 ms cycle
+ *
+ * Decoded snapshots, event records and encoded commands are needed for at
+ * most one stream slot. An arena hands them out of one caller-provided
+ * buffer by moving an offset forward, and roomba_arena_reset frees all of
+ * them at once by setting it back to zero. Nothing is freed individually and
+ * nothing touches the heap.
+ *
+ * @code
+ * static uint64_t buffer[512];
+ * ROOMBA_ARENA arena;
+ * roomba_arena_init(&arena, buffer, sizeof(buffer));
+ *
+ * ROOMBA_PACKET_GROUP_100 *copy = roomba_arena_snapshot(&arena, frame);
+ * MY_RECORD *record = ROOMBA_ARENA_NEW(&arena, MY_RECORD);
+ * ...
+ * roomba_arena_reset(&arena);   // end of the cycle
+ * @endcode
+ *
+ * An arena belongs to one thread. roomba_fleet.h keeps one per worker and
+ * resets it on every tick.
+ */
+
+#ifndef ROOMBA_ARENA_H_
+#define ROOMBA_ARENA_H_
+
+#include <string.h>
+
+#include "roomba.h"
+#include "roomba_queue.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** Alignment of every allocation, a power of two */
+#ifndef ROOMBA_ARENA_ALIGN
+  #ifdef __AVR__
+    #define ROOMBA_ARENA_ALIGN 1
+  #else
+    #define ROOMBA_ARENA_ALIGN 8
+  #endif
+#endif
+
+#if ROOMBA_ARENA_ALIGN < 1 || (ROOMBA_ARENA_ALIGN & (ROOMBA_ARENA_ALIGN - 1)) != 0
+  #error "ROOMBA_ARENA_ALIGN must be a power of two"
+#endif
+
+typedef struct _roomba_arena {
+  uint8_t *base;
+  uint32_t size;
+  uint32_t used;
+  /** Most bytes in use at a reset since init */
+  uint32_t peak;
+  /** Allocations that did not fit */
+  uint32_t failures;
+} ROOMBA_ARENA;
+
+/** Uninitialised object of type, NULL if the arena is full */
+#define ROOMBA_ARENA_NEW(arena, type) \
+  ((type *)roomba_arena_alloc((arena), sizeof(type)))
+
+/** Uninitialised array of count objects of type */
+#define ROOMBA_ARENA_ARRAY(arena, type, count) \
+  ((type *)roomba_arena_alloc((arena), (uint32_t)(sizeof(type) * (count))))
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+static inline void roomba_arena_init(ROOMBA_ARENA *arena, void *buffer,
+  uint32_t size) {
+  arena->base = buffer;
+  arena->size = size;
+  arena->used = 0;
+  arena->peak = 0;
+  arena->failures = 0;
+}
+
+/** @return size bytes, NULL if they do not fit */
+static inline void *roomba_arena_alloc(ROOMBA_ARENA *arena, uint32_t size) {
+  uint32_t pad = (uint32_t)(-(uintptr_t)(arena->base + arena->used) &
+    (ROOMBA_ARENA_ALIGN - 1));
+  void *p;
+
+  if (size > arena->size - arena->used ||
+      pad > arena->size - arena->used - size) {
+    arena->failures++;
+    return NULL;
+  }
+  p = arena->base + arena->used + pad;
+  arena->used += pad + size;
+  return p;
+}
+
+/** Frees everything allocated since the last reset */
+static inline void roomba_arena_reset(ROOMBA_ARENA *arena) {
+  if (arena->used > arena->peak) arena->peak = arena->used;
+  arena->used = 0;
+}
+
+static inline ROOMBA_PACKET_GROUP_100 *roomba_arena_snapshot(
+  ROOMBA_ARENA *arena, const ROOMBA_PACKET_GROUP_100 *frame) {
+  ROOMBA_PACKET_GROUP_100 *copy = ROOMBA_ARENA_NEW(arena,
+    ROOMBA_PACKET_GROUP_100);
+
+  if (copy) *copy = *frame;
+  return copy;
+}
+
+/** Encoded command, e.g. for a ROOMBA_TX or roomba_queue_push */
+static inline ROOMBA_COMMAND *roomba_arena_command(ROOMBA_ARENA *arena,
+  const uint8_t data[], uint8_t size) {
+  ROOMBA_COMMAND *command;
+
+  if (size > ROOMBA_COMMAND_MAX_SIZE) return NULL;
+  command = ROOMBA_ARENA_NEW(arena, ROOMBA_COMMAND);
+  if (!command) return NULL;
+  command->deadline = ROOMBA_NO_DEADLINE;
+  command->size = size;
+  memcpy(command->data, data, size);
+  return command;
+}
+
+/**@}*/
+
+#endif /* ROOMBA_ARENA_H_ */
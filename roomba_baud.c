@@ -0,0 +1,199 @@
+#include "roomba_baud.h"
+
+/* stream frames arrive every 15 ms, allow twice the time */
+#define SOAK_TIMEOUT_MS (ROOMBA_BAUD_SOAK_FRAMES * 15 * 2)
+
+static void send(ROOMBA_BAUD_NEGOTIATOR *n, uint8_t a, uint8_t b) {
+  uint8_t command[2];
+
+  command[0] = a;
+  command[1] = b;
+  n->transport.write(n->transport.context, command, 2);
+}
+
+/* bad frames per mille since the mark */
+static uint16_t error_rate(const ROOMBA_BAUD_NEGOTIATOR *n) {
+  const ROOMBA_STREAM_STATS *s = &n->parser->stats;
+  uint32_t errors = (s->checksum_errors - n->mark.checksum_errors) +
+    (s->framing_errors - n->mark.framing_errors);
+  uint32_t frames = s->frames - n->mark.frames;
+
+  if (frames + errors == 0) return 1000;
+  return (uint16_t)(errors * 1000 / (frames + errors));
+}
+
+static void begin_measurement(ROOMBA_BAUD_NEGOTIATOR *n, uint32_t now) {
+  /* a frame cut by the pause must not count against the rate */
+  n->parser->state = ROOMBA_STREAM_WAIT_HEADER;
+  n->mark = n->parser->stats;
+  n->deadline = now + SOAK_TIMEOUT_MS;
+}
+
+/* pauses the stream, Baud follows once the line is quiet */
+static void switch_to(ROOMBA_BAUD_NEGOTIATOR *n, ROOMBA_BITRATE bitrate,
+  uint32_t now) {
+  send(n, ROOMBA_PAUSE_RESUME_STREAM, 0);
+  n->candidate = bitrate;
+  n->state = ROOMBA_BAUD_DRAIN;
+  n->deadline = now + ROOMBA_BAUD_SETTLE_MS;
+}
+
+static void reject(ROOMBA_BAUD_NEGOTIATOR *n, uint32_t now) {
+  if (n->candidate != n->good) {
+    n->ceiling = n->candidate - 1;
+    switch_to(n, n->good, now);
+  } else if (n->good > ROOMBA_300BPS) {
+    /* the good rate itself went bad, keep going down */
+    n->good--;
+    n->ceiling = n->good;
+    switch_to(n, n->good, now);
+  } else {
+    n->state = ROOMBA_BAUD_FAILED;
+  }
+}
+
+static void accept(ROOMBA_BAUD_NEGOTIATOR *n, uint32_t now) {
+  n->good = n->candidate;
+  if (n->good < n->ceiling) {
+    switch_to(n, n->good + 1, now);
+  } else {
+    n->state = ROOMBA_BAUD_MONITOR;
+    begin_measurement(n, now);
+  }
+}
+
+static void check_reply(ROOMBA_BAUD_NEGOTIATOR *n, uint32_t now) {
+  uint16_t capacity = (uint16_t)(n->reply[0] << 8 | n->reply[1]);
+
+  if (!n->have_reference) {
+    n->reference = capacity;
+    n->have_reference = true;
+  } else if (capacity != n->reference) {
+    n->error_rate[n->candidate] = 1000;
+    reject(n, now);
+    return;
+  }
+  send(n, ROOMBA_PAUSE_RESUME_STREAM, 1);
+  n->state = ROOMBA_BAUD_SOAK;
+  begin_measurement(n, now);
+}
+
+void roomba_baud_init(ROOMBA_BAUD_NEGOTIATOR *negotiator,
+  ROOMBA_TRANSPORT transport,
+  void (*set_host_bitrate)(void *context, ROOMBA_BITRATE bitrate),
+  ROOMBA_STREAM_PARSER *parser, ROOMBA_BITRATE current) {
+  ROOMBA_BAUD_NEGOTIATOR *n = negotiator;
+
+  n->transport = transport;
+  n->set_host_bitrate = set_host_bitrate;
+  n->parser = parser;
+  n->state = ROOMBA_BAUD_IDLE;
+  n->candidate = current;
+  n->active = current;
+  n->good = current;
+  n->ceiling = current;
+  n->deadline = 0;
+  n->reference = 0;
+  n->have_reference = false;
+  n->reply_size = 0;
+  n->mark = parser->stats;
+  for (uint8_t i = 0; i < ROOMBA_BITRATE_COUNT; i++) {
+    n->error_rate[i] = ROOMBA_BAUD_UNTESTED;
+  }
+  n->fallbacks = 0;
+}
+
+void roomba_baud_start(ROOMBA_BAUD_NEGOTIATOR *negotiator, uint32_t now_ms,
+  ROOMBA_BITRATE highest) {
+  ROOMBA_BAUD_NEGOTIATOR *n = negotiator;
+
+  n->ceiling = highest > ROOMBA_115200BPS ? ROOMBA_115200BPS : highest;
+  n->have_reference = false;
+  /* the first round reads the reference at the current rate */
+  switch_to(n, n->good, now_ms);
+}
+
+void roomba_baud_receive(ROOMBA_BAUD_NEGOTIATOR *negotiator,
+  const uint8_t data[], uint16_t size) {
+  ROOMBA_BAUD_NEGOTIATOR *n = negotiator;
+
+  switch (n->state) {
+    case ROOMBA_BAUD_DRAIN:
+    case ROOMBA_BAUD_SETTLE:
+      /* tail of the paused stream, or noise from the switch */
+      break;
+    case ROOMBA_BAUD_QUERY:
+      for (uint16_t i = 0; i < size && n->reply_size < 2; i++) {
+        n->reply[n->reply_size++] = data[i];
+      }
+      break;
+    default:
+      roomba_stream_parse(n->parser, data, size);
+      break;
+  }
+}
+
+uint32_t roomba_baud_poll(ROOMBA_BAUD_NEGOTIATOR *negotiator, uint32_t now_ms) {
+  ROOMBA_BAUD_NEGOTIATOR *n = negotiator;
+  uint16_t rate;
+
+  switch (n->state) {
+    case ROOMBA_BAUD_DRAIN:
+      if (!roomba_expired(now_ms, n->deadline)) break;
+      if (n->candidate != n->active) {
+        /* sent at the old rate, the OI answers at the new one */
+        send(n, ROOMBA_BAUD, (uint8_t)n->candidate);
+        n->set_host_bitrate(n->transport.context, n->candidate);
+        n->active = n->candidate;
+      }
+      n->state = ROOMBA_BAUD_SETTLE;
+      n->deadline = now_ms + ROOMBA_BAUD_SETTLE_MS;
+      break;
+    case ROOMBA_BAUD_SETTLE:
+      if (!roomba_expired(now_ms, n->deadline)) break;
+      n->reply_size = 0;
+      send(n, ROOMBA_SENSORS, ROOMBA_BATTERY_CAPACITY);
+      n->state = ROOMBA_BAUD_QUERY;
+      n->deadline = now_ms + ROOMBA_BAUD_REPLY_MS;
+      break;
+    case ROOMBA_BAUD_QUERY:
+      if (n->reply_size == 2) {
+        check_reply(n, now_ms);
+      } else if (roomba_expired(now_ms, n->deadline)) {
+        n->error_rate[n->candidate] = 1000;
+        reject(n, now_ms);
+      }
+      break;
+    case ROOMBA_BAUD_SOAK:
+      if (n->parser->stats.frames - n->mark.frames < ROOMBA_BAUD_SOAK_FRAMES &&
+          !roomba_expired(now_ms, n->deadline)) {
+        break;
+      }
+      rate = error_rate(n);
+      n->error_rate[n->candidate] = rate;
+      if (rate <= ROOMBA_BAUD_MAX_ERRORS) {
+        accept(n, now_ms);
+      } else {
+        reject(n, now_ms);
+      }
+      break;
+    case ROOMBA_BAUD_MONITOR:
+      if (n->parser->stats.frames - n->mark.frames < ROOMBA_BAUD_SOAK_FRAMES &&
+          !roomba_expired(now_ms, n->deadline)) {
+        break;
+      }
+      rate = error_rate(n);
+      n->error_rate[n->good] = rate;
+      if (rate > ROOMBA_BAUD_MAX_ERRORS) {
+        n->fallbacks++;
+        reject(n, now_ms);
+      } else {
+        begin_measurement(n, now_ms);
+      }
+      break;
+    default:
+      return now_ms + SOAK_TIMEOUT_MS;
+  }
+  return n->state == ROOMBA_BAUD_FAILED ? now_ms + SOAK_TIMEOUT_MS :
+    n->deadline;
+}
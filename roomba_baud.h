@@ -0,0 +1,149 @@
+/**
+ * @file roomba_baud.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_baud.h> @endcode
+ *
+ * @brief Finds the fastest baud rate the link carries reliably
+ *
+ * Starting from the rate both ends currently use, the negotiator steps up one
+ * ROOMBA_BITRATE code at a time. Every step:
+ *   - pauses the stream and lets the line drain,
+ *   - sends Baud (129) and switches the host UART,
+ *   - waits the 100 ms the OI needs before it listens at the new rate,
+ *   - queries Battery Capacity (26) and compares it with the value read at
+ *     the starting rate,
+ *   - resumes the stream and counts checksum and framing errors over
+ *     ROOMBA_BAUD_SOAK_FRAMES frames.
+ *
+ * A step that fails goes back to the last good rate, which becomes the
+ * result. Afterwards the error rate keeps being watched and the link drops
+ * one code whenever it climbs over the threshold; a lower rate is verified
+ * the same way before it is used.
+ *
+ * Nothing blocks: received bytes go through roomba_baud_receive and
+ * roomba_baud_poll is called when its returned deadline passes.
+ *
+ * @note A stream (148) must be configured before roomba_baud_start; it is the
+ * load the error rate is measured under.
+ */
+
+#ifndef ROOMBA_BAUD_H_
+#define ROOMBA_BAUD_H_
+
+#include "roomba.h"
+#include "roomba_stream.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** Wait after pausing the stream and after Baud, the OI needs 100 ms */
+#ifndef ROOMBA_BAUD_SETTLE_MS
+  #define ROOMBA_BAUD_SETTLE_MS 100
+#endif
+
+#ifndef ROOMBA_BAUD_REPLY_MS
+  #define ROOMBA_BAUD_REPLY_MS 100
+#endif
+
+/** Frames per error rate measurement, 3 s of stream */
+#ifndef ROOMBA_BAUD_SOAK_FRAMES
+  #define ROOMBA_BAUD_SOAK_FRAMES 200
+#endif
+
+/** Highest acceptable share of bad frames, per mille */
+#ifndef ROOMBA_BAUD_MAX_ERRORS
+  #define ROOMBA_BAUD_MAX_ERRORS 5
+#endif
+
+#define ROOMBA_BITRATE_COUNT (ROOMBA_115200BPS + 1)
+
+/** error_rate entry of a rate that was not measured */
+#define ROOMBA_BAUD_UNTESTED 0xFFFF
+
+typedef enum {
+  ROOMBA_BAUD_IDLE,
+  /** Stream paused, waiting for the line to drain */
+  ROOMBA_BAUD_DRAIN,
+  /** Baud sent, waiting for the OI to switch */
+  ROOMBA_BAUD_SETTLE,
+  ROOMBA_BAUD_QUERY,
+  ROOMBA_BAUD_SOAK,
+  /** Settled, error rate still watched */
+  ROOMBA_BAUD_MONITOR,
+  /** Even the last good rate did not answer */
+  ROOMBA_BAUD_FAILED,
+} ROOMBA_BAUD_STATE;
+
+typedef struct _roomba_baud_negotiator {
+  ROOMBA_TRANSPORT transport;
+  /**
+   * Switches the host UART, called with transport.context right after the
+   * Baud command was written. It must first wait for the bytes written so
+   * far to leave at the old rate, e.g. with tcdrain() or
+   * roomba_uart_set_bitrate.
+   */
+  void (*set_host_bitrate)(void *context, ROOMBA_BITRATE bitrate);
+  ROOMBA_STREAM_PARSER *parser;
+  ROOMBA_BAUD_STATE state;
+  /** Rate being verified */
+  ROOMBA_BITRATE candidate;
+  /** Rate both ends were last switched to */
+  ROOMBA_BITRATE active;
+  /** Fastest rate that passed */
+  ROOMBA_BITRATE good;
+  /** Highest rate still worth trying */
+  ROOMBA_BITRATE ceiling;
+  uint32_t deadline;
+  /** Battery capacity read at the starting rate */
+  uint16_t reference;
+  bool have_reference;
+  uint8_t reply[2];
+  uint8_t reply_size;
+  /** Parser stats at the start of the current measurement */
+  ROOMBA_STREAM_STATS mark;
+  /** Last measured error rate per rate, per mille */
+  uint16_t error_rate[ROOMBA_BITRATE_COUNT];
+  uint16_t fallbacks;
+} ROOMBA_BAUD_NEGOTIATOR;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * @param parser receives the stream while measuring and afterwards
+ * @param current rate both ends use right now
+ */
+void roomba_baud_init(ROOMBA_BAUD_NEGOTIATOR *negotiator,
+  ROOMBA_TRANSPORT transport,
+  void (*set_host_bitrate)(void *context, ROOMBA_BITRATE bitrate),
+  ROOMBA_STREAM_PARSER *parser, ROOMBA_BITRATE current);
+
+/** @param highest fastest rate to try, ROOMBA_115200BPS for all */
+void roomba_baud_start(ROOMBA_BAUD_NEGOTIATOR *negotiator, uint32_t now_ms,
+  ROOMBA_BITRATE highest);
+
+/** Feeds received bytes; stream data is passed on to the parser */
+void roomba_baud_receive(ROOMBA_BAUD_NEGOTIATOR *negotiator,
+  const uint8_t data[], uint16_t size);
+
+/**
+ * Advances the negotiation. While the stream runs it should also be called
+ * after received bytes, measurements end on a frame count.
+ *
+ * @return time at which to call again at the latest, ms
+ */
+uint32_t roomba_baud_poll(ROOMBA_BAUD_NEGOTIATOR *negotiator, uint32_t now_ms);
+
+/** @return the rate in use once negotiated, also while monitoring */
+static inline ROOMBA_BITRATE roomba_baud_current(
+  const ROOMBA_BAUD_NEGOTIATOR *negotiator) {
+  return negotiator->good;
+}
+
+/**@}*/
+
+#endif /* ROOMBA_BAUD_H_ */
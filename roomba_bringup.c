@@ -0,0 +1,119 @@
+#include "roomba_bringup.h"
+
+static bool skipped(const ROOMBA_BRINGUP *b, ROOMBA_BRINGUP_STEP step) {
+  switch (step) {
+    case ROOMBA_BRINGUP_WAKE_LOW:
+    case ROOMBA_BRINGUP_WAKE_HIGH:
+    case ROOMBA_BRINGUP_WAKE_PULSES:
+      return b->config.set_dd == NULL;
+    case ROOMBA_BRINGUP_BAUD:
+      return !b->config.change_baud;
+    default:
+      return false;
+  }
+}
+
+static void write_byte(ROOMBA_BRINGUP *b, uint8_t byte) {
+  b->transport.write(b->transport.context, &byte, 1);
+}
+
+/* runs the action of a step and returns how long to wait after it */
+static uint32_t enter(ROOMBA_BRINGUP *b) {
+  uint8_t command[2];
+
+  switch (b->step) {
+    case ROOMBA_BRINGUP_WAKE_LOW:
+      b->config.set_dd(b->transport.context, false);
+      return ROOMBA_WAKE_LOW_MS;
+    case ROOMBA_BRINGUP_WAKE_HIGH:
+      b->config.set_dd(b->transport.context, true);
+      return ROOMBA_WAKE_HIGH_MS;
+    case ROOMBA_BRINGUP_WAKE_PULSES:
+      b->pulses = 0;
+      return 0;
+    case ROOMBA_BRINGUP_START:
+      write_byte(b, ROOMBA_START);
+      return ROOMBA_START_MS;
+    case ROOMBA_BRINGUP_MODE:
+      write_byte(b,
+        b->config.mode == ROOMBA_FULL_MODE ? ROOMBA_FULL : ROOMBA_SAFE);
+      return ROOMBA_MODE_MS;
+    case ROOMBA_BRINGUP_BAUD:
+      command[0] = ROOMBA_BAUD;
+      command[1] = (uint8_t)b->config.bitrate;
+      b->transport.write(b->transport.context, command, 2);
+      b->config.set_host_bitrate(b->transport.context, b->config.bitrate);
+      return ROOMBA_BAUD_MS;
+    default:
+      return 0;
+  }
+}
+
+/* moves on to the next step that is not skipped */
+static void advance(ROOMBA_BRINGUP *b, uint32_t now) {
+  b->probe_ms[b->step] = now - b->step_start;
+  do {
+    b->step++;
+  } while (b->step < ROOMBA_BRINGUP_DONE && skipped(b, b->step));
+
+  b->step_start = now;
+  if (b->step == ROOMBA_BRINGUP_DONE) {
+    b->total_ms = now - b->started;
+    return;
+  }
+  b->deadline = now + enter(b);
+}
+
+void roomba_bringup_init(ROOMBA_BRINGUP *bringup, ROOMBA_TRANSPORT transport,
+  const ROOMBA_BRINGUP_CONFIG *config, uint32_t now_ms) {
+  ROOMBA_BRINGUP *b = bringup;
+
+  b->transport = transport;
+  b->config = *config;
+  b->pulses = 0;
+  for (uint8_t i = 0; i < ROOMBA_BRINGUP_STEPS; i++) b->probe_ms[i] = 0;
+  b->total_ms = 0;
+  b->started = now_ms;
+  b->step_start = now_ms;
+  b->step = ROOMBA_BRINGUP_WAKE_LOW;
+  while (b->step < ROOMBA_BRINGUP_DONE && skipped(b, b->step)) b->step++;
+  b->deadline = now_ms + enter(b);
+}
+
+uint32_t roomba_bringup_poll(ROOMBA_BRINGUP *bringup, uint32_t now_ms) {
+  ROOMBA_BRINGUP *b = bringup;
+
+  while (b->step != ROOMBA_BRINGUP_DONE &&
+      roomba_expired(now_ms, b->deadline)) {
+    if (b->step == ROOMBA_BRINGUP_WAKE_PULSES &&
+        b->pulses < ROOMBA_WAKE_PULSES) {
+      /* DD is high after the previous step, the first toggle pulls it low */
+      b->config.set_dd(b->transport.context, b->pulses % 2 != 0);
+      b->pulses++;
+      b->deadline = now_ms + ROOMBA_WAKE_PULSE_MS;
+      continue;
+    }
+    if (b->step == ROOMBA_BRINGUP_WAKE_PULSES) {
+      b->config.set_dd(b->transport.context, false);
+    }
+    advance(b, now_ms);
+  }
+  return b->deadline;
+}
+
+uint32_t roomba_bringup_poll_all(ROOMBA_BRINGUP bringups[], uint16_t count,
+  uint32_t now_ms) {
+  uint32_t next = now_ms + 1000;
+
+  for (uint16_t i = 0; i < count; i++) {
+    uint32_t deadline;
+
+    if (roomba_bringup_done(&bringups[i])) continue;
+    deadline = roomba_bringup_poll(&bringups[i], now_ms);
+    if (!roomba_bringup_done(&bringups[i]) &&
+        (int32_t)(deadline - next) < 0) {
+      next = deadline;
+    }
+  }
+  return next;
+}
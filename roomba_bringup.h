@@ -0,0 +1,114 @@
+/**
+ * @file roomba_bringup.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_bringup.h> @endcode
+ *
+ * @brief Wake, Start, mode entry and baud change as a timer driven state
+ * machine
+ *
+ * The same sequence as the old blocking roomba_init, roomba_start and
+ * roomba_set_baud, about 2.9 s of waits in total:
+ *
+ * | Step   | Action                                | Wait after           |
+ * |--------|---------------------------------------|----------------------|
+ * | Wake   | DD low, DD high, 6 DD toggles, DD low | 500, 2000, 6 x 50 ms |
+ * | Start  | [128]                                 | 20 ms                |
+ * | Mode   | [131] or [132]                        | 20 ms                |
+ * | Baud   | [129][code], host UART switched       | 100 ms               |
+ *
+ * Instead of sleeping, roomba_bringup_poll does whatever is due and returns
+ * when it wants to be called next, so one thread brings up any number of
+ * robots at the same time. The time every step really took, waits included,
+ * is kept in probe_ms for finding slow robots or a late event loop.
+ */
+
+#ifndef ROOMBA_BRINGUP_H_
+#define ROOMBA_BRINGUP_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#define ROOMBA_WAKE_LOW_MS 500
+#define ROOMBA_WAKE_HIGH_MS 2000
+#define ROOMBA_WAKE_PULSES 6
+#define ROOMBA_WAKE_PULSE_MS 50
+#define ROOMBA_START_MS 20
+#define ROOMBA_MODE_MS 20
+#define ROOMBA_BAUD_MS 100
+
+typedef enum {
+  ROOMBA_BRINGUP_WAKE_LOW,
+  ROOMBA_BRINGUP_WAKE_HIGH,
+  ROOMBA_BRINGUP_WAKE_PULSES,
+  ROOMBA_BRINGUP_START,
+  ROOMBA_BRINGUP_MODE,
+  ROOMBA_BRINGUP_BAUD,
+  ROOMBA_BRINGUP_DONE,
+  ROOMBA_BRINGUP_STEPS = ROOMBA_BRINGUP_DONE,
+} ROOMBA_BRINGUP_STEP;
+
+typedef struct _roomba_bringup_config {
+  /** Drives the Device Detect pin, NULL to skip the wake-up */
+  void (*set_dd)(void *context, bool high);
+  /** ROOMBA_SAFE_MODE or ROOMBA_FULL_MODE */
+  ROOMBA_MODE mode;
+  /** Switch to bitrate after the mode change */
+  bool change_baud;
+  ROOMBA_BITRATE bitrate;
+  /**
+   * Switches the host UART, needed with change_baud. Called right after the
+   * Baud command was written, so it must first let the written bytes leave
+   * at the old rate, as roomba_baud.h asks.
+   */
+  void (*set_host_bitrate)(void *context, ROOMBA_BITRATE bitrate);
+} ROOMBA_BRINGUP_CONFIG;
+
+typedef struct _roomba_bringup {
+  ROOMBA_TRANSPORT transport;
+  ROOMBA_BRINGUP_CONFIG config;
+  ROOMBA_BRINGUP_STEP step;
+  uint8_t pulses;
+  uint32_t deadline;
+  uint32_t step_start;
+  uint32_t started;
+  /** Time each step took, 0 for skipped steps */
+  uint32_t probe_ms[ROOMBA_BRINGUP_STEPS];
+  uint32_t total_ms;
+} ROOMBA_BRINGUP;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/** Starts the sequence with the action of its first step */
+void roomba_bringup_init(ROOMBA_BRINGUP *bringup, ROOMBA_TRANSPORT transport,
+  const ROOMBA_BRINGUP_CONFIG *config, uint32_t now_ms);
+
+/**
+ * Does every action that is due.
+ *
+ * @return time at which to call again, ms; meaningless once done
+ */
+uint32_t roomba_bringup_poll(ROOMBA_BRINGUP *bringup, uint32_t now_ms);
+
+/**
+ * Polls several robots.
+ *
+ * @return earliest time one of the unfinished robots needs a poll, now_ms
+ * plus one second if all are done
+ */
+uint32_t roomba_bringup_poll_all(ROOMBA_BRINGUP bringups[], uint16_t count,
+  uint32_t now_ms);
+
+static inline bool roomba_bringup_done(const ROOMBA_BRINGUP *bringup) {
+  return bringup->step == ROOMBA_BRINGUP_DONE;
+}
+
+/**@}*/
+
+#endif /* ROOMBA_BRINGUP_H_ */
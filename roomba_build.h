@@ -0,0 +1,292 @@
+/**
+ * @file roomba_build.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_build.h> @endcode
+ *
+ * @brief Compile-time encoded constant commands
+ *
+ * Each ROOMBA_CMD_* macro expands to a brace initializer with the bytes of
+ * one command, so constant commands are encoded once by the compiler and
+ * sending them costs no more than copying a const array:
+ *
+ * @code
+ * static const uint8_t forward[] = ROOMBA_CMD_DRIVE(200, ROOMBA_RADIUS_STRAIGHT);
+ * static const uint8_t beep[] = ROOMBA_CMD_SONG(0, 2, 72, 16, 76, 16);
+ *
+ * transport.write(transport.context, forward, sizeof(forward));
+ * @endcode
+ *
+ * The size of the array follows from the initializer and always equals
+ * 1 + get_command_data_bytes for fixed-size commands. Arguments outside the
+ * range the OI accepts stop the build, e.g. a velocity beyond +-500 mm/s or a
+ * radius beyond +-2000 mm that is not one of the special values. Arguments
+ * must therefore be constant expressions.
+ */
+
+#ifndef ROOMBA_BUILD_H_
+#define ROOMBA_BUILD_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** 0 if condition holds, a negative array size compile error otherwise */
+#define ROOMBA_CHECK(condition) (0 * sizeof(char[(condition) ? 1 : -1]))
+
+#define ROOMBA_IN_RANGE(v, lo, hi) ((v) >= (lo) && (v) <= (hi))
+
+/* one data byte, checked */
+#define ROOMBA_BYTE_CHECKED(v, condition) \
+  ((uint8_t)((v) + ROOMBA_CHECK(condition)))
+
+/* a 16 bit value as high and low byte, checked */
+#define ROOMBA_WORD_CHECKED(v, condition) \
+  ROOMBA_BYTE_CHECKED(HIGH_BYTE(v), condition), LOW_BYTE(v)
+
+#define ROOMBA_VALID_VELOCITY(v) ROOMBA_IN_RANGE(v, -500, 500)
+/* compared as the int16_t on the wire: 0xFFFF turns in place clockwise */
+#define ROOMBA_VALID_RADIUS(r) (ROOMBA_IN_RANGE(r, -32768, 65535) &&          \
+  (ROOMBA_IN_RANGE((int16_t)(r), -2000, 2000) ||                               \
+   (uint16_t)(r) == ROOMBA_RADIUS_STRAIGHT_POSITIVE ||                         \
+   (uint16_t)(r) == ROOMBA_RADIUS_STRAIGHT_NEGATIVE))
+#define ROOMBA_VALID_PWM(v) ROOMBA_IN_RANGE(v, -255, 255)
+#define ROOMBA_VALID_PACKET(p) (ROOMBA_IN_RANGE(p, 0, 58) || \
+  ROOMBA_IN_RANGE(p, 100, 101) || (p) == 106 || (p) == 107)
+
+/* one packet id, checked */
+#define ROOMBA_PACKET_CHECKED(p) ROOMBA_BYTE_CHECKED(p, ROOMBA_VALID_PACKET(p))
+
+/*
+ * ROOMBA_EACH(m, a, b, ...) expands to m(a), m(b), ... for 1 - 32
+ * arguments; more do not compile.
+ */
+#define ROOMBA_CAT(a, b) ROOMBA_CAT_(a, b)
+#define ROOMBA_CAT_(a, b) a##b
+#define ROOMBA_NARG(...) ROOMBA_NARG_(__VA_ARGS__, 32, 31, 30, 29, 28, 27, \
+  26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, \
+  7, 6, 5, 4, 3, 2, 1, 0)
+#define ROOMBA_NARG_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, \
+  _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, \
+  _29, _30, _31, _32, n, ...) n
+#define ROOMBA_EACH(m, ...) \
+  ROOMBA_CAT(ROOMBA_EACH_, ROOMBA_NARG(__VA_ARGS__))(m, __VA_ARGS__)
+#define ROOMBA_EACH_1(m, a) m(a)
+#define ROOMBA_EACH_2(m, a, ...) m(a), ROOMBA_EACH_1(m, __VA_ARGS__)
+#define ROOMBA_EACH_3(m, a, ...) m(a), ROOMBA_EACH_2(m, __VA_ARGS__)
+#define ROOMBA_EACH_4(m, a, ...) m(a), ROOMBA_EACH_3(m, __VA_ARGS__)
+#define ROOMBA_EACH_5(m, a, ...) m(a), ROOMBA_EACH_4(m, __VA_ARGS__)
+#define ROOMBA_EACH_6(m, a, ...) m(a), ROOMBA_EACH_5(m, __VA_ARGS__)
+#define ROOMBA_EACH_7(m, a, ...) m(a), ROOMBA_EACH_6(m, __VA_ARGS__)
+#define ROOMBA_EACH_8(m, a, ...) m(a), ROOMBA_EACH_7(m, __VA_ARGS__)
+#define ROOMBA_EACH_9(m, a, ...) m(a), ROOMBA_EACH_8(m, __VA_ARGS__)
+#define ROOMBA_EACH_10(m, a, ...) m(a), ROOMBA_EACH_9(m, __VA_ARGS__)
+#define ROOMBA_EACH_11(m, a, ...) m(a), ROOMBA_EACH_10(m, __VA_ARGS__)
+#define ROOMBA_EACH_12(m, a, ...) m(a), ROOMBA_EACH_11(m, __VA_ARGS__)
+#define ROOMBA_EACH_13(m, a, ...) m(a), ROOMBA_EACH_12(m, __VA_ARGS__)
+#define ROOMBA_EACH_14(m, a, ...) m(a), ROOMBA_EACH_13(m, __VA_ARGS__)
+#define ROOMBA_EACH_15(m, a, ...) m(a), ROOMBA_EACH_14(m, __VA_ARGS__)
+#define ROOMBA_EACH_16(m, a, ...) m(a), ROOMBA_EACH_15(m, __VA_ARGS__)
+#define ROOMBA_EACH_17(m, a, ...) m(a), ROOMBA_EACH_16(m, __VA_ARGS__)
+#define ROOMBA_EACH_18(m, a, ...) m(a), ROOMBA_EACH_17(m, __VA_ARGS__)
+#define ROOMBA_EACH_19(m, a, ...) m(a), ROOMBA_EACH_18(m, __VA_ARGS__)
+#define ROOMBA_EACH_20(m, a, ...) m(a), ROOMBA_EACH_19(m, __VA_ARGS__)
+#define ROOMBA_EACH_21(m, a, ...) m(a), ROOMBA_EACH_20(m, __VA_ARGS__)
+#define ROOMBA_EACH_22(m, a, ...) m(a), ROOMBA_EACH_21(m, __VA_ARGS__)
+#define ROOMBA_EACH_23(m, a, ...) m(a), ROOMBA_EACH_22(m, __VA_ARGS__)
+#define ROOMBA_EACH_24(m, a, ...) m(a), ROOMBA_EACH_23(m, __VA_ARGS__)
+#define ROOMBA_EACH_25(m, a, ...) m(a), ROOMBA_EACH_24(m, __VA_ARGS__)
+#define ROOMBA_EACH_26(m, a, ...) m(a), ROOMBA_EACH_25(m, __VA_ARGS__)
+#define ROOMBA_EACH_27(m, a, ...) m(a), ROOMBA_EACH_26(m, __VA_ARGS__)
+#define ROOMBA_EACH_28(m, a, ...) m(a), ROOMBA_EACH_27(m, __VA_ARGS__)
+#define ROOMBA_EACH_29(m, a, ...) m(a), ROOMBA_EACH_28(m, __VA_ARGS__)
+#define ROOMBA_EACH_30(m, a, ...) m(a), ROOMBA_EACH_29(m, __VA_ARGS__)
+#define ROOMBA_EACH_31(m, a, ...) m(a), ROOMBA_EACH_30(m, __VA_ARGS__)
+#define ROOMBA_EACH_32(m, a, ...) m(a), ROOMBA_EACH_31(m, __VA_ARGS__)
+
+#if ROOMBA_INTERFACE_VERSION==2
+  #define ROOMBA_SONG_NUMBERS 5
+#else
+  #define ROOMBA_SONG_NUMBERS 4
+#endif
+
+/* Commands without data bytes */
+#define ROOMBA_CMD_START { ROOMBA_START }
+#define ROOMBA_CMD_SAFE { ROOMBA_SAFE }
+#define ROOMBA_CMD_FULL { ROOMBA_FULL }
+#define ROOMBA_CMD_POWER { ROOMBA_POWER }
+#define ROOMBA_CMD_SPOT { ROOMBA_SPOT }
+#define ROOMBA_CMD_SEEK_DOCK { ROOMBA_SEEK_DOCK }
+#define ROOMBA_CMD_RESET { ROOMBA_RESET }
+/** Control (130), Safe under interface 2 */
+#define ROOMBA_CMD_CONTROL { ROOMBA_CONTROL }
+#if ROOMBA_INTERFACE_VERSION==2
+  #define ROOMBA_CMD_CLEAN { ROOMBA_CLEAN }
+  #define ROOMBA_CMD_MAX { ROOMBA_MAX }
+  #define ROOMBA_CMD_STOP { ROOMBA_STOP }
+#else
+  #define ROOMBA_CMD_COVER { ROOMBA_COVER }
+#endif
+
+#define ROOMBA_CMD_BAUD(code) \
+  { ROOMBA_BAUD, ROOMBA_BYTE_CHECKED(code, ROOMBA_IN_RANGE(code, 0, 11)) }
+
+/** @param velocity mm/s @param radius mm or a ROOMBA_RADIUS_* value */
+#define ROOMBA_CMD_DRIVE(velocity, radius) { ROOMBA_DRIVE,                      \
+  ROOMBA_WORD_CHECKED(velocity, ROOMBA_VALID_VELOCITY(velocity)),               \
+  ROOMBA_WORD_CHECKED(radius, ROOMBA_VALID_RADIUS(radius)) }
+
+#define ROOMBA_CMD_DRIVE_DIRECT(right, left) { ROOMBA_DRIVE_DIRECT,             \
+  ROOMBA_WORD_CHECKED(right, ROOMBA_VALID_VELOCITY(right)),                     \
+  ROOMBA_WORD_CHECKED(left, ROOMBA_VALID_VELOCITY(left)) }
+
+#define ROOMBA_CMD_DRIVE_PWM(right, left) { ROOMBA_DRIVE_PWM,                   \
+  ROOMBA_WORD_CHECKED(right, ROOMBA_VALID_PWM(right)),                          \
+  ROOMBA_WORD_CHECKED(left, ROOMBA_VALID_PWM(left)) }
+
+#define ROOMBA_CMD_MOTORS(motors) \
+  { ROOMBA_MOTORS, ROOMBA_BYTE_CHECKED(motors, ROOMBA_IN_RANGE(motors, 0, 31)) }
+
+/** @param main_brush side_brush -127 - 127 @param vacuum 0 - 127 */
+#define ROOMBA_CMD_PWM_MOTORS(main_brush, side_brush, vacuum)                  \
+  { ROOMBA_PWM_MOTORS,                                                         \
+    ROOMBA_BYTE_CHECKED(main_brush, ROOMBA_IN_RANGE(main_brush, -127, 127)),   \
+    ROOMBA_BYTE_CHECKED(side_brush, ROOMBA_IN_RANGE(side_brush, -127, 127)),   \
+    ROOMBA_BYTE_CHECKED(vacuum, ROOMBA_IN_RANGE(vacuum, 0, 127)) }
+
+/** @param color 0 green - 255 red */
+#define ROOMBA_CMD_LEDS(leds, color, intensity) { ROOMBA_LEDS,                  \
+  ROOMBA_BYTE_CHECKED(leds, ROOMBA_IN_RANGE(leds, 0, 255)),                     \
+  ROOMBA_BYTE_CHECKED(color, ROOMBA_IN_RANGE(color, 0, 255)),                   \
+  ROOMBA_BYTE_CHECKED(intensity, ROOMBA_IN_RANGE(intensity, 0, 255)) }
+
+/**
+ * @param length number of notes, 1 - 16
+ * @param ... note number (31 - 127) and duration (1/64 s) pairs. Their count
+ * must be 2 x length.
+ */
+#define ROOMBA_CMD_SONG(number, length, ...) { ROOMBA_SONG,                    \
+  ROOMBA_BYTE_CHECKED(number, ROOMBA_IN_RANGE(number, 0,                        \
+    ROOMBA_SONG_NUMBERS - 1)),                                                  \
+  ROOMBA_BYTE_CHECKED(length, ROOMBA_IN_RANGE(length, 1, 16) &&                 \
+    sizeof((uint8_t[]){ __VA_ARGS__ }) == 2 * (length)),                        \
+  __VA_ARGS__ }
+
+#define ROOMBA_CMD_PLAY(number) { ROOMBA_PLAY,                                 \
+  ROOMBA_BYTE_CHECKED(number, ROOMBA_IN_RANGE(number, 0,                        \
+    ROOMBA_SONG_NUMBERS - 1)) }
+
+#define ROOMBA_CMD_SENSORS(packet) \
+  { ROOMBA_SENSORS, ROOMBA_BYTE_CHECKED(packet, ROOMBA_VALID_PACKET(packet)) }
+
+/**
+ * @param ... 1 - 32 packet ids, each checked; the count is derived from them
+ */
+#define ROOMBA_CMD_QUERY_LIST(...) { ROOMBA_QUERY_LIST,                         \
+  (uint8_t)ROOMBA_NARG(__VA_ARGS__),                                           \
+  ROOMBA_EACH(ROOMBA_PACKET_CHECKED, __VA_ARGS__) }
+
+/** @param ... as for ROOMBA_CMD_QUERY_LIST */
+#define ROOMBA_CMD_STREAM(...) { ROOMBA_STREAM,                                 \
+  (uint8_t)ROOMBA_NARG(__VA_ARGS__),                                           \
+  ROOMBA_EACH(ROOMBA_PACKET_CHECKED, __VA_ARGS__) }
+
+#define ROOMBA_CMD_PAUSE_RESUME_STREAM(resume) \
+  { ROOMBA_PAUSE_RESUME_STREAM, (uint8_t)((resume) ? 1 : 0) }
+
+#if ROOMBA_INTERFACE_VERSION==2
+
+#define ROOMBA_CMD_SCHEDULING_LEDS(weekdays, scheduling)                       \
+  { ROOMBA_SCHEDULING_LEDS,                                                    \
+    ROOMBA_BYTE_CHECKED(weekdays, ROOMBA_IN_RANGE(weekdays, 0, 127)),          \
+    ROOMBA_BYTE_CHECKED(scheduling, ROOMBA_IN_RANGE(scheduling, 0, 31)) }
+
+#define ROOMBA_CMD_DIGIT_LEDS_RAW(d3, d2, d1, d0)                              \
+  { ROOMBA_DIGIT_LEDS_RAW,                                                     \
+    ROOMBA_BYTE_CHECKED(d3, ROOMBA_IN_RANGE(d3, 0, 127)),                      \
+    ROOMBA_BYTE_CHECKED(d2, ROOMBA_IN_RANGE(d2, 0, 127)),                      \
+    ROOMBA_BYTE_CHECKED(d1, ROOMBA_IN_RANGE(d1, 0, 127)),                      \
+    ROOMBA_BYTE_CHECKED(d0, ROOMBA_IN_RANGE(d0, 0, 127)) }
+
+/** Printable ASCII 32 - 126, digit 3 is the leftmost */
+#define ROOMBA_CMD_DIGIT_LEDS_ASCII(d3, d2, d1, d0)                            \
+  { ROOMBA_DIGIT_LEDS_ASCII,                                                   \
+    ROOMBA_BYTE_CHECKED(d3, ROOMBA_IN_RANGE(d3, 32, 126)),                     \
+    ROOMBA_BYTE_CHECKED(d2, ROOMBA_IN_RANGE(d2, 32, 126)),                     \
+    ROOMBA_BYTE_CHECKED(d1, ROOMBA_IN_RANGE(d1, 32, 126)),                     \
+    ROOMBA_BYTE_CHECKED(d0, ROOMBA_IN_RANGE(d0, 32, 126)) }
+
+#define ROOMBA_CMD_BUTTONS(buttons) \
+  { ROOMBA_BUTTONS_CMD, ROOMBA_BYTE_CHECKED(buttons, \
+    ROOMBA_IN_RANGE(buttons, 0, 255)) }
+
+/** @param day 0 Sunday - 6 Saturday */
+#define ROOMBA_CMD_SET_DAY_TIME(day, hour, minute) { ROOMBA_SET_DAY_TIME,       \
+  ROOMBA_BYTE_CHECKED(day, ROOMBA_IN_RANGE(day, 0, 6)),                         \
+  ROOMBA_BYTE_CHECKED(hour, ROOMBA_IN_RANGE(hour, 0, 23)),                      \
+  ROOMBA_BYTE_CHECKED(minute, ROOMBA_IN_RANGE(minute, 0, 59)) }
+
+#define ROOMBA_SCHEDULE_TIME(hour, minute)                                     \
+  ROOMBA_BYTE_CHECKED(hour, ROOMBA_IN_RANGE(hour, 0, 23)),                      \
+  ROOMBA_BYTE_CHECKED(minute, ROOMBA_IN_RANGE(minute, 0, 59))
+
+/** @param days bit 0 Sunday - bit 6 Saturday, times Sunday first */
+#define ROOMBA_CMD_SCHEDULE(days, sun_h, sun_m, mon_h, mon_m, tue_h, tue_m,    \
+  wed_h, wed_m, thu_h, thu_m, fri_h, fri_m, sat_h, sat_m) { ROOMBA_SCHEDULE,   \
+  ROOMBA_BYTE_CHECKED(days, ROOMBA_IN_RANGE(days, 0, 127)),                     \
+  ROOMBA_SCHEDULE_TIME(sun_h, sun_m), ROOMBA_SCHEDULE_TIME(mon_h, mon_m),       \
+  ROOMBA_SCHEDULE_TIME(tue_h, tue_m), ROOMBA_SCHEDULE_TIME(wed_h, wed_m),       \
+  ROOMBA_SCHEDULE_TIME(thu_h, thu_m), ROOMBA_SCHEDULE_TIME(fri_h, fri_m),       \
+  ROOMBA_SCHEDULE_TIME(sat_h, sat_m) }
+
+#else
+
+#define ROOMBA_CMD_DEMO(demo) \
+  { ROOMBA_DEMO, ROOMBA_BYTE_CHECKED(demo, ROOMBA_IN_RANGE(demo, -1, 9)) }
+
+/** @param outputs bit 0 - 2 for digital outputs 0 - 2 */
+#define ROOMBA_CMD_DIGITAL_OUTPUTS(outputs) { DIGITAL_OUTPUTS,                 \
+  ROOMBA_BYTE_CHECKED(outputs, ROOMBA_IN_RANGE(outputs, 0, 7)) }
+
+#define ROOMBA_CMD_SEND_IR(value) \
+  { SEND_IR, ROOMBA_BYTE_CHECKED(value, ROOMBA_IN_RANGE(value, 0, 255)) }
+
+/**
+ * @param ... the encoded commands of the script, e.g. the bytes of
+ * ROOMBA_CMD_DRIVE and ROOMBA_CMD_WAIT_DISTANCE, at most 100
+ */
+#define ROOMBA_CMD_SCRIPT(...) { SCRIPT,                                       \
+  ROOMBA_BYTE_CHECKED(sizeof((uint8_t[]){ __VA_ARGS__ }),                       \
+    sizeof((uint8_t[]){ __VA_ARGS__ }) <= 100),                                 \
+  __VA_ARGS__ }
+
+/** Script (152) of length 0, clears the stored script */
+#define ROOMBA_CMD_SCRIPT_CLEAR { SCRIPT, 0 }
+#define ROOMBA_CMD_PLAY_SCRIPT { PLAY_SCRIPT }
+#define ROOMBA_CMD_SHOW_SCRIPT { SHOW_SCRIPT }
+
+/** @param time tenths of a second */
+#define ROOMBA_CMD_WAIT_TIME(time) \
+  { WAIT_TIME, ROOMBA_BYTE_CHECKED(time, ROOMBA_IN_RANGE(time, 0, 255)) }
+
+/** @param distance mm */
+#define ROOMBA_CMD_WAIT_DISTANCE(distance) { WAIT_DISTANCE,                    \
+  ROOMBA_WORD_CHECKED(distance, ROOMBA_IN_RANGE(distance, -32768, 32767)) }
+
+/** @param angle degrees, counterclockwise positive */
+#define ROOMBA_CMD_WAIT_ANGLE(angle) { WAIT_ANGLE,                             \
+  ROOMBA_WORD_CHECKED(angle, ROOMBA_IN_RANGE(angle, -32768, 32767)) }
+
+/** @param event 1 - 22, or its negative to wait for the inverse */
+#define ROOMBA_CMD_WAIT_EVENT(event) { WAIT_EVENT,                             \
+  ROOMBA_BYTE_CHECKED(event, ROOMBA_IN_RANGE(event, 1, 22) ||                   \
+    ROOMBA_IN_RANGE(event, -22, -1)) }
+
+#endif
+
+/**@}*/
+
+#endif /* ROOMBA_BUILD_H_ */
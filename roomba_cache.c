@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include "roomba_cache.h"
+
+static bool single(uint8_t packet) {
+  return packet >= ROOMBA_BUMPS_WHEELDROPS && packet <= ROOMBA_STASIS;
+}
+
+/* copies one packet's value between snapshots */
+static void copy_packet(ROOMBA_PACKET_GROUP_100 *to,
+  const ROOMBA_PACKET_GROUP_100 *from, uint8_t packet) {
+  uint8_t data[2];
+
+  roomba_encode_packet(from, packet, data);
+  roomba_decode_packet(to, packet, data);
+}
+
+/* bytes the robot answers a Sensors (142) or Query List (149) with */
+static uint16_t reply_bytes(const uint8_t data[], uint16_t size) {
+  uint16_t total = 0;
+  int bytes;
+
+  if (size < 2) return 0;
+  switch (data[0]) {
+    case ROOMBA_SENSORS:
+      bytes = get_packet_data_bytes(data[1]);
+      return bytes > 0 ? (uint16_t)bytes : 0;
+    case ROOMBA_QUERY_LIST:
+      for (uint16_t i = 0; i < data[1] && i + 2 < size; i++) {
+        bytes = get_packet_data_bytes(data[i + 2]);
+        if (bytes > 0) total = (uint16_t)(total + bytes);
+      }
+      return total;
+    default:
+      return 0;
+  }
+}
+
+static void cache_write(void *context, const uint8_t data[], uint16_t size) {
+  ROOMBA_CACHE *cache = context;
+
+  if (cache->queried && !cache->sent) {
+    if (size == cache->query_size && memcmp(data, cache->query, size) == 0) {
+      cache->sent = true;
+      cache->reply_size = 0;
+    } else {
+      /* someone else's query: its reply comes first and is not ours */
+      cache->skip = (uint16_t)(cache->skip + reply_bytes(data, size));
+    }
+  }
+  cache->transport.write(cache->transport.context, data, size);
+}
+
+void roomba_cache_init(ROOMBA_CACHE *cache, ROOMBA_STREAM_PARSER *parser,
+  ROOMBA_QUEUE *queue, ROOMBA_TRANSPORT transport, uint32_t now_ms) {
+  memset(cache, 0, sizeof(*cache));
+  cache->parser = parser;
+  cache->queue = queue;
+  cache->transport = transport;
+  cache->now_ms = now_ms;
+  for (uint8_t p = 0; p <= ROOMBA_STASIS; p++) {
+    cache->max_age_ms[p] = ROOMBA_CACHE_MAX_AGE_MS;
+  }
+}
+
+ROOMBA_TRANSPORT roomba_cache_transport(ROOMBA_CACHE *cache) {
+  ROOMBA_TRANSPORT transport;
+
+  transport.write = cache_write;
+  transport.context = cache;
+  return transport;
+}
+
+void roomba_cache_set_max_age(ROOMBA_CACHE *cache, uint8_t packet,
+  uint16_t max_age_ms) {
+  uint64_t mask = roomba_packet_mask(packet);
+
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= ROOMBA_STASIS; p++) {
+    if (mask & ROOMBA_PACKET_BIT(p)) cache->max_age_ms[p] = max_age_ms;
+  }
+}
+
+void roomba_cache_request(ROOMBA_CACHE *cache, uint64_t mask) {
+  uint64_t packets = 0;
+
+  /* a group bit stands for its packets, a bit of no packet for nothing */
+  for (uint8_t p = 0; p < 64; p++) {
+    if (mask & ROOMBA_PACKET_BIT(p)) packets |= roomba_packet_mask(p);
+  }
+  cache->wanted |= packets & ~cache->queried;
+}
+
+void roomba_cache_observe(ROOMBA_CACHE *cache,
+  const ROOMBA_PACKET_GROUP_100 *frame, uint64_t present) {
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= ROOMBA_STASIS; p++) {
+    if (!(present & ROOMBA_PACKET_BIT(p))) continue;
+    copy_packet(&cache->values, frame, p);
+    cache->updated_ms[p] = cache->now_ms;
+  }
+  cache->known |= present;
+  cache->wanted &= ~present;
+}
+
+void roomba_cache_frame_hook(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  roomba_cache_observe(context, frame, parser->present);
+}
+
+static void end_reply(ROOMBA_CACHE *cache) {
+  uint8_t at = 0;
+
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= ROOMBA_STASIS; p++) {
+    if (!(cache->queried & ROOMBA_PACKET_BIT(p))) continue;
+    roomba_decode_packet(&cache->values, p, &cache->reply[at]);
+    at = (uint8_t)(at + get_packet_data_bytes(p));
+    cache->updated_ms[p] = cache->now_ms;
+  }
+  cache->known |= cache->queried;
+  cache->queried = 0;
+  cache->sent = false;
+}
+
+void roomba_cache_receive(ROOMBA_CACHE *cache, const uint8_t data[],
+  uint16_t size) {
+  uint16_t i = 0;
+
+  /* byte by byte only while a reply is due: it must start between frames */
+  while ((cache->sent || cache->skip) && i < size) {
+    if (cache->parser->state == ROOMBA_STREAM_WAIT_HEADER && cache->skip) {
+      cache->skip--;
+    } else if (cache->parser->state == ROOMBA_STREAM_WAIT_HEADER) {
+      cache->reply[cache->reply_size++] = data[i];
+      if (cache->reply_size == cache->reply_expected) end_reply(cache);
+    } else {
+      roomba_stream_parse(cache->parser, &data[i], 1);
+    }
+    i++;
+  }
+  if (i < size) roomba_stream_parse(cache->parser, &data[i], size - i);
+}
+
+void roomba_cache_poll(ROOMBA_CACHE *cache, uint32_t now_ms) {
+  uint8_t command[2 + ROOMBA_CACHE_QUERY_MAX];
+  uint64_t queried = 0;
+  uint8_t count = 0, expected = 0;
+
+  cache->now_ms = now_ms;
+  if (cache->queried) {
+    if (!roomba_expired(now_ms, cache->deadline)) return;
+    cache->stats.timeouts++;
+    cache->wanted |= cache->queried;
+    cache->queried = 0;
+    cache->sent = false;
+    cache->skip = 0;
+  }
+  if (!cache->wanted) return;
+
+  command[0] = ROOMBA_QUERY_LIST;
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS;
+       p <= ROOMBA_STASIS && count < ROOMBA_CACHE_QUERY_MAX; p++) {
+    if (!(cache->wanted & ROOMBA_PACKET_BIT(p))) continue;
+    command[2 + count++] = p;
+    queried |= ROOMBA_PACKET_BIT(p);
+    expected = (uint8_t)(expected + get_packet_data_bytes(p));
+  }
+  command[1] = count;
+  if (!roomba_queue_push(cache->queue, command, (uint8_t)(2 + count))) return;
+
+  memcpy(cache->query, command, (size_t)(2 + count));
+  cache->query_size = (uint8_t)(2 + count);
+  cache->wanted &= ~queried;
+  cache->queried = queried;
+  cache->reply_expected = expected;
+  cache->deadline = now_ms + ROOMBA_CACHE_TIMEOUT_MS;
+  cache->stats.queries++;
+  cache->stats.queried_packets += count;
+}
+
+ROOMBA_CACHE_STATUS roomba_get_packet(ROOMBA_CACHE *cache,
+  ROOMBA_PACKET_CODE code, uint16_t *value) {
+  uint8_t packet = (uint8_t)code, data[2];
+  uint64_t bit;
+
+  if (!single(packet)) return ROOMBA_CACHE_INVALID;
+  bit = ROOMBA_PACKET_BIT(packet);
+  cache->used |= bit;
+  if (cache->known & bit) {
+    *value = roomba_encode_packet(&cache->values, packet, data) == 2 ?
+      (uint16_t)(data[0] << 8 | data[1]) : data[0];
+    if (cache->now_ms - cache->updated_ms[packet] <=
+        cache->max_age_ms[packet]) {
+      cache->stats.hits++;
+      return ROOMBA_CACHE_FRESH;
+    }
+  }
+  cache->stats.misses++;
+  /* callers asking while the query is out share its reply */
+  if (!(cache->queried & bit)) cache->wanted |= bit;
+  return cache->known & bit ? ROOMBA_CACHE_STALE : ROOMBA_CACHE_UNKNOWN;
+}
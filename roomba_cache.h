@@ -0,0 +1,173 @@
+/**
+ * @file roomba_cache.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_cache.h> @endcode
+ *
+ * @brief Read-through sensor cache behind roomba_get_packet
+ *
+ * roomba_get_packet answers from the newest value the cache holds. Values
+ * come from stream frames as they are decoded and from Query List (149)
+ * replies. Every packet has a maximum age; a value older than that is
+ * returned as ROOMBA_CACHE_STALE and the packet is marked wanted.
+ *
+ * roomba_cache_poll gathers everything wanted since the last query into a
+ * single Query List on the ROOMBA_QUEUE, so any number of callers asking for
+ * stale packets within one slot cost one command and one reply. Packets
+ * already in the stream are normally fresh and never queried.
+ *
+ * The reply has no header; it is told apart from the stream by timing. The
+ * cache wraps the scheduler's transport to see when its query leaves, known
+ * by its bytes, then takes the next bytes that arrive between two frames. A
+ * Sensors or Query List another user of the queue sends before it is not
+ * taken for the cache's own; its reply is skipped. This relies on the
+ * scheduler being ticked right after a frame, as roomba_loop does. A reply
+ * that does not come within ROOMBA_CACHE_TIMEOUT_MS is given up and asked
+ * for again.
+ *
+ * @code
+ * roomba_cache_init(&cache, &parser, &queue, uart, now);
+ * roomba_scheduler_init(&scheduler, &queue, roomba_cache_transport(&cache),
+ *   ROOMBA_115200BPS);
+ * roomba_stream_set_frame_hook(&parser, roomba_cache_frame_hook, &cache);
+ * // serial bytes go to roomba_cache_receive instead of roomba_stream_parse
+ * @endcode
+ */
+
+#ifndef ROOMBA_CACHE_H_
+#define ROOMBA_CACHE_H_
+
+#include "roomba.h"
+#include "roomba_stream.h"
+#include "roomba_queue.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** Maximum age of every packet until set otherwise */
+#ifndef ROOMBA_CACHE_MAX_AGE_MS
+  #define ROOMBA_CACHE_MAX_AGE_MS 100
+#endif
+
+#ifndef ROOMBA_CACHE_TIMEOUT_MS
+  #define ROOMBA_CACHE_TIMEOUT_MS 100
+#endif
+
+/** Packets per Query List; the rest wait for the next one */
+#ifndef ROOMBA_CACHE_QUERY_MAX
+  #define ROOMBA_CACHE_QUERY_MAX 16
+#endif
+
+#if ROOMBA_CACHE_QUERY_MAX < 1 || \
+    ROOMBA_CACHE_QUERY_MAX > ROOMBA_COMMAND_MAX_SIZE - 2
+  #error "ROOMBA_CACHE_QUERY_MAX must be 1 - 33"
+#endif
+
+typedef enum {
+  /** Value no older than the packet's maximum age */
+  ROOMBA_CACHE_FRESH,
+  /** Older value returned, a query is on its way */
+  ROOMBA_CACHE_STALE,
+  /** No value yet, a query is on its way */
+  ROOMBA_CACHE_UNKNOWN,
+  /** Not a single value packet */
+  ROOMBA_CACHE_INVALID,
+} ROOMBA_CACHE_STATUS;
+
+typedef struct _roomba_cache_stats {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t queries;
+  /** Packets asked for in all queries */
+  uint32_t queried_packets;
+  uint32_t timeouts;
+} ROOMBA_CACHE_STATS;
+
+typedef struct _roomba_cache {
+  ROOMBA_STREAM_PARSER *parser;
+  ROOMBA_QUEUE *queue;
+  /** Where the wrapped transport writes to */
+  ROOMBA_TRANSPORT transport;
+  ROOMBA_PACKET_GROUP_100 values;
+  /** ROOMBA_PACKET_BIT of packets with a value */
+  uint64_t known;
+  /** Stale packets asked for since the last query */
+  uint64_t wanted;
+  /** Packets of the query in the queue or on the wire */
+  uint64_t queried;
+  /** Packets read with roomba_get_packet, cleared by the user only */
+  uint64_t used;
+  /** The query has been written, its reply is due */
+  bool sent;
+  /** The query as pushed, to recognise it when it is written */
+  uint8_t query_size;
+  uint8_t query[2 + ROOMBA_CACHE_QUERY_MAX];
+  /** Bytes of other replies due before the cache's own */
+  uint16_t skip;
+  uint8_t reply_size;
+  uint8_t reply_expected;
+  uint8_t reply[2 * ROOMBA_CACHE_QUERY_MAX];
+  uint32_t now_ms;
+  uint32_t deadline;
+  uint16_t max_age_ms[ROOMBA_STASIS + 1];
+  uint32_t updated_ms[ROOMBA_STASIS + 1];
+  ROOMBA_CACHE_STATS stats;
+} ROOMBA_CACHE;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * @param queue the queries are pushed here
+ * @param transport the serial port, see roomba_cache_transport
+ */
+void roomba_cache_init(ROOMBA_CACHE *cache, ROOMBA_STREAM_PARSER *parser,
+  ROOMBA_QUEUE *queue, ROOMBA_TRANSPORT transport, uint32_t now_ms);
+
+/** Transport to give the scheduler: writes through and notes the query */
+ROOMBA_TRANSPORT roomba_cache_transport(ROOMBA_CACHE *cache);
+
+/** @param packet a single value packet or a group */
+void roomba_cache_set_max_age(ROOMBA_CACHE *cache, uint8_t packet,
+  uint16_t max_age_ms);
+
+/**
+ * Has the next query ask for packets whatever their age, e.g. to refresh
+ * them on a schedule; packets of the query on its way are not asked again
+ *
+ * @param mask ROOMBA_PACKET_BIT of the packets; the bits of groups 0 - 6
+ * ask for their packets, bits of no packet are ignored
+ */
+void roomba_cache_request(ROOMBA_CACHE *cache, uint64_t mask);
+
+/** Takes the packets in present from a decoded frame */
+void roomba_cache_observe(ROOMBA_CACHE *cache,
+  const ROOMBA_PACKET_GROUP_100 *frame, uint64_t present);
+
+/** ROOMBA_FRAME_HOOK calling roomba_cache_observe, context is the cache */
+void roomba_cache_frame_hook(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context);
+
+/** Feeds received bytes; everything but the query reply goes to the parser */
+void roomba_cache_receive(ROOMBA_CACHE *cache, const uint8_t data[],
+  uint16_t size);
+
+/**
+ * Advances the cache clock, gives up late replies and queues the query for
+ * the wanted packets. Call once per slot, before roomba_scheduler_tick.
+ */
+void roomba_cache_poll(ROOMBA_CACHE *cache, uint32_t now_ms);
+
+/**
+ * @param value the packet's value, signed packets as their two's complement;
+ * untouched unless FRESH or STALE
+ */
+ROOMBA_CACHE_STATUS roomba_get_packet(ROOMBA_CACHE *cache,
+  ROOMBA_PACKET_CODE code, uint16_t *value);
+
+/**@}*/
+
+#endif /* ROOMBA_CACHE_H_ */
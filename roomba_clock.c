@@ -0,0 +1,77 @@
+#include "roomba_clock.h"
+
+/* new slope estimates are blended in with a weight of 1/4 */
+#define DRIFT_SHIFT 2
+
+/* host and robot clocks agree far better than 1 % */
+#define MAX_DRIFT_Q16 ((ROOMBA_TICK_NS / 100) << 16)
+
+/* offset of the envelope line at a tick */
+static inline int64_t line(const ROOMBA_CLOCK *clock, int64_t tick) {
+  return clock->anchor.offset_ns +
+    (((tick - clock->anchor.tick) * clock->drift_q16) >> 16);
+}
+
+static void end_window(ROOMBA_CLOCK *clock) {
+  ROOMBA_CLOCK_POINT *a = &clock->previous_min, *b = &clock->window_min;
+
+  if (clock->window_start > 0 && b->tick > a->tick) {
+    int64_t slope = (b->offset_ns - a->offset_ns) * (1 << 16) /
+      (b->tick - a->tick);
+    clock->drift_q16 += (slope - clock->drift_q16) >> DRIFT_SHIFT;
+    if (clock->drift_q16 > MAX_DRIFT_Q16) clock->drift_q16 = MAX_DRIFT_Q16;
+    if (clock->drift_q16 < -MAX_DRIFT_Q16) clock->drift_q16 = -MAX_DRIFT_Q16;
+  }
+  /* re-anchoring also lets the line rise when the latency floor does */
+  clock->anchor = *b;
+  *a = *b;
+  clock->window_start = clock->tick;
+  b->offset_ns = INT64_MAX;
+}
+
+void roomba_clock_init(ROOMBA_CLOCK *clock) {
+  clock->origin_ns = 0;
+  clock->tick = 0;
+  clock->last_ns = 0;
+  clock->drift_q16 = 0;
+  clock->anchor.tick = 0;
+  clock->anchor.offset_ns = 0;
+  clock->window_min = clock->anchor;
+  clock->previous_min = clock->anchor;
+  clock->window_start = 0;
+  clock->frames = 0;
+  clock->lost = 0;
+}
+
+int64_t roomba_clock_update(ROOMBA_CLOCK *clock, int64_t arrival_ns) {
+  int64_t period = roomba_clock_period(clock);
+  int64_t ticks, offset;
+
+  if (clock->frames++ == 0) {
+    clock->origin_ns = arrival_ns;
+    clock->last_ns = arrival_ns;
+    return arrival_ns;
+  }
+
+  ticks = (arrival_ns - clock->last_ns + period / 2) / period;
+  if (ticks < 1) ticks = 1;
+  clock->lost += (uint32_t)(ticks - 1);
+  clock->tick += ticks;
+
+  offset = arrival_ns - clock->origin_ns - clock->tick * ROOMBA_TICK_NS;
+  if (offset < line(clock, clock->tick)) {
+    clock->anchor.tick = clock->tick;
+    clock->anchor.offset_ns = offset;
+  }
+  if (offset < clock->window_min.offset_ns) {
+    clock->window_min.tick = clock->tick;
+    clock->window_min.offset_ns = offset;
+  }
+  if (clock->tick - clock->window_start >= ROOMBA_CLOCK_WINDOW) {
+    end_window(clock);
+  }
+
+  clock->last_ns = clock->origin_ns + clock->tick * ROOMBA_TICK_NS +
+    line(clock, clock->tick);
+  return clock->last_ns;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file roomba_clock.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_clock.h> @endcode
+ *
+ * @brief Recovers the robot's 15 ms stream tick from jittery host arrival
+ * times
+ *
+ * USB serial adapters deliver bytes in batches, so a frame is seen anywhere
+ * from a fraction of a millisecond to several milliseconds after the robot
+ * sent it, but never before. Plotted against the tick number, arrival times
+ * therefore lie on or above a straight line whose slope is the robot's true
+ * tick. The estimator follows that lower envelope:
+ *   - an arrival below the line moves the line down to it at once;
+ *   - every window of ROOMBA_CLOCK_WINDOW ticks, the line is re-anchored on
+ *     the earliest arrival of the window, and the slope is trimmed towards
+ *     the one between the earliest arrivals of the last two windows.
+ *
+ * Each frame gets its point on the line as corrected timestamp. State is a
+ * few words per robot and each update is constant time, so timestamps of
+ * different robots can be compared directly.
+ *
+ * @note A frame seen more than half a period after its point on the line is
+ * taken for the next tick, i.e. counted as a lost frame. Keep the adapter
+ * latency timer well under 7.5 ms (1 ms for FTDI).
+ */
+
+#ifndef ROOMBA_CLOCK_H_
+#define ROOMBA_CLOCK_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#define ROOMBA_TICK_NS 15000000LL
+
+/** Ticks per envelope window, about 2 s */
+#ifndef ROOMBA_CLOCK_WINDOW
+  #define ROOMBA_CLOCK_WINDOW 128
+#endif
+
+/** A point (tick, offset) where offset = arrival - first arrival - tick * 15 ms */
+typedef struct _roomba_clock_point {
+  int64_t tick;
+  int64_t offset_ns;
+} ROOMBA_CLOCK_POINT;
+
+typedef struct _roomba_clock {
+  int64_t origin_ns;
+  /** Tick number of the last frame */
+  int64_t tick;
+  /** Corrected timestamp of the last frame, ns in the host clock */
+  int64_t last_ns;
+  /** Slope of the envelope relative to 15 ms, ns per tick << 16 */
+  int64_t drift_q16;
+  ROOMBA_CLOCK_POINT anchor;
+  ROOMBA_CLOCK_POINT window_min;
+  ROOMBA_CLOCK_POINT previous_min;
+  int64_t window_start;
+  uint32_t frames;
+  /** Ticks without a frame, i.e. frames lost between two arrivals */
+  uint32_t lost;
+} ROOMBA_CLOCK;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+void roomba_clock_init(ROOMBA_CLOCK *clock);
+
+/**
+ * @param arrival_ns host time the frame was received, e.g. CLOCK_MONOTONIC
+ * @return corrected timestamp of the frame
+ */
+int64_t roomba_clock_update(ROOMBA_CLOCK *clock, int64_t arrival_ns);
+
+/** @return current tick estimate in ns */
+static inline int64_t roomba_clock_period(const ROOMBA_CLOCK *clock) {
+  return ROOMBA_TICK_NS + (clock->drift_q16 >> 16);
+}
+
+/**@}*/
+
+#endif /* ROOMBA_CLOCK_H_ */
@@ -0,0 +1,159 @@
+#include <math.h>
+#include <string.h>
+
+#include "roomba_ekf.h"
+
+#define N ROOMBA_EKF_STATES
+#define DEG_TO_RAD 0.0174532925f
+
+/* caster is only meaningful when driving forward and roughly straight */
+#define STASIS_MIN_VELOCITY 50.0f
+#define STASIS_MAX_YAW_RATE 0.2f
+
+static const ROOMBA_EKF_NOISE default_noise = {
+  .process_velocity = 250000.0f,
+  .process_yaw_rate = 9.0f,
+  .encoder_velocity = 20.0f,
+  .encoder_yaw_rate = 0.1f,
+  .angle_resolution = 1.0f,
+  .requested_velocity = 150.0f,
+  .requested_yaw_rate = 1.0f,
+  .stasis_velocity = 5.0f,
+};
+
+/*
+ * Kalman update for a measurement of a single state variable. With H = e_i
+ * the innovation covariance is P[i][i] + r and the gain is column i of P.
+ */
+static void observe(ROOMBA_EKF *ekf, uint8_t i, float z, float sigma) {
+  float (*P)[N] = ekf->covariance;
+  float row[N];
+  float s = P[i][i] + sigma * sigma;
+  float innovation = z - ekf->state[i];
+
+  memcpy(row, P[i], sizeof(row));
+  for (uint8_t j = 0; j < N; j++) {
+    float k = row[j] / s;
+    ekf->state[j] += k * innovation;
+    for (uint8_t l = 0; l < N; l++) {
+      P[j][l] -= k * row[l];
+    }
+  }
+}
+
+/*
+ * Unicycle prediction. F only differs from the identity in five entries, so
+ * F P F' is expanded by hand instead of doing two dense products.
+ */
+static void predict(ROOMBA_EKF *ekf, float dt) {
+  float *x = ekf->state;
+  float (*P)[N] = ekf->covariance;
+  float c = cosf(x[ROOMBA_EKF_THETA]);
+  float s = sinf(x[ROOMBA_EKF_THETA]);
+  float v = x[ROOMBA_EKF_VELOCITY];
+  float f02 = -v * dt * s, f03 = dt * c;
+  float f12 = v * dt * c, f13 = dt * s;
+  float f24 = dt;
+  float fp[N][N];
+
+  x[ROOMBA_EKF_X] += v * dt * c;
+  x[ROOMBA_EKF_Y] += v * dt * s;
+  x[ROOMBA_EKF_THETA] += x[ROOMBA_EKF_YAW_RATE] * dt;
+
+  /* fp = F P */
+  for (uint8_t j = 0; j < N; j++) {
+    fp[0][j] = P[0][j] + f02 * P[2][j] + f03 * P[3][j];
+    fp[1][j] = P[1][j] + f12 * P[2][j] + f13 * P[3][j];
+    fp[2][j] = P[2][j] + f24 * P[4][j];
+    fp[3][j] = P[3][j];
+    fp[4][j] = P[4][j];
+  }
+  /* P = fp F' */
+  for (uint8_t i = 0; i < N; i++) {
+    P[i][0] = fp[i][0] + fp[i][2] * f02 + fp[i][3] * f03;
+    P[i][1] = fp[i][1] + fp[i][2] * f12 + fp[i][3] * f13;
+    P[i][2] = fp[i][2] + fp[i][4] * f24;
+    P[i][3] = fp[i][3];
+    P[i][4] = fp[i][4];
+  }
+  P[3][3] += ekf->noise.process_velocity * dt;
+  P[4][4] += ekf->noise.process_yaw_rate * dt;
+}
+
+/* commanded (v, omega), from Drive Direct when set, Drive otherwise */
+static void requested_motion(const ROOMBA_EKF_INPUT *in, float *v,
+  float *omega) {
+  if (in->velocity_left != 0 || in->velocity_right != 0) {
+    *v = 0.5f * (float)(in->velocity_left + in->velocity_right);
+    *omega = (float)(in->velocity_right - in->velocity_left) /
+      (float)ROOMBA_WHEEL_BASE_MM;
+    return;
+  }
+  *v = (float)in->velocity;
+  switch ((uint16_t)in->radius) {
+    case ROOMBA_RADIUS_STRAIGHT_POSITIVE:
+    case ROOMBA_RADIUS_STRAIGHT_NEGATIVE:
+      *omega = 0.0f;
+      break;
+    case ROOMBA_RADIUS_CLOCKWISE:
+    case ROOMBA_RADIUS_COUNTER_CLOCKWISE:
+      *omega = (float)in->radius * 2.0f * *v / (float)ROOMBA_WHEEL_BASE_MM;
+      *v = 0.0f;
+      break;
+    default:
+      *omega = in->radius == 0 ? 0.0f : *v / (float)in->radius;
+      break;
+  }
+}
+
+void roomba_ekf_init(ROOMBA_EKF *ekf, const ROOMBA_EKF_NOISE *noise) {
+  memset(ekf, 0, sizeof(*ekf));
+  ekf->noise = noise ? *noise : default_noise;
+  /* pose is exact at the origin, velocities are unknown */
+  ekf->covariance[ROOMBA_EKF_VELOCITY][ROOMBA_EKF_VELOCITY] = 500.0f * 500.0f;
+  ekf->covariance[ROOMBA_EKF_YAW_RATE][ROOMBA_EKF_YAW_RATE] = 4.0f;
+}
+
+void roomba_ekf_update(ROOMBA_EKF *ekf, const ROOMBA_EKF_INPUT *input,
+  float dt) {
+  const ROOMBA_EKF_NOISE *n = &ekf->noise;
+  int16_t dl, dr;
+  float requested_v, requested_omega;
+  float encoder_sigma = 1.0f;
+
+  if (!ekf->primed || dt <= 0.0f) {
+    ekf->last_left = input->encoder_counts_left;
+    ekf->last_right = input->encoder_counts_right;
+    ekf->primed = true;
+    return;
+  }
+  dl = (int16_t)(uint16_t)(input->encoder_counts_left - ekf->last_left);
+  dr = (int16_t)(uint16_t)(input->encoder_counts_right - ekf->last_right);
+  ekf->last_left = input->encoder_counts_left;
+  ekf->last_right = input->encoder_counts_right;
+
+  predict(ekf, dt);
+  requested_motion(input, &requested_v, &requested_omega);
+
+  /*
+   * The caster stops while the commanded motion is forward and straight:
+   * the wheels are slipping, so trust it over the encoders this frame.
+   */
+  if (!input->stasis && requested_v > STASIS_MIN_VELOCITY &&
+      fabsf(requested_omega) < STASIS_MAX_YAW_RATE) {
+    observe(ekf, ROOMBA_EKF_VELOCITY, 0.0f, n->stasis_velocity);
+    encoder_sigma = 10.0f;
+  }
+
+  observe(ekf, ROOMBA_EKF_VELOCITY,
+    (float)(dl + dr) * (float)(0.5 * ROOMBA_MM_PER_ENCODER_COUNT) / dt,
+    n->encoder_velocity * encoder_sigma);
+  observe(ekf, ROOMBA_EKF_YAW_RATE,
+    (float)(dr - dl) * (float)(1.0 / ROOMBA_WHEEL_BASE_COUNTS) / dt,
+    n->encoder_yaw_rate * encoder_sigma);
+  /* packet 20 is truncated to whole degrees: uniform error of one step */
+  observe(ekf, ROOMBA_EKF_YAW_RATE, (float)input->angle * DEG_TO_RAD / dt,
+    n->angle_resolution * DEG_TO_RAD / dt * 0.288675f);
+  observe(ekf, ROOMBA_EKF_VELOCITY, requested_v, n->requested_velocity);
+  observe(ekf, ROOMBA_EKF_YAW_RATE, requested_omega, n->requested_yaw_rate);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file roomba_ekf.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_ekf.h> @endcode
+ *
+ * @brief Extended Kalman filter that fuses the wheel encoders, the angle
+ * packet, the requested velocities and the stasis caster into a pose with
+ * covariance
+ *
+ * The state is [x, y, theta, v, omega] in mm, rad, mm/s and rad/s. Each frame
+ * runs one prediction followed by a scalar update per sensor. Every
+ * measurement observes v or omega directly, so the Kalman gain is a column of
+ * the covariance divided by a scalar and no matrix is ever inverted. All
+ * storage is fixed size and lives inside ROOMBA_EKF.
+ *
+ * | Sensor                      | Packets | Observes          |
+ * |-----------------------------|---------|-------------------|
+ * | Encoder counts              | 43, 44  | v, omega          |
+ * | Angle                       | 20      | omega             |
+ * | Requested velocity / radius | 39, 40  | v, omega          |
+ * | Requested wheel velocities  | 41, 42  | v, omega          |
+ * | Stasis                      | 58      | v = 0 when stuck  |
+ */
+
+#ifndef ROOMBA_EKF_H_
+#define ROOMBA_EKF_H_
+
+#include "roomba.h"
+#include "roomba_odometry.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+typedef enum {
+  ROOMBA_EKF_X,
+  ROOMBA_EKF_Y,
+  ROOMBA_EKF_THETA,
+  ROOMBA_EKF_VELOCITY,
+  ROOMBA_EKF_YAW_RATE,
+  ROOMBA_EKF_STATES,
+} ROOMBA_EKF_STATE;
+
+/**
+ * Noise model. Process terms are spectral densities, measurement terms are
+ * standard deviations in the units of the observed state.
+ */
+typedef struct _roomba_ekf_noise {
+  /** Linear acceleration, (mm/s^2)^2 s */
+  float process_velocity;
+  /** Angular acceleration, (rad/s^2)^2 s */
+  float process_yaw_rate;
+  /** mm/s */
+  float encoder_velocity;
+  /** rad/s */
+  float encoder_yaw_rate;
+  /** Resolution of packet 20 in degrees, spread as a uniform error */
+  float angle_resolution;
+  /** mm/s */
+  float requested_velocity;
+  /** rad/s */
+  float requested_yaw_rate;
+  /** mm/s, applied when the caster reports no progress */
+  float stasis_velocity;
+} ROOMBA_EKF_NOISE;
+
+/** Raw sensor values of one frame */
+typedef struct _roomba_ekf_input {
+  uint16_t encoder_counts_left;
+  uint16_t encoder_counts_right;
+  int16_t angle;
+  int16_t velocity;
+  int16_t radius;
+  int16_t velocity_right;
+  int16_t velocity_left;
+  uint8_t stasis;
+} ROOMBA_EKF_INPUT;
+
+typedef struct _roomba_ekf {
+  float state[ROOMBA_EKF_STATES];
+  float covariance[ROOMBA_EKF_STATES][ROOMBA_EKF_STATES];
+  ROOMBA_EKF_NOISE noise;
+  uint16_t last_left;
+  uint16_t last_right;
+  bool primed;
+} ROOMBA_EKF;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * @param noise noise model, or NULL for defaults tuned on a Create® 2
+ */
+void roomba_ekf_init(ROOMBA_EKF *ekf, const ROOMBA_EKF_NOISE *noise);
+
+/**
+ * Runs one predict/update cycle.
+ *
+ * @param input sensor values of the frame that just arrived
+ * @param dt time since the previous frame in seconds, nominally 0.015
+ */
+void roomba_ekf_update(ROOMBA_EKF *ekf, const ROOMBA_EKF_INPUT *input,
+  float dt);
+
+/**@}*/
+
+#endif /* ROOMBA_EKF_H_ */
@@ -0,0 +1,22 @@
+#include "roomba_events.h"
+
+void roomba_events_init(ROOMBA_EVENT_ENGINE *engine,
+  const ROOMBA_EVENT_HANDLER handlers[], void *context) {
+  engine->handlers = handlers;
+  engine->context = context;
+  engine->mask = 0;
+  engine->previous = 0;
+  for (uint8_t bit = 0; bit < ROOMBA_EVENT_COUNT; bit++) {
+    if (handlers[bit]) engine->mask |= ROOMBA_EVENT_MASK(bit);
+  }
+}
+
+void roomba_events_dispatch(ROOMBA_EVENT_ENGINE *engine, uint32_t changed,
+  uint32_t snapshot) {
+  while (changed) {
+    uint8_t bit = (uint8_t)__builtin_ctzl(changed);
+    changed &= changed - 1;
+    engine->handlers[bit]((ROOMBA_EVENT_BIT)bit, (snapshot >> bit) & 1,
+      engine->context);
+  }
+}
@@ -0,0 +1,150 @@
+/**
+ * @file roomba_events.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_events.h> @endcode
+ *
+ * @brief Edge triggered events for the bit packed sensor packets
+ *
+ * The state of packets 7, 8 - 13, 14, 18 and 45 fits in 29 bits. Each frame
+ * is packed into one word and XORed with the previous one; handlers only run
+ * for the bits that changed. Handlers are registered in a const table indexed
+ * by ROOMBA_EVENT_BIT, so an idle frame is a pack, an XOR, a mask and a
+ * branch.
+ *
+ * @code
+ * static const ROOMBA_EVENT_HANDLER handlers[ROOMBA_EVENT_COUNT] = {
+ *   [ROOMBA_EVENT_BUMP_LEFT] = on_bump,
+ *   [ROOMBA_EVENT_CLIFF_FRONT_LEFT] = on_cliff,
+ * };
+ * @endcode
+ */
+
+#ifndef ROOMBA_EVENTS_H_
+#define ROOMBA_EVENTS_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/**
+ * Bit positions in the packed word.
+ *
+ * | Bits    | Packet                            |
+ * |---------|-----------------------------------|
+ * | 0 - 3   | 7 Bumps and Wheel Drops           |
+ * | 4 - 9   | 8 - 13 Wall, Cliffs, Virtual Wall |
+ * | 10 - 14 | 14 Wheel Overcurrents             |
+ * | 15 - 22 | 18 Buttons                        |
+ * | 23 - 28 | 45 Light Bumper                   |
+ */
+typedef enum {
+  ROOMBA_EVENT_BUMP_RIGHT = 0,
+  ROOMBA_EVENT_BUMP_LEFT = 1,
+  ROOMBA_EVENT_WHEEL_DROP_RIGHT = 2,
+  ROOMBA_EVENT_WHEEL_DROP_LEFT = 3,
+  ROOMBA_EVENT_WALL = 4,
+  ROOMBA_EVENT_CLIFF_LEFT = 5,
+  ROOMBA_EVENT_CLIFF_FRONT_LEFT = 6,
+  ROOMBA_EVENT_CLIFF_FRONT_RIGHT = 7,
+  ROOMBA_EVENT_CLIFF_RIGHT = 8,
+  ROOMBA_EVENT_VIRTUAL_WALL = 9,
+  ROOMBA_EVENT_OVERCURRENT_SIDE_BRUSH = 10,
+  ROOMBA_EVENT_OVERCURRENT_RESERVED = 11,
+  ROOMBA_EVENT_OVERCURRENT_MAIN_BRUSH = 12,
+  ROOMBA_EVENT_OVERCURRENT_RIGHT_WHEEL = 13,
+  ROOMBA_EVENT_OVERCURRENT_LEFT_WHEEL = 14,
+  ROOMBA_EVENT_BUTTON_CLEAN = 15,
+  ROOMBA_EVENT_BUTTON_SPOT = 16,
+  ROOMBA_EVENT_BUTTON_DOCK = 17,
+  ROOMBA_EVENT_BUTTON_MINUTE = 18,
+  ROOMBA_EVENT_BUTTON_HOUR = 19,
+  ROOMBA_EVENT_BUTTON_DAY = 20,
+  ROOMBA_EVENT_BUTTON_SCHEDULE = 21,
+  ROOMBA_EVENT_BUTTON_CLOCK = 22,
+  ROOMBA_EVENT_LIGHT_BUMPER_LEFT = 23,
+  ROOMBA_EVENT_LIGHT_BUMPER_FRONT_LEFT = 24,
+  ROOMBA_EVENT_LIGHT_BUMPER_CENTER_LEFT = 25,
+  ROOMBA_EVENT_LIGHT_BUMPER_CENTER_RIGHT = 26,
+  ROOMBA_EVENT_LIGHT_BUMPER_FRONT_RIGHT = 27,
+  ROOMBA_EVENT_LIGHT_BUMPER_RIGHT = 28,
+  ROOMBA_EVENT_COUNT,
+} ROOMBA_EVENT_BIT;
+
+#define ROOMBA_EVENT_MASK(bit) ((uint32_t)1 << (bit))
+
+/** Any wheel drop or cliff flag */
+#define ROOMBA_EVENT_SAFETY_MASK ( \
+  ROOMBA_EVENT_MASK(ROOMBA_EVENT_WHEEL_DROP_RIGHT) | \
+  ROOMBA_EVENT_MASK(ROOMBA_EVENT_WHEEL_DROP_LEFT) | \
+  ROOMBA_EVENT_MASK(ROOMBA_EVENT_CLIFF_LEFT) | \
+  ROOMBA_EVENT_MASK(ROOMBA_EVENT_CLIFF_FRONT_LEFT) | \
+  ROOMBA_EVENT_MASK(ROOMBA_EVENT_CLIFF_FRONT_RIGHT) | \
+  ROOMBA_EVENT_MASK(ROOMBA_EVENT_CLIFF_RIGHT))
+
+/**
+ * @param bit the bit that changed
+ * @param state new value of the bit, true on a rising edge
+ * @param context the pointer given to roomba_events_init
+ */
+typedef void (*ROOMBA_EVENT_HANDLER)(ROOMBA_EVENT_BIT bit, bool state,
+  void *context);
+
+typedef struct _roomba_event_engine {
+  const ROOMBA_EVENT_HANDLER *handlers;
+  void *context;
+  /** Bits that have a handler */
+  uint32_t mask;
+  uint32_t previous;
+} ROOMBA_EVENT_ENGINE;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * @param handlers table of ROOMBA_EVENT_COUNT entries, NULL for unused bits.
+ * The table is referenced, not copied.
+ *
+ * @note The previous state starts at zero, so bits already set in the first
+ * frame are reported as rising edges. Edges are not debounced: a bit set
+ * for a single frame is reported rising, then falling.
+ */
+void roomba_events_init(ROOMBA_EVENT_ENGINE *engine,
+  const ROOMBA_EVENT_HANDLER handlers[], void *context);
+
+/** Calls the handler of every bit set in changed, lowest bit first */
+void roomba_events_dispatch(ROOMBA_EVENT_ENGINE *engine, uint32_t changed,
+  uint32_t snapshot);
+
+/** Packs the bit packed packets of a full sensor frame */
+static inline uint32_t roomba_events_pack(const ROOMBA_PACKET_GROUP_100 *p) {
+  return (uint32_t)(p->bumps_wheeldrops & 0x0F) |
+    (uint32_t)(p->wall & 1) << ROOMBA_EVENT_WALL |
+    (uint32_t)(p->cliff_left & 1) << ROOMBA_EVENT_CLIFF_LEFT |
+    (uint32_t)(p->cliff_front_left & 1) << ROOMBA_EVENT_CLIFF_FRONT_LEFT |
+    (uint32_t)(p->cliff_front_right & 1) << ROOMBA_EVENT_CLIFF_FRONT_RIGHT |
+    (uint32_t)(p->cliff_right & 1) << ROOMBA_EVENT_CLIFF_RIGHT |
+    (uint32_t)(p->virtual_wall & 1) << ROOMBA_EVENT_VIRTUAL_WALL |
+    (uint32_t)(p->overcurrents & 0x1F) << ROOMBA_EVENT_OVERCURRENT_SIDE_BRUSH |
+    (uint32_t)p->buttons_pkt << ROOMBA_EVENT_BUTTON_CLEAN |
+    (uint32_t)(p->light_bumper & 0x3F) << ROOMBA_EVENT_LIGHT_BUMPER_LEFT;
+}
+
+/**
+ * Feeds one packed frame. Only the XOR and the mask test are inline; the
+ * dispatch loop is only entered when a watched bit changed.
+ */
+static inline void roomba_events_update(ROOMBA_EVENT_ENGINE *engine,
+  uint32_t snapshot) {
+  uint32_t changed = (snapshot ^ engine->previous) & engine->mask;
+  engine->previous = snapshot;
+  if (changed) roomba_events_dispatch(engine, changed, snapshot);
+}
+
+/**@}*/
+
+#endif /* ROOMBA_EVENTS_H_ */
@@ -0,0 +1,348 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#include "roomba_executor.h"
+
+/* an idle worker looks for stolen work again after this long */
+#define IDLE_WAIT_NS 1000000L
+
+#define DEQUE_MASK (ROOMBA_EXECUTOR_DEQUE_SIZE - 1)
+#define INJECT_MASK (ROOMBA_EXECUTOR_INJECT_SIZE - 1)
+#define STRAND_MASK (ROOMBA_STRAND_FRAMES - 1)
+
+/* the worker running on this thread, NULL outside the pool */
+static __thread ROOMBA_EXECUTOR_WORKER *current;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void add(uint64_t *counter, uint64_t n) {
+  __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+/* owner only */
+static bool deque_push(ROOMBA_EXECUTOR_DEQUE *d, ROOMBA_TASK *task) {
+  int64_t bottom = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+  int64_t top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+
+  if (bottom - top >= ROOMBA_EXECUTOR_DEQUE_SIZE) return false;
+  __atomic_store_n(&d->tasks[bottom & DEQUE_MASK], task, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&d->bottom, bottom + 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+/* owner only, newest first */
+static ROOMBA_TASK *deque_pop(ROOMBA_EXECUTOR_DEQUE *d) {
+  int64_t bottom = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+  int64_t top;
+  ROOMBA_TASK *task = NULL;
+
+  __atomic_store_n(&d->bottom, bottom, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  top = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+  if (top <= bottom) {
+    task = __atomic_load_n(&d->tasks[bottom & DEQUE_MASK], __ATOMIC_RELAXED);
+    if (top < bottom) return task;
+    /* the last task: race the thieves for it */
+    if (!__atomic_compare_exchange_n(&d->top, &top, top + 1, false,
+        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+      task = NULL;
+    }
+  }
+  __atomic_store_n(&d->bottom, bottom + 1, __ATOMIC_RELAXED);
+  return task;
+}
+
+/* any thread, oldest first; NULL if empty or another thief won */
+static ROOMBA_TASK *deque_steal(ROOMBA_EXECUTOR_DEQUE *d) {
+  int64_t top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+  int64_t bottom;
+  ROOMBA_TASK *task;
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  bottom = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+  if (top >= bottom) return NULL;
+  task = __atomic_load_n(&d->tasks[top & DEQUE_MASK], __ATOMIC_RELAXED);
+  if (!__atomic_compare_exchange_n(&d->top, &top, top + 1, false,
+      __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    return NULL;
+  }
+  return task;
+}
+
+/* with executor->lock held */
+static ROOMBA_TASK *take_injected(ROOMBA_EXECUTOR *executor) {
+  ROOMBA_TASK *task;
+
+  if (executor->inject_tail == executor->inject_head) return NULL;
+  task = executor->inject[executor->inject_tail & INJECT_MASK];
+  executor->inject_tail++;
+  return task;
+}
+
+static ROOMBA_TASK *steal(ROOMBA_EXECUTOR_WORKER *worker) {
+  ROOMBA_EXECUTOR *executor = worker->executor;
+  uint32_t x = worker->random;
+  uint8_t start;
+
+  if (executor->count < 2) return NULL;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  worker->random = x;
+  start = (uint8_t)(x % executor->count);
+  for (uint8_t i = 0; i < executor->count; i++) {
+    uint8_t victim = (uint8_t)((start + i) % executor->count);
+    ROOMBA_TASK *task;
+
+    if (victim == worker->index) continue;
+    add(&worker->stats.steal_attempts, 1);
+    task = deque_steal(&executor->workers[victim].deque);
+    if (task) {
+      add(&worker->stats.steals, 1);
+      return task;
+    }
+  }
+  return NULL;
+}
+
+static void *run(void *argument) {
+  ROOMBA_EXECUTOR_WORKER *worker = argument;
+  ROOMBA_EXECUTOR *executor = worker->executor;
+  uint64_t idle_since = now_ns();
+
+  current = worker;
+  while (executor->running) {
+    ROOMBA_TASK *task = deque_pop(&worker->deque);
+    uint64_t start;
+
+    if (!task) {
+      pthread_mutex_lock(&executor->lock);
+      task = take_injected(executor);
+      pthread_mutex_unlock(&executor->lock);
+    }
+    if (!task) task = steal(worker);
+    if (!task) {
+      struct timespec until;
+      clock_gettime(CLOCK_REALTIME, &until);
+      until.tv_nsec += IDLE_WAIT_NS;
+      if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+      }
+      pthread_mutex_lock(&executor->lock);
+      if (executor->running && executor->inject_tail == executor->inject_head) {
+        __atomic_add_fetch(&executor->sleepers, 1, __ATOMIC_RELAXED);
+        pthread_cond_timedwait(&executor->wake, &executor->lock, &until);
+        __atomic_sub_fetch(&executor->sleepers, 1, __ATOMIC_RELAXED);
+      }
+      pthread_mutex_unlock(&executor->lock);
+      start = now_ns();
+      add(&worker->stats.idle_ns, start - idle_since);
+      idle_since = start;
+      continue;
+    }
+
+    start = now_ns();
+    add(&worker->stats.idle_ns, start - idle_since);
+    task->run(task);
+    idle_since = now_ns();
+    add(&worker->stats.busy_ns, idle_since - start);
+    add(&worker->stats.tasks, 1);
+  }
+  current = NULL;
+  return NULL;
+}
+
+static int spawn(ROOMBA_EXECUTOR_WORKER *worker) {
+  pthread_attr_t attributes;
+  int error;
+
+  pthread_attr_init(&attributes);
+  if (worker->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker->cpu, &set);
+    pthread_attr_setaffinity_np(&attributes, sizeof(set), &set);
+  }
+  error = pthread_create(&worker->thread, &attributes, run, worker);
+  pthread_attr_destroy(&attributes);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
+static void shut_down(ROOMBA_EXECUTOR *executor, uint8_t started) {
+  pthread_mutex_lock(&executor->lock);
+  executor->running = false;
+  pthread_cond_broadcast(&executor->wake);
+  pthread_mutex_unlock(&executor->lock);
+  for (uint8_t w = 0; w < started; w++) {
+    pthread_join(executor->workers[w].thread, NULL);
+  }
+  executor->count = 0;
+  pthread_cond_destroy(&executor->wake);
+  pthread_mutex_destroy(&executor->lock);
+}
+
+int roomba_executor_start(ROOMBA_EXECUTOR *executor, uint8_t workers,
+  int first_cpu) {
+  uint8_t started;
+
+  if (workers < 1 || workers > ROOMBA_EXECUTOR_MAX_WORKERS) {
+    errno = EINVAL;
+    return -1;
+  }
+  memset(executor, 0, sizeof(*executor));
+  pthread_mutex_init(&executor->lock, NULL);
+  pthread_cond_init(&executor->wake, NULL);
+  executor->running = true;
+  for (uint8_t w = 0; w < workers; w++) {
+    ROOMBA_EXECUTOR_WORKER *worker = &executor->workers[w];
+    worker->executor = executor;
+    worker->index = w;
+    worker->cpu = first_cpu < 0 ? -1 : first_cpu + w;
+    worker->random = 2463534242u + w;
+  }
+
+  /* deques of workers not yet started are empty, thieves can look anyway */
+  executor->count = workers;
+  for (started = 0; started < workers; started++) {
+    if (spawn(&executor->workers[started]) < 0) break;
+  }
+  if (started < workers) {
+    int error = errno;
+    shut_down(executor, started);
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
+/* the shared queue, behind whatever waits there already */
+static bool inject(ROOMBA_EXECUTOR *executor, ROOMBA_TASK *task) {
+  bool queued = false;
+
+  pthread_mutex_lock(&executor->lock);
+  if (executor->inject_head - executor->inject_tail <
+      ROOMBA_EXECUTOR_INJECT_SIZE) {
+    executor->inject[executor->inject_head & INJECT_MASK] = task;
+    executor->inject_head++;
+    queued = true;
+    if (executor->sleepers > 0) pthread_cond_signal(&executor->wake);
+  }
+  pthread_mutex_unlock(&executor->lock);
+  return queued;
+}
+
+bool roomba_executor_submit(ROOMBA_EXECUTOR *executor, ROOMBA_TASK *task) {
+  if (current && current->executor == executor &&
+      deque_push(&current->deque, task)) {
+    if (__atomic_load_n(&executor->sleepers, __ATOMIC_RELAXED) > 0) {
+      pthread_cond_signal(&executor->wake);
+    }
+    return true;
+  }
+  return inject(executor, task);
+}
+
+void roomba_executor_stop(ROOMBA_EXECUTOR *executor) {
+  shut_down(executor, executor->count);
+}
+
+void roomba_executor_stats(const ROOMBA_EXECUTOR *executor, uint8_t worker,
+  ROOMBA_EXECUTOR_STATS *stats) {
+  const ROOMBA_EXECUTOR_STATS *s = &executor->workers[worker].stats;
+
+  stats->tasks = __atomic_load_n(&s->tasks, __ATOMIC_RELAXED);
+  stats->steals = __atomic_load_n(&s->steals, __ATOMIC_RELAXED);
+  stats->steal_attempts = __atomic_load_n(&s->steal_attempts, __ATOMIC_RELAXED);
+  stats->busy_ns = __atomic_load_n(&s->busy_ns, __ATOMIC_RELAXED);
+  stats->idle_ns = __atomic_load_n(&s->idle_ns, __ATOMIC_RELAXED);
+}
+
+uint8_t roomba_executor_utilisation(const ROOMBA_EXECUTOR *executor,
+  uint8_t worker) {
+  ROOMBA_EXECUTOR_STATS stats;
+  uint64_t total;
+
+  roomba_executor_stats(executor, worker, &stats);
+  total = stats.busy_ns + stats.idle_ns;
+  return total ? (uint8_t)(stats.busy_ns * 100 / total) : 0;
+}
+
+static void run_strand(ROOMBA_TASK *task) {
+  ROOMBA_STRAND *strand = (ROOMBA_STRAND *)task;
+  /* the previous run may have been on another worker */
+  uint32_t tail = __atomic_load_n(&strand->tail, __ATOMIC_ACQUIRE);
+
+  for (;;) {
+    for (uint8_t i = 0; i < ROOMBA_STRAND_BATCH; i++) {
+      if (tail == __atomic_load_n(&strand->head, __ATOMIC_ACQUIRE)) break;
+      strand->handler(strand, &strand->frames[tail & STRAND_MASK],
+        strand->context);
+      tail++;
+      __atomic_store_n(&strand->tail, tail, __ATOMIC_RELEASE);
+    }
+    if (tail != __atomic_load_n(&strand->head, __ATOMIC_ACQUIRE)) {
+      /*
+       * More to do: requeue behind the shared queue so other strands get a
+       * turn. The own deque would hand it straight back, it is popped first.
+       */
+      if (inject(strand->executor, task) ||
+          roomba_executor_submit(strand->executor, task)) {
+        return;
+      }
+      continue;
+    }
+    __atomic_store_n(&strand->scheduled, 0, __ATOMIC_SEQ_CST);
+    /* a frame posted after the check above would find it still scheduled */
+    if (tail == __atomic_load_n(&strand->head, __ATOMIC_SEQ_CST) ||
+        __atomic_exchange_n(&strand->scheduled, 1, __ATOMIC_SEQ_CST)) {
+      return;
+    }
+  }
+}
+
+void roomba_strand_init(ROOMBA_STRAND *strand, ROOMBA_EXECUTOR *executor,
+  ROOMBA_STRAND_HANDLER handler, void *context) {
+  memset(strand, 0, sizeof(*strand) - sizeof(strand->frames));
+  strand->task.run = run_strand;
+  strand->executor = executor;
+  strand->handler = handler;
+  strand->context = context;
+}
+
+bool roomba_strand_post(ROOMBA_STRAND *strand,
+  const ROOMBA_PACKET_GROUP_100 *frame) {
+  uint32_t head = strand->head;
+
+  if (head - __atomic_load_n(&strand->tail, __ATOMIC_ACQUIRE) >=
+      ROOMBA_STRAND_FRAMES) {
+    strand->dropped++;
+    return false;
+  }
+  strand->frames[head & STRAND_MASK] = *frame;
+  __atomic_store_n(&strand->head, head + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_exchange_n(&strand->scheduled, 1, __ATOMIC_SEQ_CST)) return true;
+  if (roomba_executor_submit(strand->executor, &strand->task)) return true;
+  __atomic_store_n(&strand->scheduled, 0, __ATOMIC_SEQ_CST);
+  return false;
+}
+
+void roomba_strand_frame_hook(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  (void)parser;
+  roomba_strand_post(context, frame);
+}
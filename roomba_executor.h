@@ -0,0 +1,203 @@
+/**
+ * @file roomba_executor.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_executor.h> @endcode
+ *
+ * @brief Work-stealing task executor with per-robot strands (Linux)
+ *
+ * Each worker thread has its own deque of tasks. It pushes and pops at the
+ * bottom without contention; a worker that runs out steals from the top of
+ * another worker's deque, so robots with expensive analytics no longer pin
+ * one core while others idle. Tasks submitted from outside the pool go
+ * through a shared queue that idle workers also drain.
+ *
+ * A ROOMBA_STRAND serialises the frames of one robot: frames posted to it
+ * are handled one after the other, in the order they were posted, by
+ * whichever worker currently runs the strand. Only one worker runs a strand
+ * at a time, so a handler needs no locks for its robot's state. After
+ * ROOMBA_STRAND_BATCH frames a strand goes to the back of the shared queue,
+ * behind the strands already waiting there, so a busy robot does not starve
+ * the others; any worker may pick it up from there.
+ *
+ * @code
+ * roomba_strand_init(&strand, &executor, analyse, robot);
+ * roomba_stream_set_frame_hook(&parser, roomba_strand_frame_hook, &strand);
+ * @endcode
+ */
+
+#ifndef ROOMBA_EXECUTOR_H_
+#define ROOMBA_EXECUTOR_H_
+
+#include <pthread.h>
+
+#include "roomba.h"
+#include "roomba_stream.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#ifndef ROOMBA_EXECUTOR_MAX_WORKERS
+  #define ROOMBA_EXECUTOR_MAX_WORKERS 16
+#endif
+
+/** Tasks per worker deque, a power of two */
+#ifndef ROOMBA_EXECUTOR_DEQUE_SIZE
+  #define ROOMBA_EXECUTOR_DEQUE_SIZE 256
+#endif
+
+/** Tasks waiting in the shared queue, a power of two */
+#ifndef ROOMBA_EXECUTOR_INJECT_SIZE
+  #define ROOMBA_EXECUTOR_INJECT_SIZE 1024
+#endif
+
+/** Frames a strand holds before dropping, a power of two */
+#ifndef ROOMBA_STRAND_FRAMES
+  #define ROOMBA_STRAND_FRAMES 8
+#endif
+
+/** Frames a strand handles before letting other tasks run */
+#ifndef ROOMBA_STRAND_BATCH
+  #define ROOMBA_STRAND_BATCH 4
+#endif
+
+#if ROOMBA_EXECUTOR_MAX_WORKERS < 1 || ROOMBA_EXECUTOR_MAX_WORKERS > 256
+  #error "ROOMBA_EXECUTOR_MAX_WORKERS must be 1 - 256"
+#endif
+
+#if (ROOMBA_EXECUTOR_DEQUE_SIZE & (ROOMBA_EXECUTOR_DEQUE_SIZE - 1)) != 0 || \
+    (ROOMBA_EXECUTOR_INJECT_SIZE & (ROOMBA_EXECUTOR_INJECT_SIZE - 1)) != 0
+  #error "ROOMBA_EXECUTOR_DEQUE_SIZE and _INJECT_SIZE must be powers of two"
+#endif
+
+#if (ROOMBA_STRAND_FRAMES & (ROOMBA_STRAND_FRAMES - 1)) != 0
+  #error "ROOMBA_STRAND_FRAMES must be a power of two"
+#endif
+
+typedef struct _roomba_task ROOMBA_TASK;
+
+/** Embed a ROOMBA_TASK in the work item; run finds it from the pointer */
+struct _roomba_task {
+  void (*run)(ROOMBA_TASK *task);
+};
+
+/** Chase-Lev deque: the owner works the bottom, thieves take the top */
+typedef struct _roomba_executor_deque {
+  int64_t top;
+  int64_t bottom;
+  ROOMBA_TASK *tasks[ROOMBA_EXECUTOR_DEQUE_SIZE];
+} ROOMBA_EXECUTOR_DEQUE;
+
+/** Written by the worker, read by anyone; values may be a moment old */
+typedef struct _roomba_executor_stats {
+  uint64_t tasks;
+  /** Tasks taken from other workers */
+  uint64_t steals;
+  /** Deques looked into for a task to steal */
+  uint64_t steal_attempts;
+  /** Time spent in tasks, and waiting for one */
+  uint64_t busy_ns;
+  uint64_t idle_ns;
+} ROOMBA_EXECUTOR_STATS;
+
+typedef struct _roomba_executor ROOMBA_EXECUTOR;
+
+typedef struct _roomba_executor_worker {
+  ROOMBA_EXECUTOR *executor;
+  pthread_t thread;
+  uint8_t index;
+  int cpu;
+  /** Victim selection, xorshift */
+  uint32_t random;
+  ROOMBA_EXECUTOR_DEQUE deque;
+  ROOMBA_EXECUTOR_STATS stats;
+} ROOMBA_EXECUTOR_WORKER;
+
+struct _roomba_executor {
+  uint8_t count;
+  volatile bool running;
+  /** Shared queue for tasks submitted from outside the pool */
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  uint32_t sleepers;
+  uint32_t inject_head;
+  uint32_t inject_tail;
+  ROOMBA_TASK *inject[ROOMBA_EXECUTOR_INJECT_SIZE];
+  ROOMBA_EXECUTOR_WORKER workers[ROOMBA_EXECUTOR_MAX_WORKERS];
+};
+
+typedef struct _roomba_strand ROOMBA_STRAND;
+
+/** Runs on a worker, never concurrently for the same strand */
+typedef void (*ROOMBA_STRAND_HANDLER)(ROOMBA_STRAND *strand,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context);
+
+struct _roomba_strand {
+  ROOMBA_TASK task;
+  ROOMBA_EXECUTOR *executor;
+  ROOMBA_STRAND_HANDLER handler;
+  void *context;
+  /** Non-zero while the strand is queued or running */
+  uint32_t scheduled;
+  /** Written by the posting thread only */
+  uint32_t head;
+  /** Written by the running worker only */
+  uint32_t tail;
+  /** Frames dropped because the strand was full */
+  uint32_t dropped;
+  ROOMBA_PACKET_GROUP_100 frames[ROOMBA_STRAND_FRAMES];
+};
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * @param first_cpu CPU of the first worker, the others follow; -1 for no
+ * pinning
+ * @return 0, or -1 with errno set; no thread is left running on error
+ */
+int roomba_executor_start(ROOMBA_EXECUTOR *executor, uint8_t workers,
+  int first_cpu);
+
+/**
+ * Queues a task. From a worker it goes to that worker's deque, from any
+ * other thread to the shared queue.
+ *
+ * @return false if the queue is full
+ */
+bool roomba_executor_submit(ROOMBA_EXECUTOR *executor, ROOMBA_TASK *task);
+
+/** Lets the workers finish their current task and joins them */
+void roomba_executor_stop(ROOMBA_EXECUTOR *executor);
+
+void roomba_executor_stats(const ROOMBA_EXECUTOR *executor, uint8_t worker,
+  ROOMBA_EXECUTOR_STATS *stats);
+
+/** @return share of the time the worker spent in tasks, percent */
+uint8_t roomba_executor_utilisation(const ROOMBA_EXECUTOR *executor,
+  uint8_t worker);
+
+void roomba_strand_init(ROOMBA_STRAND *strand, ROOMBA_EXECUTOR *executor,
+  ROOMBA_STRAND_HANDLER handler, void *context);
+
+/**
+ * Copies a frame into the strand and schedules it. Frames of one strand
+ * must all be posted from the same thread.
+ *
+ * @return false if the strand is full, the frame is then dropped and
+ * counted, or if the executor queues are full, the frame then waits for the
+ * next post
+ */
+bool roomba_strand_post(ROOMBA_STRAND *strand,
+  const ROOMBA_PACKET_GROUP_100 *frame);
+
+/** ROOMBA_FRAME_HOOK posting every frame, context is the strand */
+void roomba_strand_frame_hook(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context);
+
+/**@}*/
+
+#endif /* ROOMBA_EXECUTOR_H_ */
@@ -0,0 +1,460 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "roomba_fleet.h"
+
+/* epoll data of the worker's own fds, above any slot */
+#define MAILBOX_EVENT 0xFFFFFFF0u
+#define TIMER_EVENT 0xFFFFFFF1u
+
+#define EVENTS 64
+
+static uint64_t thread_cpu_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void watch_robot(ROOMBA_FLEET_ROBOT *robot, int op) {
+  struct epoll_event event;
+
+  memset(&event, 0, sizeof(event));
+  event.events = robot->writer.blocked ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  event.data.u32 = (uint32_t)(robot->handle % ROOMBA_FLEET_WORKER_ROBOTS);
+  epoll_ctl(robot->worker->epoll_fd, op, robot->fd, &event);
+}
+
+static void robot_blocked(void *context, bool blocked) {
+  (void)blocked;
+  watch_robot(context, EPOLL_CTL_MOD);
+}
+
+static void robot_write(void *context, const uint8_t data[], uint16_t size) {
+  ROOMBA_FLEET_ROBOT *robot = context;
+  ROOMBA_FLEET_WORKER *worker = robot->worker;
+
+  if (!roomba_writer_write(&robot->writer, data, size)) {
+    __atomic_store_n(&worker->stats.dropped, worker->stats.dropped + 1,
+      __ATOMIC_RELAXED);
+  }
+}
+
+static void on_frame(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  ROOMBA_FLEET_ROBOT *robot = context;
+  ROOMBA_FLEET_WORKER *worker = robot->worker;
+  const ROOMBA_FLEET_CONFIG *config = &worker->fleet->config;
+  uint32_t events;
+
+  (void)parser;
+  __atomic_store_n(&worker->stats.frames, worker->stats.frames + 1,
+    __ATOMIC_RELAXED);
+  events = roomba_events_pack(frame);
+  if (config->on_events && events != robot->events) {
+    ROOMBA_FLEET_EVENT *event = ROOMBA_ARENA_NEW(&worker->arena,
+      ROOMBA_FLEET_EVENT);
+    /* the change is reported again with the next frame */
+    if (!event) return;
+    event->next = NULL;
+    event->robot = robot->handle;
+    event->changed = events ^ robot->events;
+    event->state = events;
+    *worker->events_tail = event;
+    worker->events_tail = &event->next;
+  }
+  robot->events = events;
+  if (config->on_frame) {
+    const ROOMBA_PACKET_GROUP_100 *snapshot =
+      roomba_arena_snapshot(&worker->arena, frame);
+    if (snapshot) config->on_frame(robot, snapshot, config->context);
+  }
+}
+
+static void add_robot(ROOMBA_FLEET_WORKER *worker,
+  const ROOMBA_FLEET_MESSAGE *message) {
+  ROOMBA_FLEET_ROBOT *robot = &worker->robots[message->slot];
+  ROOMBA_TRANSPORT transport;
+
+  robot->worker = worker;
+  robot->fd = message->fd;
+  robot->handle = worker->index * ROOMBA_FLEET_WORKER_ROBOTS + message->slot;
+  robot->context = message->context;
+  roomba_stream_init(&robot->parser);
+  roomba_stream_set_frame_hook(&robot->parser, on_frame, robot);
+  roomba_queue_init(&robot->queue);
+  transport.write = robot_write;
+  transport.context = robot;
+  roomba_scheduler_init(&robot->scheduler, &robot->queue, transport,
+    message->bitrate);
+  robot->events = 0;
+  roomba_writer_init(&robot->writer, robot->fd, robot->out, sizeof(robot->out),
+    robot_blocked, robot);
+  watch_robot(robot, EPOLL_CTL_ADD);
+}
+
+static void remove_robot(ROOMBA_FLEET_WORKER *worker, uint8_t slot) {
+  ROOMBA_FLEET_ROBOT *robot = &worker->robots[slot];
+
+  if (robot->fd < 0) return;
+  epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, robot->fd, NULL);
+  close(robot->fd);
+  robot->fd = -1;
+}
+
+/* @return false on ROOMBA_FLEET_STOP */
+static bool drain_mailbox(ROOMBA_FLEET_WORKER *worker) {
+  uint32_t head = __atomic_load_n(&worker->mailbox_head, __ATOMIC_ACQUIRE);
+  uint32_t tail = worker->mailbox_tail;
+  bool running = true;
+
+  while (tail != head) {
+    const ROOMBA_FLEET_MESSAGE *message =
+      &worker->mailbox[tail & (ROOMBA_FLEET_MAILBOX - 1)];
+    ROOMBA_FLEET_ROBOT *robot = &worker->robots[message->slot];
+
+    switch (message->request) {
+      case ROOMBA_FLEET_ADD:
+        add_robot(worker, message);
+        break;
+      case ROOMBA_FLEET_REMOVE:
+        remove_robot(worker, message->slot);
+        break;
+      case ROOMBA_FLEET_COMMAND:
+        if (robot->fd >= 0) {
+          roomba_queue_push(&robot->queue, message->data, message->size);
+        }
+        break;
+      case ROOMBA_FLEET_STOP:
+        running = false;
+        break;
+    }
+    tail++;
+  }
+  __atomic_store_n(&worker->mailbox_tail, tail, __ATOMIC_RELEASE);
+  return running;
+}
+
+static void tick(ROOMBA_FLEET_WORKER *worker) {
+  uint16_t robots = 0;
+
+  for (uint8_t i = 0; i < ROOMBA_FLEET_WORKER_ROBOTS; i++) {
+    if (worker->robots[i].fd < 0) continue;
+    roomba_scheduler_tick(&worker->robots[i].scheduler);
+    robots++;
+  }
+  if (worker->events) {
+    worker->fleet->config.on_events(worker->events,
+      worker->fleet->config.context);
+  }
+  /* everything allocated during the cycle is done with */
+  worker->events = NULL;
+  worker->events_tail = &worker->events;
+  roomba_arena_reset(&worker->arena);
+  __atomic_store_n(&worker->stats.robots, robots, __ATOMIC_RELAXED);
+  __atomic_store_n(&worker->stats.arena_peak, worker->arena.peak,
+    __ATOMIC_RELAXED);
+  __atomic_store_n(&worker->stats.arena_failures, worker->arena.failures,
+    __ATOMIC_RELAXED);
+  __atomic_store_n(&worker->stats.cpu_ns, thread_cpu_ns(), __ATOMIC_RELAXED);
+}
+
+static void *run(void *argument) {
+  ROOMBA_FLEET_WORKER *worker = argument;
+  struct epoll_event events[EVENTS];
+  uint8_t buffer[256];
+  bool running = true;
+
+  while (running) {
+    int count = epoll_wait(worker->epoll_fd, events, EVENTS, -1);
+
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    __atomic_store_n(&worker->stats.wakeups, worker->stats.wakeups + 1,
+      __ATOMIC_RELAXED);
+    for (int i = 0; i < count; i++) {
+      uint32_t id = events[i].data.u32;
+
+      if (id == MAILBOX_EVENT) {
+        uint64_t value;
+        if (read(worker->event_fd, &value, sizeof(value)) < 0) continue;
+        running = drain_mailbox(worker);
+      } else if (id == TIMER_EVENT) {
+        uint64_t expirations;
+        if (read(worker->timer_fd, &expirations, sizeof(expirations)) < 0) {
+          continue;
+        }
+        tick(worker);
+      } else if (worker->robots[id].fd >= 0) {
+        ROOMBA_FLEET_ROBOT *robot = &worker->robots[id];
+        ssize_t n;
+        if (events[i].events & EPOLLOUT) roomba_writer_flush(&robot->writer);
+        if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) continue;
+        n = read(robot->fd, buffer, sizeof(buffer));
+        if (n > 0) {
+          roomba_stream_parse(&robot->parser, buffer, (uint16_t)n);
+          __atomic_store_n(&worker->stats.bytes,
+            worker->stats.bytes + (uint64_t)n, __ATOMIC_RELAXED);
+        } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+          /* hung up: stop polling, the slot stays until removed */
+          epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, robot->fd, NULL);
+        }
+      }
+    }
+  }
+  for (uint8_t i = 0; i < ROOMBA_FLEET_WORKER_ROBOTS; i++) {
+    remove_robot(worker, i);
+  }
+  return NULL;
+}
+
+static void close_worker(ROOMBA_FLEET_WORKER *worker) {
+  if (worker->epoll_fd >= 0) close(worker->epoll_fd);
+  if (worker->event_fd >= 0) close(worker->event_fd);
+  if (worker->timer_fd >= 0) close(worker->timer_fd);
+  worker->epoll_fd = worker->event_fd = worker->timer_fd = -1;
+}
+
+static int open_worker(ROOMBA_FLEET_WORKER *worker) {
+  struct itimerspec spec;
+  struct epoll_event event;
+
+  worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  worker->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  worker->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (worker->epoll_fd < 0 || worker->event_fd < 0 || worker->timer_fd < 0) {
+    return -1;
+  }
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_nsec = ROOMBA_SLOT_MS * 1000000L;
+  spec.it_interval = spec.it_value;
+  if (timerfd_settime(worker->timer_fd, 0, &spec, NULL) < 0) return -1;
+
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u32 = MAILBOX_EVENT;
+  if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->event_fd, &event) < 0) {
+    return -1;
+  }
+  event.data.u32 = TIMER_EVENT;
+  return epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->timer_fd, &event);
+}
+
+static int spawn(ROOMBA_FLEET_WORKER *worker) {
+  pthread_attr_t attributes;
+  int error;
+
+  pthread_attr_init(&attributes);
+  if (worker->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker->cpu, &set);
+    pthread_attr_setaffinity_np(&attributes, sizeof(set), &set);
+  }
+  error = pthread_create(&worker->thread, &attributes, run, worker);
+  pthread_attr_destroy(&attributes);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
+/* @return false if the mailbox is full */
+static bool post(ROOMBA_FLEET_WORKER *worker,
+  const ROOMBA_FLEET_MESSAGE *message) {
+  uint32_t head = worker->mailbox_head;
+  uint64_t one = 1;
+  ssize_t written;
+
+  if (head - __atomic_load_n(&worker->mailbox_tail, __ATOMIC_ACQUIRE) >=
+      ROOMBA_FLEET_MAILBOX) {
+    return false;
+  }
+  worker->mailbox[head & (ROOMBA_FLEET_MAILBOX - 1)] = *message;
+  __atomic_store_n(&worker->mailbox_head, head + 1, __ATOMIC_RELEASE);
+  /* fails only when the counter is saturated: the worker wakes anyway */
+  written = write(worker->event_fd, &one, sizeof(one));
+  (void)written;
+  return true;
+}
+
+int roomba_fleet_start(ROOMBA_FLEET *fleet, const ROOMBA_FLEET_CONFIG *config) {
+  uint8_t started;
+
+  if (config->workers < 1 || config->workers > ROOMBA_FLEET_MAX_WORKERS) {
+    errno = EINVAL;
+    return -1;
+  }
+  memset(fleet, 0, sizeof(*fleet));
+  fleet->config = *config;
+  for (uint8_t w = 0; w < config->workers; w++) {
+    ROOMBA_FLEET_WORKER *worker = &fleet->workers[w];
+    worker->fleet = fleet;
+    worker->index = w;
+    worker->cpu = config->first_cpu < 0 ? -1 : config->first_cpu + w;
+    for (uint8_t i = 0; i < ROOMBA_FLEET_WORKER_ROBOTS; i++) {
+      worker->robots[i].fd = -1;
+    }
+    worker->epoll_fd = worker->event_fd = worker->timer_fd = -1;
+    roomba_arena_init(&worker->arena, worker->arena_buffer,
+      sizeof(worker->arena_buffer));
+    worker->events_tail = &worker->events;
+  }
+
+  for (started = 0; started < config->workers; started++) {
+    ROOMBA_FLEET_WORKER *worker = &fleet->workers[started];
+    if (open_worker(worker) < 0 || spawn(worker) < 0) break;
+  }
+  if (started < config->workers) {
+    int error = errno;
+    fleet->config.workers = started;
+    roomba_fleet_stop(fleet);
+    close_worker(&fleet->workers[started]);
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
+ROOMBA_FLEET_HANDLE roomba_fleet_add(ROOMBA_FLEET *fleet, int fd,
+  ROOMBA_BITRATE bitrate, void *context) {
+  ROOMBA_FLEET_WORKER *worker = NULL;
+  ROOMBA_FLEET_MESSAGE message;
+  uint8_t fewest = ROOMBA_FLEET_WORKER_ROBOTS, slot;
+  int flags;
+
+  for (uint8_t w = 0; w < fleet->config.workers; w++) {
+    uint8_t robots = (uint8_t)__builtin_popcountll(fleet->workers[w].used);
+    if (robots < fewest) {
+      fewest = robots;
+      worker = &fleet->workers[w];
+    }
+  }
+  if (!worker) {
+    errno = EAGAIN;
+    return -1;
+  }
+  slot = (uint8_t)__builtin_ctzll(~worker->used);
+  flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return -1;
+
+  memset(&message, 0, sizeof(message));
+  message.request = ROOMBA_FLEET_ADD;
+  message.slot = slot;
+  message.bitrate = bitrate;
+  message.fd = fd;
+  message.context = context;
+  if (!post(worker, &message)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  worker->used |= (uint64_t)1 << slot;
+  return worker->index * ROOMBA_FLEET_WORKER_ROBOTS + slot;
+}
+
+/* @return worker of a handle in use, NULL with errno set otherwise */
+static ROOMBA_FLEET_WORKER *owner(ROOMBA_FLEET *fleet,
+  ROOMBA_FLEET_HANDLE handle) {
+  ROOMBA_FLEET_WORKER *worker;
+
+  if (handle < 0 ||
+      handle >= fleet->config.workers * ROOMBA_FLEET_WORKER_ROBOTS) {
+    errno = EINVAL;
+    return NULL;
+  }
+  worker = &fleet->workers[handle / ROOMBA_FLEET_WORKER_ROBOTS];
+  if (!(worker->used & (uint64_t)1 << (handle % ROOMBA_FLEET_WORKER_ROBOTS))) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return worker;
+}
+
+int roomba_fleet_remove(ROOMBA_FLEET *fleet, ROOMBA_FLEET_HANDLE handle) {
+  ROOMBA_FLEET_WORKER *worker = owner(fleet, handle);
+  ROOMBA_FLEET_MESSAGE message;
+
+  if (!worker) return -1;
+  memset(&message, 0, sizeof(message));
+  message.request = ROOMBA_FLEET_REMOVE;
+  message.slot = (uint8_t)(handle % ROOMBA_FLEET_WORKER_ROBOTS);
+  if (!post(worker, &message)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  worker->used &= ~((uint64_t)1 << message.slot);
+  return 0;
+}
+
+int roomba_fleet_command(ROOMBA_FLEET *fleet, ROOMBA_FLEET_HANDLE handle,
+  const uint8_t data[], uint8_t size) {
+  ROOMBA_FLEET_WORKER *worker = owner(fleet, handle);
+  ROOMBA_FLEET_MESSAGE message;
+
+  if (!worker) return -1;
+  if (size == 0 || size > ROOMBA_COMMAND_MAX_SIZE) {
+    errno = EINVAL;
+    return -1;
+  }
+  memset(&message, 0, sizeof(message));
+  message.request = ROOMBA_FLEET_COMMAND;
+  message.slot = (uint8_t)(handle % ROOMBA_FLEET_WORKER_ROBOTS);
+  message.size = size;
+  memcpy(message.data, data, size);
+  if (!post(worker, &message)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  return 0;
+}
+
+void roomba_fleet_stop(ROOMBA_FLEET *fleet) {
+  ROOMBA_FLEET_MESSAGE message;
+
+  memset(&message, 0, sizeof(message));
+  message.request = ROOMBA_FLEET_STOP;
+  for (uint8_t w = 0; w < fleet->config.workers; w++) {
+    ROOMBA_FLEET_WORKER *worker = &fleet->workers[w];
+    /* a full mailbox is drained eventually, wait for the room */
+    while (!post(worker, &message)) sched_yield();
+  }
+  for (uint8_t w = 0; w < fleet->config.workers; w++) {
+    pthread_join(fleet->workers[w].thread, NULL);
+    close_worker(&fleet->workers[w]);
+    fleet->workers[w].used = 0;
+  }
+  fleet->config.workers = 0;
+}
+
+void roomba_fleet_stats(const ROOMBA_FLEET *fleet,
+  ROOMBA_FLEET_WORKER_STATS *stats) {
+  uint32_t peak;
+
+  memset(stats, 0, sizeof(*stats));
+  for (uint8_t w = 0; w < fleet->config.workers; w++) {
+    const ROOMBA_FLEET_WORKER_STATS *s = &fleet->workers[w].stats;
+    stats->frames += __atomic_load_n(&s->frames, __ATOMIC_RELAXED);
+    stats->bytes += __atomic_load_n(&s->bytes, __ATOMIC_RELAXED);
+    stats->cpu_ns += __atomic_load_n(&s->cpu_ns, __ATOMIC_RELAXED);
+    stats->wakeups += __atomic_load_n(&s->wakeups, __ATOMIC_RELAXED);
+    stats->dropped += __atomic_load_n(&s->dropped, __ATOMIC_RELAXED);
+    stats->robots = (uint16_t)(stats->robots +
+      __atomic_load_n(&s->robots, __ATOMIC_RELAXED));
+    peak = __atomic_load_n(&s->arena_peak, __ATOMIC_RELAXED);
+    if (peak > stats->arena_peak) stats->arena_peak = peak;
+    stats->arena_failures += __atomic_load_n(&s->arena_failures,
+      __ATOMIC_RELAXED);
+  }
+}
@@ -0,0 +1,269 @@
+/**
+ * @file roomba_fleet.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_fleet.h> @endcode
+ *
+ * @brief Many serial links shared out over a fixed pool of worker threads
+ * (Linux)
+ *
+ * Each worker is a thread pinned to one CPU, waiting on its own epoll set.
+ * A robot belongs to exactly one worker for as long as it is in the fleet:
+ * its serial port, stream parser, command queue and scheduler are only ever
+ * touched by that thread, so the data path takes no locks. The frame hook
+ * runs on the robot's worker and may push to robot->queue directly.
+ *
+ * Adding and removing robots, and commands from other threads, travel as
+ * messages through a lock-free mailbox per worker, woken by an eventfd. The
+ * control functions return at once; nothing waits for a worker. They must
+ * all be called from one control thread.
+ *
+ * Serial ports are made non blocking. Commands go through a ROOMBA_WRITER
+ * per robot: a command the port only took part of is finished on EPOLLOUT
+ * before anything else is written, so the robot never sees a cut command. A
+ * command that does not fit is dropped whole and counted.
+ *
+ * New robots go to the worker with the fewest robots. Workers tick the
+ * schedulers of all their robots every 15 ms from one timerfd.
+ *
+ * Every worker also owns a ROOMBA_ARENA, reset after each tick, and the
+ * short-lived objects of the data path come out of it instead of the heap:
+ *   - the frame the hook receives is a snapshot in the arena, so the hook may
+ *     keep the pointer until the end of the cycle;
+ *   - a frame changing any of the bits of roomba_events.h adds a
+ *     ROOMBA_FLEET_EVENT record, and the records of the cycle are handed to
+ *     the events hook at the tick, before the reset;
+ *   - the hook allocates its own records and encoded commands
+ *     (roomba_arena_command) from roomba_fleet_arena(robot).
+ * All of them stay valid until the end of the current 15 ms cycle.
+ */
+
+#ifndef ROOMBA_FLEET_H_
+#define ROOMBA_FLEET_H_
+
+#include <pthread.h>
+
+#include "roomba.h"
+#include "roomba_arena.h"
+#include "roomba_events.h"
+#include "roomba_stream.h"
+#include "roomba_queue.h"
+#include "roomba_scheduler.h"
+#include "roomba_writer.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#ifndef ROOMBA_FLEET_MAX_WORKERS
+  #define ROOMBA_FLEET_MAX_WORKERS 8
+#endif
+
+/** Robots per worker, at most 64 */
+#ifndef ROOMBA_FLEET_WORKER_ROBOTS
+  #define ROOMBA_FLEET_WORKER_ROBOTS 32
+#endif
+
+/** Messages per mailbox, a power of two */
+#ifndef ROOMBA_FLEET_MAILBOX
+  #define ROOMBA_FLEET_MAILBOX 64
+#endif
+
+/** Bytes of arena per worker */
+#ifndef ROOMBA_FLEET_ARENA_SIZE
+  #define ROOMBA_FLEET_ARENA_SIZE 16384
+#endif
+
+/** Commands buffered per serial port, at least one */
+#ifndef ROOMBA_FLEET_ROBOT_BUFFER
+  #define ROOMBA_FLEET_ROBOT_BUFFER 256
+#endif
+
+#if ROOMBA_FLEET_MAX_WORKERS < 1 || ROOMBA_FLEET_MAX_WORKERS > 256
+  #error "ROOMBA_FLEET_MAX_WORKERS must be 1 - 256"
+#endif
+
+#if ROOMBA_FLEET_WORKER_ROBOTS < 1 || ROOMBA_FLEET_WORKER_ROBOTS > 64
+  #error "ROOMBA_FLEET_WORKER_ROBOTS must be 1 - 64"
+#endif
+
+#if ROOMBA_FLEET_MAILBOX < 2 || \
+    (ROOMBA_FLEET_MAILBOX & (ROOMBA_FLEET_MAILBOX - 1)) != 0
+  #error "ROOMBA_FLEET_MAILBOX must be a power of two"
+#endif
+
+#if ROOMBA_FLEET_ROBOT_BUFFER < ROOMBA_COMMAND_MAX_SIZE || \
+    ROOMBA_FLEET_ROBOT_BUFFER > 65535
+  #error "ROOMBA_FLEET_ROBOT_BUFFER must be ROOMBA_COMMAND_MAX_SIZE - 65535"
+#endif
+
+/** worker x ROOMBA_FLEET_WORKER_ROBOTS + slot, -1 for none */
+typedef int32_t ROOMBA_FLEET_HANDLE;
+
+typedef struct _roomba_fleet_robot {
+  struct _roomba_fleet_worker *worker;
+  /** Serial port, -1 while the slot is free */
+  int fd;
+  ROOMBA_FLEET_HANDLE handle;
+  /** Given to roomba_fleet_add */
+  void *context;
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_QUEUE queue;
+  ROOMBA_SCHEDULER scheduler;
+  /** roomba_events_pack of the last frame */
+  uint32_t events;
+  ROOMBA_WRITER writer;
+  uint8_t out[ROOMBA_FLEET_ROBOT_BUFFER];
+} ROOMBA_FLEET_ROBOT;
+
+/** Bits of roomba_events.h that changed in a frame, allocated in the arena */
+typedef struct _roomba_fleet_event {
+  struct _roomba_fleet_event *next;
+  ROOMBA_FLEET_HANDLE robot;
+  /** ROOMBA_EVENT_MASK of the bits that changed, and all bits after */
+  uint32_t changed;
+  uint32_t state;
+} ROOMBA_FLEET_EVENT;
+
+/**
+ * Runs on the robot's worker thread.
+ *
+ * @param frame snapshot in the worker's arena, valid until the end of the
+ * cycle
+ */
+typedef void (*ROOMBA_FLEET_FRAME_HOOK)(ROOMBA_FLEET_ROBOT *robot,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context);
+
+/**
+ * Runs on a worker thread at every tick that follows events.
+ *
+ * @param events the records of the cycle, oldest first
+ */
+typedef void (*ROOMBA_FLEET_EVENTS_HOOK)(const ROOMBA_FLEET_EVENT *events,
+  void *context);
+
+typedef enum {
+  ROOMBA_FLEET_ADD,
+  ROOMBA_FLEET_REMOVE,
+  ROOMBA_FLEET_COMMAND,
+  ROOMBA_FLEET_STOP,
+} ROOMBA_FLEET_REQUEST;
+
+typedef struct _roomba_fleet_message {
+  ROOMBA_FLEET_REQUEST request;
+  uint8_t slot;
+  uint8_t size;
+  ROOMBA_BITRATE bitrate;
+  int fd;
+  void *context;
+  uint8_t data[ROOMBA_COMMAND_MAX_SIZE];
+} ROOMBA_FLEET_MESSAGE;
+
+/** Written by the worker, read by anyone; values may be a moment old */
+typedef struct _roomba_fleet_worker_stats {
+  uint64_t frames;
+  uint64_t bytes;
+  /** CPU time the worker thread used */
+  uint64_t cpu_ns;
+  uint32_t wakeups;
+  /** Commands dropped because a robot's buffer was full */
+  uint32_t dropped;
+  uint16_t robots;
+  /**
+   * Most arena bytes used in one tick, and allocations that failed; a frame
+   * that did not fit is not handed to the hook
+   */
+  uint32_t arena_peak;
+  uint32_t arena_failures;
+} ROOMBA_FLEET_WORKER_STATS;
+
+typedef struct _roomba_fleet_worker {
+  struct _roomba_fleet *fleet;
+  pthread_t thread;
+  uint8_t index;
+  int cpu;
+  int epoll_fd;
+  int event_fd;
+  int timer_fd;
+  /** Written by the control thread only */
+  uint32_t mailbox_head;
+  /** Written by the worker only */
+  uint32_t mailbox_tail;
+  ROOMBA_FLEET_MESSAGE mailbox[ROOMBA_FLEET_MAILBOX];
+  ROOMBA_FLEET_WORKER_STATS stats;
+  ROOMBA_ARENA arena;
+  uint64_t arena_buffer[ROOMBA_FLEET_ARENA_SIZE / sizeof(uint64_t)];
+  /** Event records of the cycle, in the arena */
+  ROOMBA_FLEET_EVENT *events;
+  ROOMBA_FLEET_EVENT **events_tail;
+  /** Slots in use as seen by the control thread */
+  uint64_t used;
+  ROOMBA_FLEET_ROBOT robots[ROOMBA_FLEET_WORKER_ROBOTS];
+} ROOMBA_FLEET_WORKER;
+
+typedef struct _roomba_fleet_config {
+  uint8_t workers;
+  /** CPU of the first worker, the others follow; -1 for no pinning */
+  int first_cpu;
+  ROOMBA_FLEET_FRAME_HOOK on_frame;
+  /** NULL to skip the event records */
+  ROOMBA_FLEET_EVENTS_HOOK on_events;
+  /** Given to both hooks */
+  void *context;
+} ROOMBA_FLEET_CONFIG;
+
+typedef struct _roomba_fleet {
+  ROOMBA_FLEET_CONFIG config;
+  ROOMBA_FLEET_WORKER workers[ROOMBA_FLEET_MAX_WORKERS];
+} ROOMBA_FLEET;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * Starts the worker threads.
+ *
+ * @return 0, or -1 with errno set; no thread is left running on error
+ */
+int roomba_fleet_start(ROOMBA_FLEET *fleet, const ROOMBA_FLEET_CONFIG *config);
+
+/**
+ * Hands a serial port to the fleet. The worker closes it on removal.
+ *
+ * @param fd serial port, set to O_NONBLOCK here: a blocking write would
+ * stall every robot of the worker
+ * @param context stored in robot->context
+ * @return handle, or -1 with errno EAGAIN when all workers are full or a
+ * mailbox is, or with the error of fcntl
+ */
+ROOMBA_FLEET_HANDLE roomba_fleet_add(ROOMBA_FLEET *fleet, int fd,
+  ROOMBA_BITRATE bitrate, void *context);
+
+/** The handle can be reused by roomba_fleet_add right away */
+int roomba_fleet_remove(ROOMBA_FLEET *fleet, ROOMBA_FLEET_HANDLE handle);
+
+/**
+ * Queues a command on the robot's worker, for use outside the frame hook.
+ *
+ * @return 0, or -1 with errno set
+ */
+int roomba_fleet_command(ROOMBA_FLEET *fleet, ROOMBA_FLEET_HANDLE handle,
+  const uint8_t data[], uint8_t size);
+
+/** Stops and joins all workers and closes every serial port still added */
+void roomba_fleet_stop(ROOMBA_FLEET *fleet);
+
+/** Sums the statistics of all workers; arena_peak is the largest of them */
+void roomba_fleet_stats(const ROOMBA_FLEET *fleet,
+  ROOMBA_FLEET_WORKER_STATS *stats);
+
+/** Arena of the robot's worker, only from the frame hook */
+static inline ROOMBA_ARENA *roomba_fleet_arena(ROOMBA_FLEET_ROBOT *robot) {
+  return &robot->worker->arena;
+}
+
+/**@}*/
+
+#endif /* ROOMBA_FLEET_H_ */
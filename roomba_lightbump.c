@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include "roomba_lightbump.h"
+
+#if ROOMBA_LIGHT_AVERAGE == 1
+  #define AVERAGE_SHIFT 0
+#elif ROOMBA_LIGHT_AVERAGE == 2
+  #define AVERAGE_SHIFT 1
+#elif ROOMBA_LIGHT_AVERAGE == 4
+  #define AVERAGE_SHIFT 2
+#elif ROOMBA_LIGHT_AVERAGE == 8
+  #define AVERAGE_SHIFT 3
+#else
+  #define AVERAGE_SHIFT 4
+#endif
+
+#if defined(__GNUC__) && !defined(__AVR__) && !defined(ROOMBA_LIGHT_SCALAR)
+
+/* one channel per lane; compiles to SSE2 or NEON where there is one */
+typedef uint16_t LANES __attribute__((vector_size(2 * ROOMBA_LIGHT_LANES)));
+
+static inline LANES lanes_add(LANES a, LANES b) { return a + b; }
+static inline LANES lanes_sub(LANES a, LANES b) { return a - b; }
+static inline LANES lanes_shr(LANES a) { return a >> AVERAGE_SHIFT; }
+static inline LANES lanes_and(LANES a, LANES b) { return a & b; }
+static inline LANES lanes_or(LANES a, LANES b) { return a | b; }
+
+/* comparisons give 0 or -1 per lane */
+static inline LANES lanes_ge(LANES a, LANES b) { return (LANES)(a >= b); }
+
+static inline LANES lanes_min(LANES a, LANES b) {
+  LANES less = (LANES)(a < b);
+  return (a & less) | (b & ~less);
+}
+
+static inline LANES lanes_max(LANES a, LANES b) {
+  LANES less = (LANES)(a < b);
+  return (b & less) | (a & ~less);
+}
+
+#else
+
+typedef struct _lanes {
+  uint16_t v[ROOMBA_LIGHT_LANES];
+} LANES;
+
+#define LANES_LOOP(expression) \
+  LANES r; \
+  for (uint8_t i = 0; i < ROOMBA_LIGHT_LANES; i++) r.v[i] = (expression); \
+  return r
+
+static inline LANES lanes_add(LANES a, LANES b) {
+  LANES_LOOP((uint16_t)(a.v[i] + b.v[i]));
+}
+static inline LANES lanes_sub(LANES a, LANES b) {
+  LANES_LOOP((uint16_t)(a.v[i] - b.v[i]));
+}
+static inline LANES lanes_shr(LANES a) {
+  LANES_LOOP((uint16_t)(a.v[i] >> AVERAGE_SHIFT));
+}
+static inline LANES lanes_and(LANES a, LANES b) {
+  LANES_LOOP((uint16_t)(a.v[i] & b.v[i]));
+}
+static inline LANES lanes_or(LANES a, LANES b) {
+  LANES_LOOP((uint16_t)(a.v[i] | b.v[i]));
+}
+static inline LANES lanes_ge(LANES a, LANES b) {
+  LANES_LOOP(a.v[i] >= b.v[i] ? 0xFFFF : 0);
+}
+static inline LANES lanes_min(LANES a, LANES b) {
+  LANES_LOOP(a.v[i] < b.v[i] ? a.v[i] : b.v[i]);
+}
+static inline LANES lanes_max(LANES a, LANES b) {
+  LANES_LOOP(a.v[i] < b.v[i] ? b.v[i] : a.v[i]);
+}
+
+#endif
+
+static inline LANES load(const uint16_t v[ROOMBA_LIGHT_LANES]) {
+  LANES lanes;
+
+  memcpy(&lanes, v, sizeof(lanes));
+  return lanes;
+}
+
+static inline void store(uint16_t v[ROOMBA_LIGHT_LANES], LANES lanes) {
+  memcpy(v, &lanes, sizeof(lanes));
+}
+
+/* median, moving average and hysteresis for one sample of every channel */
+static uint8_t filter_lanes(ROOMBA_LIGHT_FILTER *filter,
+  const uint16_t sample[ROOMBA_LIGHT_LANES]) {
+  uint16_t limit[ROOMBA_LIGHT_LANES], mask[ROOMBA_LIGHT_LANES];
+  LANES x, a, b, median, sum, average, state;
+  uint8_t detected = 0;
+
+  for (uint8_t i = 0; i < ROOMBA_LIGHT_LANES; i++) limit[i] = ROOMBA_LIGHT_MAX;
+  x = lanes_min(load(sample), load(limit));
+
+  if (!filter->primed) {
+    sum = x;
+    for (uint8_t k = 1; k < ROOMBA_LIGHT_AVERAGE; k++) sum = lanes_add(sum, x);
+    store(filter->sum, sum);
+    for (uint8_t k = 0; k < ROOMBA_LIGHT_AVERAGE; k++) {
+      store(filter->window[k], x);
+    }
+    store(filter->previous[0], x);
+    store(filter->previous[1], x);
+    filter->primed = true;
+  }
+
+  a = load(filter->previous[0]);
+  b = load(filter->previous[1]);
+  median = lanes_max(lanes_min(a, b), lanes_min(lanes_max(a, b), x));
+  store(filter->previous[0], b);
+  store(filter->previous[1], x);
+
+  sum = lanes_add(lanes_sub(load(filter->sum),
+    load(filter->window[filter->index])), median);
+  store(filter->window[filter->index], median);
+  filter->index = (uint8_t)((filter->index + 1) & (ROOMBA_LIGHT_AVERAGE - 1));
+  store(filter->sum, sum);
+  average = lanes_shr(sum);
+  store(filter->filtered, average);
+
+  state = lanes_or(lanes_ge(average, load(filter->on)),
+    lanes_and(load(filter->state), lanes_ge(average, load(filter->off))));
+  store(filter->state, state);
+
+  store(mask, state);
+  for (uint8_t i = 0; i < ROOMBA_LIGHT_CHANNELS; i++) {
+    if (mask[i]) detected |= (uint8_t)(1 << i);
+  }
+  filter->detected = detected;
+  return detected;
+}
+
+void roomba_light_filter_init(ROOMBA_LIGHT_FILTER *filter, uint16_t on,
+  uint16_t off) {
+  memset(filter, 0, sizeof(*filter));
+  for (uint8_t i = 0; i < ROOMBA_LIGHT_LANES; i++) {
+    /* padding lanes never turn on */
+    filter->on[i] = i < ROOMBA_LIGHT_CHANNELS ? on : UINT16_MAX;
+    filter->off[i] = i < ROOMBA_LIGHT_CHANNELS ? off : UINT16_MAX;
+  }
+}
+
+void roomba_light_filter_set_thresholds(ROOMBA_LIGHT_FILTER *filter,
+  uint8_t channel, uint16_t on, uint16_t off) {
+  if (channel >= ROOMBA_LIGHT_CHANNELS) return;
+  filter->on[channel] = on;
+  filter->off[channel] = off;
+}
+
+void roomba_light_filter_reset(ROOMBA_LIGHT_FILTER *filter) {
+  memset(filter->state, 0, sizeof(filter->state));
+  filter->index = 0;
+  filter->primed = false;
+  filter->detected = 0;
+}
+
+uint8_t roomba_light_filter_update(ROOMBA_LIGHT_FILTER *filter,
+  const uint16_t raw[ROOMBA_LIGHT_CHANNELS]) {
+  uint16_t sample[ROOMBA_LIGHT_LANES] = {0};
+
+  memcpy(sample, raw, ROOMBA_LIGHT_CHANNELS * sizeof(raw[0]));
+  return filter_lanes(filter, sample);
+}
+
+uint8_t roomba_light_filter_frame(ROOMBA_LIGHT_FILTER *filter,
+  const ROOMBA_PACKET_GROUP_100 *frame) {
+  uint16_t sample[ROOMBA_LIGHT_LANES] = {
+    frame->light_bump_left,
+    frame->light_bump_front_left,
+    frame->light_bump_center_left,
+    frame->light_bump_center_right,
+    frame->light_bump_front_right,
+    frame->light_bump_right,
+  };
+
+  return filter_lanes(filter, sample);
+}
+
+void roomba_light_filter_batch(ROOMBA_LIGHT_FILTER *filter,
+  const uint16_t *const raw[ROOMBA_LIGHT_CHANNELS],
+  uint16_t *const filtered[ROOMBA_LIGHT_CHANNELS], uint8_t detected[],
+  uint32_t count) {
+  uint16_t sample[ROOMBA_LIGHT_LANES] = {0};
+
+  for (uint32_t n = 0; n < count; n++) {
+    uint8_t mask;
+    for (uint8_t c = 0; c < ROOMBA_LIGHT_CHANNELS; c++) sample[c] = raw[c][n];
+    mask = filter_lanes(filter, sample);
+    if (detected) detected[n] = mask;
+    if (!filtered) continue;
+    for (uint8_t c = 0; c < ROOMBA_LIGHT_CHANNELS; c++) {
+      filtered[c][n] = filter->filtered[c];
+    }
+  }
+}
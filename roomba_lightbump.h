@@ -0,0 +1,126 @@
+/**
+ * @file roomba_lightbump.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_lightbump.h> @endcode
+ *
+ * @brief Noise filter for the six light bump signals (packets 46 - 51)
+ *
+ * Each signal is clamped to 0 - 4095, passed through a median of its last
+ * three samples to remove single-frame spikes, then averaged over the last
+ * ROOMBA_LIGHT_AVERAGE samples. A channel is detected once its average
+ * reaches its on threshold and stays detected until the average falls below
+ * its off threshold.
+ *
+ * The six channels are filtered together, one per lane of a 16-byte vector
+ * with GCC's vector extensions, so a frame costs the same handful of vector
+ * operations whatever the signals. Other compilers, AVR, and builds defining
+ * ROOMBA_LIGHT_SCALAR get a plain loop over the lanes with the same results.
+ *
+ * Bit i of the detected mask is channel i, in packet order: the same layout
+ * as light_bumper (45).
+ *
+ * @code
+ * roomba_light_filter_init(&filter, 200, 120);
+ * uint8_t near = roomba_light_filter_frame(&filter, frame);
+ * @endcode
+ *
+ * roomba_light_filter_batch runs a filter over recorded columns, one per
+ * channel, e.g. to tune the window and thresholds offline. It is a
+ * convenience: each sample depends on the ones before it, so the batch still
+ * filters one sample of the six channels at a time and costs what as many
+ * roomba_light_filter_update calls would.
+ */
+
+#ifndef ROOMBA_LIGHTBUMP_H_
+#define ROOMBA_LIGHTBUMP_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#define ROOMBA_LIGHT_CHANNELS 6
+
+/** Channels padded to a 16-byte vector */
+#define ROOMBA_LIGHT_LANES 8
+
+/** Largest signal value, higher values are clamped */
+#define ROOMBA_LIGHT_MAX 4095
+
+/** Samples in the moving average, a power of two */
+#ifndef ROOMBA_LIGHT_AVERAGE
+  #define ROOMBA_LIGHT_AVERAGE 4
+#endif
+
+/* the sum of a window must fit the 16-bit lanes */
+#if ROOMBA_LIGHT_AVERAGE < 1 || ROOMBA_LIGHT_AVERAGE > 16 || \
+    (ROOMBA_LIGHT_AVERAGE & (ROOMBA_LIGHT_AVERAGE - 1)) != 0
+  #error "ROOMBA_LIGHT_AVERAGE must be a power of two, 1 - 16"
+#endif
+
+/** Channel bits of the detected mask */
+#define ROOMBA_LIGHT_ALL ((1 << ROOMBA_LIGHT_CHANNELS) - 1)
+
+typedef struct _roomba_light_filter {
+  /** Averages at which a channel turns on, and below which it turns off */
+  uint16_t on[ROOMBA_LIGHT_LANES];
+  uint16_t off[ROOMBA_LIGHT_LANES];
+  /** The two samples before the last one, for the median */
+  uint16_t previous[2][ROOMBA_LIGHT_LANES];
+  /** Median samples in the moving average, and their sum */
+  uint16_t window[ROOMBA_LIGHT_AVERAGE][ROOMBA_LIGHT_LANES];
+  uint16_t sum[ROOMBA_LIGHT_LANES];
+  /** Moving average after the last sample */
+  uint16_t filtered[ROOMBA_LIGHT_LANES];
+  /** 0xFFFF in the lanes of detected channels */
+  uint16_t state[ROOMBA_LIGHT_LANES];
+  uint8_t index;
+  /** The first sample fills the history */
+  bool primed;
+  uint8_t detected;
+} ROOMBA_LIGHT_FILTER;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/** Sets the same thresholds on every channel, off below on */
+void roomba_light_filter_init(ROOMBA_LIGHT_FILTER *filter, uint16_t on,
+  uint16_t off);
+
+void roomba_light_filter_set_thresholds(ROOMBA_LIGHT_FILTER *filter,
+  uint8_t channel, uint16_t on, uint16_t off);
+
+/** Forgets the history, keeps the thresholds */
+void roomba_light_filter_reset(ROOMBA_LIGHT_FILTER *filter);
+
+/**
+ * @param raw light_bump_left to light_bump_right
+ * @return detected channel mask
+ */
+uint8_t roomba_light_filter_update(ROOMBA_LIGHT_FILTER *filter,
+  const uint16_t raw[ROOMBA_LIGHT_CHANNELS]);
+
+/** roomba_light_filter_update with the signals of a decoded frame */
+uint8_t roomba_light_filter_frame(ROOMBA_LIGHT_FILTER *filter,
+  const ROOMBA_PACKET_GROUP_100 *frame);
+
+/**
+ * Filters count samples of every channel, continuing from the filter's
+ * state, one roomba_light_filter_update per sample.
+ *
+ * @param raw one column per channel, sample i of channel c at raw[c][i]
+ * @param filtered columns for the moving averages, or NULL
+ * @param detected the detected mask after each sample, or NULL
+ */
+void roomba_light_filter_batch(ROOMBA_LIGHT_FILTER *filter,
+  const uint16_t *const raw[ROOMBA_LIGHT_CHANNELS],
+  uint16_t *const filtered[ROOMBA_LIGHT_CHANNELS], uint8_t detected[],
+  uint32_t count);
+
+/**@}*/
+
+#endif /* ROOMBA_LIGHTBUMP_H_ */
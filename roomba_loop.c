@@ -0,0 +1,173 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "roomba_loop.h"
+
+/* loop filter gains as shifts: phase 1/4, frequency 1/64 */
+#define PHASE_SHIFT 2
+#define FREQUENCY_SHIFT 6
+/* the robot's crystal is far better than this, it only bounds bad locks */
+#define PERIOD_TOLERANCE_NS (ROOMBA_LOOP_PERIOD_NS / 20)
+
+static int64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void record(uint32_t histogram[], int64_t ns) {
+  uint8_t bin = 0;
+  int64_t us = ns / 1000;
+
+  while (us > 0 && bin < ROOMBA_LOOP_HISTOGRAM_BINS - 1) {
+    us >>= 1;
+    bin++;
+  }
+  histogram[bin]++;
+}
+
+static int arm_timer(ROOMBA_LOOP *loop) {
+  struct itimerspec spec;
+  int64_t at = loop->expected_ns + loop->period_ns / 2;
+
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = at / 1000000000LL;
+  spec.it_value.tv_nsec = at % 1000000000LL;
+  return timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+/* phase locked loop over arrival times, leaves expected_ns on the next frame */
+static void lock(ROOMBA_LOOP *loop, int64_t t) {
+  int64_t error;
+
+  if (loop->expected_ns == 0) {
+    loop->expected_ns = t + loop->period_ns;
+    return;
+  }
+  error = t - loop->expected_ns;
+  /*
+   * Lost frames, or a late frame whose slot the timer already gave up on:
+   * compare with the closest slot instead.
+   */
+  if (error > loop->period_ns / 2 || error < -loop->period_ns / 2) {
+    int64_t half = error > 0 ? loop->period_ns / 2 : -loop->period_ns / 2;
+    int64_t slots = (error + half) / loop->period_ns;
+    loop->expected_ns += slots * loop->period_ns;
+    error = t - loop->expected_ns;
+  }
+  record(loop->stats.arrival_error, error < 0 ? -error : error);
+
+  loop->period_ns += error >> FREQUENCY_SHIFT;
+  if (loop->period_ns > ROOMBA_LOOP_PERIOD_NS + PERIOD_TOLERANCE_NS) {
+    loop->period_ns = ROOMBA_LOOP_PERIOD_NS + PERIOD_TOLERANCE_NS;
+  } else if (loop->period_ns < ROOMBA_LOOP_PERIOD_NS - PERIOD_TOLERANCE_NS) {
+    loop->period_ns = ROOMBA_LOOP_PERIOD_NS - PERIOD_TOLERANCE_NS;
+  }
+  loop->expected_ns += (error >> PHASE_SHIFT) + loop->period_ns;
+}
+
+static void on_frame(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  ROOMBA_LOOP *loop = context;
+  int64_t start = now_ns(), elapsed;
+
+  (void)parser;
+  loop->stats.frames++;
+  lock(loop, start);
+  arm_timer(loop);
+
+  if (loop->config.controller) {
+    loop->config.controller(frame, loop->config.context);
+  }
+  if (loop->config.scheduler) roomba_scheduler_tick(loop->config.scheduler);
+
+  elapsed = now_ns() - start;
+  record(loop->stats.loop_time, elapsed);
+  if (elapsed > loop->stats.max_loop_ns) loop->stats.max_loop_ns = elapsed;
+  if (elapsed > loop->period_ns) loop->stats.overruns++;
+}
+
+static int apply_policy(const ROOMBA_LOOP_CONFIG *config) {
+  if (config->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(config->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) return -1;
+  }
+  if (config->priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = config->priority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) return -1;
+    /* page faults in the loop would undo the point of SCHED_FIFO */
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) return -1;
+  }
+  return 0;
+}
+
+int roomba_loop_init(ROOMBA_LOOP *loop, const ROOMBA_LOOP_CONFIG *config) {
+  memset(loop, 0, sizeof(*loop));
+  loop->config = *config;
+  loop->period_ns = ROOMBA_LOOP_PERIOD_NS;
+  roomba_stream_init(&loop->parser);
+  roomba_stream_set_frame_hook(&loop->parser, on_frame, loop);
+  loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  return loop->timer_fd < 0 ? -1 : 0;
+}
+
+int roomba_loop_run(ROOMBA_LOOP *loop) {
+  struct pollfd fds[2];
+  uint8_t buffer[256];
+
+  if (apply_policy(&loop->config) < 0) return -1;
+
+  fds[0].fd = loop->config.fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = loop->timer_fd;
+  fds[1].events = POLLIN;
+  loop->running = true;
+  while (loop->running) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (fds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
+      ssize_t n = read(loop->config.fd, buffer, sizeof(buffer));
+      if (n < 0 && errno != EAGAIN && errno != EINTR) return -1;
+      /* hung up: poll would report it again at once, forever */
+      if (n == 0) {
+        errno = EPIPE;
+        return -1;
+      }
+      if (n > 0) roomba_stream_parse(&loop->parser, buffer, (uint16_t)n);
+    }
+    if (fds[1].revents & POLLIN) {
+      uint64_t expirations;
+      if (read(loop->timer_fd, &expirations, sizeof(expirations)) ==
+          sizeof(expirations)) {
+        loop->stats.deadline_misses += (uint32_t)expirations;
+        loop->expected_ns += (int64_t)expirations * loop->period_ns;
+        arm_timer(loop);
+      }
+    }
+  }
+  return 0;
+}
+
+void roomba_loop_stop(ROOMBA_LOOP *loop) {
+  loop->running = false;
+}
+
+void roomba_loop_close(ROOMBA_LOOP *loop) {
+  if (loop->timer_fd >= 0) close(loop->timer_fd);
+  loop->timer_fd = -1;
+}
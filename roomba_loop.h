@@ -0,0 +1,110 @@
+/**
+ * @file roomba_loop.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_loop.h> @endcode
+ *
+ * @brief Control loop runner locked to the robot's 15 ms stream cadence
+ * (Linux)
+ *
+ * Instead of sleeping for a fixed period, the loop waits on the serial port
+ * and calls the controller from the stream parser's frame hook, the moment a
+ * frame with a valid checksum has been decoded. Commands the controller
+ * queues are handed to the scheduler right after it returns, so they leave in
+ * the same slot instead of one period later.
+ *
+ * A timerfd armed at the predicted arrival of the next frame plus half a
+ * period reports late or lost frames as deadline misses. The prediction is a
+ * phase locked loop over frame arrival times. The loop can optionally run
+ * under SCHED_FIFO and pinned to one CPU.
+ */
+
+#ifndef ROOMBA_LOOP_H_
+#define ROOMBA_LOOP_H_
+
+#include "roomba.h"
+#include "roomba_stream.h"
+#include "roomba_scheduler.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#define ROOMBA_LOOP_PERIOD_NS 15000000LL
+
+/**
+ * Histogram bins: bin 0 counts durations under 1 us, bin k durations in
+ * [2^(k-1), 2^k) us; the last bin also takes everything longer.
+ */
+#define ROOMBA_LOOP_HISTOGRAM_BINS 16
+
+typedef void (*ROOMBA_CONTROLLER)(const ROOMBA_PACKET_GROUP_100 *frame,
+  void *context);
+
+typedef struct _roomba_loop_config {
+  /** Serial port, opened by the caller */
+  int fd;
+  /** SCHED_FIFO priority (1 - 99), 0 keeps the current policy */
+  int priority;
+  /** CPU to pin the loop thread to, -1 for no pinning */
+  int cpu;
+  ROOMBA_CONTROLLER controller;
+  void *context;
+  /** Ticked right after the controller, NULL if commands are sent otherwise */
+  ROOMBA_SCHEDULER *scheduler;
+} ROOMBA_LOOP_CONFIG;
+
+typedef struct _roomba_loop_stats {
+  uint32_t frames;
+  /** Timer expirations without a frame: late or lost frames */
+  uint32_t deadline_misses;
+  /** Frames whose controller and scheduler ran longer than a period */
+  uint32_t overruns;
+  /** Controller plus scheduler time per frame */
+  uint32_t loop_time[ROOMBA_LOOP_HISTOGRAM_BINS];
+  /** Absolute difference between predicted and actual frame arrival */
+  uint32_t arrival_error[ROOMBA_LOOP_HISTOGRAM_BINS];
+  int64_t max_loop_ns;
+} ROOMBA_LOOP_STATS;
+
+typedef struct _roomba_loop {
+  ROOMBA_LOOP_CONFIG config;
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_LOOP_STATS stats;
+  int timer_fd;
+  /** Predicted arrival of the next frame, CLOCK_MONOTONIC ns */
+  int64_t expected_ns;
+  int64_t period_ns;
+  volatile bool running;
+} ROOMBA_LOOP;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * Installs the frame hook on loop->parser; a packet hook (e.g.
+ * roomba_safety_packet_hook) can still be set on it.
+ *
+ * @return 0, or -1 with errno set
+ */
+int roomba_loop_init(ROOMBA_LOOP *loop, const ROOMBA_LOOP_CONFIG *config);
+
+/**
+ * Applies the scheduling policy and CPU affinity to the calling thread and
+ * runs until roomba_loop_stop.
+ *
+ * @return 0 when stopped, -1 with errno set on an I/O or setup error; EPIPE
+ * when the serial port is closed or unplugged
+ */
+int roomba_loop_run(ROOMBA_LOOP *loop);
+
+/** Safe to call from the controller or a signal handler */
+void roomba_loop_stop(ROOMBA_LOOP *loop);
+
+void roomba_loop_close(ROOMBA_LOOP *loop);
+
+/**@}*/
+
+#endif /* ROOMBA_LOOP_H_ */
@@ -0,0 +1,141 @@
+#include "roomba_mode.h"
+
+#define OFF (1 << ROOMBA_OFF_MODE)
+#define PASSIVE (1 << ROOMBA_PASSIVE_MODE)
+#define SAFE (1 << ROOMBA_SAFE_MODE)
+#define FULL (1 << ROOMBA_FULL_MODE)
+/* what the docs call "Passive, Safe, or Full" and "Safe or Full" */
+#define ON (PASSIVE | SAFE | FULL)
+#define CONTROL (SAFE | FULL)
+
+#define FIRST_OPCODE ROOMBA_START
+#define LAST_OPCODE 173
+
+/* next is the mode the opcode changes to plus one, 0 for no change */
+typedef struct {
+  uint8_t allowed;
+  uint8_t next;
+} OPCODE_MODES;
+
+#define TO(mode) ((mode) + 1)
+
+static const OPCODE_MODES opcodes[LAST_OPCODE - FIRST_OPCODE + 1] = {
+  /* Start is how the OI leaves Off */
+  [ROOMBA_START - FIRST_OPCODE] = { OFF | ON, TO(ROOMBA_PASSIVE_MODE) },
+  [ROOMBA_BAUD - FIRST_OPCODE] = { ON, 0 },
+  [ROOMBA_CONTROL - FIRST_OPCODE] = { ON, TO(ROOMBA_SAFE_MODE) },
+  [ROOMBA_SAFE - FIRST_OPCODE] = { ON, TO(ROOMBA_SAFE_MODE) },
+  [ROOMBA_FULL - FIRST_OPCODE] = { ON, TO(ROOMBA_FULL_MODE) },
+  [ROOMBA_POWER - FIRST_OPCODE] = { ON, TO(ROOMBA_PASSIVE_MODE) },
+  [ROOMBA_SPOT - FIRST_OPCODE] = { ON, TO(ROOMBA_PASSIVE_MODE) },
+  /* Clean or Cover */
+  [135 - FIRST_OPCODE] = { ON, TO(ROOMBA_PASSIVE_MODE) },
+  /* Max or Demo */
+  [136 - FIRST_OPCODE] = { ON, TO(ROOMBA_PASSIVE_MODE) },
+  [ROOMBA_DRIVE - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_MOTORS - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_LEDS - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_SONG - FIRST_OPCODE] = { ON, 0 },
+  [ROOMBA_PLAY - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_SENSORS - FIRST_OPCODE] = { ON, 0 },
+  [ROOMBA_SEEK_DOCK - FIRST_OPCODE] = { ON, TO(ROOMBA_PASSIVE_MODE) },
+  [ROOMBA_PWM_MOTORS - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_DRIVE_DIRECT - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_DRIVE_PWM - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_STREAM - FIRST_OPCODE] = { ON, 0 },
+  [ROOMBA_QUERY_LIST - FIRST_OPCODE] = { ON, 0 },
+  [ROOMBA_PAUSE_RESUME_STREAM - FIRST_OPCODE] = { ON, 0 },
+#if ROOMBA_INTERFACE_VERSION==1
+  [DIGITAL_OUTPUTS - FIRST_OPCODE] = { CONTROL, 0 },
+  [SEND_IR - FIRST_OPCODE] = { CONTROL, 0 },
+  [SCRIPT - FIRST_OPCODE] = { ON, 0 },
+  [PLAY_SCRIPT - FIRST_OPCODE] = { ON, 0 },
+  [SHOW_SCRIPT - FIRST_OPCODE] = { ON, 0 },
+  [WAIT_TIME - FIRST_OPCODE] = { ON, 0 },
+  [WAIT_DISTANCE - FIRST_OPCODE] = { ON, 0 },
+  [WAIT_ANGLE - FIRST_OPCODE] = { ON, 0 },
+  [WAIT_EVENT - FIRST_OPCODE] = { ON, 0 },
+#endif
+#if ROOMBA_INTERFACE_VERSION==2
+  [ROOMBA_SCHEDULING_LEDS - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_DIGIT_LEDS_RAW - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_DIGIT_LEDS_ASCII - FIRST_OPCODE] = { CONTROL, 0 },
+  [ROOMBA_BUTTONS_CMD - FIRST_OPCODE] = { ON, 0 },
+  [ROOMBA_SCHEDULE - FIRST_OPCODE] = { ON, 0 },
+  [ROOMBA_SET_DAY_TIME - FIRST_OPCODE] = { ON, 0 },
+  [ROOMBA_STOP - FIRST_OPCODE] = { ON, TO(ROOMBA_OFF_MODE) },
+#endif
+};
+
+static const OPCODE_MODES *lookup(uint8_t opcode) {
+  static const OPCODE_MODES reset = { OFF | ON, TO(ROOMBA_OFF_MODE) };
+
+  if (opcode == ROOMBA_RESET) return &reset;
+  if (opcode < FIRST_OPCODE || opcode > LAST_OPCODE) return NULL;
+  /* holes in the table are opcodes this interface version does not have */
+  if (opcodes[opcode - FIRST_OPCODE].allowed == 0) return NULL;
+  return &opcodes[opcode - FIRST_OPCODE];
+}
+
+void roomba_mode_init(ROOMBA_MODE_TRACKER *tracker) {
+  tracker->mode = ROOMBA_OFF_MODE;
+  tracker->known = false;
+  tracker->confirmed = false;
+  tracker->skipped = 0;
+  tracker->rejected = 0;
+  tracker->corrections = 0;
+}
+
+bool roomba_mode_allows(ROOMBA_MODE mode, uint8_t opcode) {
+  const OPCODE_MODES *entry = lookup(opcode);
+
+  return !entry || (entry->allowed & (1 << mode));
+}
+
+ROOMBA_MODE_VERDICT roomba_mode_filter(ROOMBA_MODE_TRACKER *tracker,
+  const uint8_t data[], uint8_t size) {
+  const OPCODE_MODES *entry;
+
+  if (size == 0) return ROOMBA_MODE_SEND;
+  entry = lookup(data[0]);
+  if (!entry) return ROOMBA_MODE_SEND;
+
+  if (tracker->known) {
+    if (!(entry->allowed & (1 << tracker->mode))) {
+      tracker->rejected++;
+      return ROOMBA_MODE_REJECT;
+    }
+    if ((data[0] == ROOMBA_SAFE || data[0] == ROOMBA_CONTROL ||
+         data[0] == ROOMBA_FULL) && entry->next == TO(tracker->mode) &&
+        tracker->confirmed) {
+      tracker->skipped++;
+      return ROOMBA_MODE_SKIP;
+    }
+  }
+  if (entry->next) {
+    tracker->mode = (ROOMBA_MODE)(entry->next - 1);
+    tracker->known = true;
+    tracker->confirmed = false;
+  }
+  return ROOMBA_MODE_SEND;
+}
+
+void roomba_mode_observe(ROOMBA_MODE_TRACKER *tracker, uint8_t oi_mode) {
+  if (oi_mode > ROOMBA_FULL_MODE) return;
+  if (tracker->known && tracker->mode != oi_mode) tracker->corrections++;
+  tracker->mode = (ROOMBA_MODE)oi_mode;
+  tracker->known = true;
+  tracker->confirmed = true;
+}
+
+void roomba_mode_invalidate(ROOMBA_MODE_TRACKER *tracker) {
+  tracker->known = false;
+  tracker->confirmed = false;
+}
+
+void roomba_mode_frame_hook(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  if (parser->present & ROOMBA_PACKET_BIT(ROOMBA_OPEN_INTERFACE_MODE)) {
+    roomba_mode_observe(context, frame->open_interface_mode);
+  }
+}
@@ -0,0 +1,92 @@
+/**
+ * @file roomba_mode.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_mode.h> @endcode
+ *
+ * @brief Tracks the OI mode to drop redundant and illegal commands locally
+ *
+ * The tracker knows for every opcode the modes it is available in and the
+ * mode it changes to, as listed in roomba.h. It follows the commands that
+ * are sent and corrects itself with packet 35 (Open Interface Mode) from
+ * the stream, which also catches the robot's own fall back from Safe to
+ * Passive on a cliff or wheel drop.
+ *
+ * Before a command goes out, roomba_mode_filter decides:
+ *   - Skip: Safe or Full while packet 35 has reported that mode since the
+ *     last command that changed it. A mode only inferred from sent commands
+ *     is never trusted for this: without packet 35 in the stream, the
+ *     robot's fall back to Passive would go unseen and every recovering Safe
+ *     would be skipped.
+ *   - Reject: the mode does not allow the opcode, e.g. Drive in Passive.
+ *     The robot would ignore it without any reply.
+ *   - Send: everything else, including anything while the mode is unknown.
+ */
+
+#ifndef ROOMBA_MODE_H_
+#define ROOMBA_MODE_H_
+
+#include "roomba.h"
+#include "roomba_stream.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+typedef enum {
+  ROOMBA_MODE_SEND,
+  ROOMBA_MODE_SKIP,
+  ROOMBA_MODE_REJECT,
+} ROOMBA_MODE_VERDICT;
+
+typedef struct _roomba_mode_tracker {
+  ROOMBA_MODE mode;
+  /** False until the first Start, mode change or packet 35 */
+  bool known;
+  /** Packet 35 reported mode since the last command that changed it */
+  bool confirmed;
+  /** Redundant mode commands not sent */
+  uint32_t skipped;
+  /** Commands the mode did not allow */
+  uint32_t rejected;
+  /** Packet 35 reports that differed from the tracked mode */
+  uint32_t corrections;
+} ROOMBA_MODE_TRACKER;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+void roomba_mode_init(ROOMBA_MODE_TRACKER *tracker);
+
+/** @return true if opcode is accepted in mode; unknown opcodes are */
+bool roomba_mode_allows(ROOMBA_MODE mode, uint8_t opcode);
+
+/**
+ * Decides about a command about to be sent and, if the verdict is
+ * ROOMBA_MODE_SEND, moves the tracked mode to where the command takes it.
+ */
+ROOMBA_MODE_VERDICT roomba_mode_filter(ROOMBA_MODE_TRACKER *tracker,
+  const uint8_t data[], uint8_t size);
+
+/** @param oi_mode value of packet 35 */
+void roomba_mode_observe(ROOMBA_MODE_TRACKER *tracker, uint8_t oi_mode);
+
+/**
+ * Forgets the mode, e.g. after a stop the tracker did not see. See
+ * roomba_safety_set_mode_tracker.
+ */
+void roomba_mode_invalidate(ROOMBA_MODE_TRACKER *tracker);
+
+/**
+ * ROOMBA_FRAME_HOOK feeding packet 35 of checksummed frames, context is the
+ * tracker. Call roomba_mode_observe from an existing frame hook instead if
+ * the parser already has one.
+ */
+void roomba_mode_frame_hook(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context);
+
+/**@}*/
+
+#endif /* ROOMBA_MODE_H_ */
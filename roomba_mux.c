@@ -0,0 +1,346 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "roomba_mux.h"
+
+/* epoll data of the fds that are not clients, above any client index */
+#define SERIAL_EVENT 0xFFFFFFF0u
+#define LISTEN_EVENT 0xFFFFFFF1u
+#define TIMER_EVENT 0xFFFFFFF2u
+
+#define EVENTS 64
+
+static int watch(ROOMBA_MUX *mux, int op, int fd, uint32_t events,
+  uint32_t id) {
+  struct epoll_event event;
+
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.u32 = id;
+  return epoll_ctl(mux->epoll_fd, op, fd, &event);
+}
+
+static void serial_blocked(void *context, bool blocked) {
+  ROOMBA_MUX *mux = context;
+
+  watch(mux, EPOLL_CTL_MOD, mux->fd, blocked ? EPOLLIN | EPOLLOUT : EPOLLIN,
+    SERIAL_EVENT);
+}
+
+static void serial_write(void *context, const uint8_t data[], uint16_t size) {
+  ROOMBA_MUX *mux = context;
+
+  if (!roomba_writer_write(&mux->serial, data, size)) {
+    mux->stats.serial_dropped++;
+  }
+}
+
+/* subscribes the robot to the union of what the clients want */
+static void resubscribe(ROOMBA_MUX *mux) {
+  uint8_t command[ROOMBA_COMMAND_MAX_SIZE];
+  uint8_t count = roomba_stream_request(mux->wanted, &command[2],
+    ROOMBA_STREAM_IDS_MAX);
+
+  if (count == 0) {
+    command[0] = ROOMBA_PAUSE_RESUME_STREAM;
+    command[1] = 0;
+    if (!roomba_queue_push(&mux->queue, command, 2)) return;
+    roomba_scheduler_set_stream_bytes(&mux->scheduler, 0);
+  } else {
+    command[0] = ROOMBA_STREAM;
+    command[1] = count;
+    if (!roomba_queue_push(&mux->queue, command, (uint8_t)(2 + count))) return;
+    roomba_scheduler_set_stream_bytes(&mux->scheduler,
+      roomba_stream_frame_size(&command[2], count));
+  }
+  mux->streaming = mux->wanted;
+  mux->stats.resubscribed++;
+}
+
+static void update_wanted(ROOMBA_MUX *mux) {
+  mux->wanted = 0;
+  for (uint16_t i = 0; i < ROOMBA_MUX_MAX_CLIENTS; i++) {
+    if (mux->clients[i].fd >= 0) mux->wanted |= mux->clients[i].packets;
+  }
+}
+
+static void drop_client(ROOMBA_MUX *mux, uint16_t index) {
+  ROOMBA_MUX_CLIENT *client = &mux->clients[index];
+
+  close(client->fd);
+  client->fd = -1;
+  client->out_size = 0;
+  client->packets = 0;
+  update_wanted(mux);
+}
+
+static void mark_pending(ROOMBA_MUX *mux, uint16_t index) {
+  ROOMBA_MUX_CLIENT *client = &mux->clients[index];
+
+  if (client->pending || client->blocked) return;
+  client->pending = true;
+  mux->pending[mux->pending_count++] = index;
+}
+
+static void on_frame(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  ROOMBA_MUX *mux = context;
+
+  mux->stats.frames++;
+  for (uint16_t i = 0; i < ROOMBA_MUX_MAX_CLIENTS; i++) {
+    ROOMBA_MUX_CLIENT *client = &mux->clients[i];
+    uint64_t mask = client->packets & parser->present;
+
+    if (client->fd < 0 || mask == 0) continue;
+    if (client->out_size + ROOMBA_STREAM_FRAME_MAX > ROOMBA_MUX_CLIENT_BUFFER) {
+      client->dropped++;
+      mux->stats.dropped++;
+      continue;
+    }
+    client->out_size = (uint16_t)(client->out_size +
+      roomba_stream_encode(frame, mask, &client->out[client->out_size]));
+    mark_pending(mux, i);
+  }
+}
+
+static void flush_client(ROOMBA_MUX *mux, uint16_t index) {
+  ROOMBA_MUX_CLIENT *client = &mux->clients[index];
+  ssize_t n;
+
+  if (client->fd < 0 || client->out_size == 0) return;
+  n = send(client->fd, client->out, client->out_size, MSG_NOSIGNAL);
+  mux->stats.client_writes++;
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EINTR) n = 0;
+    else {
+      drop_client(mux, index);
+      return;
+    }
+  }
+  memmove(client->out, &client->out[n], client->out_size - (size_t)n);
+  client->out_size = (uint16_t)(client->out_size - n);
+  if ((client->out_size > 0) != client->blocked) {
+    client->blocked = client->out_size > 0;
+    watch(mux, EPOLL_CTL_MOD, client->fd,
+      client->blocked ? EPOLLIN | EPOLLOUT : EPOLLIN, index);
+  }
+}
+
+/* the multiplexer alone decides what the robot sends back */
+static bool owned(uint8_t opcode) {
+  return opcode == ROOMBA_SENSORS || opcode == ROOMBA_QUERY_LIST ||
+    opcode == ROOMBA_STREAM || opcode == ROOMBA_PAUSE_RESUME_STREAM;
+}
+
+static void handle_message(ROOMBA_MUX *mux, ROOMBA_MUX_CLIENT *client,
+  uint8_t type, uint8_t payload[], uint8_t size) {
+  uint64_t packets = 0;
+
+  switch (type) {
+    case ROOMBA_MUX_SUBSCRIBE:
+      for (uint8_t i = 0; i < size; i++) {
+        packets |= roomba_packet_mask(payload[i]);
+      }
+      client->packets = packets;
+      update_wanted(mux);
+      break;
+    case ROOMBA_MUX_COMMAND:
+      mux->stats.commands++;
+      if (size == 0 || size > ROOMBA_COMMAND_MAX_SIZE || owned(payload[0]) ||
+          !is_valid_roomba_command(payload, size) ||
+          !roomba_queue_push(&mux->queue, payload, size)) {
+        mux->stats.rejected++;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/* @return false if the client is gone */
+static bool read_client(ROOMBA_MUX *mux, uint16_t index) {
+  ROOMBA_MUX_CLIENT *client = &mux->clients[index];
+  uint16_t used = 0;
+  ssize_t n;
+
+  n = recv(client->fd, &client->in[client->in_size],
+    sizeof(client->in) - client->in_size, 0);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+    drop_client(mux, index);
+    return false;
+  }
+  if (n < 0) return true;
+  client->in_size = (uint16_t)(client->in_size + n);
+
+  while (client->in_size - used >= 2 &&
+         client->in_size - used >= 2 + client->in[used + 1]) {
+    uint8_t size = client->in[used + 1];
+    handle_message(mux, client, client->in[used], &client->in[used + 2], size);
+    used = (uint16_t)(used + 2 + size);
+  }
+  memmove(client->in, &client->in[used], client->in_size - used);
+  client->in_size = (uint16_t)(client->in_size - used);
+  return true;
+}
+
+static void accept_clients(ROOMBA_MUX *mux) {
+  for (;;) {
+    uint16_t i;
+    bool pending;
+    int fd = accept4(mux->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0) return;
+    for (i = 0; i < ROOMBA_MUX_MAX_CLIENTS; i++) {
+      if (mux->clients[i].fd < 0) break;
+    }
+    if (i == ROOMBA_MUX_MAX_CLIENTS || watch(mux, EPOLL_CTL_ADD, fd, EPOLLIN,
+        i) < 0) {
+      close(fd);
+      mux->stats.refused++;
+      continue;
+    }
+    /* a slot freed in this iteration may still be on the pending list */
+    pending = mux->clients[i].pending;
+    memset(&mux->clients[i], 0, sizeof(mux->clients[i]) -
+      sizeof(mux->clients[i].out));
+    mux->clients[i].fd = fd;
+    mux->clients[i].pending = pending;
+    mux->stats.accepted++;
+  }
+}
+
+int roomba_mux_init(ROOMBA_MUX *mux, int fd, const char *path,
+  ROOMBA_BITRATE bitrate) {
+  struct sockaddr_un address;
+  struct itimerspec spec;
+  ROOMBA_TRANSPORT transport;
+  int flags;
+
+  memset(mux, 0, sizeof(*mux) - sizeof(mux->clients));
+  for (uint16_t i = 0; i < ROOMBA_MUX_MAX_CLIENTS; i++) {
+    mux->clients[i].fd = -1;
+  }
+  mux->fd = fd;
+  mux->listen_fd = mux->epoll_fd = mux->timer_fd = -1;
+  flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return -1;
+  roomba_writer_init(&mux->serial, fd, mux->serial_out,
+    sizeof(mux->serial_out), serial_blocked, mux);
+  roomba_stream_init(&mux->parser);
+  roomba_stream_set_frame_hook(&mux->parser, on_frame, mux);
+  roomba_queue_init(&mux->queue);
+  transport.write = serial_write;
+  transport.context = mux;
+  roomba_scheduler_init(&mux->scheduler, &mux->queue, transport, bitrate);
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(address.sun_path, path);
+  unlink(path);
+  mux->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+    0);
+  if (mux->listen_fd < 0) return -1;
+  if (bind(mux->listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(mux->listen_fd, SOMAXCONN) < 0) {
+    return -1;
+  }
+
+  mux->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (mux->timer_fd < 0) return -1;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_nsec = ROOMBA_SLOT_MS * 1000000L;
+  spec.it_interval = spec.it_value;
+  if (timerfd_settime(mux->timer_fd, 0, &spec, NULL) < 0) return -1;
+
+  mux->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (mux->epoll_fd < 0) return -1;
+  if (watch(mux, EPOLL_CTL_ADD, fd, EPOLLIN, SERIAL_EVENT) < 0 ||
+      watch(mux, EPOLL_CTL_ADD, mux->listen_fd, EPOLLIN, LISTEN_EVENT) < 0 ||
+      watch(mux, EPOLL_CTL_ADD, mux->timer_fd, EPOLLIN, TIMER_EVENT) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+int roomba_mux_run(ROOMBA_MUX *mux) {
+  struct epoll_event events[EVENTS];
+  uint8_t buffer[512];
+
+  mux->running = true;
+  while (mux->running) {
+    int count = epoll_wait(mux->epoll_fd, events, EVENTS, -1);
+
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    for (int i = 0; i < count; i++) {
+      uint32_t id = events[i].data.u32;
+
+      if (id == SERIAL_EVENT) {
+        ssize_t n;
+        if (events[i].events & EPOLLOUT) roomba_writer_flush(&mux->serial);
+        if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) continue;
+        n = read(mux->fd, buffer, sizeof(buffer));
+        /* a hung up port stays readable, it would be reported forever */
+        if (n == 0) {
+          errno = EPIPE;
+          return -1;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) return -1;
+        if (n > 0) roomba_stream_parse(&mux->parser, buffer, (uint16_t)n);
+      } else if (id == LISTEN_EVENT) {
+        accept_clients(mux);
+      } else if (id == TIMER_EVENT) {
+        uint64_t expirations;
+        if (read(mux->timer_fd, &expirations, sizeof(expirations)) !=
+            sizeof(expirations)) {
+          continue;
+        }
+        if (mux->wanted != mux->streaming) resubscribe(mux);
+        roomba_scheduler_tick(&mux->scheduler);
+      } else if (mux->clients[id].fd >= 0) {
+        if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+            !read_client(mux, (uint16_t)id)) {
+          continue;
+        }
+        if (events[i].events & EPOLLOUT) flush_client(mux, (uint16_t)id);
+      }
+    }
+
+    /* one write per client for everything this iteration produced */
+    for (uint16_t i = 0; i < mux->pending_count; i++) {
+      mux->clients[mux->pending[i]].pending = false;
+      flush_client(mux, mux->pending[i]);
+    }
+    mux->pending_count = 0;
+  }
+  return 0;
+}
+
+void roomba_mux_stop(ROOMBA_MUX *mux) {
+  mux->running = false;
+}
+
+void roomba_mux_close(ROOMBA_MUX *mux) {
+  for (uint16_t i = 0; i < ROOMBA_MUX_MAX_CLIENTS; i++) {
+    if (mux->clients[i].fd >= 0) close(mux->clients[i].fd);
+    mux->clients[i].fd = -1;
+  }
+  if (mux->epoll_fd >= 0) close(mux->epoll_fd);
+  if (mux->timer_fd >= 0) close(mux->timer_fd);
+  if (mux->listen_fd >= 0) close(mux->listen_fd);
+  mux->epoll_fd = mux->timer_fd = mux->listen_fd = -1;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file roomba_mux.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_mux.h> @endcode
+ *
+ * @brief Serial port multiplexer serving many local clients over a Unix
+ * domain socket (Linux)
+ *
+ * One process owns the serial port; any number of clients connect to a
+ * SOCK_STREAM socket instead of opening the port themselves. The robot
+ * streams the union of the packets the clients subscribed to, as one Stream
+ * (148) subscription, and every client only receives its own packets.
+ *
+ * Client to multiplexer, one message after the other:
+ *
+ * | Type                  | Payload                                      |
+ * |-----------------------|----------------------------------------------|
+ * | ROOMBA_MUX_SUBSCRIBE  | packet ids, groups allowed, none to stop     |
+ * | ROOMBA_MUX_COMMAND    | one OI command, opcode and data bytes        |
+ *
+ * each framed as [type][payload size][payload]. A subscription replaces the
+ * previous one. Sensors, Query List, Stream and Pause/Resume Stream are
+ * refused, the multiplexer owns what the robot sends back. Other commands go
+ * through is_valid_roomba_command into the shared
+ * ROOMBA_QUEUE, so a client's motion command still overtakes another one's
+ * song.
+ *
+ * Multiplexer to client: stream frames in the robot's own format,
+ * [19][size][id data ...][checksum], holding the client's packets from the
+ * frame that just arrived. A client feeds them to roomba_stream_parse.
+ *
+ * Commands for the robot go through a ROOMBA_WRITER: the serial port is made
+ * non blocking, and a command the port only took part of is finished on
+ * EPOLLOUT before anything else is written, so the robot never sees a cut
+ * command. A command that does not fit in the buffer is dropped whole.
+ *
+ * Frames are appended to a per-client buffer and written with one write per
+ * client per event loop iteration. A client that does not keep up loses
+ * whole frames, never parts of one, and never holds up the others.
+ *
+ * All storage is in ROOMBA_MUX; with the defaults it is about 600 kB.
+ */
+
+#ifndef ROOMBA_MUX_H_
+#define ROOMBA_MUX_H_
+
+#include "roomba.h"
+#include "roomba_stream.h"
+#include "roomba_queue.h"
+#include "roomba_scheduler.h"
+#include "roomba_writer.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#ifndef ROOMBA_MUX_MAX_CLIENTS
+  #define ROOMBA_MUX_MAX_CLIENTS 256
+#endif
+
+/** Output buffered per client, at least one frame */
+#ifndef ROOMBA_MUX_CLIENT_BUFFER
+  #define ROOMBA_MUX_CLIENT_BUFFER 2048
+#endif
+
+/** Commands buffered for the serial port, a few slots worth */
+#ifndef ROOMBA_MUX_SERIAL_BUFFER
+  #define ROOMBA_MUX_SERIAL_BUFFER 1024
+#endif
+
+#if ROOMBA_MUX_MAX_CLIENTS < 1 || ROOMBA_MUX_MAX_CLIENTS > 4096
+  #error "ROOMBA_MUX_MAX_CLIENTS must be 1 - 4096"
+#endif
+
+#if ROOMBA_MUX_CLIENT_BUFFER < ROOMBA_STREAM_FRAME_MAX || \
+    ROOMBA_MUX_CLIENT_BUFFER > 65535
+  #error "ROOMBA_MUX_CLIENT_BUFFER must be ROOMBA_STREAM_FRAME_MAX - 65535"
+#endif
+
+#if ROOMBA_MUX_SERIAL_BUFFER < ROOMBA_COMMAND_MAX_SIZE || \
+    ROOMBA_MUX_SERIAL_BUFFER > 65535
+  #error "ROOMBA_MUX_SERIAL_BUFFER must be ROOMBA_COMMAND_MAX_SIZE - 65535"
+#endif
+
+typedef enum {
+  ROOMBA_MUX_SUBSCRIBE = 1,
+  ROOMBA_MUX_COMMAND = 2,
+} ROOMBA_MUX_MESSAGE;
+
+/** Largest message: type, size and 255 payload bytes */
+#define ROOMBA_MUX_MESSAGE_MAX 257
+
+typedef struct _roomba_mux_client {
+  int fd;
+  /** ROOMBA_PACKET_BIT of the subscribed packets */
+  uint64_t packets;
+  /** Waiting for EPOLLOUT */
+  bool blocked;
+  /** On the list of clients to write to */
+  bool pending;
+  uint16_t in_size;
+  uint16_t out_size;
+  /** Frames dropped because the buffer was full */
+  uint32_t dropped;
+  uint8_t in[ROOMBA_MUX_MESSAGE_MAX];
+  uint8_t out[ROOMBA_MUX_CLIENT_BUFFER];
+} ROOMBA_MUX_CLIENT;
+
+typedef struct _roomba_mux_stats {
+  uint32_t frames;
+  uint32_t accepted;
+  /** Connections refused because all client slots were taken */
+  uint32_t refused;
+  uint32_t commands;
+  /** Commands that were invalid or did not fit in the queue */
+  uint32_t rejected;
+  /** Stream subscriptions sent to the robot */
+  uint32_t resubscribed;
+  uint32_t dropped;
+  /** Writes to clients, at most one per client per loop iteration */
+  uint32_t client_writes;
+  /** Commands dropped because the serial buffer was full */
+  uint32_t serial_dropped;
+} ROOMBA_MUX_STATS;
+
+typedef struct _roomba_mux {
+  /** Serial port, opened by the caller */
+  int fd;
+  int listen_fd;
+  int epoll_fd;
+  int timer_fd;
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_QUEUE queue;
+  ROOMBA_SCHEDULER scheduler;
+  /** Union the robot is streaming, and the one it should stream */
+  uint64_t streaming;
+  uint64_t wanted;
+  ROOMBA_MUX_STATS stats;
+  volatile bool running;
+  ROOMBA_WRITER serial;
+  uint8_t serial_out[ROOMBA_MUX_SERIAL_BUFFER];
+  uint16_t pending_count;
+  uint16_t pending[ROOMBA_MUX_MAX_CLIENTS];
+  ROOMBA_MUX_CLIENT clients[ROOMBA_MUX_MAX_CLIENTS];
+} ROOMBA_MUX;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * Creates and listens on the socket at path, replacing a stale one.
+ *
+ * @param fd serial port, already set up for bitrate; set to O_NONBLOCK here,
+ * a blocking write would stall every client
+ * @return 0, or -1 with errno set
+ */
+int roomba_mux_init(ROOMBA_MUX *mux, int fd, const char *path,
+  ROOMBA_BITRATE bitrate);
+
+/**
+ * Serves clients until roomba_mux_stop. Commands are sent by the scheduler
+ * once per 15 ms slot.
+ *
+ * @return 0 when stopped, -1 with errno set on a serial port or setup error;
+ * EPIPE when the serial port hung up
+ */
+int roomba_mux_run(ROOMBA_MUX *mux);
+
+/** Safe to call from a signal handler */
+void roomba_mux_stop(ROOMBA_MUX *mux);
+
+/** Disconnects all clients and closes the socket; the serial port stays open */
+void roomba_mux_close(ROOMBA_MUX *mux);
+
+/**@}*/
+
+#endif /* ROOMBA_MUX_H_ */
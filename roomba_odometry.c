@@ -0,0 +1,224 @@
+#include "roomba_odometry.h"
+
+/**
+ * Largest heading change, in encoder counts, integrated in a single step.
+ * 128 counts is about 0.24 rad, where the rotation polynomials below are
+ * still accurate to better than 1e-6. A normal 15 ms frame at full speed
+ * stays under 40 counts, so larger jumps only happen after lost frames.
+ */
+#define ROOMBA_ODOMETRY_MAX_STEP 128
+
+#ifdef ROOMBA_ODOMETRY_FIXED_POINT
+
+#define Q30_ONE ((int32_t)1 << 30)
+#define Q30_ROUND ((int64_t)1 << 29)
+#define Q22_ROUND ((int64_t)1 << 21)
+#define MM_Q16_PER_COUNT \
+  ((int32_t)(65536.0 * ROOMBA_MM_PER_ENCODER_COUNT + 0.5))
+#define HALF_RAD_Q30_PER_COUNT \
+  ((int32_t)(1073741824.0 / (2.0 * ROOMBA_WHEEL_BASE_COUNTS) + 0.5))
+#define RAD_Q32_PER_COUNT \
+  ((int64_t)(4294967296.0 / ROOMBA_WHEEL_BASE_COUNTS + 0.5))
+#define TWO_PI_Q16 ((int32_t)411775)
+#define MAX_ANGLE_Q30 ((int32_t)(0.25 * 1073741824.0))
+
+/* rotates the unit vector (c, s) by a, with a in Q2.30 radians */
+static inline void rotate(int32_t *c, int32_t *s, int32_t a) {
+  int64_t a2 = ((int64_t)a * a) >> 30;
+  int32_t sa = a - (int32_t)((((int64_t)a * a2) >> 30) / 6);
+  int32_t ca = Q30_ONE - (int32_t)(a2 >> 1) + (int32_t)(((a2 * a2) >> 30) / 24);
+  int32_t nc = (int32_t)(((int64_t)*c * ca - (int64_t)*s * sa + Q30_ROUND) >> 30);
+  int32_t ns = (int32_t)(((int64_t)*s * ca + (int64_t)*c * sa + Q30_ROUND) >> 30);
+  *c = nc;
+  *s = ns;
+}
+
+/* one Newton step towards c^2 + s^2 = 1, enough to cancel rounding drift */
+static inline void normalize(int32_t *c, int32_t *s) {
+  int64_t m = ((int64_t)*c * *c + (int64_t)*s * *s) >> 30;
+  int64_t f = (3 * (int64_t)Q30_ONE - m) >> 1;
+  *c = (int32_t)((*c * f + Q30_ROUND) >> 30);
+  *s = (int32_t)((*s * f + Q30_ROUND) >> 30);
+}
+
+static inline void step(ROOMBA_ODOMETRY *o, int32_t dl, int32_t dr) {
+  int32_t k = dr - dl;
+  int32_t half = k * HALF_RAD_Q30_PER_COUNT;
+  int32_t d = ((dl + dr) * MM_Q16_PER_COUNT) / 2;
+
+  rotate(&o->cos_theta, &o->sin_theta, half);
+  o->x_q30 += ((int64_t)d * o->cos_theta) >> 16;
+  o->y_q30 += ((int64_t)d * o->sin_theta) >> 16;
+  rotate(&o->cos_theta, &o->sin_theta, half);
+  normalize(&o->cos_theta, &o->sin_theta);
+  o->heading_counts += k;
+}
+
+static inline void update_pose(ROOMBA_ODOMETRY *o) {
+  o->pose.x = (int32_t)((o->x_q30 + Q22_ROUND) >> 22);
+  o->pose.y = (int32_t)((o->y_q30 + Q22_ROUND) >> 22);
+  o->pose.theta = o->theta_origin +
+    (int32_t)(((int64_t)o->heading_counts * RAD_Q32_PER_COUNT) >> 16);
+}
+
+void roomba_odometry_set_pose(ROOMBA_ODOMETRY *odometry,
+  ROOMBA_ODOMETRY_VALUE x, ROOMBA_ODOMETRY_VALUE y,
+  ROOMBA_ODOMETRY_VALUE theta) {
+  int32_t remaining = theta % TWO_PI_Q16;
+
+  odometry->pose.x = x;
+  odometry->pose.y = y;
+  odometry->pose.theta = theta;
+  odometry->x_q30 = (int64_t)x * (1 << 22);
+  odometry->y_q30 = (int64_t)y * (1 << 22);
+  odometry->theta_origin = theta;
+  odometry->heading_counts = 0;
+  odometry->cos_theta = Q30_ONE;
+  odometry->sin_theta = 0;
+  /* Q16.16 to Q2.30 in chunks the polynomial handles */
+  while (remaining != 0) {
+    int32_t chunk = remaining;
+    if (chunk > (MAX_ANGLE_Q30 >> 14)) chunk = MAX_ANGLE_Q30 >> 14;
+    if (chunk < -(MAX_ANGLE_Q30 >> 14)) chunk = -(MAX_ANGLE_Q30 >> 14);
+    rotate(&odometry->cos_theta, &odometry->sin_theta, chunk * (1 << 14));
+    normalize(&odometry->cos_theta, &odometry->sin_theta);
+    remaining -= chunk;
+  }
+}
+
+#else
+
+#define HALF_RAD_PER_COUNT ((float)(0.5 / ROOMBA_WHEEL_BASE_COUNTS))
+#define RAD_PER_COUNT ((float)(1.0 / ROOMBA_WHEEL_BASE_COUNTS))
+#define HALF_MM_PER_COUNT ((float)(0.5 * ROOMBA_MM_PER_ENCODER_COUNT))
+#define TWO_PI 6.28318530717959f
+#define MAX_ANGLE 0.25f
+
+static inline void rotate(float *c, float *s, float a) {
+  float a2 = a * a;
+  float sa = a * (1.0f - a2 * (1.0f / 6.0f));
+  float ca = 1.0f - a2 * 0.5f * (1.0f - a2 * (1.0f / 12.0f));
+  float nc = *c * ca - *s * sa;
+  float ns = *s * ca + *c * sa;
+  *c = nc;
+  *s = ns;
+}
+
+static inline void normalize(float *c, float *s) {
+  float f = 0.5f * (3.0f - (*c * *c + *s * *s));
+  *c *= f;
+  *s *= f;
+}
+
+static inline void step(ROOMBA_ODOMETRY *o, int32_t dl, int32_t dr) {
+  int32_t k = dr - dl;
+  float half = (float)k * HALF_RAD_PER_COUNT;
+  float d = (float)(dl + dr) * HALF_MM_PER_COUNT;
+
+  rotate(&o->cos_theta, &o->sin_theta, half);
+  o->pose.x += d * o->cos_theta;
+  o->pose.y += d * o->sin_theta;
+  rotate(&o->cos_theta, &o->sin_theta, half);
+  normalize(&o->cos_theta, &o->sin_theta);
+  o->heading_counts += k;
+}
+
+static inline void update_pose(ROOMBA_ODOMETRY *o) {
+  o->pose.theta = o->theta_origin + (float)o->heading_counts * RAD_PER_COUNT;
+}
+
+void roomba_odometry_set_pose(ROOMBA_ODOMETRY *odometry,
+  ROOMBA_ODOMETRY_VALUE x, ROOMBA_ODOMETRY_VALUE y,
+  ROOMBA_ODOMETRY_VALUE theta) {
+  float remaining = theta - (float)(int32_t)(theta / TWO_PI) * TWO_PI;
+
+  odometry->pose.x = x;
+  odometry->pose.y = y;
+  odometry->pose.theta = theta;
+  odometry->theta_origin = theta;
+  odometry->heading_counts = 0;
+  odometry->cos_theta = 1.0f;
+  odometry->sin_theta = 0.0f;
+  while (remaining != 0.0f) {
+    float chunk = remaining;
+    if (chunk > MAX_ANGLE) chunk = MAX_ANGLE;
+    if (chunk < -MAX_ANGLE) chunk = -MAX_ANGLE;
+    rotate(&odometry->cos_theta, &odometry->sin_theta, chunk);
+    normalize(&odometry->cos_theta, &odometry->sin_theta);
+    remaining -= chunk;
+  }
+}
+
+#endif
+
+/*
+ * Splits a jump that is too large to integrate as one arc (e.g. after lost
+ * frames) into equal sub-steps. Only taken when frames were dropped.
+ */
+static void step_split(ROOMBA_ODOMETRY *o, int32_t dl, int32_t dr) {
+  int32_t k = dr - dl;
+  int32_t n = (k < 0 ? -k : k) / ROOMBA_ODOMETRY_MAX_STEP + 1;
+  int32_t done_l = 0, done_r = 0;
+
+  for (int32_t i = 1; i <= n; i++) {
+    int32_t l = dl * i / n;
+    int32_t r = dr * i / n;
+    step(o, l - done_l, r - done_r);
+    done_l = l;
+    done_r = r;
+  }
+}
+
+static inline void integrate(ROOMBA_ODOMETRY *o, uint16_t left,
+  uint16_t right) {
+  /* modular difference, correct across the 65535 -> 0 roll over */
+  int32_t dl = (int16_t)(uint16_t)(left - o->last_left);
+  int32_t dr = (int16_t)(uint16_t)(right - o->last_right);
+  int32_t k = dr - dl;
+
+  o->last_left = left;
+  o->last_right = right;
+  if (k > ROOMBA_ODOMETRY_MAX_STEP || k < -ROOMBA_ODOMETRY_MAX_STEP) {
+    step_split(o, dl, dr);
+  } else if (dl != 0 || dr != 0) {
+    step(o, dl, dr);
+  }
+}
+
+void roomba_odometry_init(ROOMBA_ODOMETRY *odometry) {
+  roomba_odometry_set_pose(odometry, 0, 0, 0);
+  odometry->last_left = 0;
+  odometry->last_right = 0;
+  odometry->primed = false;
+}
+
+void roomba_odometry_update(ROOMBA_ODOMETRY *odometry, uint16_t left,
+  uint16_t right) {
+  if (!odometry->primed) {
+    odometry->last_left = left;
+    odometry->last_right = right;
+    odometry->primed = true;
+    return;
+  }
+  integrate(odometry, left, right);
+  update_pose(odometry);
+}
+
+void roomba_odometry_update_batch(ROOMBA_ODOMETRY *odometry,
+  const uint16_t left[], const uint16_t right[], uint16_t count) {
+  ROOMBA_ODOMETRY o = *odometry;
+  uint16_t i = 0;
+
+  if (count == 0) return;
+  if (!o.primed) {
+    o.last_left = left[0];
+    o.last_right = right[0];
+    o.primed = true;
+    i = 1;
+  }
+  for (; i < count; i++) {
+    integrate(&o, left[i], right[i]);
+  }
+  update_pose(&o);
+  *odometry = o;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file roomba_odometry.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_odometry.h> @endcode
+ *
+ * @brief Incremental pose integrator driven by the raw wheel encoder counts
+ * (packets 43 and 44)
+ *
+ * The distance (19) and angle (20) packets are rounded to whole millimeters
+ * and degrees by the robot every time they are read, so integrating them
+ * loses precision on every frame. The encoder counts are cumulative and only
+ * wrap, which makes them lossless as long as the difference between two
+ * consecutive readings fits in a signed 16-bit value.
+ *
+ * The heading is kept as an integer number of encoder ticks (right minus
+ * left) so it never drifts, and as a cosine/sine pair that is rotated by a
+ * short polynomial on each frame. No trigonometric function is called.
+ *
+ * Define ROOMBA_ODOMETRY_FIXED_POINT to build the integer only version for
+ * targets without a floating point unit:
+ *
+ * '''bash
+ * -D ROOMBA_ODOMETRY_FIXED_POINT
+ * '''
+ *
+ * | Field | Floating point | Fixed point      |
+ * |-------|----------------|------------------|
+ * | x, y  | mm             | 1/256 mm (Q24.8) |
+ * | theta | rad            | rad (Q16.16)     |
+ */
+
+#ifndef ROOMBA_ODOMETRY_H_
+#define ROOMBA_ODOMETRY_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/**
+ * Robot geometry. The defaults are the values given in the Create® 2 Open
+ * Interface specification and can be overridden with compiler flags.
+ */
+#ifndef ROOMBA_ENCODER_COUNTS_PER_REV
+  #define ROOMBA_ENCODER_COUNTS_PER_REV 508.8
+#endif
+
+#ifndef ROOMBA_WHEEL_DIAMETER_MM
+  #define ROOMBA_WHEEL_DIAMETER_MM 72.0
+#endif
+
+#ifndef ROOMBA_WHEEL_BASE_MM
+  #define ROOMBA_WHEEL_BASE_MM 235.0
+#endif
+
+#define ROOMBA_MM_PER_ENCODER_COUNT \
+  (3.14159265358979 * ROOMBA_WHEEL_DIAMETER_MM / ROOMBA_ENCODER_COUNTS_PER_REV)
+
+/** Wheel base expressed in encoder counts, one radian of heading per unit */
+#define ROOMBA_WHEEL_BASE_COUNTS \
+  (ROOMBA_WHEEL_BASE_MM / ROOMBA_MM_PER_ENCODER_COUNT)
+
+#ifdef ROOMBA_ODOMETRY_FIXED_POINT
+  typedef int32_t ROOMBA_ODOMETRY_VALUE;
+#else
+  typedef float ROOMBA_ODOMETRY_VALUE;
+#endif
+
+typedef struct _roomba_pose {
+  ROOMBA_ODOMETRY_VALUE x;
+  ROOMBA_ODOMETRY_VALUE y;
+  /** Unwrapped heading, counter-clockwise positive */
+  ROOMBA_ODOMETRY_VALUE theta;
+} ROOMBA_POSE;
+
+typedef struct _roomba_odometry {
+  ROOMBA_POSE pose;
+  /** Heading as a unit vector, Q2.30 in fixed point mode */
+  ROOMBA_ODOMETRY_VALUE cos_theta;
+  ROOMBA_ODOMETRY_VALUE sin_theta;
+  /** Heading passed to roomba_odometry_set_pose */
+  ROOMBA_ODOMETRY_VALUE theta_origin;
+  #ifdef ROOMBA_ODOMETRY_FIXED_POINT
+  /** Position accumulators in Q34.30 mm, rounded into pose after each update */
+  int64_t x_q30;
+  int64_t y_q30;
+  #endif
+  /** Right minus left encoder counts since roomba_odometry_set_pose */
+  int32_t heading_counts;
+  uint16_t last_left;
+  uint16_t last_right;
+  bool primed;
+} ROOMBA_ODOMETRY;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * Resets the integrator to the origin. The first encoder reading after this
+ * call only primes the integrator and does not move the pose.
+ */
+void roomba_odometry_init(ROOMBA_ODOMETRY *odometry);
+
+/**
+ * @param x position in the units of ROOMBA_POSE
+ * @param y position in the units of ROOMBA_POSE
+ * @param theta heading in the units of ROOMBA_POSE
+ */
+void roomba_odometry_set_pose(ROOMBA_ODOMETRY *odometry,
+  ROOMBA_ODOMETRY_VALUE x, ROOMBA_ODOMETRY_VALUE y,
+  ROOMBA_ODOMETRY_VALUE theta);
+
+/**
+ * Integrates one frame.
+ *
+ * @param left value of packet 43 (ROOMBA_ENCODER_COUNTS_LEFT)
+ * @param right value of packet 44 (ROOMBA_ENCODER_COUNTS_RIGHT)
+ */
+void roomba_odometry_update(ROOMBA_ODOMETRY *odometry, uint16_t left,
+  uint16_t right);
+
+/**
+ * Integrates a recorded sequence of frames, equivalent to calling
+ * roomba_odometry_update for each pair but with the state kept in registers
+ * for the whole run.
+ *
+ * @param left count values of packet 43, one per frame
+ * @param right count values of packet 44, one per frame
+ * @param count number of frames
+ */
+void roomba_odometry_update_batch(ROOMBA_ODOMETRY *odometry,
+  const uint16_t left[], const uint16_t right[], uint16_t count);
+
+/**@}*/
+
+#endif /* ROOMBA_ODOMETRY_H_ */
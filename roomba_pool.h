@@ -0,0 +1,90 @@
+/**
+ * @file roomba_pool.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_pool.h> @endcode
+ *
+ * @brief Fixed-size static pools for builds without a heap
+ *
+ * The library never allocates: parsers, queues, rings and the rest are plain
+ * structs whose buffers are sized by macros at compile time. For a variable
+ * number of robots, ROOMBA_POOL_DEFINE reserves the objects statically and
+ * hands them out and back in constant time:
+ *
+ * @code
+ * ROOMBA_POOL_DEFINE(parsers, ROOMBA_STREAM_PARSER, 4)
+ *
+ * ROOMBA_STREAM_PARSER *parser = parsers_acquire();   // NULL when exhausted
+ * parsers_release(parser);
+ * @endcode
+ *
+ * Define ROOMBA_NO_HEAP for the whole build to make any call to malloc,
+ * calloc, realloc or free a compile error, on the host as well as on the
+ * target. Size macros out of range, and pools too large for their bitmap,
+ * are rejected at compile time too.
+ */
+
+#ifndef ROOMBA_POOL_H_
+#define ROOMBA_POOL_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+  #define ROOMBA_STATIC_ASSERT(condition, name) _Static_assert(condition, #name)
+#else
+  /* negative array size when the condition is false */
+  #define ROOMBA_STATIC_ASSERT(condition, name) \
+    typedef char roomba_static_assert_##name[(condition) ? 1 : -1]
+#endif
+
+/** Objects per pool, one bit each in a uint32_t */
+#define ROOMBA_POOL_MAX 32
+
+/**
+ * Defines a pool of count objects of type with these functions:
+ *   - type *name_acquire(void), NULL when all objects are in use
+ *   - void name_release(type *object)
+ *   - uint8_t name_available(void)
+ *
+ * Acquired objects are not cleared, call their init function.
+ */
+#define ROOMBA_POOL_DEFINE(name, type, count)                                  \
+  ROOMBA_STATIC_ASSERT((count) > 0 && (count) <= ROOMBA_POOL_MAX,              \
+    name##_pool_size);                                                         \
+  static type name##_objects[count];                                           \
+  static uint32_t name##_used;                                                 \
+                                                                               \
+  static inline type *name##_acquire(void) {                                   \
+    uint32_t all = (uint32_t)0xFFFFFFFFUL >> (32 - (count));                 \
+    uint32_t free_bits = ~name##_used & all;                                   \
+    uint8_t i = 0;                                                             \
+                                                                               \
+    if (free_bits == 0) return NULL;                                           \
+    while (!(free_bits & 1)) {                                                 \
+      free_bits >>= 1;                                                         \
+      i++;                                                                     \
+    }                                                                          \
+    name##_used |= (uint32_t)1 << i;                                           \
+    return &name##_objects[i];                                                 \
+  }                                                                            \
+                                                                               \
+  static inline void name##_release(type *object) {                            \
+    name##_used &= ~((uint32_t)1 << (object - name##_objects));                \
+  }                                                                            \
+                                                                               \
+  static inline uint8_t name##_available(void) {                               \
+    uint8_t n = 0;                                                             \
+    for (uint8_t i = 0; i < (count); i++) {                                    \
+      if (!(name##_used & ((uint32_t)1 << i))) n++;                            \
+    }                                                                          \
+    return n;                                                                  \
+  }
+
+/**@}*/
+
+#endif /* ROOMBA_POOL_H_ */
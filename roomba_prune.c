@@ -0,0 +1,107 @@
+#include <string.h>
+
+#include "roomba_prune.h"
+
+void roomba_prune_init(ROOMBA_PRUNE *prune, ROOMBA_CACHE *cache,
+  ROOMBA_QUEUE *queue, ROOMBA_SCHEDULER *scheduler) {
+  memset(prune, 0, sizeof(*prune));
+  prune->cache = cache;
+  prune->queue = queue;
+  prune->scheduler = scheduler;
+}
+
+void roomba_prune_set_hook(ROOMBA_PRUNE *prune, ROOMBA_PRUNE_HOOK hook,
+  void *context) {
+  prune->hook = hook;
+  prune->hook_context = context;
+}
+
+/* requests the stream of packets, pauses it if there are none */
+static bool stream(ROOMBA_PRUNE *prune, const uint8_t packets[],
+  uint8_t count) {
+  uint8_t command[ROOMBA_COMMAND_MAX_SIZE];
+  uint16_t size = 0;
+
+  if (count == 0) {
+    command[0] = ROOMBA_PAUSE_RESUME_STREAM;
+    command[1] = 0;
+  } else {
+    command[0] = ROOMBA_STREAM;
+    command[1] = count;
+    memcpy(&command[2], packets, count);
+    size = roomba_stream_frame_size(packets, count);
+  }
+  if (!roomba_queue_push(prune->queue, command,
+      (uint8_t)(count == 0 ? 2 : 2 + count))) {
+    return false;
+  }
+  roomba_scheduler_set_stream_bytes(prune->scheduler, size);
+  prune->stats.streamed_bytes = size;
+  return true;
+}
+
+bool roomba_prune_start(ROOMBA_PRUNE *prune, const uint8_t packets[],
+  uint8_t count, uint32_t now_ms, uint32_t warmup_ms) {
+  uint64_t requested = 0;
+  uint16_t size;
+
+  if (count > ROOMBA_STREAM_IDS_MAX) return false;
+  for (uint8_t i = 0; i < count; i++) {
+    requested |= roomba_packet_mask(packets[i]);
+  }
+  if (!stream(prune, packets, count)) return false;
+
+  size = prune->stats.streamed_bytes;
+  memset(&prune->stats, 0, sizeof(prune->stats));
+  prune->stats.requested_bytes = size;
+  prune->stats.streamed_bytes = size;
+  prune->requested = requested;
+  prune->streaming = requested;
+  prune->deadline = now_ms + warmup_ms;
+  prune->warming_up = true;
+  prune->cache->used = 0;
+  return true;
+}
+
+/*
+ * Streams the packets read during the warm-up. The list may carry more than
+ * those, e.g. group 100 when the ids do not fit a command; streaming holds
+ * what it really carries.
+ */
+static void prune_stream(ROOMBA_PRUNE *prune) {
+  uint8_t packets[ROOMBA_STREAM_IDS_MAX];
+  uint64_t used = prune->cache->used & prune->requested;
+  uint8_t count = roomba_stream_request(used, packets, ROOMBA_STREAM_IDS_MAX);
+  uint64_t streaming = 0;
+
+  /* tried again next slot */
+  if (!stream(prune, packets, count)) return;
+
+  for (uint8_t i = 0; i < count; i++) {
+    streaming |= roomba_packet_mask(packets[i]);
+  }
+  prune->streaming = streaming;
+  prune->warming_up = false;
+  prune->stats.saved_bytes =
+    prune->stats.requested_bytes > prune->stats.streamed_bytes ?
+    (uint16_t)(prune->stats.requested_bytes - prune->stats.streamed_bytes) : 0;
+  if (prune->hook) prune->hook(prune, prune->hook_context);
+}
+
+void roomba_prune_poll(ROOMBA_PRUNE *prune, uint32_t now_ms) {
+  uint64_t late;
+
+  if (prune->requested == 0) return;
+  if (prune->warming_up) {
+    if (roomba_expired(now_ms, prune->deadline)) prune_stream(prune);
+    return;
+  }
+
+  /* the cache queries these on its own, this only counts them */
+  late = prune->cache->used & prune->requested & ~prune->streaming &
+    ~prune->stats.late;
+  for (; late; late &= late - 1) {
+    prune->stats.late |= late & -late;
+    prune->stats.late_packets++;
+  }
+}
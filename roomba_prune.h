@@ -0,0 +1,101 @@
+/**
+ * @file roomba_prune.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_prune.h> @endcode
+ *
+ * @brief Stream list pruned to the packets the application reads
+ *
+ * Streaming group 100 "just in case" costs 80 of the 172 bytes a slot
+ * carries at 115200 bps. Instead of requesting the stream itself the
+ * application can hand its list to roomba_prune_start. The full list is
+ * streamed for a warm-up window while the ROOMBA_CACHE notes every packet
+ * read through roomba_get_packet. When the window ends the stream is
+ * requested again with only those packets, and the bytes saved per slot are
+ * kept in the stats and reported to the hook.
+ *
+ * A packet read after pruning is no longer streamed; the cache finds it
+ * stale and fetches it with a Query List, as for any other packet. Such
+ * packets are counted so a too short warm-up shows.
+ *
+ * @code
+ * uint8_t packets[] = {ALL_PACKETS};
+ * roomba_prune_init(&prune, &cache, &queue, &scheduler);
+ * roomba_prune_start(&prune, packets, 1, now, 10000);
+ * // every slot
+ * roomba_prune_poll(&prune, now);
+ * @endcode
+ */
+
+#ifndef ROOMBA_PRUNE_H_
+#define ROOMBA_PRUNE_H_
+
+#include "roomba.h"
+#include "roomba_cache.h"
+#include "roomba_queue.h"
+#include "roomba_scheduler.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+typedef struct _roomba_prune_stats {
+  /** Stream frame size as requested and as streamed, bytes */
+  uint16_t requested_bytes;
+  uint16_t streamed_bytes;
+  /** Receive bytes per slot saved by pruning */
+  uint16_t saved_bytes;
+  /** Pruned packets read since, each counted once */
+  uint8_t late_packets;
+  /** ROOMBA_PACKET_BIT of those packets */
+  uint64_t late;
+} ROOMBA_PRUNE_STATS;
+
+typedef struct _roomba_prune ROOMBA_PRUNE;
+
+/** Called once the stream has been pruned */
+typedef void (*ROOMBA_PRUNE_HOOK)(const ROOMBA_PRUNE *prune, void *context);
+
+struct _roomba_prune {
+  ROOMBA_CACHE *cache;
+  ROOMBA_QUEUE *queue;
+  ROOMBA_SCHEDULER *scheduler;
+  ROOMBA_PRUNE_HOOK hook;
+  void *hook_context;
+  /** ROOMBA_PACKET_BIT of the packets asked for, and of those streamed */
+  uint64_t requested;
+  uint64_t streaming;
+  /** End of the warm-up window */
+  uint32_t deadline;
+  bool warming_up;
+  ROOMBA_PRUNE_STATS stats;
+};
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/** @param cache must see every frame and every read, see roomba_cache.h */
+void roomba_prune_init(ROOMBA_PRUNE *prune, ROOMBA_CACHE *cache,
+  ROOMBA_QUEUE *queue, ROOMBA_SCHEDULER *scheduler);
+
+void roomba_prune_set_hook(ROOMBA_PRUNE *prune, ROOMBA_PRUNE_HOOK hook,
+  void *context);
+
+/**
+ * Streams the packets and starts the warm-up window; restarts it if pruning
+ * is under way or done.
+ *
+ * @param packets single value packets and groups, as for Stream (148)
+ * @return false if the queue is full
+ */
+bool roomba_prune_start(ROOMBA_PRUNE *prune, const uint8_t packets[],
+  uint8_t count, uint32_t now_ms, uint32_t warmup_ms);
+
+/** Prunes the stream at the end of the warm-up. Call once per slot. */
+void roomba_prune_poll(ROOMBA_PRUNE *prune, uint32_t now_ms);
+
+/**@}*/
+
+#endif /* ROOMBA_PRUNE_H_ */
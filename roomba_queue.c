@@ -0,0 +1,211 @@
+#include <string.h>
+
+#include "roomba_queue.h"
+
+/* commands of the same family supersede each other, 0 for none */
+static uint8_t family(uint8_t opcode) {
+  switch (opcode) {
+    case ROOMBA_DRIVE:
+    case ROOMBA_DRIVE_DIRECT:
+    case ROOMBA_DRIVE_PWM:
+      return 1;
+    case ROOMBA_MOTORS:
+    case ROOMBA_PWM_MOTORS:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+/* commands that change the mode, what nothing pushed later may overtake */
+static bool is_barrier(uint8_t opcode) {
+  switch (opcode) {
+    case ROOMBA_RESET:
+    case ROOMBA_START:
+    case ROOMBA_CONTROL:
+    case ROOMBA_SAFE:
+    case ROOMBA_FULL:
+    case ROOMBA_POWER:
+    case ROOMBA_SPOT:
+    case 135: /* Clean or Cover */
+    case 136: /* Max or Demo */
+    case ROOMBA_SEEK_DOCK:
+    #if ROOMBA_INTERFACE_VERSION==2
+    case ROOMBA_STOP:
+    #endif
+      return true;
+    default:
+      return false;
+  }
+}
+
+/* sequence a was pushed before b, across the wrap */
+static inline bool before(uint16_t a, uint16_t b) {
+  return (int16_t)(a - b) < 0;
+}
+
+static inline ROOMBA_COMMAND *slot(ROOMBA_QUEUE_LANE *lane, uint8_t i) {
+  return &lane->commands[(uint8_t)(lane->head + i) % ROOMBA_QUEUE_CAPACITY];
+}
+
+ROOMBA_PRIORITY roomba_command_priority(uint8_t opcode) {
+  switch (opcode) {
+    case ROOMBA_DRIVE:
+    case ROOMBA_MOTORS:
+    case ROOMBA_PWM_MOTORS:
+    case ROOMBA_DRIVE_DIRECT:
+    case ROOMBA_DRIVE_PWM:
+      return ROOMBA_PRIORITY_MOTION;
+    case ROOMBA_LEDS:
+    case ROOMBA_SONG:
+    case ROOMBA_PLAY:
+    #if ROOMBA_INTERFACE_VERSION==2
+    case ROOMBA_SCHEDULING_LEDS:
+    case ROOMBA_DIGIT_LEDS_RAW:
+    case ROOMBA_DIGIT_LEDS_ASCII:
+    #endif
+      return ROOMBA_PRIORITY_COSMETIC;
+    default:
+      return ROOMBA_PRIORITY_MODE;
+  }
+}
+
+void roomba_queue_init(ROOMBA_QUEUE *queue) {
+  memset(queue, 0, sizeof(*queue));
+}
+
+bool roomba_queue_push(ROOMBA_QUEUE *queue, const uint8_t data[],
+  uint8_t size) {
+  if (size == 0) return false;
+  return roomba_queue_push_priority(queue, roomba_command_priority(data[0]),
+    data, size);
+}
+
+bool roomba_queue_push_priority(ROOMBA_QUEUE *queue, ROOMBA_PRIORITY priority,
+  const uint8_t data[], uint8_t size) {
+  return roomba_queue_push_deadline(queue, priority, data, size,
+    ROOMBA_NO_DEADLINE);
+}
+
+bool roomba_queue_push_deadline(ROOMBA_QUEUE *queue, ROOMBA_PRIORITY priority,
+  const uint8_t data[], uint8_t size, uint32_t deadline) {
+  ROOMBA_QUEUE_LANE *lane = &queue->lanes[priority];
+  ROOMBA_COMMAND *command = NULL;
+  uint8_t f, depth;
+
+  if (size == 0 || size > ROOMBA_COMMAND_MAX_SIZE) return false;
+  queue->stats.pushed++;
+
+  f = priority == ROOMBA_PRIORITY_MOTION ? family(data[0]) : 0;
+  for (uint8_t i = 0; f && i < lane->count; i++) {
+    /* not across a mode change: the older one goes out before it */
+    if (queue->barriers &&
+        before(slot(lane, i)->sequence, queue->last_barrier)) {
+      continue;
+    }
+    if (family(slot(lane, i)->data[0]) == f) {
+      command = slot(lane, i);
+      queue->stats.coalesced++;
+      break;
+    }
+  }
+  if (!command) {
+    if (lane->count == ROOMBA_QUEUE_CAPACITY) {
+      queue->stats.dropped++;
+      return false;
+    }
+    command = slot(lane, lane->count++);
+    command->sequence = queue->sequence++;
+    if (is_barrier(data[0])) {
+      queue->barriers++;
+      queue->last_barrier = command->sequence;
+    }
+    depth = roomba_queue_depth(queue);
+    if (depth > queue->stats.max_depth) queue->stats.max_depth = depth;
+  }
+  command->deadline = deadline;
+  command->size = size;
+  memcpy(command->data, data, size);
+  return true;
+}
+
+/* sequence of the oldest mode change queued */
+static uint16_t first_barrier(const ROOMBA_QUEUE *queue) {
+  uint16_t first = queue->last_barrier;
+
+  for (uint8_t p = 0; p < ROOMBA_PRIORITY_COUNT; p++) {
+    const ROOMBA_QUEUE_LANE *lane = &queue->lanes[p];
+    for (uint8_t i = 0; i < lane->count; i++) {
+      const ROOMBA_COMMAND *command =
+        &lane->commands[(uint8_t)(lane->head + i) % ROOMBA_QUEUE_CAPACITY];
+      if (!is_barrier(command->data[0])) continue;
+      if (before(command->sequence, first)) first = command->sequence;
+      break;
+    }
+  }
+  return first;
+}
+
+/*
+ * The highest lane whose head was pushed before the oldest mode change, or
+ * is that mode change; -1 when empty. The lane holding the barrier always
+ * qualifies, its head is no younger than the barrier.
+ */
+static int8_t next_lane(const ROOMBA_QUEUE *queue) {
+  uint16_t barrier = queue->barriers ? first_barrier(queue) : 0;
+
+  for (uint8_t p = 0; p < ROOMBA_PRIORITY_COUNT; p++) {
+    const ROOMBA_QUEUE_LANE *lane = &queue->lanes[p];
+    if (!lane->count) continue;
+    if (p == ROOMBA_PRIORITY_SAFETY || !queue->barriers ||
+        !before(barrier, lane->commands[lane->head].sequence)) {
+      return (int8_t)p;
+    }
+  }
+  return -1;
+}
+
+const ROOMBA_COMMAND *roomba_queue_peek(const ROOMBA_QUEUE *queue) {
+  int8_t p = next_lane(queue);
+
+  if (p < 0) return NULL;
+  return &queue->lanes[p].commands[queue->lanes[p].head];
+}
+
+static bool remove_head(ROOMBA_QUEUE *queue) {
+  int8_t p = next_lane(queue);
+  ROOMBA_QUEUE_LANE *lane;
+
+  if (p < 0) return false;
+  lane = &queue->lanes[p];
+  if (is_barrier(lane->commands[lane->head].data[0])) queue->barriers--;
+  lane->head = (lane->head + 1) % ROOMBA_QUEUE_CAPACITY;
+  lane->count--;
+  return true;
+}
+
+void roomba_queue_pop(ROOMBA_QUEUE *queue) {
+  if (remove_head(queue)) queue->stats.sent++;
+}
+
+void roomba_queue_expire(ROOMBA_QUEUE *queue) {
+  if (remove_head(queue)) queue->stats.expired++;
+}
+
+void roomba_queue_flush(ROOMBA_QUEUE *queue, ROOMBA_TRANSPORT transport) {
+  const ROOMBA_COMMAND *command;
+
+  while ((command = roomba_queue_peek(queue))) {
+    transport.write(transport.context, command->data, command->size);
+    roomba_queue_pop(queue);
+  }
+}
+
+uint8_t roomba_queue_depth(const ROOMBA_QUEUE *queue) {
+  uint8_t depth = 0;
+
+  for (uint8_t p = 0; p < ROOMBA_PRIORITY_COUNT; p++) {
+    depth += queue->lanes[p].count;
+  }
+  return depth;
+}
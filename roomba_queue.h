@@ -0,0 +1,159 @@
+/**
+ * @file roomba_queue.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_queue.h> @endcode
+ *
+ * @brief Outbound command queue with priorities and coalescing of superseded
+ * motion commands
+ *
+ * Commands wait in one FIFO lane per priority and are sent highest priority
+ * first. A motion command replaces, in place, an unsent command of the same
+ * family: Drive, Drive Direct and Drive PWM all set the wheel speeds, Motors
+ * and PWM Motors both set the cleaning motors. When control runs faster than
+ * the link, the wire only carries the latest setpoint and it keeps the place
+ * in line of the first one.
+ *
+ * | Priority | Opcodes                                                 |
+ * |----------|---------------------------------------------------------|
+ * | Safety   | Only through roomba_queue_push_priority                 |
+ * | Motion   | 137, 138, 144, 145, 146                                 |
+ * | Mode     | Everything not listed here                              |
+ * | Cosmetic | 139, 140, 141, 162, 163, 164                            |
+ *
+ * A command that changes the mode (7, 128, 130 - 136, 143, 173) is a barrier:
+ * nothing pushed after it overtakes it from a higher lane, and no motion
+ * command pushed after it coalesces with one pushed before. A Drive pushed
+ * after Safe would otherwise go out first and be ignored in Passive. The
+ * safety lane is not held back.
+ */
+
+#ifndef ROOMBA_QUEUE_H_
+#define ROOMBA_QUEUE_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** Commands per priority lane */
+#ifndef ROOMBA_QUEUE_CAPACITY
+  #define ROOMBA_QUEUE_CAPACITY 8
+#endif
+
+/* ring positions and the total depth of all four lanes are a uint8_t */
+#if ROOMBA_QUEUE_CAPACITY < 1 || ROOMBA_QUEUE_CAPACITY > 63
+  #error "ROOMBA_QUEUE_CAPACITY must be 1 - 63"
+#endif
+
+/** Longest command: Song with 16 notes, [140][number][length] + 2 x 16 */
+#define ROOMBA_COMMAND_MAX_SIZE 35
+
+typedef enum {
+  ROOMBA_PRIORITY_SAFETY,
+  ROOMBA_PRIORITY_MOTION,
+  ROOMBA_PRIORITY_MODE,
+  ROOMBA_PRIORITY_COSMETIC,
+  ROOMBA_PRIORITY_COUNT,
+} ROOMBA_PRIORITY;
+
+/** No deadline, the command waits as long as it takes */
+#define ROOMBA_NO_DEADLINE 0
+
+typedef struct _roomba_command {
+  /** Last slot the command may be sent in, see roomba_scheduler.h */
+  uint32_t deadline;
+  /** Push order, for the barriers */
+  uint16_t sequence;
+  uint8_t size;
+  uint8_t data[ROOMBA_COMMAND_MAX_SIZE];
+} ROOMBA_COMMAND;
+
+typedef struct _roomba_queue_lane {
+  ROOMBA_COMMAND commands[ROOMBA_QUEUE_CAPACITY];
+  uint8_t head;
+  uint8_t count;
+} ROOMBA_QUEUE_LANE;
+
+typedef struct _roomba_queue_stats {
+  uint32_t pushed;
+  uint32_t sent;
+  /** Commands that replaced an unsent command of the same family */
+  uint32_t coalesced;
+  /** Commands rejected because their lane was full */
+  uint32_t dropped;
+  /**
+   * Commands removed unsent with roomba_queue_expire: past their deadline or
+   * filtered by the mode
+   */
+  uint32_t expired;
+  /** Highest total depth seen */
+  uint8_t max_depth;
+} ROOMBA_QUEUE_STATS;
+
+typedef struct _roomba_queue {
+  ROOMBA_QUEUE_LANE lanes[ROOMBA_PRIORITY_COUNT];
+  /** Sequence of the next push */
+  uint16_t sequence;
+  /** Mode changes queued, and the sequence of the last one pushed */
+  uint8_t barriers;
+  uint16_t last_barrier;
+  ROOMBA_QUEUE_STATS stats;
+} ROOMBA_QUEUE;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/** @return the lane an opcode goes to when pushed with roomba_queue_push */
+ROOMBA_PRIORITY roomba_command_priority(uint8_t opcode);
+
+void roomba_queue_init(ROOMBA_QUEUE *queue);
+
+/**
+ * Queues a complete command, opcode first, in the lane given by
+ * roomba_command_priority.
+ *
+ * @return false if the command is too long or its lane is full
+ */
+bool roomba_queue_push(ROOMBA_QUEUE *queue, const uint8_t data[],
+  uint8_t size);
+
+bool roomba_queue_push_priority(ROOMBA_QUEUE *queue, ROOMBA_PRIORITY priority,
+  const uint8_t data[], uint8_t size);
+
+/**
+ * @param deadline last scheduler slot the command is still useful in, or
+ * ROOMBA_NO_DEADLINE. A coalesced command takes the deadline of the newer one.
+ */
+bool roomba_queue_push_deadline(ROOMBA_QUEUE *queue, ROOMBA_PRIORITY priority,
+  const uint8_t data[], uint8_t size, uint32_t deadline);
+
+/**
+ * @return the next command to send, NULL when empty: the head of the highest
+ * lane not held back by a barrier
+ */
+const ROOMBA_COMMAND *roomba_queue_peek(const ROOMBA_QUEUE *queue);
+
+/** Removes the command returned by roomba_queue_peek and counts it as sent */
+void roomba_queue_pop(ROOMBA_QUEUE *queue);
+
+/** Removes the command returned by roomba_queue_peek without sending it */
+void roomba_queue_expire(ROOMBA_QUEUE *queue);
+
+/** Writes every queued command to transport, highest priority first */
+void roomba_queue_flush(ROOMBA_QUEUE *queue, ROOMBA_TRANSPORT transport);
+
+/** @return number of queued commands across all lanes */
+uint8_t roomba_queue_depth(const ROOMBA_QUEUE *queue);
+
+static inline uint8_t roomba_queue_lane_depth(const ROOMBA_QUEUE *queue,
+  ROOMBA_PRIORITY priority) {
+  return queue->lanes[priority].count;
+}
+
+/**@}*/
+
+#endif /* ROOMBA_QUEUE_H_ */
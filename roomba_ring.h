@@ -0,0 +1,105 @@
+/**
+ * @file roomba_ring.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_ring.h> @endcode
+ *
+ * @brief Byte ring buffer shared between an interrupt and the main loop
+ *
+ * One side only puts, the other only gets. Each index is written by one side
+ * only and is a single byte, so on AVR no interrupts need to be disabled.
+ * Indices run freely and wrap at 256, hence sizes are powers of two up to
+ * 128. Plain C, the same code runs in a host build.
+ */
+
+#ifndef ROOMBA_RING_H_
+#define ROOMBA_RING_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/*
+ * Keeps the compiler from moving buffer accesses past the volatile index
+ * updates once the functions are inlined. An interrupt and the main loop
+ * share one core, so nothing more is needed there.
+ */
+#if defined(__GNUC__)
+  #define ROOMBA_RING_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+  #define ROOMBA_RING_BARRIER() do { } while (0)
+#endif
+
+#define ROOMBA_RING_SIZE_OK(size) \
+  ((size) >= 2 && (size) <= 128 && ((size) & ((size) - 1)) == 0)
+
+typedef struct _roomba_ring {
+  uint8_t *buffer;
+  uint8_t mask;
+  /** Written by the producer only */
+  volatile uint8_t head;
+  /** Written by the consumer only */
+  volatile uint8_t tail;
+} ROOMBA_RING;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/** @param size a power of two, 2 - 128 */
+static inline void roomba_ring_init(ROOMBA_RING *ring, uint8_t buffer[],
+  uint8_t size) {
+  ring->buffer = buffer;
+  ring->mask = (uint8_t)(size - 1);
+  ring->head = 0;
+  ring->tail = 0;
+}
+
+static inline uint8_t roomba_ring_count(const ROOMBA_RING *ring) {
+  return (uint8_t)(ring->head - ring->tail);
+}
+
+static inline uint8_t roomba_ring_space(const ROOMBA_RING *ring) {
+  return (uint8_t)(ring->mask + 1 - roomba_ring_count(ring));
+}
+
+/** @return false if full */
+static inline bool roomba_ring_put(ROOMBA_RING *ring, uint8_t byte) {
+  uint8_t head = ring->head;
+
+  if ((uint8_t)(head - ring->tail) > ring->mask) return false;
+  ring->buffer[head & ring->mask] = byte;
+  /* the byte is stored before the consumer can see it */
+  ROOMBA_RING_BARRIER();
+  ring->head = (uint8_t)(head + 1);
+  return true;
+}
+
+/** @return false if empty */
+static inline bool roomba_ring_get(ROOMBA_RING *ring, uint8_t *byte) {
+  uint8_t tail = ring->tail;
+
+  if (tail == ring->head) return false;
+  /* read after head says it is there, before the slot is handed back */
+  ROOMBA_RING_BARRIER();
+  *byte = ring->buffer[tail & ring->mask];
+  ROOMBA_RING_BARRIER();
+  ring->tail = (uint8_t)(tail + 1);
+  return true;
+}
+
+/** @return number of bytes copied out, at most size */
+static inline uint8_t roomba_ring_read(ROOMBA_RING *ring, uint8_t data[],
+  uint8_t size) {
+  uint8_t n = 0;
+
+  while (n < size && roomba_ring_get(ring, &data[n])) n++;
+  return n;
+}
+
+/**@}*/
+
+#endif /* ROOMBA_RING_H_ */
@@ -0,0 +1,73 @@
+#include "roomba_safety.h"
+
+static const uint8_t drive_stop[] = { ROOMBA_DRIVE, 0, 0, 0, 0 };
+#if ROOMBA_INTERFACE_VERSION==2
+static const uint8_t oi_stop[] = { ROOMBA_STOP };
+#else
+static const uint8_t oi_stop[] = { ROOMBA_DRIVE, 0, 0, 0, 0 };
+#endif
+
+/*
+ * Bits of ROOMBA_SAFETY.active: the two wheel drops in their packet 7
+ * positions (2, 3), cliffs 9 - 12 in bits 4 - 7.
+ */
+static inline uint8_t flag_bits(uint8_t packet, uint8_t value) {
+  if (packet == ROOMBA_BUMPS_WHEELDROPS) return value & ROOMBA_WHEELDROP_MASK;
+  return (value & 1) << (packet - ROOMBA_CLIFF_LEFT + 4);
+}
+
+static inline uint8_t flag_mask(uint8_t packet) {
+  if (packet == ROOMBA_BUMPS_WHEELDROPS) return ROOMBA_WHEELDROP_MASK;
+  return 1 << (packet - ROOMBA_CLIFF_LEFT + 4);
+}
+
+void roomba_safety_init(ROOMBA_SAFETY *safety, ROOMBA_TRANSPORT transport,
+  uint32_t (*clock)(void), bool stop_oi) {
+  safety->transport = transport;
+  safety->clock = clock;
+  safety->stop_command = stop_oi ? oi_stop : drive_stop;
+  safety->stop_size = stop_oi ? sizeof(oi_stop) : sizeof(drive_stop);
+  safety->mode = NULL;
+  safety->active = 0;
+  safety->trips = 0;
+  safety->max_latency = 0;
+}
+
+void roomba_safety_set_mode_tracker(ROOMBA_SAFETY *safety,
+  ROOMBA_MODE_TRACKER *tracker) {
+  safety->mode = tracker;
+}
+
+void roomba_safety_packet_hook(const ROOMBA_STREAM_PARSER *parser,
+  uint8_t packet, void *context) {
+  ROOMBA_SAFETY *safety = context;
+  uint8_t value, bits, rising;
+  uint32_t start;
+  ROOMBA_SAFETY_EVENT *event;
+
+  switch (packet) {
+    case ROOMBA_BUMPS_WHEELDROPS: value = parser->work.bumps_wheeldrops; break;
+    case ROOMBA_CLIFF_LEFT: value = parser->work.cliff_left; break;
+    case ROOMBA_CLIFF_FRONT_LEFT: value = parser->work.cliff_front_left; break;
+    case ROOMBA_CLIFF_FRONT_RIGHT: value = parser->work.cliff_front_right; break;
+    case ROOMBA_CLIFF_RIGHT: value = parser->work.cliff_right; break;
+    default: return;
+  }
+  bits = flag_bits(packet, value);
+  rising = bits & ~safety->active;
+  safety->active = (safety->active & ~flag_mask(packet)) | bits;
+  if (!rising) return;
+
+  start = safety->clock();
+  safety->transport.write(safety->transport.context, safety->stop_command,
+    safety->stop_size);
+  event = &safety->events[safety->trips % ROOMBA_SAFETY_LOG_SIZE];
+  event->packet = packet;
+  event->value = value;
+  event->latency = safety->clock() - start;
+  if (event->latency > safety->max_latency) {
+    safety->max_latency = event->latency;
+  }
+  safety->trips++;
+  if (safety->mode) roomba_mode_invalidate(safety->mode);
+}
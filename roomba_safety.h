@@ -0,0 +1,95 @@
+/**
+ * @file roomba_safety.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_safety.h> @endcode
+ *
+ * @brief Stop fast path for wheel drops and cliffs
+ *
+ * roomba_safety_packet_hook is installed as the packet hook of a
+ * ROOMBA_STREAM_PARSER. It looks at packets 7 and 9 - 12 the moment their
+ * byte is decoded and, when a wheel drop or cliff flag rises, writes the stop
+ * command straight to the transport. Nothing queued for the robot is waited
+ * for. The time from the decision to the return of the write is recorded for
+ * every stop.
+ *
+ * A cliff or wheel drop also drops the robot from Safe to Passive on its
+ * own, and a Stop (173) leaves the OI, both behind the back of a
+ * ROOMBA_MODE_TRACKER. A tracker given to roomba_safety_set_mode_tracker
+ * forgets the mode on every stop.
+ *
+ * @note The hook runs before the frame checksum is checked. A corrupted byte
+ * can cause a spurious stop, never a missed one.
+ */
+
+#ifndef ROOMBA_SAFETY_H_
+#define ROOMBA_SAFETY_H_
+
+#include "roomba.h"
+#include "roomba_mode.h"
+#include "roomba_stream.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#ifndef ROOMBA_SAFETY_LOG_SIZE
+  #define ROOMBA_SAFETY_LOG_SIZE 8
+#endif
+
+#if ROOMBA_SAFETY_LOG_SIZE < 1
+  #error "ROOMBA_SAFETY_LOG_SIZE must be at least 1"
+#endif
+
+/** Wheel drop bits of packet 7 */
+#define ROOMBA_WHEELDROP_MASK 0x0C
+
+typedef struct _roomba_safety_event {
+  /** Packet that triggered the stop */
+  uint8_t packet;
+  uint8_t value;
+  /** Clock ticks between the decision and the end of the write */
+  uint32_t latency;
+} ROOMBA_SAFETY_EVENT;
+
+typedef struct _roomba_safety {
+  ROOMBA_TRANSPORT transport;
+  /** Free running clock, microseconds recommended */
+  uint32_t (*clock)(void);
+  const uint8_t *stop_command;
+  uint8_t stop_size;
+  /** Invalidated on every stop when set */
+  ROOMBA_MODE_TRACKER *mode;
+  /** One bit per watched flag, see roomba_safety.c */
+  uint8_t active;
+  /** Ring of the latest stops, events[(trips - 1) % size] is the newest */
+  ROOMBA_SAFETY_EVENT events[ROOMBA_SAFETY_LOG_SIZE];
+  uint32_t trips;
+  uint32_t max_latency;
+} ROOMBA_SAFETY;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * @param transport written to directly when a stop is needed
+ * @param clock timestamp source for the latency log
+ * @param stop_oi send Stop (173) instead of Drive (137) with zero velocity
+ * and radius. Stop also leaves the OI, so Start has to be sent again.
+ */
+void roomba_safety_init(ROOMBA_SAFETY *safety, ROOMBA_TRANSPORT transport,
+  uint32_t (*clock)(void), bool stop_oi);
+
+/** NULL leaves the mode tracking alone */
+void roomba_safety_set_mode_tracker(ROOMBA_SAFETY *safety,
+  ROOMBA_MODE_TRACKER *tracker);
+
+/** ROOMBA_PACKET_HOOK, context is the ROOMBA_SAFETY */
+void roomba_safety_packet_hook(const ROOMBA_STREAM_PARSER *parser,
+  uint8_t packet, void *context);
+
+/**@}*/
+
+#endif /* ROOMBA_SAFETY_H_ */
@@ -0,0 +1,152 @@
+#include <string.h>
+
+#include "roomba_scheduler.h"
+
+/* bytes the robot sends back for a query, 0 for any other command */
+static uint16_t response_bytes(const ROOMBA_COMMAND *command) {
+  uint16_t total = 0;
+  int size;
+
+  switch (command->data[0]) {
+    case ROOMBA_SENSORS:
+      size = get_packet_data_bytes(command->data[1]);
+      return size > 0 ? (uint16_t)size : 0;
+    case ROOMBA_QUERY_LIST:
+      for (uint8_t i = 0; i < command->data[1] && i + 2 < command->size; i++) {
+        size = get_packet_data_bytes(command->data[i + 2]);
+        if (size > 0) total += (uint16_t)size;
+      }
+      return total;
+    default:
+      return 0;
+  }
+}
+
+#define MILLI(bytes) ((int32_t)(bytes) * 1000)
+
+static inline int32_t refill(int32_t credit, int32_t budget) {
+  credit += budget;
+  return credit > budget ? budget : credit;
+}
+
+static inline uint8_t percent(uint16_t used, uint16_t budget) {
+  uint32_t p;
+
+  if (budget == 0) return used ? 255 : 0;
+  p = (uint32_t)used * 100 / budget;
+  return p > 255 ? 255 : (uint8_t)p;
+}
+
+uint16_t roomba_slot_bytes(ROOMBA_BITRATE bitrate) {
+  /* 8N1 framing: 10 bits on the wire per byte */
+  return (uint16_t)(get_bitrate_bps(bitrate) * ROOMBA_SLOT_MS / 10000);
+}
+
+void roomba_scheduler_init(ROOMBA_SCHEDULER *scheduler, ROOMBA_QUEUE *queue,
+  ROOMBA_TRANSPORT transport, ROOMBA_BITRATE bitrate) {
+  memset(scheduler, 0, sizeof(*scheduler));
+  scheduler->queue = queue;
+  scheduler->transport = transport;
+  scheduler->cosmetic_share = ROOMBA_COSMETIC_SHARE;
+  /* slot 0 would read as ROOMBA_NO_DEADLINE */
+  scheduler->slot = 1;
+  roomba_scheduler_set_bitrate(scheduler, bitrate);
+}
+
+void roomba_scheduler_set_bitrate(ROOMBA_SCHEDULER *scheduler,
+  ROOMBA_BITRATE bitrate) {
+  scheduler->slot_bytes = roomba_slot_bytes(bitrate);
+  scheduler->slot_millibytes =
+    (int32_t)(get_bitrate_bps(bitrate) * ROOMBA_SLOT_MS / 10);
+  scheduler->tx_credit = scheduler->slot_millibytes;
+  scheduler->rx_credit = scheduler->slot_millibytes -
+    MILLI(scheduler->stream_bytes);
+  if (scheduler->rx_credit < 0) scheduler->rx_credit = 0;
+}
+
+void roomba_scheduler_set_stream_bytes(ROOMBA_SCHEDULER *scheduler,
+  uint16_t frame_bytes) {
+  scheduler->stream_bytes = frame_bytes;
+}
+
+void roomba_scheduler_set_mode_tracker(ROOMBA_SCHEDULER *scheduler,
+  ROOMBA_MODE_TRACKER *tracker) {
+  scheduler->mode = tracker;
+}
+
+void roomba_scheduler_tick(ROOMBA_SCHEDULER *scheduler) {
+  ROOMBA_SCHEDULER *s = scheduler;
+  const ROOMBA_COMMAND *command;
+  int32_t tx_budget = s->slot_millibytes;
+  int32_t rx_budget = s->slot_millibytes - MILLI(s->stream_bytes);
+  uint16_t cosmetic_limit = (uint16_t)((uint32_t)s->slot_bytes *
+    s->cosmetic_share / 100);
+  uint16_t tx = 0, rx = 0, cosmetic = 0;
+
+  /*
+   * A stream frame larger than the slot leaves nothing for replies; a
+   * negative budget would lower the credit every slot until it overflows.
+   * Credit only goes below 0 by one command's debt, so it stays bounded.
+   */
+  if (rx_budget < 0) rx_budget = 0;
+  s->tx_credit = refill(s->tx_credit, tx_budget);
+  s->rx_credit = refill(s->rx_credit, rx_budget);
+
+  while ((command = roomba_queue_peek(s->queue))) {
+    uint16_t response;
+    bool is_cosmetic;
+
+    if (command->deadline != ROOMBA_NO_DEADLINE && command->deadline < s->slot) {
+      roomba_queue_expire(s->queue);
+      s->stats.expired++;
+      continue;
+    }
+    response = response_bytes(command);
+    is_cosmetic =
+      roomba_command_priority(command->data[0]) == ROOMBA_PRIORITY_COSMETIC;
+    /*
+     * Something that does not fit waits for the next slot, unless the credit
+     * is full: a command longer than a whole slot (slow baud rates) is sent
+     * then and paid off over the following slots.
+     */
+    if ((MILLI(command->size) > s->tx_credit && s->tx_credit < tx_budget) ||
+        (response > 0 && MILLI(response) > s->rx_credit &&
+         s->rx_credit < rx_budget) ||
+        (is_cosmetic && cosmetic + command->size > cosmetic_limit && tx > 0)) {
+      s->stats.deferred++;
+      break;
+    }
+    if (s->mode && roomba_mode_filter(s->mode, command->data, command->size) !=
+        ROOMBA_MODE_SEND) {
+      roomba_queue_expire(s->queue);
+      s->stats.filtered++;
+      continue;
+    }
+    s->transport.write(s->transport.context, command->data, command->size);
+    s->tx_credit -= MILLI(command->size);
+    s->rx_credit -= MILLI(response);
+    tx += command->size;
+    rx += response;
+    if (is_cosmetic) cosmetic += command->size;
+    roomba_queue_pop(s->queue);
+  }
+
+  s->tx_used[s->slot % ROOMBA_SCHEDULER_HISTORY] = tx;
+  s->rx_used[s->slot % ROOMBA_SCHEDULER_HISTORY] = rx + s->stream_bytes;
+  s->slot++;
+  s->stats.slots++;
+}
+
+uint8_t roomba_scheduler_utilisation(const ROOMBA_SCHEDULER *scheduler,
+  uint8_t age) {
+  uint32_t slot = scheduler->slot - 1 - age;
+  return percent(scheduler->tx_used[slot % ROOMBA_SCHEDULER_HISTORY],
+    scheduler->slot_bytes);
+}
+
+uint8_t roomba_scheduler_rx_utilisation(const ROOMBA_SCHEDULER *scheduler,
+  uint8_t age) {
+  uint32_t slot = scheduler->slot - 1 - age;
+  return percent(scheduler->rx_used[slot % ROOMBA_SCHEDULER_HISTORY],
+    scheduler->slot_bytes);
+}
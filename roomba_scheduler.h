@@ -0,0 +1,139 @@
+/**
+ * @file roomba_scheduler.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_scheduler.h> @endcode
+ *
+ * @brief Transmit scheduler that shares each 15 ms stream slot between
+ * commands and queries
+ *
+ * At a given baud rate the link carries baud / 10 bytes per second in each
+ * direction, 172 bytes per 15 ms slot at 115200 bps. roomba_scheduler_tick is
+ * called once per slot and sends queued commands, highest priority first,
+ * until the slot's transmit budget is used. Queries (142, 149) are also
+ * charged the size of their response against what the stream frame leaves of
+ * the receive budget.
+ *
+ * The lanes of the ROOMBA_QUEUE are served strictly in order: when a command
+ * does not fit, everything behind it waits for the next slot. Cosmetic
+ * commands (LEDs, songs, digits) are further limited to a share of the slot
+ * so they never crowd out the motion commands that follow them.
+ *
+ * Deadlines only drop commands that are no longer useful; they do not
+ * reorder a lane. Within a lane commands leave in the order they were
+ * pushed, which the motion coalescing of the queue relies on.
+ */
+
+#ifndef ROOMBA_SCHEDULER_H_
+#define ROOMBA_SCHEDULER_H_
+
+#include "roomba.h"
+#include "roomba_queue.h"
+#include "roomba_mode.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#define ROOMBA_SLOT_MS 15
+
+/** Slots of utilisation history kept, a power of two */
+#ifndef ROOMBA_SCHEDULER_HISTORY
+  #define ROOMBA_SCHEDULER_HISTORY 64
+#endif
+
+/* slot numbers wrap cleanly only for powers of two; ages are a uint8_t */
+#if ROOMBA_SCHEDULER_HISTORY < 1 || ROOMBA_SCHEDULER_HISTORY > 256 || \
+    (ROOMBA_SCHEDULER_HISTORY & (ROOMBA_SCHEDULER_HISTORY - 1)) != 0
+  #error "ROOMBA_SCHEDULER_HISTORY must be a power of two, 1 - 256"
+#endif
+
+/** Default percentage of a slot that cosmetic commands may use */
+#ifndef ROOMBA_COSMETIC_SHARE
+  #define ROOMBA_COSMETIC_SHARE 50
+#endif
+
+typedef struct _roomba_scheduler_stats {
+  uint32_t slots;
+  /** Commands dropped because their deadline passed */
+  uint32_t expired;
+  /** Slots in which a command had to wait for budget */
+  uint32_t deferred;
+  /** Commands the mode tracker skipped or rejected */
+  uint32_t filtered;
+} ROOMBA_SCHEDULER_STATS;
+
+typedef struct _roomba_scheduler {
+  ROOMBA_QUEUE *queue;
+  ROOMBA_TRANSPORT transport;
+  /** Consulted before every command when set */
+  ROOMBA_MODE_TRACKER *mode;
+  /** Bytes per slot at the active bit rate, both directions */
+  uint16_t slot_bytes;
+  /** Same in 1/1000 bytes, so slow baud rates keep their fraction */
+  int32_t slot_millibytes;
+  /** Receive bytes per slot taken by the stream frame */
+  uint16_t stream_bytes;
+  uint8_t cosmetic_share;
+  /**
+   * Unused budget in 1/1000 bytes, negative while paying off a command
+   * longer than what was left
+   */
+  int32_t tx_credit;
+  int32_t rx_credit;
+  /** Current slot number, what ROOMBA_COMMAND.deadline refers to */
+  uint32_t slot;
+  /** Bytes sent in the last ROOMBA_SCHEDULER_HISTORY slots */
+  uint16_t tx_used[ROOMBA_SCHEDULER_HISTORY];
+  uint16_t rx_used[ROOMBA_SCHEDULER_HISTORY];
+  ROOMBA_SCHEDULER_STATS stats;
+} ROOMBA_SCHEDULER;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/** @return bytes per 15 ms slot at the given baud code */
+uint16_t roomba_slot_bytes(ROOMBA_BITRATE bitrate);
+
+void roomba_scheduler_init(ROOMBA_SCHEDULER *scheduler, ROOMBA_QUEUE *queue,
+  ROOMBA_TRANSPORT transport, ROOMBA_BITRATE bitrate);
+
+/** Call after a Baud command (129) has taken effect */
+void roomba_scheduler_set_bitrate(ROOMBA_SCHEDULER *scheduler,
+  ROOMBA_BITRATE bitrate);
+
+/**
+ * @param frame_bytes size of one stream frame: 3 + number of packets + data
+ * bytes, 0 when no stream is active
+ */
+void roomba_scheduler_set_stream_bytes(ROOMBA_SCHEDULER *scheduler,
+  uint16_t frame_bytes);
+
+/**
+ * Commands are then filtered by the OI mode at the moment they are sent,
+ * after the queue has put them in order. A queued mode change goes out
+ * before anything pushed after it, so a Drive behind Safe is checked in
+ * Safe. NULL turns filtering off.
+ */
+void roomba_scheduler_set_mode_tracker(ROOMBA_SCHEDULER *scheduler,
+  ROOMBA_MODE_TRACKER *tracker);
+
+/** Sends what fits in the current slot and advances to the next one */
+void roomba_scheduler_tick(ROOMBA_SCHEDULER *scheduler);
+
+/**
+ * @param age 0 for the last completed slot, up to ROOMBA_SCHEDULER_HISTORY - 1
+ * @return percentage of the transmit budget used in that slot
+ */
+uint8_t roomba_scheduler_utilisation(const ROOMBA_SCHEDULER *scheduler,
+  uint8_t age);
+
+/** Same as roomba_scheduler_utilisation for the receive direction */
+uint8_t roomba_scheduler_rx_utilisation(const ROOMBA_SCHEDULER *scheduler,
+  uint8_t age);
+
+/**@}*/
+
+#endif /* ROOMBA_SCHEDULER_H_ */
@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "roomba_shm.h"
+
+static size_t ring_size(uint32_t slots) {
+  return sizeof(ROOMBA_SHM_RING) + (size_t)slots * sizeof(ROOMBA_SHM_SLOT);
+}
+
+int roomba_shm_publisher_open(ROOMBA_SHM_PUBLISHER *publisher,
+  const char *name, uint32_t slots) {
+  ROOMBA_SHM_PUBLISHER *p = publisher;
+  uint64_t head = 0;
+  void *map;
+  int fd;
+
+  memset(p, 0, sizeof(*p));
+  if (slots == 0) slots = ROOMBA_SHM_SLOTS;
+  if (strlen(name) >= sizeof(p->name)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+  if (fd < 0) return -1;
+  p->size = ring_size(slots);
+  if (ftruncate(fd, (off_t)p->size) < 0) {
+    close(fd);
+    return -1;
+  }
+  map = mmap(NULL, p->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return -1;
+
+  p->ring = map;
+  strcpy(p->name, name);
+  /*
+   * A restarted publisher carries on with the frame numbers of the last one,
+   * so subscribers still mapped keep following and never wait for a head
+   * that went back to 0.
+   */
+  if (__atomic_load_n(&p->ring->magic, __ATOMIC_ACQUIRE) == ROOMBA_SHM_MAGIC) {
+    head = __atomic_load_n(&p->ring->head, __ATOMIC_ACQUIRE);
+    if (p->ring->slot_size == sizeof(ROOMBA_SHM_SLOT) &&
+        p->ring->slots == slots) {
+      return 0;
+    }
+  }
+  /* subscribers check the magic last, after the layout is valid */
+  __atomic_store_n(&p->ring->magic, 0, __ATOMIC_RELEASE);
+  memset(p->ring->slot, 0, (size_t)slots * sizeof(ROOMBA_SHM_SLOT));
+  p->ring->slot_size = sizeof(ROOMBA_SHM_SLOT);
+  p->ring->slots = slots;
+  __atomic_store_n(&p->ring->head, head, __ATOMIC_RELEASE);
+  __atomic_store_n(&p->ring->magic, ROOMBA_SHM_MAGIC, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void roomba_shm_publish(ROOMBA_SHM_PUBLISHER *publisher,
+  const ROOMBA_PACKET_GROUP_100 *frame, uint64_t present, int64_t timestamp_ns) {
+  ROOMBA_SHM_RING *ring = publisher->ring;
+  uint64_t n = ring->head;
+  ROOMBA_SHM_SLOT *slot = &ring->slot[n % ring->slots];
+
+  __atomic_store_n(&slot->sequence, 2 * n + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->data.number = n;
+  slot->data.timestamp_ns = timestamp_ns;
+  slot->data.present = present;
+  slot->data.frame = *frame;
+  __atomic_store_n(&slot->sequence, 2 * n + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, n + 1, __ATOMIC_RELEASE);
+}
+
+void roomba_shm_frame_hook(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  roomba_shm_publish(context, frame, parser->present,
+    (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+void roomba_shm_publisher_close(ROOMBA_SHM_PUBLISHER *publisher) {
+  if (!publisher->ring) return;
+  munmap(publisher->ring, publisher->size);
+  shm_unlink(publisher->name);
+  publisher->ring = NULL;
+}
+
+int roomba_shm_subscriber_open(ROOMBA_SHM_SUBSCRIBER *subscriber,
+  const char *name) {
+  ROOMBA_SHM_SUBSCRIBER *s = subscriber;
+  const ROOMBA_SHM_RING *ring;
+  struct stat st;
+  void *map;
+  int fd;
+
+  memset(s, 0, sizeof(*s));
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) return -1;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ROOMBA_SHM_RING)) {
+    close(fd);
+    errno = EPROTO;
+    return -1;
+  }
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return -1;
+
+  ring = map;
+  if (__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != ROOMBA_SHM_MAGIC ||
+      ring->slot_size != sizeof(ROOMBA_SHM_SLOT) ||
+      ring_size(ring->slots) > (size_t)st.st_size) {
+    munmap(map, (size_t)st.st_size);
+    errno = EPROTO;
+    return -1;
+  }
+  s->ring = ring;
+  s->size = (size_t)st.st_size;
+  s->next = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  if (s->next > 0) s->next--;
+  return 0;
+}
+
+/* copies frame n if the slot still holds it, complete */
+static bool copy_frame(const ROOMBA_SHM_RING *ring, uint64_t n,
+  ROOMBA_SHM_FRAME *out) {
+  const ROOMBA_SHM_SLOT *slot = &ring->slot[n % ring->slots];
+  uint64_t before, after;
+
+  before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+  if (before != 2 * n + 2) return false;
+  memcpy(out, (const void *)&slot->data, sizeof(*out));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+  return before == after;
+}
+
+bool roomba_shm_read(ROOMBA_SHM_SUBSCRIBER *subscriber, ROOMBA_SHM_FRAME *out) {
+  ROOMBA_SHM_SUBSCRIBER *s = subscriber;
+  const ROOMBA_SHM_RING *ring = s->ring;
+
+  /* a publisher restarted with more slots than were mapped */
+  if (ring_size(ring->slots) > s->size) return false;
+  for (;;) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (s->next >= head) return false;
+    /* the oldest frame may be overwritten any moment, start one later */
+    if (head - s->next >= ring->slots) {
+      uint64_t oldest = head - ring->slots + 1;
+      s->missed += oldest - s->next;
+      s->next = oldest;
+    }
+    if (copy_frame(ring, s->next, out)) {
+      s->next++;
+      return true;
+    }
+    /* a publisher restarted with another layout cleared the frame */
+    if (__atomic_load_n(&ring->slot[s->next % ring->slots].sequence,
+        __ATOMIC_ACQUIRE) < 2 * s->next + 1) {
+      s->missed++;
+      s->next++;
+      continue;
+    }
+    /* overwritten while copying: the publisher lapped us, try again */
+  }
+}
+
+bool roomba_shm_read_latest(ROOMBA_SHM_SUBSCRIBER *subscriber,
+  ROOMBA_SHM_FRAME *out) {
+  ROOMBA_SHM_SUBSCRIBER *s = subscriber;
+  uint64_t head = __atomic_load_n(&s->ring->head, __ATOMIC_ACQUIRE);
+
+  /* skipped on purpose, not counted as missed */
+  if (head > s->next + 1) s->next = head - 1;
+  return roomba_shm_read(s, out);
+}
+
+void roomba_shm_subscriber_close(ROOMBA_SHM_SUBSCRIBER *subscriber) {
+  if (!subscriber->ring) return;
+  munmap((void *)subscriber->ring, subscriber->size);
+  subscriber->ring = NULL;
+}
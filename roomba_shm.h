@@ -0,0 +1,134 @@
+/**
+ * @file roomba_shm.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_shm.h> @endcode
+ *
+ * @brief Shared memory bus for decoded stream frames (POSIX)
+ *
+ * One publisher per robot writes every checksummed frame once into a ring in
+ * POSIX shared memory. Any number of local processes map the same ring read
+ * only and follow it at their own pace, so the serial port is read and the
+ * stream decoded once no matter how many readers there are. The publisher
+ * never looks at its subscribers; publishing costs the same for none or
+ * many.
+ *
+ * Each slot is guarded by a sequence number (a seqlock): odd while the
+ * publisher writes, and 2 x (frame number + 1) once the frame is complete. A
+ * subscriber copies the slot and keeps the copy only if the sequence number
+ * was even and unchanged around the copy. A subscriber that falls more than
+ * a ring behind skips forward and counts the frames it missed.
+ */
+
+#ifndef ROOMBA_SHM_H_
+#define ROOMBA_SHM_H_
+
+#include "roomba.h"
+#include "roomba_stream.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** Frames kept in the ring, about 1 s of stream */
+#ifndef ROOMBA_SHM_SLOTS
+  #define ROOMBA_SHM_SLOTS 64
+#endif
+
+#define ROOMBA_SHM_MAGIC 0x524F4D42UL
+
+typedef struct _roomba_shm_frame {
+  /**
+   * Number of the frame, counting from 0 when the object was created and
+   * carried on by a publisher that takes it over
+   */
+  uint64_t number;
+  /** Arrival time, CLOCK_MONOTONIC ns */
+  int64_t timestamp_ns;
+  /** ROOMBA_PACKET_BIT of the packets the frame carried */
+  uint64_t present;
+  ROOMBA_PACKET_GROUP_100 frame;
+} ROOMBA_SHM_FRAME;
+
+typedef struct _roomba_shm_slot {
+  uint64_t sequence;
+  ROOMBA_SHM_FRAME data;
+} ROOMBA_SHM_SLOT;
+
+/** Layout of the shared memory object */
+typedef struct _roomba_shm_ring {
+  uint32_t magic;
+  /** sizeof(ROOMBA_SHM_SLOT), guards against mismatched builds */
+  uint32_t slot_size;
+  uint32_t slots;
+  /** Number of the next frame to be written */
+  uint64_t head;
+  ROOMBA_SHM_SLOT slot[];
+} ROOMBA_SHM_RING;
+
+typedef struct _roomba_shm_publisher {
+  ROOMBA_SHM_RING *ring;
+  size_t size;
+  char name[64];
+} ROOMBA_SHM_PUBLISHER;
+
+typedef struct _roomba_shm_subscriber {
+  const ROOMBA_SHM_RING *ring;
+  size_t size;
+  /** Number of the next frame to read */
+  uint64_t next;
+  /** Frames overwritten before this subscriber got to them */
+  uint64_t missed;
+} ROOMBA_SHM_SUBSCRIBER;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * Creates, or takes over, the shared memory object. Taking over keeps the
+ * frame numbers going, so subscribers of the last publisher carry on; with
+ * the same number of slots they keep the frames already published too.
+ *
+ * @param name shm_open name, e.g. "/roomba0"
+ * @return 0, or -1 with errno set
+ */
+int roomba_shm_publisher_open(ROOMBA_SHM_PUBLISHER *publisher,
+  const char *name, uint32_t slots);
+
+void roomba_shm_publish(ROOMBA_SHM_PUBLISHER *publisher,
+  const ROOMBA_PACKET_GROUP_100 *frame, uint64_t present, int64_t timestamp_ns);
+
+/** ROOMBA_FRAME_HOOK, context is the publisher; timestamps with CLOCK_MONOTONIC */
+void roomba_shm_frame_hook(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context);
+
+/** Unmaps and removes the name; mapped subscribers keep working */
+void roomba_shm_publisher_close(ROOMBA_SHM_PUBLISHER *publisher);
+
+/**
+ * Maps the ring read only and starts at the newest frame: the first
+ * roomba_shm_read copies it if one was published, later ones what follows.
+ *
+ * @return 0, or -1 with errno set (EPROTO for a ring of another build)
+ */
+int roomba_shm_subscriber_open(ROOMBA_SHM_SUBSCRIBER *subscriber,
+  const char *name);
+
+/**
+ * Copies the next frame.
+ *
+ * @return true if a frame was copied, false if none is newer
+ */
+bool roomba_shm_read(ROOMBA_SHM_SUBSCRIBER *subscriber, ROOMBA_SHM_FRAME *out);
+
+/** Skips to the newest complete frame and copies it */
+bool roomba_shm_read_latest(ROOMBA_SHM_SUBSCRIBER *subscriber,
+  ROOMBA_SHM_FRAME *out);
+
+void roomba_shm_subscriber_close(ROOMBA_SHM_SUBSCRIBER *subscriber);
+
+/**@}*/
+
+#endif /* ROOMBA_SHM_H_ */
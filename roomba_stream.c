@@ -0,0 +1,235 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "roomba_stream.h"
+
+#define FIELD(name) offsetof(ROOMBA_PACKET_GROUP_100, name)
+
+/* offset of packets 7 - 58 in ROOMBA_PACKET_GROUP_100 */
+static const uint8_t offsets[] = {
+  FIELD(bumps_wheeldrops), FIELD(wall), FIELD(cliff_left),
+  FIELD(cliff_front_left), FIELD(cliff_front_right), FIELD(cliff_right),
+  FIELD(virtual_wall), FIELD(overcurrents), FIELD(dirt_detect),
+  FIELD(unused_1), FIELD(ir_opcode), FIELD(buttons_pkt), FIELD(distance),
+  FIELD(angle), FIELD(charging_state), FIELD(voltage), FIELD(current),
+  FIELD(temperature), FIELD(battery_charge), FIELD(battery_capacity),
+  FIELD(wall_signal), FIELD(cliff_left_signal),
+  FIELD(cliff_front_left_signal), FIELD(cliff_front_right_signal),
+  FIELD(cliff_right_signal), FIELD(unused_2), FIELD(unused_3),
+  FIELD(charger_available), FIELD(open_interface_mode), FIELD(song_number),
+  FIELD(song_playing), FIELD(oi_stream_num_packets), FIELD(velocity),
+  FIELD(radius), FIELD(velocity_right), FIELD(velocity_left),
+  FIELD(encoder_counts_left), FIELD(encoder_counts_right),
+  FIELD(light_bumper), FIELD(light_bump_left), FIELD(light_bump_front_left),
+  FIELD(light_bump_center_left), FIELD(light_bump_center_right),
+  FIELD(light_bump_front_right), FIELD(light_bump_right),
+  FIELD(ir_opcode_left), FIELD(ir_opcode_right), FIELD(left_motor_current),
+  FIELD(right_motor_current), FIELD(main_brush_current),
+  FIELD(side_brush_current), FIELD(stasis),
+};
+
+/* first and last single value packet of a packet id */
+static bool packet_range(uint8_t packet, uint8_t *first, uint8_t *last) {
+  switch (packet) {
+    case G0: *first = 7; *last = 26; return true;
+    case G1: *first = 7; *last = 16; return true;
+    case G2: *first = 17; *last = 20; return true;
+    case G3: *first = 21; *last = 26; return true;
+    case G4: *first = 27; *last = 34; return true;
+    case G5: *first = 35; *last = 42; return true;
+    case G6: *first = 7; *last = 42; return true;
+    case ALL_PACKETS: *first = 7; *last = 58; return true;
+    case G101: *first = 43; *last = 58; return true;
+    case G106: *first = 46; *last = 51; return true;
+    case G107: *first = 54; *last = 58; return true;
+    default:
+      *first = *last = packet;
+      return packet >= ROOMBA_BUMPS_WHEELDROPS && packet <= ROOMBA_STASIS;
+  }
+}
+
+void roomba_decode_packet(ROOMBA_PACKET_GROUP_100 *snapshot, uint8_t packet,
+  const uint8_t data[]) {
+  uint8_t *field = (uint8_t *)snapshot +
+    offsets[packet - ROOMBA_BUMPS_WHEELDROPS];
+
+  if (get_packet_data_bytes(packet) == 2) {
+    *(uint16_t *)field = (uint16_t)(data[0] << 8 | data[1]);
+  } else {
+    *field = data[0];
+  }
+}
+
+uint8_t roomba_encode_packet(const ROOMBA_PACKET_GROUP_100 *snapshot,
+  uint8_t packet, uint8_t data[]) {
+  const uint8_t *field = (const uint8_t *)snapshot +
+    offsets[packet - ROOMBA_BUMPS_WHEELDROPS];
+
+  if (get_packet_data_bytes(packet) == 2) {
+    uint16_t value = *(const uint16_t *)field;
+    data[0] = (uint8_t)(value >> 8);
+    data[1] = (uint8_t)value;
+    return 2;
+  }
+  data[0] = *field;
+  return 1;
+}
+
+uint64_t roomba_packet_mask(uint8_t packet) {
+  uint64_t mask = 0;
+  uint8_t first, last;
+
+  if (!packet_range(packet, &first, &last)) return 0;
+  for (uint8_t p = first; p <= last; p++) mask |= ROOMBA_PACKET_BIT(p);
+  return mask;
+}
+
+uint8_t roomba_stream_encode(const ROOMBA_PACKET_GROUP_100 *snapshot,
+  uint64_t mask, uint8_t out[]) {
+  uint8_t size = 2, checksum = 0;
+
+  out[0] = ROOMBA_STREAM_HEADER;
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= ROOMBA_STASIS; p++) {
+    if (!(mask & ROOMBA_PACKET_BIT(p))) continue;
+    out[size++] = p;
+    size += roomba_encode_packet(snapshot, p, &out[size]);
+  }
+  out[1] = (uint8_t)(size - 2);
+  for (uint8_t i = 0; i < size; i++) checksum += out[i];
+  out[size++] = (uint8_t)-checksum;
+  return size;
+}
+
+uint8_t roomba_stream_request(uint64_t mask, uint8_t packets[], uint8_t max) {
+  /* widest first */
+  static const uint8_t groups[] = { ALL_PACKETS, G6, G101, G0, G1, G2, G3, G4,
+    G5, G106, G107 };
+  uint64_t left = mask;
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < sizeof(groups) && left; i++) {
+    uint64_t group = roomba_packet_mask(groups[i]);
+    if ((group & mask) == group && (group & left) != 0 && count < max) {
+      packets[count++] = groups[i];
+      left &= ~group;
+    }
+  }
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= ROOMBA_STASIS && left; p++) {
+    if (!(left & ROOMBA_PACKET_BIT(p))) continue;
+    if (count == max) {
+      packets[0] = ALL_PACKETS;
+      return 1;
+    }
+    packets[count++] = p;
+    left &= ~ROOMBA_PACKET_BIT(p);
+  }
+  return count;
+}
+
+uint16_t roomba_stream_frame_size(const uint8_t packets[], uint8_t count) {
+  uint16_t size = (uint16_t)(3 + count);
+
+  for (uint8_t i = 0; i < count; i++) {
+    int bytes = get_packet_data_bytes(packets[i]);
+    if (bytes > 0) size = (uint16_t)(size + bytes);
+  }
+  return size;
+}
+
+static void resync(ROOMBA_STREAM_PARSER *p) {
+  p->stats.framing_errors++;
+  p->work = p->frame;
+  p->state = ROOMBA_STREAM_WAIT_HEADER;
+}
+
+static void begin_packet(ROOMBA_STREAM_PARSER *p) {
+  p->data_left = (uint8_t)get_packet_data_bytes(p->packet);
+  p->state = ROOMBA_STREAM_WAIT_DATA;
+}
+
+static void end_packet(ROOMBA_STREAM_PARSER *p) {
+  roomba_decode_packet(&p->work, p->packet, p->data);
+  p->work_present |= ROOMBA_PACKET_BIT(p->packet);
+  if (p->on_packet) p->on_packet(p, p->packet, p->packet_context);
+  if (p->packet < p->group_end) {
+    p->packet++;
+    begin_packet(p);
+  } else {
+    p->state = p->remaining ? ROOMBA_STREAM_WAIT_PACKET_ID :
+      ROOMBA_STREAM_WAIT_CHECKSUM;
+  }
+}
+
+static void end_frame(ROOMBA_STREAM_PARSER *p) {
+  p->state = ROOMBA_STREAM_WAIT_HEADER;
+  if (p->checksum != 0) {
+    p->stats.checksum_errors++;
+    p->work = p->frame;
+    return;
+  }
+  p->stats.frames++;
+  p->frame = p->work;
+  p->present = p->work_present;
+  if (p->on_frame) p->on_frame(p, &p->frame, p->frame_context);
+}
+
+static inline void parse_byte(ROOMBA_STREAM_PARSER *p, uint8_t b) {
+  int size;
+
+  p->checksum += b;
+  switch (p->state) {
+    case ROOMBA_STREAM_WAIT_HEADER:
+      if (b == ROOMBA_STREAM_HEADER) {
+        p->checksum = b;
+        p->state = ROOMBA_STREAM_WAIT_LENGTH;
+      }
+      break;
+    case ROOMBA_STREAM_WAIT_LENGTH:
+      p->remaining = b;
+      p->work_present = 0;
+      p->state = b ? ROOMBA_STREAM_WAIT_PACKET_ID : ROOMBA_STREAM_WAIT_CHECKSUM;
+      break;
+    case ROOMBA_STREAM_WAIT_PACKET_ID:
+      p->remaining--;
+      size = get_packet_data_bytes(b);
+      if (!packet_range(b, &p->packet, &p->group_end) ||
+          size < 0 || size > p->remaining) {
+        resync(p);
+        break;
+      }
+      begin_packet(p);
+      break;
+    case ROOMBA_STREAM_WAIT_DATA:
+      p->remaining--;
+      p->data[get_packet_data_bytes(p->packet) - p->data_left] = b;
+      if (--p->data_left == 0) end_packet(p);
+      break;
+    case ROOMBA_STREAM_WAIT_CHECKSUM:
+      end_frame(p);
+      break;
+  }
+}
+
+void roomba_stream_init(ROOMBA_STREAM_PARSER *parser) {
+  memset(parser, 0, sizeof(*parser));
+  parser->state = ROOMBA_STREAM_WAIT_HEADER;
+}
+
+void roomba_stream_set_packet_hook(ROOMBA_STREAM_PARSER *parser,
+  ROOMBA_PACKET_HOOK hook, void *context) {
+  parser->on_packet = hook;
+  parser->packet_context = context;
+}
+
+void roomba_stream_set_frame_hook(ROOMBA_STREAM_PARSER *parser,
+  ROOMBA_FRAME_HOOK hook, void *context) {
+  parser->on_frame = hook;
+  parser->frame_context = context;
+}
+
+void roomba_stream_parse(ROOMBA_STREAM_PARSER *parser, const uint8_t data[],
+  uint16_t size) {
+  for (uint16_t i = 0; i < size; i++) {
+    parse_byte(parser, data[i]);
+  }
+}
@@ -0,0 +1,158 @@
+/**
+ * @file roomba_stream.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_stream.h> @endcode
+ *
+ * @brief Incremental parser for the frames sent after a Stream command (148)
+ *
+ * A frame is [19][N][Packet ID 1][Packet 1 data...][Packet ID 2]...[Checksum]
+ * where N counts the ids and data bytes and all bytes of the frame, checksum
+ * included, add up to 0 (low byte). Group packets (0 - 6, 100 - 107) are
+ * expanded into their single value packets.
+ *
+ * Every packet is decoded into a ROOMBA_PACKET_GROUP_100 as soon as its last
+ * byte arrives and the packet hook runs right away, before the checksum is
+ * known. The frame hook only runs for frames whose checksum is valid; a bad
+ * frame is rolled back and leaves the last good frame untouched.
+ */
+
+#ifndef ROOMBA_STREAM_H_
+#define ROOMBA_STREAM_H_
+
+#include "roomba.h"
+#include "roomba_queue.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#define ROOMBA_STREAM_HEADER 19
+
+/** Bit of a packet id in the present masks */
+#define ROOMBA_PACKET_BIT(packet) ((uint64_t)1 << (packet))
+
+/** Longest frame: header, length, 52 ids, 80 data bytes, checksum */
+#define ROOMBA_STREAM_FRAME_MAX 135
+
+/** Most ids in one Stream (148): [148][count] leaves this many a command */
+#define ROOMBA_STREAM_IDS_MAX (ROOMBA_COMMAND_MAX_SIZE - 2)
+
+typedef enum {
+  ROOMBA_STREAM_WAIT_HEADER,
+  ROOMBA_STREAM_WAIT_LENGTH,
+  ROOMBA_STREAM_WAIT_PACKET_ID,
+  ROOMBA_STREAM_WAIT_DATA,
+  ROOMBA_STREAM_WAIT_CHECKSUM,
+} ROOMBA_STREAM_STATE;
+
+typedef struct _roomba_stream_stats {
+  uint32_t frames;
+  uint32_t checksum_errors;
+  /** Unknown packet ids and packets overrunning the frame length */
+  uint32_t framing_errors;
+} ROOMBA_STREAM_STATS;
+
+typedef struct _roomba_stream_parser ROOMBA_STREAM_PARSER;
+
+/**
+ * Called as soon as the data bytes of a single value packet are decoded into
+ * parser->work. The frame checksum has not been verified yet.
+ */
+typedef void (*ROOMBA_PACKET_HOOK)(const ROOMBA_STREAM_PARSER *parser,
+  uint8_t packet, void *context);
+
+/** Called for every frame with a valid checksum */
+typedef void (*ROOMBA_FRAME_HOOK)(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context);
+
+struct _roomba_stream_parser {
+  /** Packets of the frame being received, on top of the last good frame */
+  ROOMBA_PACKET_GROUP_100 work;
+  /** Last frame with a valid checksum */
+  ROOMBA_PACKET_GROUP_100 frame;
+  /** ROOMBA_PACKET_BIT of the packets received in work and frame */
+  uint64_t work_present;
+  uint64_t present;
+  ROOMBA_PACKET_HOOK on_packet;
+  void *packet_context;
+  ROOMBA_FRAME_HOOK on_frame;
+  void *frame_context;
+  ROOMBA_STREAM_STATS stats;
+  uint8_t state;
+  uint8_t remaining;
+  uint8_t checksum;
+  uint8_t packet;
+  uint8_t group_end;
+  uint8_t data_left;
+  uint8_t data[2];
+};
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+void roomba_stream_init(ROOMBA_STREAM_PARSER *parser);
+
+void roomba_stream_set_packet_hook(ROOMBA_STREAM_PARSER *parser,
+  ROOMBA_PACKET_HOOK hook, void *context);
+
+void roomba_stream_set_frame_hook(ROOMBA_STREAM_PARSER *parser,
+  ROOMBA_FRAME_HOOK hook, void *context);
+
+/**
+ * Feeds received bytes. Any split of the byte stream is accepted; hooks run
+ * from inside this call.
+ */
+void roomba_stream_parse(ROOMBA_STREAM_PARSER *parser, const uint8_t data[],
+  uint16_t size);
+
+/**
+ * Decodes the data bytes of one single value packet (7 - 58), high byte
+ * first, into the matching field of snapshot.
+ */
+void roomba_decode_packet(ROOMBA_PACKET_GROUP_100 *snapshot, uint8_t packet,
+  const uint8_t data[]);
+
+/**
+ * Inverse of roomba_decode_packet.
+ *
+ * @return number of data bytes written
+ */
+uint8_t roomba_encode_packet(const ROOMBA_PACKET_GROUP_100 *snapshot,
+  uint8_t packet, uint8_t data[]);
+
+/**
+ * @param packet a single value packet or a group
+ * @return ROOMBA_PACKET_BIT of every single value packet it stands for, 0 if
+ * unknown
+ */
+uint64_t roomba_packet_mask(uint8_t packet);
+
+/**
+ * Builds a stream frame, as the robot would send it, carrying the packets in
+ * mask (single value packets only) with their values from snapshot.
+ *
+ * @param out at least ROOMBA_STREAM_FRAME_MAX bytes
+ * @return frame size
+ */
+uint8_t roomba_stream_encode(const ROOMBA_PACKET_GROUP_100 *snapshot,
+  uint64_t mask, uint8_t out[]);
+
+/**
+ * Packet ids for a Stream (148) request covering mask. Groups wanted whole
+ * replace their packets; if more than max ids would still be needed, the
+ * request is group 100 alone.
+ *
+ * @param packets at least max bytes
+ * @return number of ids, 0 for an empty mask
+ */
+uint8_t roomba_stream_request(uint64_t mask, uint8_t packets[], uint8_t max);
+
+/** @return size of the frames the robot sends for a Stream request */
+uint16_t roomba_stream_frame_size(const uint8_t packets[], uint8_t count);
+
+/**@}*/
+
+#endif /* ROOMBA_STREAM_H_ */
@@ -0,0 +1,149 @@
+#include <string.h>
+
+#include "roomba_subscribe.h"
+
+static uint8_t count_packets(uint64_t mask) {
+  uint8_t count = 0;
+
+  for (; mask; mask &= mask - 1) count++;
+  return count;
+}
+
+void roomba_subscriptions_init(ROOMBA_SUBSCRIPTIONS *subs,
+  ROOMBA_CACHE *cache, ROOMBA_QUEUE *queue, ROOMBA_SCHEDULER *scheduler) {
+  memset(subs, 0, sizeof(*subs));
+  subs->cache = cache;
+  subs->queue = queue;
+  subs->scheduler = scheduler;
+}
+
+int8_t roomba_subscribe(ROOMBA_SUBSCRIPTIONS *subs, uint8_t packet,
+  uint16_t period_ms) {
+  if (period_ms == 0 || roomba_packet_mask(packet) == 0) return -1;
+
+  for (int8_t i = 0; i < ROOMBA_SUBSCRIPTION_MAX; i++) {
+    ROOMBA_SUBSCRIPTION *sub = &subs->subscriptions[i];
+    if (sub->period_ms != 0) continue;
+    sub->packet = packet;
+    sub->period_ms = period_ms;
+    sub->period_slots = period_ms / ROOMBA_SLOT_MS;
+    if (sub->period_slots == 0) sub->period_slots = 1;
+    sub->phase = sub->period_slots > 1 ?
+      subs->next_phase++ % sub->period_slots : 0;
+    subs->changed = true;
+    return i;
+  }
+  return -1;
+}
+
+void roomba_unsubscribe(ROOMBA_SUBSCRIPTIONS *subs, int8_t handle) {
+  if (handle < 0 || handle >= ROOMBA_SUBSCRIPTION_MAX) return;
+  subs->subscriptions[handle].period_ms = 0;
+  subs->changed = true;
+}
+
+/* room for a Pause and a Stream, so neither goes out without the other */
+static bool room_for_restream(const ROOMBA_QUEUE *queue) {
+  ROOMBA_PRIORITY pause = roomba_command_priority(ROOMBA_PAUSE_RESUME_STREAM);
+  ROOMBA_PRIORITY stream = roomba_command_priority(ROOMBA_STREAM);
+  uint8_t need = pause == stream ? 2 : 1;
+
+  return
+    roomba_queue_lane_depth(queue, pause) + need <= ROOMBA_QUEUE_CAPACITY &&
+    roomba_queue_lane_depth(queue, stream) + need <= ROOMBA_QUEUE_CAPACITY;
+}
+
+/*
+ * Pauses the stream and requests the new list, if there is one. The list
+ * may stream more than asked for, e.g. group 100 when the ids do not fit a
+ * command; streaming holds what it really carries.
+ */
+static bool restream(ROOMBA_SUBSCRIPTIONS *subs, uint64_t stream) {
+  uint8_t pause[] = {ROOMBA_PAUSE_RESUME_STREAM, 0};
+  uint8_t command[ROOMBA_COMMAND_MAX_SIZE];
+  uint8_t count = 0;
+  uint64_t streaming = 0;
+
+  if (stream) {
+    count = roomba_stream_request(stream, &command[2], ROOMBA_STREAM_IDS_MAX);
+    for (uint8_t i = 0; i < count; i++) {
+      streaming |= roomba_packet_mask(command[2 + i]);
+    }
+  }
+  if (streaming == subs->streaming) return true;
+  if (!room_for_restream(subs->queue)) return false;
+
+  roomba_queue_push(subs->queue, pause, sizeof(pause));
+  subs->frame_bytes = 0;
+  if (count) {
+    command[0] = ROOMBA_STREAM;
+    command[1] = count;
+    roomba_queue_push(subs->queue, command, (uint8_t)(2 + count));
+    subs->frame_bytes = roomba_stream_frame_size(&command[2], count);
+  }
+  roomba_scheduler_set_stream_bytes(subs->scheduler, subs->frame_bytes);
+  subs->streaming = streaming;
+  subs->stats.restreams++;
+  return true;
+}
+
+/*
+ * Streams every packet wanted each slot and gives the queried ones a maximum
+ * age of their shortest period, plus a slot for the reply.
+ */
+static void apply(ROOMBA_SUBSCRIPTIONS *subs) {
+  uint16_t period_ms[ROOMBA_STASIS + 1];
+  uint64_t stream = 0;
+
+  memset(period_ms, 0, sizeof(period_ms));
+  for (uint8_t i = 0; i < ROOMBA_SUBSCRIPTION_MAX; i++) {
+    const ROOMBA_SUBSCRIPTION *sub = &subs->subscriptions[i];
+    uint64_t mask = roomba_packet_mask(sub->packet);
+    if (sub->period_ms == 0) continue;
+    if (sub->period_slots == 1) {
+      stream |= mask;
+      continue;
+    }
+    for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= ROOMBA_STASIS; p++) {
+      if (!(mask & ROOMBA_PACKET_BIT(p))) continue;
+      if (period_ms[p] == 0 || sub->period_ms < period_ms[p]) {
+        period_ms[p] = sub->period_ms;
+      }
+    }
+  }
+
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= ROOMBA_STASIS; p++) {
+    uint16_t max_age_ms = ROOMBA_CACHE_MAX_AGE_MS;
+    if (period_ms[p] != 0 && !(stream & ROOMBA_PACKET_BIT(p))) {
+      max_age_ms = period_ms[p] > UINT16_MAX - ROOMBA_SLOT_MS ?
+        UINT16_MAX : (uint16_t)(period_ms[p] + ROOMBA_SLOT_MS);
+    }
+    roomba_cache_set_max_age(subs->cache, p, max_age_ms);
+  }
+
+  /* left changed until the commands fit in the queue */
+  if (!restream(subs, stream)) return;
+  subs->changed = false;
+}
+
+void roomba_subscriptions_poll(ROOMBA_SUBSCRIPTIONS *subs, uint32_t now_ms) {
+  uint64_t due = 0;
+
+  if (subs->changed) apply(subs);
+
+  for (uint8_t i = 0; i < ROOMBA_SUBSCRIPTION_MAX; i++) {
+    const ROOMBA_SUBSCRIPTION *sub = &subs->subscriptions[i];
+    if (sub->period_ms == 0 || sub->period_slots == 1) continue;
+    if (subs->slot % sub->period_slots == sub->phase) {
+      due |= roomba_packet_mask(sub->packet);
+    }
+  }
+  due &= ~subs->streaming;
+  if (due) {
+    roomba_cache_request(subs->cache, due);
+    subs->stats.requested_packets += count_packets(due);
+  }
+  subs->slot++;
+
+  roomba_cache_poll(subs->cache, now_ms);
+}
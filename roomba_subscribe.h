@@ -0,0 +1,129 @@
+/**
+ * @file roomba_subscribe.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_subscribe.h> @endcode
+ *
+ * @brief Multi-rate sensor subscriptions over the one stream of the robot
+ *
+ * The robot streams a single packet list, every packet every 15 ms. A
+ * subscription asks for a packet or group at its own period instead, e.g.
+ * voltage every 1000 ms, bumps every 15 ms and light bumpers every 50 ms.
+ *
+ * Streaming a packet costs its id and data in every slot, querying it costs
+ * its data once per period plus a share of a Query List (149). So only
+ * packets with a period under two slots go into the stream; the
+ * others are asked for through the ROOMBA_CACHE every period, one Query List
+ * per slot for whatever is due. Subscriptions with the same period are given
+ * different phases so their queries fall into different slots, and the
+ * scheduler fits each into the receive budget the now smaller stream frame
+ * leaves.
+ *
+ * When the stream list changes the stream is paused (150) and the new list
+ * requested (148), and the scheduler is told the new frame size.
+ *
+ * @code
+ * roomba_subscriptions_init(&subs, &cache, &queue, &scheduler);
+ * roomba_subscribe(&subs, ROOMBA_VOLTAGE, 1000);
+ * roomba_subscribe(&subs, ROOMBA_BUMPS_WHEELDROPS, 15);
+ * roomba_subscribe(&subs, G106, 50);
+ * // every slot
+ * roomba_subscriptions_poll(&subs, now);
+ * roomba_scheduler_tick(&scheduler);
+ * @endcode
+ */
+
+#ifndef ROOMBA_SUBSCRIBE_H_
+#define ROOMBA_SUBSCRIBE_H_
+
+#include "roomba.h"
+#include "roomba_cache.h"
+#include "roomba_queue.h"
+#include "roomba_scheduler.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#ifndef ROOMBA_SUBSCRIPTION_MAX
+  #define ROOMBA_SUBSCRIPTION_MAX 16
+#endif
+
+#if ROOMBA_SUBSCRIPTION_MAX < 1 || ROOMBA_SUBSCRIPTION_MAX > 127
+  #error "ROOMBA_SUBSCRIPTION_MAX must be 1 - 127"
+#endif
+
+typedef struct _roomba_subscription {
+  /** Single value packet or group */
+  uint8_t packet;
+  /** 0 while the subscription is free */
+  uint16_t period_ms;
+  /** Period in slots, 1 for streamed packets */
+  uint16_t period_slots;
+  /** Slot within the period its query goes out */
+  uint16_t phase;
+} ROOMBA_SUBSCRIPTION;
+
+typedef struct _roomba_subscriptions_stats {
+  /** Stream requests sent for a changed list */
+  uint32_t restreams;
+  /** Packets handed to the cache to query */
+  uint32_t requested_packets;
+} ROOMBA_SUBSCRIPTIONS_STATS;
+
+typedef struct _roomba_subscriptions {
+  ROOMBA_CACHE *cache;
+  ROOMBA_QUEUE *queue;
+  ROOMBA_SCHEDULER *scheduler;
+  /** ROOMBA_PACKET_BIT of the packets in the stream */
+  uint64_t streaming;
+  /** Subscriptions changed since the stream was last requested */
+  bool changed;
+  /** Slots polled */
+  uint32_t slot;
+  /** Phase given to the next queried subscription */
+  uint16_t next_phase;
+  /** Size of the stream frame, 0 while paused */
+  uint16_t frame_bytes;
+  ROOMBA_SUBSCRIPTIONS_STATS stats;
+  ROOMBA_SUBSCRIPTION subscriptions[ROOMBA_SUBSCRIPTION_MAX];
+} ROOMBA_SUBSCRIPTIONS;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/**
+ * @param cache queries slow packets and holds every value, see
+ * roomba_cache.h
+ * @param queue the stream commands are pushed here
+ * @param scheduler told the stream frame size
+ */
+void roomba_subscriptions_init(ROOMBA_SUBSCRIPTIONS *subs,
+  ROOMBA_CACHE *cache, ROOMBA_QUEUE *queue, ROOMBA_SCHEDULER *scheduler);
+
+/**
+ * Takes effect at the next poll. Read the values with roomba_get_packet.
+ *
+ * @param packet a single value packet or a group
+ * @param period_ms wanted time between two values, at least one slot is
+ * used
+ * @return handle for roomba_unsubscribe, -1 if the packet is unknown, the
+ * period 0 or no subscription is free
+ */
+int8_t roomba_subscribe(ROOMBA_SUBSCRIPTIONS *subs, uint8_t packet,
+  uint16_t period_ms);
+
+void roomba_unsubscribe(ROOMBA_SUBSCRIPTIONS *subs, int8_t handle);
+
+/**
+ * Applies changed subscriptions, has the cache query the packets due in
+ * this slot and polls the cache. Call once per slot, before
+ * roomba_scheduler_tick; do not call roomba_cache_poll as well.
+ */
+void roomba_subscriptions_poll(ROOMBA_SUBSCRIPTIONS *subs, uint32_t now_ms);
+
+/**@}*/
+
+#endif /* ROOMBA_SUBSCRIBE_H_ */
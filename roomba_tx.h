@@ -0,0 +1,290 @@
+/**
+ * @file roomba_tx.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_tx.h> @endcode
+ *
+ * @brief Inline command encoders writing straight into a TX buffer
+ *
+ * Every encoder is a static inline function that stores the opcode and data
+ * bytes of one command into a ROOMBA_TX. With constant arguments the compiler
+ * reduces a call to a handful of byte stores. The buffer is handed to the
+ * transport once per batch instead of once per byte:
+ *
+ * @code
+ * ROOMBA_TX tx;
+ * roomba_tx_clear(&tx);
+ * roomba_tx_drive(&tx, 200, ROOMBA_RADIUS_STRAIGHT_POSITIVE);
+ * roomba_tx_sensors(&tx, ROOMBA_BATTERY_CHARGE);
+ * roomba_tx_flush(&tx, transport);
+ * @endcode
+ *
+ * Define ROOMBA_TX_WRITE to the name of a write function with the signature
+ * of ROOMBA_TRANSPORT.write, e.g. -DROOMBA_TX_WRITE=roomba_uart_write, to get
+ * roomba_tx_send, which calls it directly so it can be inlined as well.
+ *
+ * Encoders only exist for the opcodes of the selected
+ * ROOMBA_INTERFACE_VERSION. They do not check ranges; see
+ * is_valid_roomba_command.
+ */
+
+#ifndef ROOMBA_TX_H_
+#define ROOMBA_TX_H_
+
+#include <string.h>
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** Bytes per batch, at least one Song with 16 notes (35 bytes) */
+#ifndef ROOMBA_TX_SIZE
+  #define ROOMBA_TX_SIZE 64
+#endif
+
+#if ROOMBA_TX_SIZE < 35 || ROOMBA_TX_SIZE > 255
+  #error "ROOMBA_TX_SIZE must be 35 - 255"
+#endif
+
+typedef struct _roomba_tx {
+  uint8_t size;
+  uint8_t data[ROOMBA_TX_SIZE];
+} ROOMBA_TX;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+static inline void roomba_tx_clear(ROOMBA_TX *tx) {
+  tx->size = 0;
+}
+
+/** @return where the next n bytes go, NULL if they do not fit */
+static inline uint8_t *roomba_tx_reserve(ROOMBA_TX *tx, uint16_t n) {
+  uint8_t *p;
+
+  if (n > ROOMBA_TX_SIZE - tx->size) return NULL;
+  p = &tx->data[tx->size];
+  tx->size = (uint8_t)(tx->size + n);
+  return p;
+}
+
+static inline void roomba_tx_flush(ROOMBA_TX *tx, ROOMBA_TRANSPORT transport) {
+  if (tx->size > 0) transport.write(transport.context, tx->data, tx->size);
+  tx->size = 0;
+}
+
+#ifdef ROOMBA_TX_WRITE
+static inline void roomba_tx_send(ROOMBA_TX *tx) {
+  if (tx->size > 0) ROOMBA_TX_WRITE(NULL, tx->data, tx->size);
+  tx->size = 0;
+}
+#endif
+
+/**
+ * Commands without data bytes: Start, Safe, Full, Power, Spot, Clean or
+ * Cover, Max or Demo on the SCI, Seek Dock, Stop, Reset.
+ *
+ * @return false if the buffer is full, for all encoders
+ */
+static inline bool roomba_tx_opcode(ROOMBA_TX *tx, ROOMBA_OP_CODE opcode) {
+  uint8_t *p = roomba_tx_reserve(tx, 1);
+
+  if (!p) return false;
+  p[0] = (uint8_t)opcode;
+  return true;
+}
+
+/** Commands with one data byte: Baud, Motors, Play, Sensors, Buttons... */
+static inline bool roomba_tx_opcode_byte(ROOMBA_TX *tx, ROOMBA_OP_CODE opcode,
+  uint8_t value) {
+  uint8_t *p = roomba_tx_reserve(tx, 2);
+
+  if (!p) return false;
+  p[0] = (uint8_t)opcode;
+  p[1] = value;
+  return true;
+}
+
+/* opcode followed by two signed 16 bit values, high byte first */
+static inline bool roomba_tx_opcode_words(ROOMBA_TX *tx, ROOMBA_OP_CODE opcode,
+  int16_t a, int16_t b) {
+  uint8_t *p = roomba_tx_reserve(tx, 5);
+
+  if (!p) return false;
+  p[0] = (uint8_t)opcode;
+  p[1] = (uint8_t)((uint16_t)a >> 8);
+  p[2] = (uint8_t)a;
+  p[3] = (uint8_t)((uint16_t)b >> 8);
+  p[4] = (uint8_t)b;
+  return true;
+}
+
+static inline bool roomba_tx_baud(ROOMBA_TX *tx, ROOMBA_BITRATE bitrate) {
+  return roomba_tx_opcode_byte(tx, ROOMBA_BAUD, (uint8_t)bitrate);
+}
+
+/** @param velocity mm/s, -500 - 500 @param radius mm, -2000 - 2000 or special */
+static inline bool roomba_tx_drive(ROOMBA_TX *tx, int16_t velocity,
+  int16_t radius) {
+  return roomba_tx_opcode_words(tx, ROOMBA_DRIVE, velocity, radius);
+}
+
+/** @param right left mm/s, -500 - 500 */
+static inline bool roomba_tx_drive_direct(ROOMBA_TX *tx, int16_t right,
+  int16_t left) {
+  return roomba_tx_opcode_words(tx, ROOMBA_DRIVE_DIRECT, right, left);
+}
+
+/** @param right left PWM, -255 - 255 */
+static inline bool roomba_tx_drive_pwm(ROOMBA_TX *tx, int16_t right,
+  int16_t left) {
+  return roomba_tx_opcode_words(tx, ROOMBA_DRIVE_PWM, right, left);
+}
+
+static inline bool roomba_tx_motors(ROOMBA_TX *tx, uint8_t motors) {
+  return roomba_tx_opcode_byte(tx, ROOMBA_MOTORS, motors);
+}
+
+static inline bool roomba_tx_pwm_motors(ROOMBA_TX *tx, int8_t main_brush,
+  int8_t side_brush, uint8_t vacuum) {
+  uint8_t *p = roomba_tx_reserve(tx, 4);
+
+  if (!p) return false;
+  p[0] = ROOMBA_PWM_MOTORS;
+  p[1] = (uint8_t)main_brush;
+  p[2] = (uint8_t)side_brush;
+  p[3] = vacuum;
+  return true;
+}
+
+static inline bool roomba_tx_leds(ROOMBA_TX *tx, uint8_t leds,
+  uint8_t power_color, uint8_t power_intensity) {
+  uint8_t *p = roomba_tx_reserve(tx, 4);
+
+  if (!p) return false;
+  p[0] = ROOMBA_LEDS;
+  p[1] = leds;
+  p[2] = power_color;
+  p[3] = power_intensity;
+  return true;
+}
+
+/**
+ * @param notes note number and duration pairs as on the wire, 2 x length
+ * bytes
+ * @param length 1 - 16, false otherwise
+ */
+static inline bool roomba_tx_song(ROOMBA_TX *tx, uint8_t number,
+  const uint8_t notes[], uint8_t length) {
+  uint8_t *p;
+
+  if (length < 1 || length > 16) return false;
+  p = roomba_tx_reserve(tx, (uint16_t)(3 + 2 * length));
+  if (!p) return false;
+  p[0] = ROOMBA_SONG;
+  p[1] = number;
+  p[2] = length;
+  memcpy(&p[3], notes, 2 * length);
+  return true;
+}
+
+static inline bool roomba_tx_play(ROOMBA_TX *tx, uint8_t number) {
+  return roomba_tx_opcode_byte(tx, ROOMBA_PLAY, number);
+}
+
+static inline bool roomba_tx_sensors(ROOMBA_TX *tx, uint8_t packet) {
+  return roomba_tx_opcode_byte(tx, ROOMBA_SENSORS, packet);
+}
+
+/* Stream and Query List share [opcode][count][ids] */
+static inline bool roomba_tx_packet_list(ROOMBA_TX *tx, ROOMBA_OP_CODE opcode,
+  const uint8_t packets[], uint8_t count) {
+  uint8_t *p;
+
+  if (count > ROOMBA_TX_SIZE - 2) return false;
+  p = roomba_tx_reserve(tx, (uint16_t)(2 + count));
+  if (!p) return false;
+  p[0] = (uint8_t)opcode;
+  p[1] = count;
+  memcpy(&p[2], packets, count);
+  return true;
+}
+
+static inline bool roomba_tx_query_list(ROOMBA_TX *tx, const uint8_t packets[],
+  uint8_t count) {
+  return roomba_tx_packet_list(tx, ROOMBA_QUERY_LIST, packets, count);
+}
+
+static inline bool roomba_tx_stream(ROOMBA_TX *tx, const uint8_t packets[],
+  uint8_t count) {
+  return roomba_tx_packet_list(tx, ROOMBA_STREAM, packets, count);
+}
+
+static inline bool roomba_tx_pause_resume_stream(ROOMBA_TX *tx, bool resume) {
+  return roomba_tx_opcode_byte(tx, ROOMBA_PAUSE_RESUME_STREAM, resume);
+}
+
+#if ROOMBA_INTERFACE_VERSION==2
+
+static inline bool roomba_tx_scheduling_leds(ROOMBA_TX *tx, uint8_t weekdays,
+  uint8_t scheduling) {
+  uint8_t *p = roomba_tx_reserve(tx, 3);
+
+  if (!p) return false;
+  p[0] = ROOMBA_SCHEDULING_LEDS;
+  p[1] = weekdays;
+  p[2] = scheduling;
+  return true;
+}
+
+/**
+ * @param opcode ROOMBA_DIGIT_LEDS_RAW or ROOMBA_DIGIT_LEDS_ASCII
+ * @param digits digit 3 (leftmost) to digit 0
+ */
+static inline bool roomba_tx_digit_leds(ROOMBA_TX *tx, ROOMBA_OP_CODE opcode,
+  const uint8_t digits[4]) {
+  uint8_t *p = roomba_tx_reserve(tx, 5);
+
+  if (!p) return false;
+  p[0] = (uint8_t)opcode;
+  memcpy(&p[1], digits, 4);
+  return true;
+}
+
+static inline bool roomba_tx_buttons(ROOMBA_TX *tx, uint8_t buttons) {
+  return roomba_tx_opcode_byte(tx, ROOMBA_BUTTONS_CMD, buttons);
+}
+
+static inline bool roomba_tx_set_day_time(ROOMBA_TX *tx, uint8_t day,
+  uint8_t hour, uint8_t minute) {
+  uint8_t *p = roomba_tx_reserve(tx, 4);
+
+  if (!p) return false;
+  p[0] = ROOMBA_SET_DAY_TIME;
+  p[1] = day;
+  p[2] = hour;
+  p[3] = minute;
+  return true;
+}
+
+/** @param times hour and minute pairs, Sunday first, 14 bytes */
+static inline bool roomba_tx_schedule(ROOMBA_TX *tx, uint8_t days,
+  const uint8_t times[14]) {
+  uint8_t *p = roomba_tx_reserve(tx, 16);
+
+  if (!p) return false;
+  p[0] = ROOMBA_SCHEDULE;
+  p[1] = days;
+  memcpy(&p[2], times, 14);
+  return true;
+}
+
+#endif
+
+/**@}*/
+
+#endif /* ROOMBA_TX_H_ */
@@ -0,0 +1,111 @@
+#ifdef __AVR__
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "roomba_uart_avr.h"
+
+#if defined(USART0_RX_vect)
+  #define RX_VECT USART0_RX_vect
+  #define UDRE_VECT USART0_UDRE_vect
+#else
+  #define RX_VECT USART_RX_vect
+  #define UDRE_VECT USART_UDRE_vect
+#endif
+
+static uint8_t rx_buffer[ROOMBA_UART_RX_SIZE];
+static uint8_t tx_buffer[ROOMBA_UART_TX_SIZE];
+static ROOMBA_RING rx;
+static ROOMBA_RING tx;
+static volatile ROOMBA_UART_STATS stats;
+static bool sent;
+
+ISR(RX_VECT) {
+  uint8_t status = UCSR0A;
+  uint8_t byte = UDR0;
+
+  if (status & (_BV(FE0) | _BV(DOR0))) stats.rx_errors++;
+  if (!roomba_ring_put(&rx, byte)) stats.rx_overflows++;
+}
+
+ISR(UDRE_VECT) {
+  uint8_t byte;
+
+  if (roomba_ring_get(&tx, &byte)) {
+    /* TXC then means this byte has left the shift register */
+    UCSR0A |= _BV(TXC0);
+    UDR0 = byte;
+  } else {
+    UCSR0B &= ~_BV(UDRIE0);
+  }
+}
+
+static void set_ubrr(ROOMBA_BITRATE bitrate) {
+  uint32_t bps = get_bitrate_bps(bitrate);
+  /* double speed mode, rounded to the nearest divisor */
+  uint16_t ubrr = (uint16_t)((F_CPU + bps * 4) / (bps * 8) - 1);
+
+  UBRR0H = (uint8_t)(ubrr >> 8);
+  UBRR0L = (uint8_t)ubrr;
+  UCSR0A = _BV(U2X0);
+}
+
+void roomba_uart_init(ROOMBA_BITRATE bitrate) {
+  roomba_ring_init(&rx, rx_buffer, ROOMBA_UART_RX_SIZE);
+  roomba_ring_init(&tx, tx_buffer, ROOMBA_UART_TX_SIZE);
+  stats.rx_overflows = 0;
+  stats.rx_errors = 0;
+  sent = false;
+  set_ubrr(bitrate);
+  UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+  UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+void roomba_uart_set_bitrate(void *context, ROOMBA_BITRATE bitrate) {
+  (void)context;
+  while (roomba_ring_count(&tx) > 0 || (UCSR0B & _BV(UDRIE0))) {}
+  if (sent) {
+    while (!(UCSR0A & _BV(TXC0))) {}
+  }
+  set_ubrr(bitrate);
+}
+
+void roomba_uart_write(void *context, const uint8_t data[], uint16_t size) {
+  (void)context;
+  sent = true;
+  for (uint16_t i = 0; i < size; i++) {
+    while (!roomba_ring_put(&tx, data[i])) {}
+    UCSR0B |= _BV(UDRIE0);
+  }
+}
+
+uint8_t roomba_uart_read(uint8_t data[], uint8_t size) {
+  return roomba_ring_read(&rx, data, size);
+}
+
+void roomba_uart_poll(ROOMBA_STREAM_PARSER *parser) {
+  uint8_t chunk[16];
+  uint8_t n;
+
+  while ((n = roomba_ring_read(&rx, chunk, sizeof(chunk))) > 0) {
+    roomba_stream_parse(parser, chunk, n);
+  }
+}
+
+ROOMBA_UART_STATS roomba_uart_stats(void) {
+  ROOMBA_UART_STATS copy;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    copy.rx_overflows = stats.rx_overflows;
+    copy.rx_errors = stats.rx_errors;
+  }
+  return copy;
+}
+
+#else
+
+/* ISO C does not allow an empty translation unit */
+typedef int roomba_uart_avr_host_build;
+
+#endif /* __AVR__ */
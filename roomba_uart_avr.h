@@ -0,0 +1,85 @@
+/**
+ * @file roomba_uart_avr.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_uart_avr.h> @endcode
+ *
+ * @brief Interrupt driven USART0 backend for AVR
+ *
+ * roomba_uart_write only copies into the TX ring and enables the data
+ * register empty interrupt, which sends the bytes in the background; a 20
+ * byte song costs a few microseconds instead of about 2 ms of waiting at
+ * 115200 baud. Received bytes are collected by the RX interrupt and handed
+ * to the stream parser from the main loop with roomba_uart_poll.
+ *
+ * The ring logic is in roomba_ring.h and builds on the host as well.
+ */
+
+#ifndef ROOMBA_UART_AVR_H_
+#define ROOMBA_UART_AVR_H_
+
+#include "roomba.h"
+#include "roomba_ring.h"
+#include "roomba_stream.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** A full stream frame of group 100 is 84 bytes */
+#ifndef ROOMBA_UART_RX_SIZE
+  #define ROOMBA_UART_RX_SIZE 128
+#endif
+
+#ifndef ROOMBA_UART_TX_SIZE
+  #define ROOMBA_UART_TX_SIZE 64
+#endif
+
+#if !ROOMBA_RING_SIZE_OK(ROOMBA_UART_RX_SIZE) || \
+    !ROOMBA_RING_SIZE_OK(ROOMBA_UART_TX_SIZE)
+  #error "ROOMBA_UART_RX_SIZE and ROOMBA_UART_TX_SIZE must be powers of two, 2 - 128"
+#endif
+
+typedef struct _roomba_uart_stats {
+  /** Bytes lost because the RX ring was full */
+  uint16_t rx_overflows;
+  /** Frame errors and hardware data overruns */
+  uint16_t rx_errors;
+} ROOMBA_UART_STATS;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/** Sets up USART0 at 8N1; interrupts must be enabled with sei() */
+void roomba_uart_init(ROOMBA_BITRATE bitrate);
+
+/**
+ * Waits until all queued bytes have left, then changes the rate. Fits the
+ * set_host_bitrate callbacks of roomba_baud.h and roomba_bringup.h.
+ */
+void roomba_uart_set_bitrate(void *context, ROOMBA_BITRATE bitrate);
+
+/**
+ * Queues bytes for sending. Only waits when the TX ring is full.
+ * Use as ROOMBA_TRANSPORT write function, the context is ignored.
+ */
+void roomba_uart_write(void *context, const uint8_t data[], uint16_t size);
+
+/** @return number of received bytes copied to data */
+uint8_t roomba_uart_read(uint8_t data[], uint8_t size);
+
+/** Feeds everything received so far to the parser, call from the main loop */
+void roomba_uart_poll(ROOMBA_STREAM_PARSER *parser);
+
+ROOMBA_UART_STATS roomba_uart_stats(void);
+
+static inline ROOMBA_TRANSPORT roomba_uart_transport(void) {
+  ROOMBA_TRANSPORT transport = { roomba_uart_write, NULL };
+  return transport;
+}
+
+/**@}*/
+
+#endif /* ROOMBA_UART_AVR_H_ */
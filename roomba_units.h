@@ -0,0 +1,111 @@
+/**
+ * @file roomba_units.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_units.h> @endcode
+ *
+ * @brief Range-checked motion types for Drive, Drive Direct and Drive PWM
+ *
+ * A ROOMBA_SPEED, ROOMBA_TURN_RADIUS or ROOMBA_WHEEL_PWM only comes out of its
+ * constructor, which saturates the value to the range the OI accepts. Being
+ * distinct structs, a speed cannot be passed where a radius is expected.
+ * The encoders taking these types therefore skip is_valid_roomba_command on
+ * the hot path.
+ *
+ * | Type               | Unit | Range                  | Constructor        |
+ * |--------------------|------|------------------------|--------------------|
+ * | ROOMBA_SPEED       | mm/s | -500 - 500             | roomba_speed       |
+ * | ROOMBA_TURN_RADIUS | mm   | -2000 - 2000, straight | roomba_turn_radius |
+ * | ROOMBA_WHEEL_PWM   | 1    | -255 - 255             | roomba_wheel_pwm   |
+ */
+
+#ifndef ROOMBA_UNITS_H_
+#define ROOMBA_UNITS_H_
+
+#include "roomba.h"
+#include "roomba_tx.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+#define ROOMBA_MAX_VELOCITY 500
+#define ROOMBA_MAX_RADIUS 2000
+#define ROOMBA_MAX_WHEEL_PWM 255
+
+typedef struct _roomba_speed {
+  int16_t mm_s;
+} ROOMBA_SPEED;
+
+typedef struct _roomba_turn_radius {
+  int16_t mm;
+} ROOMBA_TURN_RADIUS;
+
+typedef struct _roomba_wheel_pwm {
+  int16_t duty;
+} ROOMBA_WHEEL_PWM;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+static inline int16_t roomba_saturate(int32_t value, int16_t limit) {
+  if (value > limit) return limit;
+  if (value < -limit) return (int16_t)-limit;
+  return (int16_t)value;
+}
+
+static inline ROOMBA_SPEED roomba_speed(int32_t mm_s) {
+  ROOMBA_SPEED v;
+
+  v.mm_s = roomba_saturate(mm_s, ROOMBA_MAX_VELOCITY);
+  return v;
+}
+
+/**
+ * Saturates to +-2000 mm. Use roomba_turn_straight for straight driving;
+ * 1 and -1 turn in place counter-clockwise and clockwise.
+ */
+static inline ROOMBA_TURN_RADIUS roomba_turn_radius(int32_t mm) {
+  ROOMBA_TURN_RADIUS r;
+
+  r.mm = roomba_saturate(mm, ROOMBA_MAX_RADIUS);
+  return r;
+}
+
+static inline ROOMBA_TURN_RADIUS roomba_turn_straight(void) {
+  ROOMBA_TURN_RADIUS r;
+
+  r.mm = (int16_t)ROOMBA_RADIUS_STRAIGHT_POSITIVE;
+  return r;
+}
+
+static inline ROOMBA_WHEEL_PWM roomba_wheel_pwm(int32_t duty) {
+  ROOMBA_WHEEL_PWM p;
+
+  p.duty = roomba_saturate(duty, ROOMBA_MAX_WHEEL_PWM);
+  return p;
+}
+
+/** Drive (137) without validation, see roomba_tx.h for the buffer */
+static inline bool roomba_drive(ROOMBA_TX *tx, ROOMBA_SPEED speed,
+  ROOMBA_TURN_RADIUS radius) {
+  return roomba_tx_drive(tx, speed.mm_s, radius.mm);
+}
+
+/** Drive Direct (145) without validation */
+static inline bool roomba_drive_direct(ROOMBA_TX *tx, ROOMBA_SPEED right,
+  ROOMBA_SPEED left) {
+  return roomba_tx_drive_direct(tx, right.mm_s, left.mm_s);
+}
+
+/** Drive PWM (146) without validation */
+static inline bool roomba_drive_pwm(ROOMBA_TX *tx, ROOMBA_WHEEL_PWM right,
+  ROOMBA_WHEEL_PWM left) {
+  return roomba_tx_drive_pwm(tx, right.duty, left.duty);
+}
+
+/**@}*/
+
+#endif /* ROOMBA_UNITS_H_ */
@@ -0,0 +1,49 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "roomba_writer.h"
+
+void roomba_writer_init(ROOMBA_WRITER *writer, int fd, uint8_t buffer[],
+  uint16_t capacity, ROOMBA_WRITER_BLOCKED on_blocked, void *context) {
+  writer->fd = fd;
+  writer->buffer = buffer;
+  writer->capacity = capacity;
+  writer->size = 0;
+  writer->blocked = false;
+  writer->on_blocked = on_blocked;
+  writer->context = context;
+}
+
+bool roomba_writer_write(ROOMBA_WRITER *writer, const uint8_t data[],
+  uint16_t size) {
+  if (size > writer->capacity - writer->size) return false;
+  memcpy(&writer->buffer[writer->size], data, size);
+  writer->size = (uint16_t)(writer->size + size);
+  /* behind an unfinished command: EPOLLOUT sends it */
+  if (!writer->blocked) roomba_writer_flush(writer);
+  return true;
+}
+
+void roomba_writer_flush(ROOMBA_WRITER *writer) {
+  uint16_t sent = 0;
+
+  while (sent < writer->size) {
+    ssize_t n = write(writer->fd, &writer->buffer[sent], writer->size - sent);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      /* a broken port shows on the next read */
+      if (errno != EAGAIN) sent = writer->size;
+      break;
+    }
+    sent = (uint16_t)(sent + n);
+  }
+  memmove(writer->buffer, &writer->buffer[sent], writer->size - sent);
+  writer->size = (uint16_t)(writer->size - sent);
+  if ((writer->size > 0) != writer->blocked) {
+    writer->blocked = writer->size > 0;
+    writer->on_blocked(writer->context, writer->blocked);
+  }
+}
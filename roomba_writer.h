@@ -0,0 +1,70 @@
+/**
+ * @file roomba_writer.h
+ * @ingroup roomba-lib
+ * @code #include <roomba_writer.h> @endcode
+ *
+ * @brief Whole-command output buffer for a non blocking serial port (Linux)
+ *
+ * A non blocking port may take only part of a command. The writer keeps the
+ * rest and finishes it, on EPOLLOUT, before anything else is written, so the
+ * robot never sees a cut command. A command that does not fit in the buffer
+ * is dropped whole.
+ *
+ * The writer does not know the event loop: when it starts or stops waiting
+ * for the port it calls on_blocked, and the owner adds or removes EPOLLOUT.
+ *
+ * @code
+ * roomba_writer_init(&writer, fd, buffer, sizeof(buffer), watch, context);
+ * if (!roomba_writer_write(&writer, data, size)) dropped++;
+ * // on EPOLLOUT
+ * roomba_writer_flush(&writer);
+ * @endcode
+ */
+
+#ifndef ROOMBA_WRITER_H_
+#define ROOMBA_WRITER_H_
+
+#include "roomba.h"
+
+/**@{*/
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+
+/** @param blocked true to wait for EPOLLOUT, false to stop */
+typedef void (*ROOMBA_WRITER_BLOCKED)(void *context, bool blocked);
+
+typedef struct _roomba_writer {
+  int fd;
+  uint8_t *buffer;
+  uint16_t capacity;
+  uint16_t size;
+  /** Waiting for EPOLLOUT */
+  bool blocked;
+  ROOMBA_WRITER_BLOCKED on_blocked;
+  void *context;
+} ROOMBA_WRITER;
+
+/*******************************************************************************
+ * Function
+ ******************************************************************************/
+
+/** @param fd serial port, O_NONBLOCK */
+void roomba_writer_init(ROOMBA_WRITER *writer, int fd, uint8_t buffer[],
+  uint16_t capacity, ROOMBA_WRITER_BLOCKED on_blocked, void *context);
+
+/**
+ * Appends a whole command and writes what the port takes now.
+ *
+ * @return false if it did not fit, nothing of it was written
+ */
+bool roomba_writer_write(ROOMBA_WRITER *writer, const uint8_t data[],
+  uint16_t size);
+
+/** Writes what the port takes now, the rest waits for EPOLLOUT */
+void roomba_writer_flush(ROOMBA_WRITER *writer);
+
+/**@}*/
+
+#endif /* ROOMBA_WRITER_H_ */
@@ -0,0 +1,44 @@
+/**
+ * @file bench.h
+ * @brief Timing for the benchmark programs
+ *
+ * BENCH_RUN times a statement over a number of iterations and prints the
+ * cost of one; the statement can use the iteration number bench_i. Set
+ * ROOMBA_BENCH_SCALE in the environment to run that many times more
+ * iterations than the quick default ctest uses.
+ */
+
+#ifndef ROOMBA_BENCH_H_
+#define ROOMBA_BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static inline uint32_t bench_iterations(uint32_t quick) {
+  const char *scale = getenv("ROOMBA_BENCH_SCALE");
+
+  return scale ? quick * (uint32_t)atoi(scale) : quick;
+}
+
+/* keeps a result alive so the timed work is not optimised away */
+static volatile uint32_t bench_sink;
+
+#define BENCH_RUN(label, iterations, statement) \
+  do { \
+    uint32_t n_ = (iterations); \
+    uint64_t start_ = bench_now_ns(); \
+    for (uint32_t bench_i = 0; bench_i < n_; bench_i++) { statement; } \
+    printf("%-32s %10.1f ns\n", (label), \
+      (double)(bench_now_ns() - start_) / (n_ ? n_ : 1)); \
+  } while (0)
+
+#endif /* ROOMBA_BENCH_H_ */
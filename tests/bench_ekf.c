@@ -0,0 +1,29 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "roomba_ekf.h"
+
+/* one predict/update cycle has to fit well inside the 15 ms frame */
+int main(void) {
+  ROOMBA_EKF ekf;
+  ROOMBA_EKF_INPUT input = {0};
+  uint32_t iterations = bench_iterations(100000);
+
+  roomba_ekf_init(&ekf, NULL);
+  input.velocity = 200;
+  input.radius = 1000;
+  input.velocity_left = 190;
+  input.velocity_right = 210;
+  input.stasis = 1;
+
+  BENCH_RUN("ekf update", iterations, {
+    input.encoder_counts_left = (uint16_t)(bench_i * 7);
+    input.encoder_counts_right = (uint16_t)(bench_i * 8);
+    input.angle = (int16_t)(bench_i & 1);
+    roomba_ekf_update(&ekf, &input, 0.015f);
+  });
+
+  bench_sink = (uint32_t)ekf.state[ROOMBA_EKF_X];
+  /* the estimate must stay finite over the whole run */
+  return ekf.state[ROOMBA_EKF_X] == ekf.state[ROOMBA_EKF_X] ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+
+#include <sched.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "roomba_fleet.h"
+
+#define MAX_ROBOTS (ROOMBA_FLEET_MAX_WORKERS * ROOMBA_FLEET_WORKER_ROBOTS)
+
+/* [19][2][7 bumps][0] and its checksum: a frame a robot might stream */
+static const uint8_t frame[] = {19, 2, 7, 0, (uint8_t)-(19 + 2 + 7)};
+
+/* cpu_ns is refreshed once per tick, wait for one */
+static void settled(const ROOMBA_FLEET *fleet,
+  ROOMBA_FLEET_WORKER_STATS *stats) {
+  sleep_ms(3 * ROOMBA_SLOT_MS);
+  roomba_fleet_stats(fleet, stats);
+}
+
+/* the same burst to every robot, @return CPU ns per frame */
+static double measure(ROOMBA_FLEET *fleet, const int robots[], int count,
+  uint32_t frames, double *per_second) {
+  static uint8_t burst[256 * sizeof(frame)];
+  uint32_t per_write = sizeof(burst) / sizeof(frame);
+  ROOMBA_FLEET_WORKER_STATS before, after;
+  uint64_t start, elapsed, expected;
+  uint32_t sent = 0;
+
+  for (uint32_t i = 0; i < per_write; i++) {
+    memcpy(&burst[i * sizeof(frame)], frame, sizeof(frame));
+  }
+  settled(fleet, &before);
+  start = bench_now_ns();
+  while (sent < frames) {
+    uint32_t n = frames - sent < per_write ? frames - sent : per_write;
+    for (int r = 0; r < count; r++) {
+      CHECK(write(robots[r], burst, n * sizeof(frame)) ==
+        (ssize_t)(n * sizeof(frame)));
+    }
+    sent += n;
+  }
+  expected = before.frames + (uint64_t)frames * count;
+  do {
+    sched_yield();
+    roomba_fleet_stats(fleet, &after);
+  } while (after.frames < expected && bench_now_ns() - start < 10000000000u);
+  elapsed = bench_now_ns() - start;
+  CHECK(after.frames >= expected);
+  settled(fleet, &after);
+
+  *per_second = (double)frames * count * 1e9 / (double)elapsed;
+  return (double)(after.cpu_ns - before.cpu_ns) / ((double)frames * count);
+}
+
+/*
+ * Frames per second and worker CPU as the fleet grows to its full size,
+ * ROOMBA_FLEET_MAX_WORKERS workers of ROOMBA_FLEET_WORKER_ROBOTS robots each,
+ * socket pairs standing in for the serial ports. Workers are pinned when
+ * there are CPUs enough. The CPU a robot costs at its real rate, a frame
+ * every 15 ms, is the CPU per frame over the slot.
+ */
+int main(void) {
+  static ROOMBA_FLEET fleet;
+  static int robots[MAX_ROBOTS];
+  ROOMBA_FLEET_CONFIG config;
+  uint32_t frames = bench_iterations(200);
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  printf("%-8s %-8s %14s %16s %16s\n", "workers", "robots", "frames/s",
+    "cpu ns/frame", "cpu %/robot");
+  for (int workers = 1; workers <= ROOMBA_FLEET_MAX_WORKERS; workers *= 2) {
+    int count = 0;
+
+    memset(&config, 0, sizeof(config));
+    config.workers = (uint8_t)workers;
+    config.first_cpu = cpus >= workers ? 0 : -1;
+    CHECK_EQ(roomba_fleet_start(&fleet, &config), 0);
+    if (test_failures) break;
+
+    /* 1, 8 and 32 robots per worker */
+    for (int each = 1; each <= ROOMBA_FLEET_WORKER_ROBOTS;
+         each = each == 1 ? 8 : each * 4) {
+      double cpu, per_second;
+
+      for (; count < workers * each; count++) {
+        int pair[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+        CHECK(roomba_fleet_add(&fleet, pair[0], ROOMBA_115200BPS, NULL) >= 0);
+        robots[count] = pair[1];
+      }
+      cpu = measure(&fleet, robots, count, frames, &per_second);
+      printf("%-8d %-8d %14.0f %16.1f %16.4f\n", workers, count, per_second,
+        cpu, cpu * 100 / (ROOMBA_SLOT_MS * 1e6));
+      if (test_failures) break;
+    }
+
+    roomba_fleet_stop(&fleet);
+    for (int r = 0; r < count; r++) close(robots[r]);
+    if (test_failures) break;
+  }
+  return TEST_RESULT();
+}
@@ -0,0 +1,57 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+
+#include <string.h>
+
+#include "light_scalar.h"
+
+#define BATCH 256
+
+static uint16_t raw[ROOMBA_LIGHT_CHANNELS][BATCH];
+static uint16_t filtered[ROOMBA_LIGHT_CHANNELS][BATCH];
+static uint8_t detected[BATCH];
+
+/*
+ * One frame through the vector and the scalar builds, then a recorded batch
+ * through roomba_light_filter_batch. The batch gathers a sample at a time, so
+ * its cost per sample should match a frame.
+ */
+int main(void) {
+  ROOMBA_PACKET_GROUP_100 frame;
+  ROOMBA_LIGHT_FILTER filter;
+  const uint16_t *columns[ROOMBA_LIGHT_CHANNELS];
+  uint16_t *outputs[ROOMBA_LIGHT_CHANNELS];
+  uint32_t iterations = bench_iterations(1000000);
+
+  memset(&frame, 0, sizeof(frame));
+  for (uint8_t c = 0; c < ROOMBA_LIGHT_CHANNELS; c++) {
+    for (uint32_t n = 0; n < BATCH; n++) {
+      raw[c][n] = (uint16_t)((n * 37 + c * 101) % 1200);
+    }
+    columns[c] = raw[c];
+    outputs[c] = filtered[c];
+  }
+
+  roomba_light_filter_init(&filter, 600, 400);
+  BENCH_RUN("roomba_light_filter_frame", iterations, {
+    frame.light_bump_left = (uint16_t)(bench_i & 1023);
+    frame.light_bump_center_right = (uint16_t)(bench_i >> 2 & 1023);
+    bench_sink += roomba_light_filter_frame(&filter, &frame);
+  });
+
+  scalar_light_filter_init(&filter, 600, 400);
+  BENCH_RUN("scalar_light_filter_frame", iterations, {
+    frame.light_bump_left = (uint16_t)(bench_i & 1023);
+    frame.light_bump_center_right = (uint16_t)(bench_i >> 2 & 1023);
+    bench_sink += scalar_light_filter_frame(&filter, &frame);
+  });
+
+  roomba_light_filter_init(&filter, 600, 400);
+  BENCH_RUN("roomba_light_filter_batch 256", iterations / BATCH, {
+    roomba_light_filter_batch(&filter, columns, outputs, detected, BATCH);
+    bench_sink += detected[bench_i % BATCH];
+  });
+
+  return 0;
+}
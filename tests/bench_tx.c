@@ -0,0 +1,71 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static uint8_t sink[256];
+static uint8_t sink_size;
+
+/* what roomba_tx_send calls, known to the compiler */
+static inline void sink_write(void *context, const uint8_t data[],
+  uint16_t size) {
+  (void)context;
+  for (uint16_t i = 0; i < size; i++) sink[(uint8_t)(sink_size + i)] = data[i];
+  sink_size = (uint8_t)(sink_size + size);
+}
+
+#define ROOMBA_TX_WRITE sink_write
+#include "roomba_tx.h"
+
+/* the sketched C API: one indirect call per byte */
+static void send_byte(uint8_t byte) {
+  sink[sink_size++] = byte;
+}
+
+static void (*volatile uart_send_byte_fn)(uint8_t) = send_byte;
+
+static void drive_per_byte(void (*send)(uint8_t), int16_t velocity,
+  int16_t radius) {
+  send(ROOMBA_DRIVE);
+  send((uint8_t)((uint16_t)velocity >> 8));
+  send((uint8_t)velocity);
+  send((uint8_t)((uint16_t)radius >> 8));
+  send((uint8_t)radius);
+}
+
+static void query_per_byte(void (*send)(uint8_t), const uint8_t packets[],
+  uint8_t count) {
+  send(ROOMBA_QUERY_LIST);
+  send(count);
+  for (uint8_t i = 0; i < count; i++) send(packets[i]);
+}
+
+int main(void) {
+  static const uint8_t packets[] = {ROOMBA_VOLTAGE, ROOMBA_CURRENT,
+    ROOMBA_BATTERY_CHARGE};
+  uint32_t iterations = bench_iterations(1000000);
+  ROOMBA_TX tx;
+
+  /* a Drive and a Query List of three packets per iteration */
+  BENCH_RUN("function pointer per byte", iterations, {
+    drive_per_byte(uart_send_byte_fn, (int16_t)bench_i, 500);
+    query_per_byte(uart_send_byte_fn, packets, sizeof(packets));
+  });
+  BENCH_RUN("roomba_tx batch", iterations, {
+    roomba_tx_clear(&tx);
+    roomba_tx_drive(&tx, (int16_t)bench_i, 500);
+    roomba_tx_query_list(&tx, packets, sizeof(packets));
+    roomba_tx_send(&tx);
+  });
+
+  /* both paths put the same bytes on the wire */
+  sink_size = 0;
+  drive_per_byte(uart_send_byte_fn, -200, 500);
+  roomba_tx_clear(&tx);
+  roomba_tx_drive(&tx, -200, 500);
+  roomba_tx_send(&tx);
+  bench_sink = sink_size;
+  return sink_size == 10 && memcmp(sink, &sink[5], 5) == 0 ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file heap.h
+ * @brief Counts heap calls made from the library and the test
+ *
+ * Link with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+ * (roomba_heap_test does). Every call from the linked objects then goes
+ * through these wrappers; calls libc makes internally are not seen.
+ */
+
+#ifndef ROOMBA_HEAP_H_
+#define ROOMBA_HEAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+static volatile uint32_t heap_calls;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t count, size_t size);
+void *__wrap_realloc(void *pointer, size_t size);
+void __wrap_free(void *pointer);
+
+void *__wrap_malloc(size_t size) {
+  heap_calls++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  heap_calls++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  heap_calls++;
+  return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void *pointer) {
+  heap_calls++;
+  __real_free(pointer);
+}
+
+#endif /* ROOMBA_HEAP_H_ */
@@ -0,0 +1,27 @@
+/**
+ * @file light_scalar.h
+ * @brief The plain loop build of roomba_lightbump.c
+ *
+ * roomba_light_scalar (tests/CMakeLists.txt) compiles roomba_lightbump.c
+ * again with ROOMBA_LIGHT_SCALAR and its functions renamed scalar_light_*, so
+ * a test can run both builds side by side on the same filter type.
+ */
+
+#ifndef ROOMBA_LIGHT_SCALAR_H_
+#define ROOMBA_LIGHT_SCALAR_H_
+
+#include "roomba_lightbump.h"
+
+void scalar_light_filter_init(ROOMBA_LIGHT_FILTER *filter, uint16_t on,
+  uint16_t off);
+
+void scalar_light_filter_set_thresholds(ROOMBA_LIGHT_FILTER *filter,
+  uint8_t channel, uint16_t on, uint16_t off);
+
+uint8_t scalar_light_filter_update(ROOMBA_LIGHT_FILTER *filter,
+  const uint16_t raw[ROOMBA_LIGHT_CHANNELS]);
+
+uint8_t scalar_light_filter_frame(ROOMBA_LIGHT_FILTER *filter,
+  const ROOMBA_PACKET_GROUP_100 *frame);
+
+#endif /* ROOMBA_LIGHT_SCALAR_H_ */
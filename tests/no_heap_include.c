@@ -0,0 +1,12 @@
+/* roomba.h first, the C library after it, as an application would */
+#define ROOMBA_NO_HEAP
+
+#include "roomba.h"
+#include <stdlib.h>
+#include <string.h>
+
+int no_heap_include(int value);
+
+int no_heap_include(int value) {
+  return abs(value);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file test.h
+ * @brief Minimal checks for the test programs
+ *
+ * A test program calls CHECK for every expectation and returns
+ * TEST_RESULT() from main; ctest counts a non-zero exit as a failure.
+ * CHECK_EQ compares integers, CHECK_NEAR real values within a tolerance.
+ *
+ * Tests of the Linux modules define _GNU_SOURCE and also get sleep_ms and
+ * sleep_us, to let worker threads run.
+ */
+
+#ifndef ROOMBA_TEST_H_
+#define ROOMBA_TEST_H_
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+        #condition); \
+      test_failures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long a_ = (long long)(actual), e_ = (long long)(expected); \
+    if (a_ != e_) { \
+      fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, \
+        __LINE__, #actual, a_, e_); \
+      test_failures++; \
+    } \
+  } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+  do { \
+    double a_ = (double)(actual), e_ = (double)(expected); \
+    if (!(a_ - e_ <= (tolerance) && e_ - a_ <= (tolerance))) { \
+      fprintf(stderr, "%s:%d: %s is %g, expected %g\n", __FILE__, \
+        __LINE__, #actual, a_, e_); \
+      test_failures++; \
+    } \
+  } while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? 0 : 1)
+
+#ifdef _GNU_SOURCE
+
+#include <time.h>
+
+static inline void sleep_us(long us) {
+  struct timespec ts = {us / 1000000, (us % 1000000) * 1000L};
+
+  nanosleep(&ts, NULL);
+}
+
+static inline void sleep_ms(long ms) {
+  sleep_us(ms * 1000);
+}
+
+#endif
+
+#endif /* ROOMBA_TEST_H_ */
@@ -0,0 +1,154 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_baud.h"
+
+#define CAPACITY 2696
+
+/* a robot on the other end of the line */
+typedef struct {
+  ROOMBA_BITRATE host;
+  ROOMBA_BITRATE robot;
+  /** Fastest rate replies arrive intact at */
+  ROOMBA_BITRATE reliable;
+  /** Bad frames per mille at each rate */
+  uint16_t errors[ROOMBA_BITRATE_COUNT];
+  bool streaming;
+  bool queried;
+  uint8_t last_write[2];
+  ROOMBA_BITRATE switches[16];
+  uint8_t switch_count;
+  uint32_t frames;
+} LINK;
+
+static void link_write(void *context, const uint8_t data[], uint16_t size) {
+  LINK *link = context;
+
+  CHECK_EQ(size, 2);
+  memcpy(link->last_write, data, 2);
+  /* only heard at the rate the robot listens at */
+  if (link->host != link->robot) return;
+  switch (data[0]) {
+    case ROOMBA_PAUSE_RESUME_STREAM: link->streaming = data[1]; break;
+    case ROOMBA_BAUD: link->robot = (ROOMBA_BITRATE)data[1]; break;
+    case ROOMBA_SENSORS: link->queried = data[1] == ROOMBA_BATTERY_CAPACITY;
+      break;
+  }
+}
+
+static void link_set_bitrate(void *context, ROOMBA_BITRATE bitrate) {
+  LINK *link = context;
+
+  /* switched right behind the Baud command that asked for it */
+  CHECK_EQ(link->last_write[0], ROOMBA_BAUD);
+  CHECK_EQ(link->last_write[1], bitrate);
+  link->host = bitrate;
+  if (link->switch_count < 16) link->switches[link->switch_count++] = bitrate;
+}
+
+/* runs a 15 ms slot: what the robot sends, then the negotiator's poll */
+static void slot(ROOMBA_BAUD_NEGOTIATOR *n, LINK *link, uint32_t now) {
+  ROOMBA_PACKET_GROUP_100 snapshot;
+  uint8_t bytes[ROOMBA_STREAM_FRAME_MAX];
+  uint8_t size;
+
+  if (link->host == link->robot && link->queried) {
+    bytes[0] = CAPACITY >> 8;
+    bytes[1] = link->robot > link->reliable ? 0 : CAPACITY & 0xFF;
+    roomba_baud_receive(n, bytes, 2);
+    link->queried = false;
+  }
+  if (link->host == link->robot && link->streaming) {
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.voltage = 15000;
+    size = roomba_stream_encode(&snapshot, ROOMBA_PACKET_BIT(ROOMBA_VOLTAGE),
+      bytes);
+    /* spread evenly over the frames */
+    if (link->errors[link->robot] &&
+        link->frames++ % (1000 / link->errors[link->robot]) == 0) {
+      bytes[size - 1] ^= 1;
+    }
+    roomba_baud_receive(n, bytes, size);
+  }
+  roomba_baud_poll(n, now);
+}
+
+/* runs slots until the negotiation settles, returns the time it took */
+static uint32_t settle(ROOMBA_BAUD_NEGOTIATOR *n, LINK *link,
+  uint32_t *now) {
+  uint32_t start = *now;
+
+  do {
+    slot(n, link, *now += 15);
+  } while (n->state != ROOMBA_BAUD_MONITOR &&
+    n->state != ROOMBA_BAUD_FAILED && *now - start < 120000);
+  return *now - start;
+}
+
+int main(void) {
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_BAUD_NEGOTIATOR n;
+  LINK link;
+  ROOMBA_TRANSPORT transport = {link_write, &link};
+  uint32_t now = 0;
+
+  /* up from 19200; replies at 115200 come back garbled */
+  memset(&link, 0, sizeof(link));
+  link.host = link.robot = ROOMBA_19200BPS;
+  link.reliable = ROOMBA_57600BPS;
+  link.streaming = true;
+  roomba_stream_init(&parser);
+  roomba_baud_init(&n, transport, link_set_bitrate, &parser, ROOMBA_19200BPS);
+  roomba_baud_start(&n, now, ROOMBA_115200BPS);
+  settle(&n, &link, &now);
+  CHECK_EQ(n.state, ROOMBA_BAUD_MONITOR);
+  CHECK_EQ(roomba_baud_current(&n), ROOMBA_57600BPS);
+  CHECK_EQ(link.switch_count, 5);
+  CHECK_EQ(link.switches[0], ROOMBA_28800BPS);
+  CHECK_EQ(link.switches[1], ROOMBA_38400BPS);
+  CHECK_EQ(link.switches[2], ROOMBA_57600BPS);
+  CHECK_EQ(link.switches[3], ROOMBA_115200BPS);
+  CHECK_EQ(link.switches[4], ROOMBA_57600BPS);
+  CHECK_EQ(link.host, ROOMBA_57600BPS);
+  CHECK_EQ(link.robot, ROOMBA_57600BPS);
+  CHECK(link.streaming);
+  CHECK_EQ(n.error_rate[ROOMBA_19200BPS], 0);
+  CHECK_EQ(n.error_rate[ROOMBA_57600BPS], 0);
+  CHECK_EQ(n.error_rate[ROOMBA_115200BPS], 1000);
+  CHECK_EQ(n.error_rate[ROOMBA_9600BPS], ROOMBA_BAUD_UNTESTED);
+
+  /* the link gets worse while monitored: one code down, verified */
+  link.errors[ROOMBA_57600BPS] = 20;
+  link.switch_count = 0;
+  for (int i = 0; i < 2 * ROOMBA_BAUD_SOAK_FRAMES && n.fallbacks == 0; i++) {
+    slot(&n, &link, now += 15);
+  }
+  settle(&n, &link, &now);
+  CHECK_EQ(n.fallbacks, 1);
+  CHECK_EQ(n.state, ROOMBA_BAUD_MONITOR);
+  CHECK_EQ(roomba_baud_current(&n), ROOMBA_38400BPS);
+  CHECK_EQ(link.switch_count, 1);
+  CHECK_EQ(link.switches[0], ROOMBA_38400BPS);
+  CHECK_EQ(link.robot, ROOMBA_38400BPS);
+  CHECK(n.error_rate[ROOMBA_57600BPS] > ROOMBA_BAUD_MAX_ERRORS);
+
+  /* a step losing too many frames is not taken, faster ones not tried */
+  memset(&link, 0, sizeof(link));
+  link.host = link.robot = ROOMBA_38400BPS;
+  link.reliable = ROOMBA_115200BPS;
+  link.errors[ROOMBA_57600BPS] = 30;
+  link.streaming = true;
+  roomba_stream_init(&parser);
+  roomba_baud_init(&n, transport, link_set_bitrate, &parser, ROOMBA_38400BPS);
+  roomba_baud_start(&n, now, ROOMBA_115200BPS);
+  settle(&n, &link, &now);
+  CHECK_EQ(n.state, ROOMBA_BAUD_MONITOR);
+  CHECK_EQ(roomba_baud_current(&n), ROOMBA_38400BPS);
+  CHECK_EQ(link.switch_count, 2);
+  CHECK_EQ(link.switches[0], ROOMBA_57600BPS);
+  CHECK_EQ(link.switches[1], ROOMBA_38400BPS);
+  CHECK(n.error_rate[ROOMBA_57600BPS] > ROOMBA_BAUD_MAX_ERRORS);
+  CHECK_EQ(n.error_rate[ROOMBA_115200BPS], ROOMBA_BAUD_UNTESTED);
+
+  return TEST_RESULT();
+}
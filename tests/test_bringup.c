@@ -0,0 +1,134 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_bringup.h"
+
+typedef struct {
+  uint8_t written[16];
+  uint8_t written_size;
+  /** Time of every write and DD change, and the DD levels */
+  uint32_t times[32];
+  uint8_t levels[32];
+  uint8_t events;
+  ROOMBA_BITRATE host;
+} ROBOT;
+
+static uint32_t now;
+
+static void robot_write(void *context, const uint8_t data[], uint16_t size) {
+  ROBOT *robot = context;
+
+  memcpy(&robot->written[robot->written_size], data, size);
+  robot->written_size = (uint8_t)(robot->written_size + size);
+  robot->times[robot->events] = now;
+  robot->levels[robot->events++] = data[0];
+}
+
+static void robot_set_dd(void *context, bool high) {
+  ROBOT *robot = context;
+
+  robot->times[robot->events] = now;
+  robot->levels[robot->events++] = high;
+}
+
+static void robot_set_bitrate(void *context, ROOMBA_BITRATE bitrate) {
+  ROBOT *robot = context;
+
+  /* right behind the Baud command */
+  CHECK(robot->written_size >= 2);
+  CHECK_EQ(robot->written[robot->written_size - 2], ROOMBA_BAUD);
+  CHECK_EQ(robot->written[robot->written_size - 1], bitrate);
+  robot->host = bitrate;
+}
+
+int main(void) {
+  ROBOT robots[2];
+  ROOMBA_BRINGUP bringups[2];
+  ROOMBA_BRINGUP_CONFIG config;
+  ROOMBA_TRANSPORT transport = {robot_write, &robots[0]};
+  uint8_t commands[] = {ROOMBA_START, ROOMBA_SAFE, ROOMBA_BAUD,
+    ROOMBA_115200BPS};
+  /* DD: low, high, six toggles from high, low */
+  uint32_t dd_times[] = {0, 500, 2500, 2550, 2600, 2650, 2700, 2750, 2800};
+  uint8_t dd_levels[] = {0, 1, 0, 1, 0, 1, 0, 1, 0};
+  uint32_t deadline;
+
+  /* the whole sequence, each poll exactly at the time it asked for */
+  memset(robots, 0, sizeof(robots));
+  memset(&config, 0, sizeof(config));
+  config.set_dd = robot_set_dd;
+  config.mode = ROOMBA_SAFE_MODE;
+  config.change_baud = true;
+  config.bitrate = ROOMBA_115200BPS;
+  config.set_host_bitrate = robot_set_bitrate;
+  now = 1000;
+  roomba_bringup_init(&bringups[0], transport, &config, now);
+  while (!roomba_bringup_done(&bringups[0])) {
+    deadline = roomba_bringup_poll(&bringups[0], now);
+    if (!roomba_bringup_done(&bringups[0])) {
+      CHECK((int32_t)(deadline - now) > 0);
+      now = deadline;
+    }
+  }
+  CHECK_EQ(robots[0].events, 9 + 3);
+  for (uint8_t i = 0; i < 9; i++) {
+    CHECK_EQ(robots[0].times[i], 1000 + dd_times[i]);
+    CHECK_EQ(robots[0].levels[i], dd_levels[i]);
+  }
+  CHECK_EQ(robots[0].written_size, sizeof(commands));
+  CHECK(memcmp(robots[0].written, commands, sizeof(commands)) == 0);
+  CHECK_EQ(robots[0].times[9], 3800);
+  CHECK_EQ(robots[0].times[10], 3820);
+  CHECK_EQ(robots[0].times[11], 3840);
+  CHECK_EQ(robots[0].host, ROOMBA_115200BPS);
+  CHECK_EQ(now, 3940);
+  CHECK_EQ(bringups[0].total_ms, 2940);
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_WAKE_LOW], 500);
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_WAKE_HIGH], 2000);
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_WAKE_PULSES], 300);
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_START], 20);
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_MODE], 20);
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_BAUD], 100);
+
+  /* no wake-up or baud change; a late poll shows in the probe */
+  memset(robots, 0, sizeof(robots));
+  config.set_dd = NULL;
+  config.mode = ROOMBA_FULL_MODE;
+  config.change_baud = false;
+  now = 0;
+  roomba_bringup_init(&bringups[0], transport, &config, now);
+  CHECK_EQ(robots[0].written_size, 1);
+  CHECK_EQ(robots[0].written[0], ROOMBA_START);
+  CHECK_EQ(roomba_bringup_poll(&bringups[0], now = 10), 20);
+  CHECK_EQ(robots[0].written_size, 1);
+  CHECK_EQ(roomba_bringup_poll(&bringups[0], now = 100), 120);
+  CHECK_EQ(robots[0].written[1], ROOMBA_FULL);
+  roomba_bringup_poll(&bringups[0], now = 120);
+  CHECK(roomba_bringup_done(&bringups[0]));
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_WAKE_LOW], 0);
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_START], 100);
+  CHECK_EQ(bringups[0].probe_ms[ROOMBA_BRINGUP_MODE], 20);
+  CHECK_EQ(bringups[0].total_ms, 120);
+
+  /* two robots from one loop, woken and not */
+  memset(robots, 0, sizeof(robots));
+  now = 0;
+  roomba_bringup_init(&bringups[0], transport, &config, now);
+  config.set_dd = robot_set_dd;
+  transport.context = &robots[1];
+  roomba_bringup_init(&bringups[1], transport, &config, now);
+  CHECK_EQ(roomba_bringup_poll_all(bringups, 2, now), 20);
+  CHECK_EQ(roomba_bringup_poll_all(bringups, 2, now = 20), 40);
+  CHECK_EQ(roomba_bringup_poll_all(bringups, 2, now = 40), 500);
+  CHECK(roomba_bringup_done(&bringups[0]));
+  CHECK(!roomba_bringup_done(&bringups[1]));
+  while (!roomba_bringup_done(&bringups[1])) {
+    now = roomba_bringup_poll_all(bringups, 2, now);
+  }
+  CHECK_EQ(bringups[1].total_ms, 2840);
+  CHECK_EQ(robots[1].written_size, 2);
+  CHECK_EQ(robots[1].written[1], ROOMBA_FULL);
+  CHECK_EQ(roomba_bringup_poll_all(bringups, 2, now), now + 1000);
+
+  return TEST_RESULT();
+}
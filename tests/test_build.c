@@ -0,0 +1,67 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_build.h"
+
+/* built for the selected ROOMBA_INTERFACE_VERSION, see tests/CMakeLists.txt */
+int main(void) {
+  static const uint8_t spin[] = ROOMBA_CMD_DRIVE(-200, ROOMBA_RADIUS_CLOCKWISE);
+  static const uint8_t arc[] = ROOMBA_CMD_DRIVE(500, -2000);
+  static const uint8_t straight[] =
+    ROOMBA_CMD_DRIVE(100, ROOMBA_RADIUS_STRAIGHT_NEGATIVE);
+  static const uint8_t left[] =
+    ROOMBA_CMD_DRIVE(100, ROOMBA_RADIUS_COUNTER_CLOCKWISE);
+  static const uint8_t beep[] = ROOMBA_CMD_SONG(0, 2, 72, 16, 76, 16);
+  static const uint8_t control[] = ROOMBA_CMD_CONTROL;
+  static const uint8_t query[] = ROOMBA_CMD_QUERY_LIST(ROOMBA_VOLTAGE, 100,
+    ROOMBA_BUMPS_WHEELDROPS);
+  static const uint8_t stream[] = ROOMBA_CMD_STREAM(0, 1, 2, 3, 4, 5, 6, 7, 8,
+    9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27,
+    28, 29, 30, 31);
+  static const uint8_t spin_bytes[] = {ROOMBA_DRIVE, 0xFF, 0x38, 0xFF, 0xFF};
+  static const uint8_t arc_bytes[] = {ROOMBA_DRIVE, 0x01, 0xF4, 0xF8, 0x30};
+
+  CHECK(sizeof(spin) == 5 && memcmp(spin, spin_bytes, 5) == 0);
+  CHECK(sizeof(arc) == 5 && memcmp(arc, arc_bytes, 5) == 0);
+  CHECK_EQ(straight[3], 0x80);
+  CHECK_EQ(left[4], 0x01);
+  CHECK_EQ(sizeof(beep), 3 + 4);
+  CHECK(sizeof(control) == 1 && control[0] == ROOMBA_CONTROL);
+  CHECK_EQ(sizeof(query), 2 + 3);
+  CHECK(query[0] == ROOMBA_QUERY_LIST && query[1] == 3);
+  CHECK(query[2] == ROOMBA_VOLTAGE && query[3] == 100 && query[4] == 7);
+  CHECK_EQ(sizeof(stream), 2 + 32);
+  CHECK(stream[0] == ROOMBA_STREAM && stream[1] == 32);
+  CHECK(stream[2] == 0 && stream[33] == 31);
+
+#if ROOMBA_INTERFACE_VERSION==1
+  {
+    /* drive 40 cm and stop, as in the OI manual */
+    static const uint8_t script[] = ROOMBA_CMD_SCRIPT(
+      ROOMBA_DRIVE, 1, 44, 128, 0, WAIT_DISTANCE, 1, 144,
+      ROOMBA_DRIVE, 0, 0, 0, 0);
+    static const uint8_t distance[] = ROOMBA_CMD_WAIT_DISTANCE(-400);
+    static const uint8_t no_bump[] = ROOMBA_CMD_WAIT_EVENT(-5);
+    static const uint8_t outputs[] = ROOMBA_CMD_DIGITAL_OUTPUTS(5);
+    static const uint8_t play[] = ROOMBA_CMD_PLAY_SCRIPT;
+
+    CHECK_EQ(sizeof(script), 2 + 13);
+    CHECK_EQ(script[1], 13);
+    CHECK(distance[0] == WAIT_DISTANCE && distance[1] == 0xFE &&
+      distance[2] == 0x70);
+    CHECK_EQ(no_bump[1], 251);
+    CHECK_EQ(outputs[1], 5);
+    CHECK_EQ(play[0], PLAY_SCRIPT);
+  }
+#else
+  {
+    static const uint8_t digits[] =
+      ROOMBA_CMD_DIGIT_LEDS_ASCII('G', 'O', ' ', '1');
+
+    CHECK_EQ(sizeof(digits), 5);
+    CHECK_EQ(digits[1], 'G');
+  }
+#endif
+
+  return TEST_RESULT();
+}
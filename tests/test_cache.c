@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_cache.h"
+#include "roomba_scheduler.h"
+
+static uint8_t written[256];
+static uint16_t written_size;
+
+static void capture(void *context, const uint8_t data[], uint16_t size) {
+  (void)context;
+  memcpy(&written[written_size], data, size);
+  written_size = (uint16_t)(written_size + size);
+}
+
+int main(void) {
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_QUEUE queue;
+  ROOMBA_SCHEDULER scheduler;
+  ROOMBA_CACHE cache;
+  ROOMBA_PACKET_GROUP_100 frame;
+  ROOMBA_TRANSPORT uart = {capture, NULL};
+  uint8_t other[] = {ROOMBA_QUERY_LIST, 1, ROOMBA_TEMPERATURE};
+  /* temperature for the other query, then the voltage for the cache */
+  uint8_t replies[] = {30, 0x3A, 0x98};
+  uint8_t both[] = {ROOMBA_QUERY_LIST, 2, ROOMBA_VOLTAGE, ROOMBA_TEMPERATURE};
+  uint8_t current[] = {ROOMBA_QUERY_LIST, 1, ROOMBA_CURRENT};
+  /* voltage 14000, temperature 31 */
+  uint8_t reply[] = {0x36, 0xB0, 31};
+  uint16_t value = 0;
+  uint32_t now = 0;
+
+  roomba_stream_init(&parser);
+  roomba_queue_init(&queue);
+  roomba_cache_init(&cache, &parser, &queue, uart, 0);
+  roomba_scheduler_init(&scheduler, &queue, roomba_cache_transport(&cache),
+    ROOMBA_115200BPS);
+  roomba_stream_set_frame_hook(&parser, roomba_cache_frame_hook, &cache);
+
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_VOLTAGE, &value),
+    ROOMBA_CACHE_UNKNOWN);
+
+  /* another user of the queue queries first */
+  CHECK(roomba_queue_push(&queue, other, sizeof(other)));
+  roomba_cache_poll(&cache, 15);
+  roomba_scheduler_tick(&scheduler);
+  CHECK_EQ(written_size, sizeof(other) + 3);
+  CHECK(cache.sent);
+  CHECK_EQ(cache.skip, 1);
+
+  /* the temperature is not taken for the voltage */
+  roomba_cache_receive(&cache, replies, sizeof(replies));
+  CHECK(!cache.sent);
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_VOLTAGE, &value),
+    ROOMBA_CACHE_FRESH);
+  CHECK_EQ(value, 15000);
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_TEMPERATURE, &value),
+    ROOMBA_CACHE_UNKNOWN);
+
+  /* values from a stream frame, fresh until their maximum age */
+  roomba_cache_init(&cache, &parser, &queue, uart, now);
+  roomba_scheduler_init(&scheduler, &queue, roomba_cache_transport(&cache),
+    ROOMBA_115200BPS);
+  memset(&frame, 0, sizeof(frame));
+  frame.voltage = 15000;
+  roomba_cache_observe(&cache, &frame, ROOMBA_PACKET_BIT(ROOMBA_VOLTAGE));
+  roomba_cache_poll(&cache, now += ROOMBA_CACHE_MAX_AGE_MS);
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_VOLTAGE, &value),
+    ROOMBA_CACHE_FRESH);
+  CHECK_EQ(value, 15000);
+  CHECK_EQ(cache.wanted, 0);
+  roomba_cache_poll(&cache, now += 1);
+  value = 0;
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_VOLTAGE, &value),
+    ROOMBA_CACHE_STALE);
+  CHECK_EQ(value, 15000);
+
+  /* callers within one slot share one Query List and its reply */
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_TEMPERATURE, &value),
+    ROOMBA_CACHE_UNKNOWN);
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_VOLTAGE, &value),
+    ROOMBA_CACHE_STALE);
+  roomba_cache_poll(&cache, now += ROOMBA_SLOT_MS);
+  CHECK_EQ(cache.stats.queries, 1);
+  CHECK_EQ(cache.stats.queried_packets, 2);
+  written_size = 0;
+  roomba_scheduler_tick(&scheduler);
+  CHECK_EQ(written_size, sizeof(both));
+  CHECK(memcmp(written, both, sizeof(both)) == 0);
+  /* asked again while the query is out: no second query */
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_TEMPERATURE, &value),
+    ROOMBA_CACHE_UNKNOWN);
+  roomba_cache_poll(&cache, now += 1);
+  CHECK_EQ(cache.stats.queries, 1);
+  roomba_cache_receive(&cache, reply, sizeof(reply));
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_VOLTAGE, &value),
+    ROOMBA_CACHE_FRESH);
+  CHECK_EQ(value, 14000);
+  CHECK_EQ(roomba_get_packet(&cache, ROOMBA_TEMPERATURE, &value),
+    ROOMBA_CACHE_FRESH);
+  CHECK_EQ(value, 31);
+
+  /* no reply: given up after the timeout and asked for again */
+  roomba_cache_request(&cache, ROOMBA_PACKET_BIT(ROOMBA_CURRENT));
+  roomba_cache_poll(&cache, now += ROOMBA_SLOT_MS);
+  written_size = 0;
+  roomba_scheduler_tick(&scheduler);
+  CHECK(memcmp(written, current, sizeof(current)) == 0);
+  roomba_cache_poll(&cache, now += ROOMBA_CACHE_TIMEOUT_MS - 1);
+  CHECK_EQ(cache.stats.timeouts, 0);
+  roomba_cache_poll(&cache, now += 1);
+  CHECK_EQ(cache.stats.timeouts, 1);
+  CHECK_EQ(cache.stats.queries, 3);
+  CHECK(!cache.sent);
+  written_size = 0;
+  roomba_scheduler_tick(&scheduler);
+  CHECK(memcmp(written, current, sizeof(current)) == 0);
+
+  /* a group bit asks for its packets, bits of no packet for nothing */
+  roomba_cache_init(&cache, &parser, &queue, uart, now);
+  roomba_scheduler_init(&scheduler, &queue, roomba_cache_transport(&cache),
+    ROOMBA_115200BPS);
+  roomba_queue_init(&queue);
+  roomba_cache_request(&cache, ROOMBA_PACKET_BIT(60) | ROOMBA_PACKET_BIT(63));
+  for (int i = 0; i < 5; i++) roomba_cache_poll(&cache, now += ROOMBA_SLOT_MS);
+  CHECK_EQ(cache.stats.queries, 0);
+  CHECK_EQ(roomba_queue_depth(&queue), 0);
+  roomba_cache_request(&cache, ROOMBA_PACKET_BIT(2));
+  roomba_cache_poll(&cache, now += ROOMBA_SLOT_MS);
+  CHECK_EQ(cache.stats.queries, 1);
+  CHECK_EQ(cache.stats.queried_packets, 4);
+  CHECK_EQ(roomba_queue_peek(&queue)->data[2], ROOMBA_IR_OPCODE);
+
+  return TEST_RESULT();
+}
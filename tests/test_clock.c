@@ -0,0 +1,63 @@
+#include "test.h"
+#include "roomba_clock.h"
+
+/* the robot ticks 100 ppm slow; frames are seen 1 - 5 ms after they left */
+#define PERIOD_NS (ROOMBA_TICK_NS + 1500)
+#define LATENCY_NS 1000000
+#define FRAMES 3000
+
+static uint32_t seed = 1;
+
+/* 0 - 4 ms of batching delay, none on every 8th frame */
+static int64_t jitter_ns(int64_t tick) {
+  seed = seed * 1103515245u + 12345u;
+  if (tick % 8 == 0) return 0;
+  return (int64_t)(seed >> 8) % 4000000;
+}
+
+int main(void) {
+  ROOMBA_CLOCK clock;
+  int64_t start = 5000000000LL, tick = 0, sent, corrected, error;
+  int64_t worst = 0;
+
+  roomba_clock_init(&clock);
+  CHECK_EQ(roomba_clock_update(&clock, start + LATENCY_NS),
+    start + LATENCY_NS);
+
+  /* once the slope has settled, timestamps follow the earliest arrivals */
+  for (tick = 1; tick < FRAMES; tick++) {
+    sent = start + tick * PERIOD_NS;
+    corrected = roomba_clock_update(&clock, sent + LATENCY_NS +
+      jitter_ns(tick));
+    error = corrected - (sent + LATENCY_NS);
+    if (error < 0) error = -error;
+    if (tick > 10 * ROOMBA_CLOCK_WINDOW && error > worst) worst = error;
+  }
+  CHECK_EQ(clock.tick, FRAMES - 1);
+  CHECK_EQ(clock.lost, 0);
+  CHECK_NEAR(roomba_clock_period(&clock), PERIOD_NS, 100);
+  CHECK(worst < 100000);
+
+  /* three frames lost */
+  tick += 3;
+  sent = start + tick * PERIOD_NS;
+  corrected = roomba_clock_update(&clock, sent + LATENCY_NS);
+  CHECK_EQ(clock.lost, 3);
+  CHECK_EQ(clock.tick, tick);
+  CHECK_NEAR(corrected, sent + LATENCY_NS, 100000);
+
+  /* more than half a period late is taken for a lost frame */
+  tick++;
+  sent = start + tick * PERIOD_NS;
+  roomba_clock_update(&clock, sent + LATENCY_NS + PERIOD_NS / 2 + 500000);
+  CHECK_EQ(clock.lost, 4);
+
+  /* one under half a period is not */
+  roomba_clock_init(&clock);
+  roomba_clock_update(&clock, start);
+  roomba_clock_update(&clock, start + PERIOD_NS + PERIOD_NS / 2 - 500000);
+  CHECK_EQ(clock.lost, 0);
+  CHECK_EQ(clock.tick, 1);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,81 @@
+#include "test.h"
+#include "roomba_build.h"
+
+#define VALID(...) \
+  is_valid_roomba_command((uint8_t[]){ __VA_ARGS__ }, \
+    sizeof((uint8_t[]){ __VA_ARGS__ }))
+
+/* the same for the initializers of roomba_build.h */
+#define VALID_CMD(...) \
+  is_valid_roomba_command((uint8_t[])__VA_ARGS__, \
+    sizeof((uint8_t[])__VA_ARGS__))
+
+int main(void) {
+  /* every opcode without data */
+  CHECK(VALID(ROOMBA_RESET));
+  CHECK(VALID(ROOMBA_START));
+  CHECK(VALID(ROOMBA_SAFE));
+  CHECK(VALID(ROOMBA_FULL));
+  CHECK(VALID(ROOMBA_POWER));
+  CHECK(VALID(ROOMBA_SPOT));
+  CHECK(VALID(ROOMBA_SEEK_DOCK));
+  CHECK(!VALID(ROOMBA_SAFE, 0));
+
+  CHECK(VALID_CMD(ROOMBA_CMD_DRIVE(-500, ROOMBA_RADIUS_STRAIGHT_POSITIVE)));
+  CHECK(!VALID(ROOMBA_DRIVE, 0x01, 0xF5, 0, 0));
+  CHECK(VALID_CMD(ROOMBA_CMD_BAUD(11)));
+  CHECK(!VALID(ROOMBA_BAUD, 12));
+  CHECK(VALID_CMD(ROOMBA_CMD_MOTORS(7)));
+  CHECK(!VALID(ROOMBA_MOTORS, 32));
+  CHECK(VALID_CMD(ROOMBA_CMD_LEDS(10, 128, 255)));
+  CHECK(!VALID(ROOMBA_LEDS, 10, 128));
+  CHECK(VALID_CMD(ROOMBA_CMD_PWM_MOTORS(-127, 127, 127)));
+  CHECK(!VALID(ROOMBA_PWM_MOTORS, 0x80, 0, 0));
+  CHECK(!VALID(ROOMBA_PWM_MOTORS, 0, 0, 128));
+
+  /* songs: the length byte has to match the notes */
+  CHECK(VALID_CMD(ROOMBA_CMD_SONG(0, 2, 60, 32, 64, 32)));
+  CHECK(!VALID(ROOMBA_SONG, 0, 2, 60, 32));
+  CHECK(!VALID(ROOMBA_SONG, 0, 0));
+  CHECK(!VALID(ROOMBA_SONG, ROOMBA_SONG_NUMBERS, 1, 60, 32));
+  CHECK(VALID_CMD(ROOMBA_CMD_PLAY(0)));
+  CHECK(!VALID(ROOMBA_PLAY, ROOMBA_SONG_NUMBERS));
+
+  /* packet lists */
+  CHECK(VALID_CMD(ROOMBA_CMD_SENSORS(100)));
+  CHECK(!VALID(ROOMBA_SENSORS, 59));
+  CHECK(VALID_CMD(ROOMBA_CMD_QUERY_LIST(7, 22, 106)));
+  CHECK(!VALID(ROOMBA_QUERY_LIST, 2, 7));
+  CHECK(!VALID(ROOMBA_QUERY_LIST, 1, 200));
+  CHECK(VALID_CMD(ROOMBA_CMD_STREAM(100)));
+  CHECK(!VALID(ROOMBA_STREAM, 0));
+  CHECK(VALID_CMD(ROOMBA_CMD_PAUSE_RESUME_STREAM(true)));
+  CHECK(!VALID(ROOMBA_PAUSE_RESUME_STREAM, 2));
+
+#if ROOMBA_INTERFACE_VERSION==2
+  CHECK(VALID_CMD(ROOMBA_CMD_STOP));
+  CHECK(VALID_CMD(ROOMBA_CMD_DIGIT_LEDS_ASCII('R', 'O', 'O', 'M')));
+  CHECK(!VALID(ROOMBA_DIGIT_LEDS_ASCII, 'R', 'O', 'O', 10));
+  CHECK(VALID_CMD(ROOMBA_CMD_SET_DAY_TIME(6, 23, 59)));
+  CHECK(!VALID(ROOMBA_SET_DAY_TIME, 7, 0, 0));
+  CHECK(VALID_CMD(ROOMBA_CMD_SCHEDULE(0x7F, 9, 0, 9, 0, 9, 0, 9, 0, 9, 0, 9, 0,
+    9, 30)));
+  CHECK(!VALID(ROOMBA_SCHEDULE, 0x7F, 24, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0));
+#else
+  CHECK(VALID_CMD(ROOMBA_CMD_DEMO(-1)));
+  CHECK(!VALID(ROOMBA_DEMO, 10));
+  CHECK(VALID_CMD(ROOMBA_CMD_SCRIPT(ROOMBA_DRIVE, 0, 100, 0, 0,
+    WAIT_DISTANCE, 0x01, 0xF4)));
+  CHECK(VALID_CMD(ROOMBA_CMD_SCRIPT_CLEAR));
+  CHECK(!VALID(SCRIPT, 2, 137));
+  CHECK(VALID_CMD(ROOMBA_CMD_WAIT_EVENT(-22)));
+  CHECK(!VALID(WAIT_EVENT, 0));
+#endif
+
+  /* not an opcode */
+  CHECK(!VALID(0));
+  CHECK(!VALID(200));
+
+  return TEST_RESULT();
+}
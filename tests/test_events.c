@@ -0,0 +1,101 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_events.h"
+
+typedef struct {
+  uint8_t bit;
+  bool state;
+} EVENT;
+
+static EVENT events[16];
+static uint8_t event_count;
+
+static void record(ROOMBA_EVENT_BIT bit, bool state, void *context) {
+  CHECK(context == events);
+  if (event_count < 16) {
+    events[event_count].bit = (uint8_t)bit;
+    events[event_count].state = state;
+    event_count++;
+  }
+}
+
+static const ROOMBA_EVENT_HANDLER handlers[ROOMBA_EVENT_COUNT] = {
+  [ROOMBA_EVENT_BUMP_LEFT] = record,
+  [ROOMBA_EVENT_WHEEL_DROP_RIGHT] = record,
+  [ROOMBA_EVENT_CLIFF_FRONT_LEFT] = record,
+  [ROOMBA_EVENT_BUTTON_CLEAN] = record,
+  [ROOMBA_EVENT_LIGHT_BUMPER_RIGHT] = record,
+};
+
+int main(void) {
+  ROOMBA_EVENT_ENGINE engine;
+  ROOMBA_PACKET_GROUP_100 frame;
+
+  roomba_events_init(&engine, handlers, events);
+  CHECK_EQ(engine.mask, ROOMBA_EVENT_MASK(ROOMBA_EVENT_BUMP_LEFT) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_WHEEL_DROP_RIGHT) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_CLIFF_FRONT_LEFT) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_BUTTON_CLEAN) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_LIGHT_BUMPER_RIGHT));
+
+  /* every packet lands on its bits */
+  memset(&frame, 0, sizeof(frame));
+  frame.bumps_wheeldrops = 0x02;
+  frame.cliff_front_left = 1;
+  frame.virtual_wall = 1;
+  frame.overcurrents = 0x10;
+  frame.buttons_pkt = 0x81;
+  frame.light_bumper = 0x20;
+  CHECK_EQ(roomba_events_pack(&frame),
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_BUMP_LEFT) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_CLIFF_FRONT_LEFT) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_VIRTUAL_WALL) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_OVERCURRENT_LEFT_WHEEL) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_BUTTON_CLEAN) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_BUTTON_CLOCK) |
+    ROOMBA_EVENT_MASK(ROOMBA_EVENT_LIGHT_BUMPER_RIGHT));
+
+  /* bits set in the first frame rise, lowest first; unwatched are quiet */
+  roomba_events_update(&engine, roomba_events_pack(&frame));
+  CHECK_EQ(event_count, 4);
+  CHECK_EQ(events[0].bit, ROOMBA_EVENT_BUMP_LEFT);
+  CHECK_EQ(events[1].bit, ROOMBA_EVENT_CLIFF_FRONT_LEFT);
+  CHECK_EQ(events[2].bit, ROOMBA_EVENT_BUTTON_CLEAN);
+  CHECK_EQ(events[3].bit, ROOMBA_EVENT_LIGHT_BUMPER_RIGHT);
+  for (int i = 0; i < 4; i++) CHECK(events[i].state);
+
+  /* held bits and unwatched changes report nothing */
+  event_count = 0;
+  frame.virtual_wall = 0;
+  frame.overcurrents = 0;
+  frame.buttons_pkt = 0x01;
+  for (int i = 0; i < 5; i++) {
+    roomba_events_update(&engine, roomba_events_pack(&frame));
+  }
+  CHECK_EQ(event_count, 0);
+
+  /* a rising and a falling edge in the same frame */
+  frame.bumps_wheeldrops = 0x04;
+  roomba_events_update(&engine, roomba_events_pack(&frame));
+  CHECK_EQ(event_count, 2);
+  CHECK_EQ(events[0].bit, ROOMBA_EVENT_BUMP_LEFT);
+  CHECK(!events[0].state);
+  CHECK_EQ(events[1].bit, ROOMBA_EVENT_WHEEL_DROP_RIGHT);
+  CHECK(events[1].state);
+
+  /* no debouncing: a one frame glitch is a rise and a fall */
+  event_count = 0;
+  frame.cliff_front_left = 0;
+  roomba_events_update(&engine, roomba_events_pack(&frame));
+  frame.cliff_front_left = 1;
+  roomba_events_update(&engine, roomba_events_pack(&frame));
+  roomba_events_update(&engine, roomba_events_pack(&frame));
+  CHECK_EQ(event_count, 2);
+  CHECK_EQ(events[0].bit, ROOMBA_EVENT_CLIFF_FRONT_LEFT);
+  CHECK(!events[0].state);
+  CHECK_EQ(events[1].bit, ROOMBA_EVENT_CLIFF_FRONT_LEFT);
+  CHECK(events[1].state);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+
+#include <string.h>
+
+#include "test.h"
+#include "roomba_executor.h"
+
+#define STRANDS 4
+#define FRAMES 2000
+#define CHILDREN 64
+
+static ROOMBA_EXECUTOR executor;
+
+typedef struct {
+  ROOMBA_STRAND strand;
+  uint16_t next;
+  volatile uint32_t handled;
+  uint32_t out_of_order;
+  uint32_t overlaps;
+  int inside;
+} ROBOT;
+
+static void ordered(ROOMBA_STRAND *strand, const ROOMBA_PACKET_GROUP_100 *frame,
+  void *context) {
+  ROBOT *robot = context;
+
+  (void)strand;
+  if (__atomic_exchange_n(&robot->inside, 1, __ATOMIC_SEQ_CST)) {
+    robot->overlaps++;
+  }
+  if (frame->voltage != robot->next) robot->out_of_order++;
+  robot->next = (uint16_t)(frame->voltage + 1);
+  robot->handled++;
+  __atomic_store_n(&robot->inside, 0, __ATOMIC_SEQ_CST);
+}
+
+/* a task that queues work on its own worker, for the others to steal */
+static ROOMBA_TASK children[CHILDREN];
+static volatile uint32_t child_runs;
+
+static void run_child(ROOMBA_TASK *task) {
+  (void)task;
+  sleep_us(500);
+  __atomic_add_fetch(&child_runs, 1, __ATOMIC_SEQ_CST);
+}
+
+static void run_parent(ROOMBA_TASK *task) {
+  (void)task;
+  for (int i = 0; i < CHILDREN; i++) {
+    children[i].run = run_child;
+    roomba_executor_submit(&executor, &children[i]);
+  }
+}
+
+static volatile uint64_t a_frames, b_frames;
+
+static void busy(ROOMBA_STRAND *strand, const ROOMBA_PACKET_GROUP_100 *frame,
+  void *context) {
+  uint64_t until = 0;
+  struct timespec now;
+
+  (void)strand;
+  (void)frame;
+  (void)context;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  until = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec +
+    2000000u;
+  do {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+  } while ((uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec < until);
+  a_frames++;
+}
+
+static void once(ROOMBA_STRAND *strand, const ROOMBA_PACKET_GROUP_100 *frame,
+  void *context) {
+  (void)strand;
+  (void)frame;
+  (void)context;
+  b_frames++;
+}
+
+int main(void) {
+  static ROBOT robots[STRANDS];
+  static ROOMBA_STRAND a, b;
+  ROOMBA_PACKET_GROUP_100 frame;
+  ROOMBA_EXECUTOR_STATS stats;
+  ROOMBA_TASK parent = {run_parent};
+  uint64_t steals = 0, attempts = 0;
+
+  memset(&frame, 0, sizeof(frame));
+
+  /* every strand handles its frames in order, never on two workers at once */
+  CHECK_EQ(roomba_executor_start(&executor, 2, -1), 0);
+  for (int r = 0; r < STRANDS; r++) {
+    roomba_strand_init(&robots[r].strand, &executor, ordered, &robots[r]);
+  }
+  for (uint16_t n = 0; n < FRAMES; n++) {
+    for (int r = 0; r < STRANDS; r++) {
+      ROOMBA_STRAND *strand = &robots[r].strand;
+      while (strand->head - __atomic_load_n(&strand->tail, __ATOMIC_ACQUIRE) >=
+             ROOMBA_STRAND_FRAMES) {
+        sleep_us(50);
+      }
+      frame.voltage = n;
+      CHECK(roomba_strand_post(strand, &frame));
+    }
+  }
+  for (int i = 0; i < 1000; i++) {
+    bool done = true;
+    for (int r = 0; r < STRANDS; r++) done &= robots[r].handled == FRAMES;
+    if (done) break;
+    sleep_ms(1);
+  }
+  for (int r = 0; r < STRANDS; r++) {
+    CHECK_EQ(robots[r].handled, FRAMES);
+    CHECK_EQ(robots[r].out_of_order, 0);
+    CHECK_EQ(robots[r].overlaps, 0);
+    CHECK_EQ(robots[r].strand.dropped, 0);
+  }
+
+  /* tasks one worker queues for itself are stolen by the idle one */
+  CHECK(roomba_executor_submit(&executor, &parent));
+  for (int i = 0; i < 1000 && child_runs < CHILDREN; i++) sleep_ms(1);
+  CHECK_EQ(child_runs, CHILDREN);
+  for (uint8_t w = 0; w < 2; w++) {
+    roomba_executor_stats(&executor, w, &stats);
+    steals += stats.steals;
+    attempts += stats.steal_attempts;
+  }
+  CHECK(steals > 0);
+  CHECK(attempts >= steals);
+  roomba_executor_stop(&executor);
+
+  /* one worker, a strand always busy: another strand still gets its turn */
+  CHECK_EQ(roomba_executor_start(&executor, 1, -1), 0);
+  roomba_strand_init(&a, &executor, busy, NULL);
+  roomba_strand_init(&b, &executor, once, NULL);
+  roomba_strand_post(&a, &frame);
+  sleep_us(100);
+  roomba_strand_post(&b, &frame);
+  for (int i = 0; i < 2000 && b_frames == 0; i++) {
+    roomba_strand_post(&a, &frame);
+    sleep_us(100);
+  }
+  CHECK_EQ(b_frames, 1);
+  CHECK(a_frames > 0);
+  roomba_executor_stop(&executor);
+
+  return TEST_RESULT();
+}
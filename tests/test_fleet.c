@@ -0,0 +1,127 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "roomba_fleet.h"
+
+#define WORKERS 2
+
+static volatile void *last_context;
+static volatile uint32_t frames;
+static volatile bool hold, held;
+
+static void on_frame(ROOMBA_FLEET_ROBOT *robot,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  (void)frame;
+  (void)context;
+  last_context = robot->context;
+  frames++;
+  /* keeps the worker from draining its mailbox */
+  held = hold;
+  while (hold) sleep_ms(1);
+}
+
+/* [19][2][7 bumps][0] and its checksum */
+static void send_frame(int fd) {
+  static const uint8_t frame[] = {19, 2, 7, 0, (uint8_t)-(19 + 2 + 7)};
+  ssize_t written = write(fd, frame, sizeof(frame));
+
+  (void)written;
+}
+
+static bool wait_frames(uint32_t count) {
+  for (int i = 0; i < 200 && frames < count; i++) sleep_ms(1);
+  return frames >= count;
+}
+
+int main(void) {
+  static ROOMBA_FLEET fleet;
+  ROOMBA_FLEET_CONFIG config;
+  ROOMBA_FLEET_HANDLE handles[WORKERS * ROOMBA_FLEET_WORKER_ROBOTS];
+  int peers[WORKERS * ROOMBA_FLEET_WORKER_ROBOTS];
+  uint8_t drive[] = {ROOMBA_DRIVE_DIRECT, 0, 100, 0, 100};
+  int contexts[3], pair[2], flags, posted = 0, added;
+  char byte;
+
+  memset(&config, 0, sizeof(config));
+  config.workers = WORKERS;
+  config.first_cpu = -1;
+  config.on_frame = on_frame;
+  CHECK_EQ(roomba_fleet_start(&fleet, &config), 0);
+
+  /* each robot goes to the worker with the fewest, the port non blocking */
+  for (int i = 0; i < 3; i++) {
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    handles[i] = roomba_fleet_add(&fleet, pair[0], ROOMBA_115200BPS,
+      &contexts[i]);
+    peers[i] = pair[1];
+    flags = fcntl(pair[0], F_GETFL);
+    CHECK(flags & O_NONBLOCK);
+  }
+  CHECK_EQ(handles[0], 0);
+  CHECK_EQ(handles[1], ROOMBA_FLEET_WORKER_ROBOTS);
+  CHECK_EQ(handles[2], 1);
+  send_frame(peers[1]);
+  CHECK(wait_frames(1));
+  CHECK(last_context == &contexts[1]);
+
+  /* removed: the worker closes the port, the handle is free again */
+  CHECK_EQ(roomba_fleet_remove(&fleet, handles[0]), 0);
+  CHECK_EQ(roomba_fleet_command(&fleet, handles[0], drive, sizeof(drive)), -1);
+  CHECK_EQ(errno, EINVAL);
+  CHECK_EQ(roomba_fleet_remove(&fleet, handles[0]), -1);
+  CHECK(read(peers[0], &byte, 1) == 0);
+  close(peers[0]);
+
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+  CHECK_EQ(roomba_fleet_add(&fleet, pair[0], ROOMBA_115200BPS, &contexts[0]),
+    handles[0]);
+  peers[0] = pair[1];
+  send_frame(peers[0]);
+  CHECK(wait_frames(2));
+  CHECK(last_context == &contexts[0]);
+
+  /* a worker stuck in its hook: its mailbox fills, then EAGAIN */
+  hold = true;
+  send_frame(peers[0]);
+  for (int i = 0; i < 200 && !held; i++) sleep_ms(1);
+  CHECK(held);
+  while (roomba_fleet_command(&fleet, handles[0], drive, sizeof(drive)) == 0) {
+    posted++;
+    if (posted > ROOMBA_FLEET_MAILBOX) break;
+  }
+  CHECK_EQ(errno, EAGAIN);
+  CHECK_EQ(posted, ROOMBA_FLEET_MAILBOX);
+  hold = false;
+  for (int i = 0; i < 200; i++) {
+    if (roomba_fleet_command(&fleet, handles[0], drive, sizeof(drive)) == 0) {
+      break;
+    }
+    sleep_ms(1);
+  }
+  CHECK_EQ(roomba_fleet_command(&fleet, handles[0], drive, sizeof(drive)), 0);
+
+  /* every slot of every worker taken: EAGAIN */
+  for (added = 3; added < WORKERS * ROOMBA_FLEET_WORKER_ROBOTS; added++) {
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    handles[added] = roomba_fleet_add(&fleet, pair[0], ROOMBA_115200BPS, NULL);
+    peers[added] = pair[1];
+    CHECK(handles[added] >= 0);
+    /* give the workers time for their mailboxes */
+    if (added % 16 == 0) sleep_ms(5);
+  }
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+  CHECK_EQ(roomba_fleet_add(&fleet, pair[0], ROOMBA_115200BPS, NULL), -1);
+  CHECK_EQ(errno, EAGAIN);
+  close(pair[0]);
+  close(pair[1]);
+
+  roomba_fleet_stop(&fleet);
+  for (int i = 0; i < added; i++) close(peers[i]);
+  return TEST_RESULT();
+}
@@ -0,0 +1,106 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "heap.h"
+#include "test.h"
+#include "roomba_fleet.h"
+
+#define FRAMES 400
+
+static volatile uint32_t frames, events, records, commands;
+static volatile const ROOMBA_PACKET_GROUP_100 *last;
+
+static void on_frame(ROOMBA_FLEET_ROBOT *robot,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  ROOMBA_ARENA *arena = roomba_fleet_arena(robot);
+  uint8_t drive[] = {ROOMBA_DRIVE_DIRECT, 0, 100, 0, 100};
+  ROOMBA_COMMAND *command = roomba_arena_command(arena, drive, sizeof(drive));
+  uint32_t *record = ROOMBA_ARENA_NEW(arena, uint32_t);
+
+  (void)context;
+  /* the snapshot lives in the arena, not in the parser */
+  if ((const void *)frame != (const void *)&robot->parser.frame) last = frame;
+  if (record) {
+    *record = frame->bumps_wheeldrops;
+    records++;
+  }
+  if (command && roomba_queue_push(&robot->queue, command->data,
+      command->size)) {
+    commands++;
+  }
+  frames++;
+}
+
+static void on_events(const ROOMBA_FLEET_EVENT *event, void *context) {
+  (void)context;
+  for (; event; event = event->next) events++;
+}
+
+/* [19][2][7 bumps][value] and its checksum */
+static void send_frame(int fd, uint8_t bumps) {
+  uint8_t frame[] = {19, 2, 7, bumps, 0};
+  ssize_t written;
+
+  frame[4] = (uint8_t)-(19 + 2 + 7 + bumps);
+  written = write(fd, frame, sizeof(frame));
+  (void)written;
+}
+
+int main(void) {
+  static ROOMBA_FLEET fleet;
+  ROOMBA_FLEET_CONFIG config;
+  ROOMBA_FLEET_WORKER_STATS stats;
+  uint32_t calls, sent;
+  int pair[2];
+  char drain[256];
+  void *probe;
+
+  probe = malloc(16);
+  free(probe);
+  CHECK_EQ(heap_calls, 2);
+
+  memset(&config, 0, sizeof(config));
+  config.workers = 1;
+  config.first_cpu = -1;
+  config.on_frame = on_frame;
+  config.on_events = on_events;
+  CHECK_EQ(roomba_fleet_start(&fleet, &config), 0);
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair) == 0);
+  CHECK(roomba_fleet_add(&fleet, pair[0], ROOMBA_115200BPS, NULL) >= 0);
+
+  /* warm up: threads, timers and the first ticks */
+  for (int i = 0; i < 20; i++) {
+    send_frame(pair[1], 0);
+    sleep_ms(ROOMBA_SLOT_MS);
+  }
+
+  /* steady state: frames, events, records and commands, no heap */
+  calls = heap_calls;
+  sent = frames;
+  for (int i = 0; i < FRAMES; i++) {
+    send_frame(pair[1], (uint8_t)(i & 1));
+    if (i % 8 == 0) sleep_ms(2);
+    while (read(pair[1], drain, sizeof(drain)) > 0) continue;
+  }
+  for (int i = 0; i < 100 && frames - sent < FRAMES; i++) sleep_ms(5);
+  sleep_ms(3 * ROOMBA_SLOT_MS);
+  CHECK_EQ(heap_calls - calls, 0);
+
+  CHECK_EQ(frames - sent, FRAMES);
+  CHECK(last != NULL);
+  CHECK(events >= FRAMES - 1);
+  CHECK(records >= FRAMES);
+  CHECK(commands > 0);
+  roomba_fleet_stats(&fleet, &stats);
+  CHECK(stats.arena_peak > 0);
+  CHECK_EQ(stats.arena_failures, 0);
+
+  roomba_fleet_stop(&fleet);
+  close(pair[1]);
+  return TEST_RESULT();
+}
@@ -0,0 +1,109 @@
+#include <string.h>
+
+#include "light_scalar.h"
+#include "test.h"
+
+#define SAMPLES 20000
+
+static uint16_t raw[ROOMBA_LIGHT_CHANNELS][SAMPLES];
+static uint16_t filtered[ROOMBA_LIGHT_CHANNELS][SAMPLES];
+static uint8_t detected[SAMPLES];
+
+static uint32_t seed = 12345;
+
+static uint16_t random16(void) {
+  seed = seed * 1103515245u + 12345u;
+  return (uint16_t)(seed >> 16);
+}
+
+/* a slow sweep with noise, the odd spike and values past the clamp */
+static uint16_t signal(uint8_t channel, uint32_t n) {
+  uint16_t r = random16();
+  uint32_t level = (n / 7 + channel * 500u) % 1000u;
+
+  if ((r & 63) == 0) return (uint16_t)(r | 0x8000);
+  return (uint16_t)(level + (r & 127));
+}
+
+int main(void) {
+  ROOMBA_LIGHT_FILTER vector, scalar, batch;
+  const uint16_t *columns[ROOMBA_LIGHT_CHANNELS];
+  uint16_t *outputs[ROOMBA_LIGHT_CHANNELS];
+
+  roomba_light_filter_init(&vector, 600, 400);
+  scalar_light_filter_init(&scalar, 600, 400);
+  roomba_light_filter_init(&batch, 600, 400);
+  roomba_light_filter_set_thresholds(&vector, 5, 900, 100);
+  scalar_light_filter_set_thresholds(&scalar, 5, 900, 100);
+  roomba_light_filter_set_thresholds(&batch, 5, 900, 100);
+
+  for (uint32_t n = 0; n < SAMPLES; n++) {
+    for (uint8_t c = 0; c < ROOMBA_LIGHT_CHANNELS; c++) {
+      raw[c][n] = signal(c, n);
+    }
+  }
+  for (uint8_t c = 0; c < ROOMBA_LIGHT_CHANNELS; c++) {
+    columns[c] = raw[c];
+    outputs[c] = filtered[c];
+  }
+  roomba_light_filter_batch(&batch, columns, outputs, detected, SAMPLES);
+
+  /* the vector and scalar builds and the batch agree on every sample */
+  for (uint32_t n = 0; n < SAMPLES; n++) {
+    uint16_t sample[ROOMBA_LIGHT_CHANNELS];
+    uint8_t v, s;
+    for (uint8_t c = 0; c < ROOMBA_LIGHT_CHANNELS; c++) sample[c] = raw[c][n];
+    v = roomba_light_filter_update(&vector, sample);
+    s = scalar_light_filter_update(&scalar, sample);
+    CHECK_EQ(v, s);
+    CHECK_EQ(v, detected[n]);
+    CHECK(memcmp(vector.filtered, scalar.filtered,
+      sizeof(vector.filtered)) == 0);
+    for (uint8_t c = 0; c < ROOMBA_LIGHT_CHANNELS; c++) {
+      CHECK_EQ(vector.filtered[c], filtered[c][n]);
+    }
+    if (test_failures) break;
+  }
+  CHECK(memcmp(&vector, &scalar, sizeof(vector)) == 0);
+
+  /* the data reaches both sides of the thresholds */
+  CHECK_EQ(vector.detected, scalar.detected);
+  {
+    uint8_t seen = 0, missed = 0;
+    for (uint32_t n = 0; n < SAMPLES; n++) {
+      seen |= detected[n];
+      missed |= (uint8_t)~detected[n];
+    }
+    CHECK_EQ(seen & ROOMBA_LIGHT_ALL, ROOMBA_LIGHT_ALL);
+    CHECK_EQ(missed & ROOMBA_LIGHT_ALL, ROOMBA_LIGHT_ALL);
+  }
+
+  /*
+   * Worked by hand for channel 0, on at 200 and off below 120: the spike
+   * never leaves the median, the step to 300 reaches the average over four
+   * samples, 150 holds the channel on and 100 turns it off. Channel 1 sits
+   * past the clamp.
+   */
+  {
+    static const uint16_t input[] = {100, 100, 3000, 100, 300, 300, 300, 300,
+      150, 150, 150, 150, 150, 150, 100, 100, 100, 100};
+    static const uint16_t average[] = {100, 100, 100, 100, 150, 200, 250, 300,
+      300, 262, 225, 187, 150, 150, 150, 137, 125, 112};
+    static const uint8_t on[] = {0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+      1, 1, 0};
+    uint16_t sample[ROOMBA_LIGHT_CHANNELS] = {0, 5000, 0, 0, 0, 0};
+
+    roomba_light_filter_init(&vector, 200, 120);
+    scalar_light_filter_init(&scalar, 200, 120);
+    for (uint8_t n = 0; n < sizeof(input) / sizeof(input[0]); n++) {
+      sample[0] = input[n];
+      CHECK_EQ(roomba_light_filter_update(&vector, sample), on[n] | 0x02);
+      CHECK_EQ(scalar_light_filter_update(&scalar, sample), on[n] | 0x02);
+      CHECK_EQ(vector.filtered[0], average[n]);
+      CHECK_EQ(scalar.filtered[0], average[n]);
+      CHECK_EQ(vector.filtered[1], ROOMBA_LIGHT_MAX);
+    }
+  }
+
+  return TEST_RESULT();
+}
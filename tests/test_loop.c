@@ -0,0 +1,43 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "roomba_loop.h"
+
+static uint32_t frames;
+
+static void controller(const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  (void)frame;
+  (void)context;
+  frames++;
+}
+
+int main(void) {
+  ROOMBA_LOOP loop;
+  ROOMBA_LOOP_CONFIG config;
+  /* [19][2][7 bumps][3] and its checksum */
+  uint8_t frame[] = {19, 2, 7, 3, 0};
+  int fds[2];
+
+  frame[4] = (uint8_t)-(19 + 2 + 7 + 3);
+  CHECK(pipe(fds) == 0);
+  memset(&config, 0, sizeof(config));
+  config.fd = fds[0];
+  config.cpu = -1;
+  config.controller = controller;
+  CHECK(roomba_loop_init(&loop, &config) == 0);
+
+  /* the frame is handled, then the hang-up ends the loop instead of spinning */
+  CHECK(write(fds[1], frame, sizeof(frame)) == sizeof(frame));
+  close(fds[1]);
+  CHECK(roomba_loop_run(&loop) == -1);
+  CHECK_EQ(errno, EPIPE);
+  CHECK_EQ(frames, 1);
+
+  roomba_loop_close(&loop);
+  close(fds[0]);
+  return TEST_RESULT();
+}
@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_safety.h"
+#include "roomba_scheduler.h"
+
+static uint16_t written;
+
+static void count_write(void *context, const uint8_t data[], uint16_t size) {
+  (void)context;
+  (void)data;
+  written = (uint16_t)(written + size);
+}
+
+static uint32_t clock_zero(void) {
+  return 0;
+}
+
+int main(void) {
+  ROOMBA_MODE_TRACKER tracker;
+  ROOMBA_QUEUE queue;
+  ROOMBA_SCHEDULER scheduler;
+  ROOMBA_SAFETY safety;
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_TRANSPORT transport = {count_write, NULL};
+  uint8_t safe[] = {ROOMBA_SAFE};
+  uint8_t start[] = {ROOMBA_START};
+  uint8_t drive[] = {ROOMBA_DRIVE_DIRECT, 0, 100, 0, 100};
+
+  /* a mode only inferred from sent commands does not skip Safe */
+  roomba_mode_init(&tracker);
+  CHECK_EQ(roomba_mode_filter(&tracker, start, 1), ROOMBA_MODE_SEND);
+  CHECK_EQ(roomba_mode_filter(&tracker, safe, 1), ROOMBA_MODE_SEND);
+  CHECK_EQ(roomba_mode_filter(&tracker, safe, 1), ROOMBA_MODE_SEND);
+  CHECK_EQ(tracker.skipped, 0);
+
+  /* once packet 35 confirms it, it does */
+  roomba_mode_observe(&tracker, ROOMBA_SAFE_MODE);
+  CHECK_EQ(roomba_mode_filter(&tracker, safe, 1), ROOMBA_MODE_SKIP);
+  CHECK_EQ(roomba_mode_filter(&tracker, drive, sizeof(drive)),
+    ROOMBA_MODE_SEND);
+
+  /* the robot fell back to Passive on its own */
+  roomba_mode_observe(&tracker, ROOMBA_PASSIVE_MODE);
+  CHECK_EQ(tracker.corrections, 1);
+  CHECK_EQ(roomba_mode_filter(&tracker, drive, sizeof(drive)),
+    ROOMBA_MODE_REJECT);
+  CHECK_EQ(roomba_mode_filter(&tracker, safe, 1), ROOMBA_MODE_SEND);
+
+  /* a safety stop forgets the mode */
+  memset(&parser, 0, sizeof(parser));
+  roomba_safety_init(&safety, transport, clock_zero, false);
+  roomba_safety_set_mode_tracker(&safety, &tracker);
+  roomba_mode_observe(&tracker, ROOMBA_SAFE_MODE);
+  parser.work.cliff_left = 1;
+  roomba_safety_packet_hook(&parser, ROOMBA_CLIFF_LEFT, &safety);
+  CHECK_EQ(safety.trips, 1);
+  CHECK(!tracker.known);
+  CHECK_EQ(roomba_mode_filter(&tracker, safe, 1), ROOMBA_MODE_SEND);
+
+  /* filtered commands are not counted as sent */
+  roomba_queue_init(&queue);
+  roomba_scheduler_init(&scheduler, &queue, transport, ROOMBA_115200BPS);
+  roomba_scheduler_set_mode_tracker(&scheduler, &tracker);
+  roomba_mode_observe(&tracker, ROOMBA_PASSIVE_MODE);
+  written = 0;
+  CHECK(roomba_queue_push(&queue, drive, sizeof(drive)));
+  roomba_scheduler_tick(&scheduler);
+  CHECK_EQ(written, 0);
+  CHECK_EQ(scheduler.stats.filtered, 1);
+  CHECK_EQ(queue.stats.sent, 0);
+  CHECK_EQ(queue.stats.expired, 1);
+
+  /* Safe then Drive in one slot: the Drive is checked in Safe, not Passive */
+  written = 0;
+  CHECK(roomba_queue_push(&queue, safe, sizeof(safe)));
+  CHECK(roomba_queue_push(&queue, drive, sizeof(drive)));
+  roomba_scheduler_tick(&scheduler);
+  CHECK_EQ(written, sizeof(safe) + sizeof(drive));
+  CHECK_EQ(scheduler.stats.filtered, 1);
+  CHECK_EQ(queue.stats.sent, 2);
+  CHECK_EQ(tracker.mode, ROOMBA_SAFE_MODE);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,192 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "roomba_mux.h"
+
+#define CLIENTS 20
+
+static ROOMBA_MUX mux;
+static int run_result, run_errno;
+
+static void *run(void *context) {
+  (void)context;
+  run_result = roomba_mux_run(&mux);
+  run_errno = errno;
+  return NULL;
+}
+
+static int connect_client(const char *path) {
+  struct sockaddr_un address;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) return -1;
+  return fd;
+}
+
+static void send_message(int fd, uint8_t type, const uint8_t payload[],
+  uint8_t size) {
+  uint8_t message[ROOMBA_MUX_MESSAGE_MAX];
+
+  message[0] = type;
+  message[1] = size;
+  memcpy(&message[2], payload, size);
+  CHECK(write(fd, message, 2 + size) == 2 + size);
+}
+
+/* reads until want bytes arrived or nothing more comes */
+static size_t receive(int fd, uint8_t buffer[], size_t size, size_t want) {
+  size_t got = 0;
+
+  for (int idle = 0; idle < 20 && got < want; idle++) {
+    ssize_t n = recv(fd, &buffer[got], size - got, MSG_DONTWAIT);
+    if (n > 0) {
+      got += (size_t)n;
+      idle = 0;
+      continue;
+    }
+    sleep_ms(5);
+  }
+  return got;
+}
+
+/* the last Stream among the commands the robot received, its ids in ids */
+static uint8_t last_stream(const uint8_t data[], size_t size, uint8_t ids[]) {
+  uint8_t count = 0;
+
+  for (size_t at = 0; at < size;) {
+    uint8_t opcode = data[at];
+    size_t length;
+    if (opcode == ROOMBA_STREAM || opcode == ROOMBA_QUERY_LIST) {
+      length = 2 + (size_t)data[at + 1];
+    } else {
+      length = 1 + (size_t)get_command_data_bytes((ROOMBA_OP_CODE)opcode);
+    }
+    if (opcode == ROOMBA_STREAM) {
+      count = data[at + 1];
+      memcpy(ids, &data[at + 2], count);
+    }
+    at += length;
+  }
+  return count;
+}
+
+int main(void) {
+  /* bumps 1, voltage 15000, temperature 30 */
+  static const uint8_t frame[] = {19, 7, 7, 1, 22, 0x3A, 0x98, 24, 30,
+    (uint8_t)-(19 + 7 + 7 + 1 + 22 + 0x3A + 0x98 + 24 + 30)};
+  static const uint8_t voltage_frame[] = {19, 3, 22, 0x3A, 0x98,
+    (uint8_t)-(19 + 3 + 22 + 0x3A + 0x98)};
+  static const uint8_t bumps_frame[] = {19, 2, 7, 1,
+    (uint8_t)-(19 + 2 + 7 + 1)};
+  static const uint8_t temperature_frame[] = {19, 2, 24, 30,
+    (uint8_t)-(19 + 2 + 24 + 30)};
+  static const uint8_t *expected[CLIENTS];
+  static size_t expected_size[CLIENTS];
+  uint8_t voltage[] = {ROOMBA_VOLTAGE};
+  uint8_t bumps[] = {ROOMBA_BUMPS_WHEELDROPS};
+  uint8_t temperature[] = {ROOMBA_TEMPERATURE};
+  uint8_t owned[][2] = {{ROOMBA_SENSORS, ROOMBA_VOLTAGE},
+    {ROOMBA_QUERY_LIST, 0}, {ROOMBA_STREAM, 0},
+    {ROOMBA_PAUSE_RESUME_STREAM, 0}};
+  uint8_t drive[] = {ROOMBA_DRIVE_DIRECT, 0, 100, 0, 100};
+  uint8_t robot[512], received[256], ids[ROOMBA_COMMAND_MAX_SIZE];
+  uint8_t batch[3 * sizeof(frame)];
+  uint32_t writes, rejected;
+  int serial[2], clients[CLIENTS];
+  size_t size;
+  char path[64];
+  pthread_t thread;
+
+  /* serial[0] is the port, serial[1] the robot */
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, serial) == 0);
+  snprintf(path, sizeof(path), "/tmp/roomba_mux_test_%d", (int)getpid());
+  CHECK_EQ(roomba_mux_init(&mux, serial[0], path, ROOMBA_115200BPS), 0);
+  CHECK(pthread_create(&thread, NULL, run, NULL) == 0);
+
+  /* many clients, three different subscriptions */
+  for (int c = 0; c < CLIENTS; c++) {
+    clients[c] = connect_client(path);
+    CHECK(clients[c] >= 0);
+    if (c == 0) {
+      send_message(clients[c], ROOMBA_MUX_SUBSCRIBE, voltage, 1);
+      expected[c] = voltage_frame;
+      expected_size[c] = sizeof(voltage_frame);
+    } else if (c == 1) {
+      send_message(clients[c], ROOMBA_MUX_SUBSCRIBE, bumps, 1);
+      expected[c] = bumps_frame;
+      expected_size[c] = sizeof(bumps_frame);
+    } else {
+      send_message(clients[c], ROOMBA_MUX_SUBSCRIBE, temperature, 1);
+      expected[c] = temperature_frame;
+      expected_size[c] = sizeof(temperature_frame);
+    }
+  }
+  sleep_ms(5 * ROOMBA_SLOT_MS);
+
+  /* the robot streams the union, as one Stream */
+  size = receive(serial[1], robot, sizeof(robot), sizeof(robot));
+  CHECK_EQ(last_stream(robot, size, ids), 3);
+  CHECK_EQ(ids[0], ROOMBA_BUMPS_WHEELDROPS);
+  CHECK_EQ(ids[1], ROOMBA_VOLTAGE);
+  CHECK_EQ(ids[2], ROOMBA_TEMPERATURE);
+  CHECK_EQ(mux.stats.accepted, CLIENTS);
+
+  /* every client gets its own packets of the frame, and only those */
+  CHECK(write(serial[1], frame, sizeof(frame)) == sizeof(frame));
+  for (int c = 0; c < CLIENTS; c++) {
+    size = receive(clients[c], received, sizeof(received), expected_size[c]);
+    CHECK_EQ(size, expected_size[c]);
+    CHECK(memcmp(received, expected[c], expected_size[c]) == 0);
+  }
+
+  /* three frames read at once: one write per client for all three */
+  for (int i = 0; i < 3; i++) {
+    memcpy(&batch[i * sizeof(frame)], frame, sizeof(frame));
+  }
+  writes = mux.stats.client_writes;
+  CHECK(write(serial[1], batch, sizeof(batch)) == sizeof(batch));
+  for (int c = 0; c < CLIENTS; c++) {
+    size = receive(clients[c], received, sizeof(received),
+      3 * expected_size[c]);
+    CHECK_EQ(size, 3 * expected_size[c]);
+    for (int i = 0; i < 3; i++) {
+      CHECK(memcmp(&received[i * expected_size[c]], expected[c],
+        expected_size[c]) == 0);
+    }
+  }
+  CHECK_EQ(mux.stats.client_writes - writes, CLIENTS);
+
+  /* what the robot sends back is the multiplexer's: refused */
+  rejected = mux.stats.rejected;
+  for (int i = 0; i < 4; i++) {
+    send_message(clients[0], ROOMBA_MUX_COMMAND, owned[i], 2);
+  }
+  send_message(clients[0], ROOMBA_MUX_COMMAND, drive, sizeof(drive));
+  size = receive(serial[1], robot, sizeof(robot), sizeof(drive));
+  CHECK_EQ(mux.stats.rejected - rejected, 4);
+  CHECK_EQ(size, sizeof(drive));
+  CHECK(memcmp(robot, drive, sizeof(drive)) == 0);
+
+  /* the robot hangs up: the multiplexer stops instead of spinning */
+  close(serial[1]);
+  pthread_join(thread, NULL);
+  CHECK_EQ(run_result, -1);
+  CHECK_EQ(run_errno, EPIPE);
+
+  for (int c = 0; c < CLIENTS; c++) close(clients[c]);
+  roomba_mux_close(&mux);
+  close(serial[0]);
+  unlink(path);
+  return TEST_RESULT();
+}
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "heap.h"
+#include "test.h"
+#include "roomba_cache.h"
+#include "roomba_odometry.h"
+#include "roomba_pool.h"
+#include "roomba_scheduler.h"
+#include "roomba_stream.h"
+
+ROOMBA_POOL_DEFINE(parsers, ROOMBA_STREAM_PARSER, 4)
+
+int no_heap_include(int value);
+
+static void discard(void *context, const uint8_t data[], uint16_t size) {
+  (void)context;
+  (void)data;
+  (void)size;
+}
+
+static void pools(void) {
+  ROOMBA_STREAM_PARSER *taken[4];
+
+  for (uint8_t i = 0; i < 4; i++) {
+    taken[i] = parsers_acquire();
+    CHECK(taken[i] != NULL);
+  }
+  CHECK(parsers_acquire() == NULL);
+  parsers_release(taken[2]);
+  CHECK_EQ(parsers_available(), 1);
+  CHECK(parsers_acquire() == taken[2]);
+  for (uint8_t i = 0; i < 4; i++) parsers_release(taken[i]);
+  CHECK_EQ(parsers_available(), 4);
+}
+
+int main(void) {
+  ROOMBA_STREAM_PARSER *parser;
+  ROOMBA_QUEUE queue;
+  ROOMBA_SCHEDULER scheduler;
+  ROOMBA_CACHE cache;
+  ROOMBA_ODOMETRY odometry;
+  ROOMBA_PACKET_GROUP_100 snapshot;
+  ROOMBA_TRANSPORT transport = {discard, NULL};
+  uint8_t frame[ROOMBA_STREAM_FRAME_MAX];
+  uint8_t drive[] = {ROOMBA_DRIVE_DIRECT, 0, 100, 0, 100};
+  uint8_t leds[] = {ROOMBA_LEDS, 0, 0, 255};
+  uint16_t voltage = 0, temperature;
+  void *probe;
+
+  /* the wrappers see calls from this program */
+  probe = malloc(16);
+  free(probe);
+  CHECK_EQ(heap_calls, 2);
+  CHECK_EQ(no_heap_include(-3), 3);
+
+  heap_calls = 0;
+  pools();
+  parser = parsers_acquire();
+  roomba_stream_init(parser);
+  roomba_queue_init(&queue);
+  roomba_cache_init(&cache, parser, &queue, transport, 0);
+  roomba_scheduler_init(&scheduler, &queue, roomba_cache_transport(&cache),
+    ROOMBA_115200BPS);
+  roomba_stream_set_frame_hook(parser, roomba_cache_frame_hook, &cache);
+  roomba_odometry_init(&odometry);
+  memset(&snapshot, 0, sizeof(snapshot));
+
+  /* a minute of frames, commands and reads */
+  for (uint32_t i = 0; i < 4000; i++) {
+    uint8_t size;
+    snapshot.encoder_counts_left = (uint16_t)(i * 11);
+    snapshot.encoder_counts_right = (uint16_t)(i * 13);
+    snapshot.voltage = (uint16_t)(14000 + i);
+    size = roomba_stream_encode(&snapshot,
+      roomba_packet_mask(G101) | roomba_packet_mask(ROOMBA_VOLTAGE), frame);
+    roomba_cache_receive(&cache, frame, size);
+    roomba_odometry_update(&odometry, snapshot.encoder_counts_left,
+      snapshot.encoder_counts_right);
+    roomba_get_packet(&cache, ROOMBA_VOLTAGE, &voltage);
+    roomba_get_packet(&cache, ROOMBA_TEMPERATURE, &temperature);
+    roomba_queue_push(&queue, drive, sizeof(drive));
+    roomba_queue_push(&queue, leds, sizeof(leds));
+    roomba_cache_poll(&cache, i * ROOMBA_SLOT_MS);
+    roomba_scheduler_tick(&scheduler);
+  }
+  CHECK_EQ(voltage, 14000 + 3999);
+  CHECK_EQ(heap_calls, 0);
+
+  return TEST_RESULT();
+}
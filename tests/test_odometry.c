@@ -0,0 +1,122 @@
+#include <math.h>
+
+#include "test.h"
+#include "roomba_odometry.h"
+
+/* pose fields to and from mm and rad, see the table in roomba_odometry.h */
+#ifdef ROOMBA_ODOMETRY_FIXED_POINT
+  #define MM(v) ((double)(v) / 256.0)
+  #define RAD(v) ((double)(v) / 65536.0)
+  #define FROM_MM(v) ((ROOMBA_ODOMETRY_VALUE)((v) * 256.0))
+  #define FROM_RAD(v) ((ROOMBA_ODOMETRY_VALUE)((v) * 65536.0 + 0.5))
+#else
+  #define MM(v) ((double)(v))
+  #define RAD(v) ((double)(v))
+  #define FROM_MM(v) ((ROOMBA_ODOMETRY_VALUE)(v))
+  #define FROM_RAD(v) ((ROOMBA_ODOMETRY_VALUE)(v))
+#endif
+
+#define MM_PER_COUNT ROOMBA_MM_PER_ENCODER_COUNT
+#define BASE ROOMBA_WHEEL_BASE_COUNTS
+#define FRAMES 500
+
+int main(void) {
+  ROOMBA_ODOMETRY odometry, batch;
+  static uint16_t left[FRAMES], right[FRAMES];
+  uint16_t l = 65500, r = 65500;
+  double theta, radius;
+
+  /* the first reading only primes */
+  roomba_odometry_init(&odometry);
+  roomba_odometry_update(&odometry, l, r);
+  CHECK_EQ(odometry.pose.x, 0);
+  CHECK_EQ(odometry.pose.y, 0);
+
+  /* 1000 counts straight ahead, through the 65535 -> 0 roll over */
+  for (int i = 0; i < 100; i++) {
+    l = (uint16_t)(l + 10);
+    r = (uint16_t)(r + 10);
+    roomba_odometry_update(&odometry, l, r);
+  }
+  CHECK_EQ(l, 964);
+  CHECK_NEAR(MM(odometry.pose.x), 1000 * MM_PER_COUNT, 0.05);
+  CHECK_NEAR(MM(odometry.pose.y), 0, 0.05);
+  CHECK_NEAR(RAD(odometry.pose.theta), 0, 1e-4);
+
+  /* and back through it */
+  for (int i = 0; i < 100; i++) {
+    l = (uint16_t)(l - 10);
+    r = (uint16_t)(r - 10);
+    roomba_odometry_update(&odometry, l, r);
+  }
+  CHECK_NEAR(MM(odometry.pose.x), 0, 0.05);
+  CHECK_NEAR(MM(odometry.pose.y), 0, 0.05);
+
+  /*
+   * An arc of 300 frames, 10 and 20 counts a frame. Each frame moves along
+   * the heading halfway through it, so the sum has a closed form.
+   */
+  roomba_odometry_init(&odometry);
+  l = 65530;
+  r = 65520;
+  roomba_odometry_update(&odometry, l, r);
+  for (int i = 0; i < 300; i++) {
+    l = (uint16_t)(l + 10);
+    r = (uint16_t)(r + 20);
+    roomba_odometry_update(&odometry, l, r);
+  }
+  theta = 3000 / BASE;
+  radius = 15 * MM_PER_COUNT / (2 * sin(5 / BASE));
+  CHECK_NEAR(RAD(odometry.pose.theta), theta, 1e-4);
+  CHECK_NEAR(MM(odometry.pose.x), radius * sin(theta), 0.1);
+  CHECK_NEAR(MM(odometry.pose.y), radius * (1 - cos(theta)), 0.1);
+
+  /* a turn too large for one step, as after lost frames, then 100 ahead */
+  roomba_odometry_init(&odometry);
+  roomba_odometry_update(&odometry, 1000, 0);
+  roomba_odometry_update(&odometry, 0, 1000);
+  theta = 2000 / BASE;
+  CHECK_NEAR(RAD(odometry.pose.theta), theta, 1e-4);
+  CHECK_NEAR(MM(odometry.pose.x), 0, 0.05);
+  CHECK_NEAR(MM(odometry.pose.y), 0, 0.05);
+  roomba_odometry_update(&odometry, 100, 1100);
+  CHECK_NEAR(MM(odometry.pose.x), 100 * MM_PER_COUNT * cos(theta), 0.05);
+  CHECK_NEAR(MM(odometry.pose.y), 100 * MM_PER_COUNT * sin(theta), 0.05);
+
+  /* from a pose set facing +y */
+  roomba_odometry_init(&odometry);
+  roomba_odometry_set_pose(&odometry, FROM_MM(100.0), FROM_MM(0.0),
+    FROM_RAD(1.57079632679490));
+  roomba_odometry_update(&odometry, 0, 0);
+  roomba_odometry_update(&odometry, 100, 100);
+  CHECK_NEAR(MM(odometry.pose.x), 100, 0.05);
+  CHECK_NEAR(MM(odometry.pose.y), 100 * MM_PER_COUNT, 0.05);
+  CHECK_NEAR(RAD(odometry.pose.theta), 1.57079632679490, 1e-4);
+
+  /* replaying a recording in a batch lands on the same pose */
+  l = 65000;
+  r = 400;
+  for (int i = 0; i < FRAMES; i++) {
+    l = (uint16_t)(l + i % 7 * 9 - 20);
+    r = (uint16_t)(r + i % 11 * 7 - 25);
+    left[i] = l;
+    right[i] = r;
+  }
+  left[FRAMES / 2] = (uint16_t)(left[FRAMES / 2] + 400);
+  roomba_odometry_init(&odometry);
+  for (int i = 0; i < FRAMES; i++) {
+    roomba_odometry_update(&odometry, left[i], right[i]);
+  }
+  roomba_odometry_init(&batch);
+  roomba_odometry_update_batch(&batch, left, right, FRAMES / 3);
+  roomba_odometry_update_batch(&batch, &left[FRAMES / 3],
+    &right[FRAMES / 3], FRAMES - FRAMES / 3);
+  CHECK(MM(odometry.pose.x) != 0);
+  CHECK_NEAR(MM(batch.pose.x), MM(odometry.pose.x), 1e-3);
+  CHECK_NEAR(MM(batch.pose.y), MM(odometry.pose.y), 1e-3);
+  CHECK_NEAR(RAD(batch.pose.theta), RAD(odometry.pose.theta), 1e-6);
+  CHECK_EQ(batch.heading_counts, odometry.heading_counts);
+  CHECK_EQ(batch.last_left, left[FRAMES - 1]);
+
+  return TEST_RESULT();
+}
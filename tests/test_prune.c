@@ -0,0 +1,115 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_prune.h"
+
+static void ignore(void *context, const uint8_t data[], uint16_t size) {
+  (void)context;
+  (void)data;
+  (void)size;
+}
+
+static int pruned;
+
+static void on_pruned(const ROOMBA_PRUNE *prune, void *context) {
+  CHECK(context == &pruned);
+  CHECK_EQ(prune->stats.saved_bytes, 76);
+  pruned++;
+}
+
+int main(void) {
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_QUEUE queue;
+  ROOMBA_SCHEDULER scheduler;
+  ROOMBA_CACHE cache;
+  ROOMBA_PRUNE prune;
+  ROOMBA_TRANSPORT uart = {ignore, NULL};
+  const ROOMBA_COMMAND *command;
+  uint8_t all[] = {ALL_PACKETS};
+  uint8_t group_100[] = {ROOMBA_STREAM, 1, ALL_PACKETS};
+  uint8_t two[] = {ROOMBA_STREAM, 2, ROOMBA_VOLTAGE, ROOMBA_TEMPERATURE};
+  /* one packet short of every group, too many ids for one command */
+  uint8_t skipped[] = {8, 20, 21, 30, 35, 45, 46, 54};
+  uint16_t value;
+  uint32_t now = 1000;
+
+  roomba_stream_init(&parser);
+  roomba_queue_init(&queue);
+  roomba_cache_init(&cache, &parser, &queue, uart, now);
+  roomba_scheduler_init(&scheduler, &queue, uart, ROOMBA_115200BPS);
+  roomba_prune_init(&prune, &cache, &queue, &scheduler);
+  roomba_prune_set_hook(&prune, on_pruned, &pruned);
+
+  /* group 100 streams during the warm-up */
+  CHECK(roomba_prune_start(&prune, all, sizeof(all), now, 1000));
+  command = roomba_queue_peek(&queue);
+  CHECK(command != NULL);
+  CHECK_EQ(command->size, sizeof(group_100));
+  CHECK(memcmp(command->data, group_100, sizeof(group_100)) == 0);
+  roomba_queue_pop(&queue);
+  CHECK_EQ(prune.stats.requested_bytes, 84);
+  CHECK_EQ(prune.stats.streamed_bytes, 84);
+
+  roomba_get_packet(&cache, ROOMBA_VOLTAGE, &value);
+  roomba_get_packet(&cache, ROOMBA_TEMPERATURE, &value);
+  roomba_prune_poll(&prune, now + 999);
+  CHECK(prune.warming_up);
+  CHECK_EQ(roomba_queue_depth(&queue), 0);
+
+  /* then only what was read: 3 + 2 ids + 2 + 1 bytes a frame */
+  roomba_prune_poll(&prune, now + 1000);
+  CHECK(!prune.warming_up);
+  CHECK_EQ(pruned, 1);
+  command = roomba_queue_peek(&queue);
+  CHECK(command != NULL);
+  CHECK_EQ(command->size, sizeof(two));
+  CHECK(memcmp(command->data, two, sizeof(two)) == 0);
+  roomba_queue_pop(&queue);
+  CHECK_EQ(prune.stats.streamed_bytes, 8);
+  CHECK_EQ(prune.stats.saved_bytes, 76);
+  CHECK_EQ(scheduler.stream_bytes, 8);
+
+  /* a pruned packet read later counts once, a streamed one never */
+  roomba_prune_poll(&prune, now + 1015);
+  CHECK_EQ(prune.stats.late_packets, 0);
+  roomba_get_packet(&cache, ROOMBA_CURRENT, &value);
+  roomba_get_packet(&cache, ROOMBA_VOLTAGE, &value);
+  roomba_prune_poll(&prune, now + 1030);
+  roomba_get_packet(&cache, ROOMBA_CURRENT, &value);
+  roomba_prune_poll(&prune, now + 1045);
+  CHECK_EQ(prune.stats.late_packets, 1);
+  CHECK_EQ(prune.stats.late, ROOMBA_PACKET_BIT(ROOMBA_CURRENT));
+  CHECK_EQ(pruned, 1);
+
+  /* restarting warms up again */
+  now += 2000;
+  roomba_queue_init(&queue);
+  roomba_prune_set_hook(&prune, NULL, NULL);
+  CHECK(roomba_prune_start(&prune, all, sizeof(all), now, 1000));
+  roomba_queue_pop(&queue);
+  CHECK(prune.warming_up);
+  CHECK_EQ(prune.stats.late_packets, 0);
+
+  /* reads that do not fit a command fall back to group 100 */
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= ROOMBA_STASIS; p++) {
+    if (memchr(skipped, p, sizeof(skipped)) == NULL) {
+      roomba_get_packet(&cache, p, &value);
+    }
+  }
+  roomba_prune_poll(&prune, now + 1000);
+  command = roomba_queue_peek(&queue);
+  CHECK(command != NULL);
+  CHECK_EQ(command->size, sizeof(group_100));
+  CHECK(memcmp(command->data, group_100, sizeof(group_100)) == 0);
+  CHECK_EQ(prune.stats.saved_bytes, 0);
+  CHECK_EQ(prune.streaming, roomba_packet_mask(ALL_PACKETS));
+
+  /* so the skipped packets are still streamed, not late */
+  for (uint8_t i = 0; i < sizeof(skipped); i++) {
+    roomba_get_packet(&cache, skipped[i], &value);
+  }
+  roomba_prune_poll(&prune, now + 1015);
+  CHECK_EQ(prune.stats.late_packets, 0);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,110 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_queue.h"
+
+static uint8_t next_opcode(ROOMBA_QUEUE *queue) {
+  const ROOMBA_COMMAND *command = roomba_queue_peek(queue);
+  uint8_t opcode;
+
+  if (!command) return 0;
+  opcode = command->data[0];
+  roomba_queue_pop(queue);
+  return opcode;
+}
+
+int main(void) {
+  ROOMBA_QUEUE queue;
+  uint8_t leds[] = {ROOMBA_LEDS, 0, 0, 0};
+  uint8_t sensors[] = {ROOMBA_SENSORS, ROOMBA_VOLTAGE};
+  uint8_t drive[] = {ROOMBA_DRIVE_DIRECT, 0, 100, 0, 100};
+  uint8_t faster[] = {ROOMBA_DRIVE_DIRECT, 0, 200, 0, 200};
+  uint8_t motors[] = {ROOMBA_MOTORS, 1};
+  uint8_t safe[] = {ROOMBA_SAFE};
+  uint8_t stop[] = {ROOMBA_DRIVE_DIRECT, 0, 0, 0, 0};
+
+  /* highest lane first, each lane in order */
+  roomba_queue_init(&queue);
+  CHECK(roomba_queue_push(&queue, leds, sizeof(leds)));
+  CHECK(roomba_queue_push(&queue, sensors, sizeof(sensors)));
+  CHECK(roomba_queue_push(&queue, drive, sizeof(drive)));
+  CHECK(roomba_queue_push(&queue, motors, sizeof(motors)));
+  CHECK_EQ(roomba_queue_depth(&queue), 4);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_DRIVE_DIRECT);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_MOTORS);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_SENSORS);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_LEDS);
+  CHECK(roomba_queue_peek(&queue) == NULL);
+
+  /* a newer setpoint replaces the unsent one in its place */
+  roomba_queue_init(&queue);
+  CHECK(roomba_queue_push(&queue, drive, sizeof(drive)));
+  CHECK(roomba_queue_push(&queue, motors, sizeof(motors)));
+  CHECK(roomba_queue_push(&queue, faster, sizeof(faster)));
+  CHECK_EQ(roomba_queue_lane_depth(&queue, ROOMBA_PRIORITY_MOTION), 2);
+  CHECK_EQ(roomba_queue_peek(&queue)->data[2], 200);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_DRIVE_DIRECT);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_MOTORS);
+  CHECK_EQ(queue.stats.pushed, 3);
+  CHECK_EQ(queue.stats.coalesced, 1);
+  CHECK_EQ(queue.stats.sent, 2);
+  CHECK_EQ(queue.stats.max_depth, 2);
+
+  /* a full lane drops, the others still take commands */
+  roomba_queue_init(&queue);
+  for (uint8_t i = 0; i < ROOMBA_QUEUE_CAPACITY; i++) {
+    CHECK(roomba_queue_push(&queue, sensors, sizeof(sensors)));
+  }
+  CHECK(!roomba_queue_push(&queue, sensors, sizeof(sensors)));
+  CHECK(roomba_queue_push(&queue, leds, sizeof(leds)));
+  CHECK_EQ(queue.stats.dropped, 1);
+  roomba_queue_expire(&queue);
+  CHECK_EQ(queue.stats.expired, 1);
+  CHECK_EQ(queue.stats.sent, 0);
+  CHECK_EQ(roomba_queue_depth(&queue), ROOMBA_QUEUE_CAPACITY);
+
+  /* a Drive pushed after Safe does not overtake it */
+  roomba_queue_init(&queue);
+  CHECK(roomba_queue_push(&queue, sensors, sizeof(sensors)));
+  CHECK(roomba_queue_push(&queue, safe, sizeof(safe)));
+  CHECK(roomba_queue_push(&queue, drive, sizeof(drive)));
+  CHECK(roomba_queue_push(&queue, leds, sizeof(leds)));
+  CHECK_EQ(next_opcode(&queue), ROOMBA_SENSORS);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_SAFE);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_DRIVE_DIRECT);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_LEDS);
+  CHECK_EQ(queue.barriers, 0);
+
+  /* one pushed before still goes first, and keeps its own setpoint */
+  roomba_queue_init(&queue);
+  CHECK(roomba_queue_push(&queue, drive, sizeof(drive)));
+  CHECK(roomba_queue_push(&queue, safe, sizeof(safe)));
+  CHECK(roomba_queue_push(&queue, faster, sizeof(faster)));
+  CHECK_EQ(queue.stats.coalesced, 0);
+  CHECK_EQ(roomba_queue_peek(&queue)->data[2], 100);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_DRIVE_DIRECT);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_SAFE);
+  CHECK_EQ(roomba_queue_peek(&queue)->data[2], 200);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_DRIVE_DIRECT);
+
+  /* the safety lane is never held back */
+  roomba_queue_init(&queue);
+  CHECK(roomba_queue_push(&queue, sensors, sizeof(sensors)));
+  CHECK(roomba_queue_push(&queue, safe, sizeof(safe)));
+  CHECK(roomba_queue_push_priority(&queue, ROOMBA_PRIORITY_SAFETY, stop,
+    sizeof(stop)));
+  CHECK_EQ(roomba_queue_peek(&queue)->data[2], 0);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_DRIVE_DIRECT);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_SENSORS);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_SAFE);
+
+  /* the order holds across the wrap of the push sequence */
+  roomba_queue_init(&queue);
+  queue.sequence = UINT16_MAX;
+  CHECK(roomba_queue_push(&queue, safe, sizeof(safe)));
+  CHECK(roomba_queue_push(&queue, drive, sizeof(drive)));
+  CHECK_EQ(next_opcode(&queue), ROOMBA_SAFE);
+  CHECK_EQ(next_opcode(&queue), ROOMBA_DRIVE_DIRECT);
+
+  return TEST_RESULT();
+}
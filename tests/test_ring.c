@@ -0,0 +1,79 @@
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "test.h"
+#include "roomba_ring.h"
+
+#define STRESS_BYTES 20000
+
+static uint8_t stress_buffer[16];
+static ROOMBA_RING stress;
+static volatile uint32_t produced;
+
+/* a signal handler interrupts the main loop like an ISR does on the MCU */
+static void interrupt(int signal) {
+  (void)signal;
+  for (uint8_t i = 0; i < 8 && produced < STRESS_BYTES; i++) {
+    /* full: the rest waits for the next interrupt */
+    if (!roomba_ring_put(&stress, (uint8_t)produced)) return;
+    produced++;
+  }
+}
+
+static void basics(void) {
+  uint8_t buffer[8], out[8] = {0}, byte = 0;
+  ROOMBA_RING ring;
+
+  roomba_ring_init(&ring, buffer, sizeof(buffer));
+  CHECK(!roomba_ring_get(&ring, &byte));
+  CHECK_EQ(roomba_ring_space(&ring), 8);
+
+  /* runs the free-running indices through several wraps of 256 */
+  for (uint32_t round = 0; round < 200; round++) {
+    for (uint8_t i = 0; i < 8; i++) CHECK(roomba_ring_put(&ring, i));
+    CHECK(!roomba_ring_put(&ring, 99));
+    CHECK_EQ(roomba_ring_count(&ring), 8);
+    CHECK_EQ(roomba_ring_space(&ring), 0);
+    CHECK_EQ(roomba_ring_read(&ring, out, 5), 5);
+    CHECK_EQ(out[4], 4);
+    CHECK_EQ(roomba_ring_read(&ring, out, 8), 3);
+    CHECK_EQ(out[2], 7);
+    CHECK_EQ(roomba_ring_count(&ring), 0);
+  }
+}
+
+static void interrupted(void) {
+  struct itimerval timer;
+  struct sigaction action;
+  uint32_t consumed = 0, errors = 0;
+  uint8_t byte;
+
+  roomba_ring_init(&stress, stress_buffer, sizeof(stress_buffer));
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = interrupt;
+  sigaction(SIGALRM, &action, NULL);
+  memset(&timer, 0, sizeof(timer));
+  timer.it_interval.tv_usec = 50;
+  timer.it_value.tv_usec = 50;
+  setitimer(ITIMER_REAL, &timer, NULL);
+
+  while (consumed < STRESS_BYTES) {
+    if (!roomba_ring_get(&stress, &byte)) continue;
+    if (byte != (uint8_t)consumed) errors++;
+    consumed++;
+  }
+
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_REAL, &timer, NULL);
+  CHECK_EQ(errors, 0);
+  CHECK_EQ(produced, STRESS_BYTES);
+}
+
+int main(void) {
+  basics();
+  interrupted();
+  return TEST_RESULT();
+}
@@ -0,0 +1,101 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_safety.h"
+
+static uint8_t written[64];
+static uint16_t written_size;
+static uint32_t ticks;
+
+static void capture(void *context, const uint8_t data[], uint16_t size) {
+  (void)context;
+  memcpy(&written[written_size], data, size);
+  written_size = (uint16_t)(written_size + size);
+  /* the write takes 3 ticks */
+  ticks += 3;
+}
+
+static uint32_t clock_ticks(void) {
+  return ticks;
+}
+
+/* feeds a frame of bumps and wheel drops (7) and cliff left (9) */
+static void feed(ROOMBA_STREAM_PARSER *parser, uint8_t bumps, uint8_t cliff,
+  bool corrupt) {
+  uint8_t frame[] = {ROOMBA_STREAM_HEADER, 4, ROOMBA_BUMPS_WHEELDROPS, bumps,
+    ROOMBA_CLIFF_LEFT, cliff, 0};
+  uint8_t sum = 0;
+
+  for (uint8_t i = 0; i < sizeof(frame) - 1; i++) {
+    sum = (uint8_t)(sum + frame[i]);
+  }
+  frame[sizeof(frame) - 1] = (uint8_t)(-sum + (corrupt ? 1 : 0));
+  roomba_stream_parse(parser, frame, sizeof(frame));
+}
+
+int main(void) {
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_SAFETY safety;
+  ROOMBA_MODE_TRACKER tracker;
+  ROOMBA_TRANSPORT uart = {capture, NULL};
+  uint8_t drive_stop[] = {ROOMBA_DRIVE, 0, 0, 0, 0};
+
+  roomba_stream_init(&parser);
+  roomba_safety_init(&safety, uart, clock_ticks, false);
+  roomba_mode_init(&tracker);
+  roomba_safety_set_mode_tracker(&safety, &tracker);
+  roomba_stream_set_packet_hook(&parser, roomba_safety_packet_hook, &safety);
+
+  /* bumps alone do not stop */
+  roomba_mode_observe(&tracker, ROOMBA_SAFE_MODE);
+  feed(&parser, 0x03, 0, false);
+  CHECK_EQ(written_size, 0);
+  CHECK(tracker.known);
+
+  /* a cliff writes the stop and forgets the mode */
+  feed(&parser, 0, 1, false);
+  CHECK_EQ(written_size, sizeof(drive_stop));
+  CHECK(memcmp(written, drive_stop, sizeof(drive_stop)) == 0);
+  CHECK_EQ(safety.trips, 1);
+  CHECK_EQ(safety.events[0].packet, ROOMBA_CLIFF_LEFT);
+  CHECK_EQ(safety.events[0].value, 1);
+  CHECK_EQ(safety.events[0].latency, 3);
+  CHECK_EQ(safety.max_latency, 3);
+  CHECK(!tracker.known);
+
+  /* the cliff held is not a new stop, the wheel drop rising is */
+  roomba_mode_observe(&tracker, ROOMBA_PASSIVE_MODE);
+  written_size = 0;
+  feed(&parser, 0, 1, false);
+  CHECK_EQ(written_size, 0);
+  feed(&parser, 0x04, 1, false);
+  CHECK_EQ(written_size, sizeof(drive_stop));
+  CHECK_EQ(safety.trips, 2);
+  CHECK_EQ(safety.events[1].packet, ROOMBA_BUMPS_WHEELDROPS);
+  CHECK_EQ(safety.events[1].value, 0x04);
+  CHECK(!tracker.known);
+
+  /* the other wheel drops too */
+  feed(&parser, 0x0C, 1, false);
+  CHECK_EQ(safety.trips, 3);
+
+  /* stops before the checksum, even of a frame then thrown away */
+  feed(&parser, 0, 0, false);
+  written_size = 0;
+  feed(&parser, 0x08, 0, true);
+  CHECK_EQ(parser.stats.checksum_errors, 1);
+  CHECK_EQ(written_size, sizeof(drive_stop));
+  CHECK_EQ(safety.trips, 4);
+
+  /* Stop (173) instead of Drive, and no tracker */
+  roomba_stream_init(&parser);
+  roomba_safety_init(&safety, uart, clock_ticks, true);
+  roomba_stream_set_packet_hook(&parser, roomba_safety_packet_hook, &safety);
+  written_size = 0;
+  feed(&parser, 0x08, 0, false);
+  CHECK_EQ(written_size, 1);
+  CHECK_EQ(written[0], ROOMBA_STOP);
+  CHECK_EQ(safety.trips, 1);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,51 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_scheduler.h"
+
+static uint16_t written;
+
+static void count_write(void *context, const uint8_t data[], uint16_t size) {
+  (void)context;
+  (void)data;
+  written = (uint16_t)(written + size);
+}
+
+int main(void) {
+  ROOMBA_QUEUE queue;
+  ROOMBA_SCHEDULER scheduler;
+  ROOMBA_TRANSPORT transport = {count_write, NULL};
+  uint8_t query[] = {ROOMBA_SENSORS, ROOMBA_VOLTAGE};
+  uint8_t drive[] = {ROOMBA_DRIVE_DIRECT, 0, 100, 0, 100};
+
+  roomba_queue_init(&queue);
+  roomba_scheduler_init(&scheduler, &queue, transport, ROOMBA_115200BPS);
+  CHECK_EQ(roomba_slot_bytes(ROOMBA_115200BPS), 172);
+
+  /* a stream frame larger than the slot: no room for replies, ever */
+  roomba_scheduler_set_stream_bytes(&scheduler, 400);
+  for (uint32_t i = 0; i < 100000; i++) roomba_scheduler_tick(&scheduler);
+  CHECK(scheduler.rx_credit >= 0);
+
+  CHECK(roomba_queue_push(&queue, query, sizeof(query)));
+  roomba_scheduler_tick(&scheduler);
+  CHECK(scheduler.rx_credit >= -2000);
+
+  /* commands without a reply still go out */
+  written = 0;
+  roomba_queue_init(&queue);
+  CHECK(roomba_queue_push(&queue, drive, sizeof(drive)));
+  roomba_scheduler_tick(&scheduler);
+  CHECK_EQ(written, sizeof(drive));
+
+  /* once the stream shrinks, the query is answered in the next slot */
+  written = 0;
+  roomba_scheduler_set_stream_bytes(&scheduler, 10);
+  CHECK(roomba_queue_push(&queue, query, sizeof(query)));
+  roomba_scheduler_tick(&scheduler);
+  roomba_scheduler_tick(&scheduler);
+  CHECK_EQ(written, sizeof(query));
+  CHECK_EQ(roomba_queue_depth(&queue), 0);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,63 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "roomba_shm.h"
+
+static void publish(ROOMBA_SHM_PUBLISHER *publisher, uint16_t voltage) {
+  ROOMBA_PACKET_GROUP_100 frame;
+
+  memset(&frame, 0, sizeof(frame));
+  frame.voltage = voltage;
+  roomba_shm_publish(publisher, &frame, ROOMBA_PACKET_BIT(ROOMBA_VOLTAGE), 0);
+}
+
+int main(void) {
+  ROOMBA_SHM_PUBLISHER publisher, restarted, resized;
+  ROOMBA_SHM_SUBSCRIBER subscriber;
+  ROOMBA_SHM_FRAME out;
+  char name[32];
+
+  snprintf(name, sizeof(name), "/roomba_test_%d", (int)getpid());
+  CHECK_EQ(roomba_shm_publisher_open(&publisher, name, 4), 0);
+
+  /* a subscriber without any frame waits for the first */
+  CHECK_EQ(roomba_shm_subscriber_open(&subscriber, name), 0);
+  CHECK(!roomba_shm_read(&subscriber, &out));
+  publish(&publisher, 1000);
+  CHECK(roomba_shm_read(&subscriber, &out));
+  CHECK_EQ(out.number, 0);
+  roomba_shm_subscriber_close(&subscriber);
+
+  /* a later one starts at the newest frame */
+  publish(&publisher, 1001);
+  publish(&publisher, 1002);
+  CHECK_EQ(roomba_shm_subscriber_open(&subscriber, name), 0);
+  CHECK(roomba_shm_read(&subscriber, &out));
+  CHECK_EQ(out.number, 2);
+  CHECK_EQ(out.frame.voltage, 1002);
+  CHECK(!roomba_shm_read(&subscriber, &out));
+
+  /* a restarted publisher keeps the numbers going */
+  CHECK_EQ(roomba_shm_publisher_open(&restarted, name, 4), 0);
+  publish(&restarted, 1003);
+  CHECK(roomba_shm_read(&subscriber, &out));
+  CHECK_EQ(out.number, 3);
+  CHECK_EQ(out.frame.voltage, 1003);
+  CHECK_EQ(subscriber.missed, 0);
+
+  /* with fewer slots the old frames are gone, the numbers are not */
+  CHECK_EQ(roomba_shm_publisher_open(&resized, name, 2), 0);
+  CHECK(!roomba_shm_read(&subscriber, &out));
+  publish(&resized, 1004);
+  CHECK(roomba_shm_read(&subscriber, &out));
+  CHECK_EQ(out.number, 4);
+  CHECK_EQ(out.frame.voltage, 1004);
+
+  roomba_shm_subscriber_close(&subscriber);
+  roomba_shm_publisher_close(&resized);
+  return TEST_RESULT();
+}
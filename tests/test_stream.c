@@ -0,0 +1,138 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_stream.h"
+
+static int frames;
+static uint8_t packets[64];
+static uint8_t packet_count;
+
+static void on_packet(const ROOMBA_STREAM_PARSER *parser, uint8_t packet,
+  void *context) {
+  (void)parser;
+  CHECK(context == packets);
+  if (packet_count < sizeof(packets)) packets[packet_count++] = packet;
+}
+
+static void on_frame(const ROOMBA_STREAM_PARSER *parser,
+  const ROOMBA_PACKET_GROUP_100 *frame, void *context) {
+  CHECK(context == &frames);
+  CHECK(frame == &parser->frame);
+  frames++;
+}
+
+/* [19][N] in front of the size bytes of ids and data, the checksum after */
+static uint16_t frame(uint8_t out[], const uint8_t body[], uint8_t size) {
+  uint8_t sum = ROOMBA_STREAM_HEADER + size;
+
+  out[0] = ROOMBA_STREAM_HEADER;
+  out[1] = size;
+  memcpy(&out[2], body, size);
+  for (uint8_t i = 0; i < size; i++) sum = (uint8_t)(sum + body[i]);
+  out[2 + size] = (uint8_t)-sum;
+  return (uint16_t)(size + 3);
+}
+
+int main(void) {
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_PACKET_GROUP_100 snapshot;
+  /* bumps 1, voltage 15000 */
+  uint8_t first[] = {ROOMBA_BUMPS_WHEELDROPS, 0x01, ROOMBA_VOLTAGE, 0x3A,
+    0x98};
+  /* voltage 14000, temperature 31 */
+  uint8_t second[] = {ROOMBA_VOLTAGE, 0x36, 0xB0, ROOMBA_TEMPERATURE, 31};
+  /* group 2: infrared 5, buttons 1, distance -2, angle 3 */
+  uint8_t group[] = {2, 5, 1, 0xFF, 0xFE, 0x00, 0x03};
+  uint8_t bytes[ROOMBA_STREAM_FRAME_MAX * 4];
+  uint16_t size;
+
+  roomba_stream_init(&parser);
+  roomba_stream_set_packet_hook(&parser, on_packet, packets);
+  roomba_stream_set_frame_hook(&parser, on_frame, &frames);
+
+  /* one byte at a time */
+  size = frame(bytes, first, sizeof(first));
+  for (uint16_t i = 0; i < size; i++) {
+    roomba_stream_parse(&parser, &bytes[i], 1);
+  }
+  CHECK_EQ(frames, 1);
+  CHECK_EQ(parser.stats.frames, 1);
+  CHECK_EQ(parser.frame.bumps_wheeldrops, 1);
+  CHECK_EQ(parser.frame.voltage, 15000);
+  CHECK_EQ(parser.present, ROOMBA_PACKET_BIT(ROOMBA_BUMPS_WHEELDROPS) |
+    ROOMBA_PACKET_BIT(ROOMBA_VOLTAGE));
+  CHECK_EQ(packet_count, 2);
+  CHECK_EQ(packets[0], ROOMBA_BUMPS_WHEELDROPS);
+  CHECK_EQ(packets[1], ROOMBA_VOLTAGE);
+
+  /* a bad checksum: packets seen, frame rolled back, no frame hook */
+  packet_count = 0;
+  size = frame(bytes, second, sizeof(second));
+  bytes[size - 1] ^= 0x40;
+  roomba_stream_parse(&parser, bytes, size);
+  CHECK_EQ(packet_count, 2);
+  CHECK_EQ(frames, 1);
+  CHECK_EQ(parser.stats.checksum_errors, 1);
+  CHECK_EQ(parser.frame.voltage, 15000);
+  CHECK_EQ(parser.work.voltage, 15000);
+  CHECK_EQ(parser.frame.temperature, 0);
+
+  /* noise, a false header and an unknown id before a good frame */
+  bytes[0] = 0x00;
+  bytes[1] = 0x55;
+  bytes[2] = ROOMBA_STREAM_HEADER;
+  bytes[3] = 4;
+  bytes[4] = 99;
+  size = (uint16_t)(5 + frame(&bytes[5], second, sizeof(second)));
+  roomba_stream_parse(&parser, bytes, size);
+  CHECK_EQ(parser.stats.framing_errors, 1);
+  CHECK_EQ(frames, 2);
+  CHECK_EQ(parser.frame.voltage, 14000);
+  CHECK_EQ(parser.frame.temperature, 31);
+  /* earlier values stay, present only covers this frame */
+  CHECK_EQ(parser.frame.bumps_wheeldrops, 1);
+  CHECK_EQ(parser.present, ROOMBA_PACKET_BIT(ROOMBA_VOLTAGE) |
+    ROOMBA_PACKET_BIT(ROOMBA_TEMPERATURE));
+
+  /* a packet longer than the frame length says */
+  bytes[0] = ROOMBA_STREAM_HEADER;
+  bytes[1] = 2;
+  bytes[2] = ROOMBA_VOLTAGE;
+  size = (uint16_t)(3 + frame(&bytes[3], first, sizeof(first)));
+  roomba_stream_parse(&parser, bytes, size);
+  CHECK_EQ(parser.stats.framing_errors, 2);
+  CHECK_EQ(frames, 3);
+  CHECK_EQ(parser.frame.voltage, 15000);
+
+  /* a group is expanded into its packets */
+  packet_count = 0;
+  size = frame(bytes, group, sizeof(group));
+  roomba_stream_parse(&parser, bytes, size);
+  CHECK_EQ(frames, 4);
+  CHECK_EQ(packet_count, 4);
+  CHECK_EQ(packets[0], ROOMBA_IR_OPCODE);
+  CHECK_EQ(packets[3], ROOMBA_ANGLE);
+  CHECK_EQ(parser.frame.ir_opcode, 5);
+  CHECK_EQ(parser.frame.buttons_pkt, 1);
+  CHECK_EQ(parser.frame.distance, -2);
+  CHECK_EQ(parser.frame.angle, 3);
+  CHECK_EQ(parser.present, roomba_packet_mask(2));
+
+  /* frames as roomba_stream_encode builds them, back to back */
+  memset(&snapshot, 0, sizeof(snapshot));
+  snapshot.voltage = 16000;
+  snapshot.current = -1200;
+  snapshot.open_interface_mode = ROOMBA_SAFE_MODE;
+  size = roomba_stream_encode(&snapshot, roomba_packet_mask(3), bytes);
+  size = (uint16_t)(size + roomba_stream_encode(&snapshot,
+    ROOMBA_PACKET_BIT(ROOMBA_OPEN_INTERFACE_MODE), &bytes[size]));
+  roomba_stream_parse(&parser, bytes, size);
+  CHECK_EQ(frames, 6);
+  CHECK_EQ(parser.frame.voltage, 16000);
+  CHECK_EQ(parser.frame.current, -1200);
+  CHECK_EQ(parser.frame.open_interface_mode, ROOMBA_SAFE_MODE);
+  CHECK_EQ(parser.stats.checksum_errors, 1);
+  CHECK_EQ(parser.stats.framing_errors, 2);
+
+  return TEST_RESULT();
+}
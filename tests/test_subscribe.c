@@ -0,0 +1,77 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_subscribe.h"
+
+static void discard(void *context, const uint8_t data[], uint16_t size) {
+  (void)context;
+  (void)data;
+  (void)size;
+}
+
+/* packets 7 - 50 but one of every group, so no group stands in for them */
+static bool split(uint8_t p) {
+  return p != 16 && p != 20 && p != 26 && p != 34 && p != 42;
+}
+
+int main(void) {
+  ROOMBA_STREAM_PARSER parser;
+  ROOMBA_QUEUE queue;
+  ROOMBA_SCHEDULER scheduler;
+  ROOMBA_CACHE cache;
+  ROOMBA_SUBSCRIPTIONS subs;
+  ROOMBA_TRANSPORT uart = {discard, NULL};
+  ROOMBA_PRIORITY lane = roomba_command_priority(ROOMBA_STREAM);
+  uint8_t filler[] = {ROOMBA_SENSORS, ROOMBA_VOLTAGE};
+  uint8_t all[] = {ALL_PACKETS};
+  uint32_t now = 0;
+
+  roomba_stream_init(&parser);
+  roomba_queue_init(&queue);
+  roomba_cache_init(&cache, &parser, &queue, uart, 0);
+  roomba_scheduler_init(&scheduler, &queue, roomba_cache_transport(&cache),
+    ROOMBA_115200BPS);
+  roomba_subscriptions_init(&subs, &cache, &queue, &scheduler);
+
+  /* room for one command only: neither the Pause nor the Stream goes out */
+  for (uint8_t i = 0; i + 1 < ROOMBA_QUEUE_CAPACITY; i++) {
+    CHECK(roomba_queue_push_priority(&queue, lane, filler, sizeof(filler)));
+  }
+  CHECK(roomba_subscribe(&subs, ROOMBA_BUMPS_WHEELDROPS, 15) >= 0);
+  roomba_subscriptions_poll(&subs, now += ROOMBA_SLOT_MS);
+  roomba_subscriptions_poll(&subs, now += ROOMBA_SLOT_MS);
+  CHECK_EQ(roomba_queue_lane_depth(&queue, lane), ROOMBA_QUEUE_CAPACITY - 1);
+  CHECK(subs.changed);
+  CHECK_EQ(subs.streaming, 0);
+  CHECK_EQ(subs.stats.restreams, 0);
+
+  /* both once there is room */
+  while (roomba_queue_peek(&queue)) roomba_queue_pop(&queue);
+  roomba_subscriptions_poll(&subs, now += ROOMBA_SLOT_MS);
+  CHECK(!subs.changed);
+  CHECK_EQ(roomba_queue_lane_depth(&queue, lane), 2);
+  CHECK_EQ(roomba_queue_peek(&queue)->data[0], ROOMBA_PAUSE_RESUME_STREAM);
+  roomba_queue_pop(&queue);
+  CHECK_EQ(roomba_queue_peek(&queue)->data[0], ROOMBA_STREAM);
+  roomba_queue_pop(&queue);
+  CHECK_EQ(subs.streaming, roomba_packet_mask(ROOMBA_BUMPS_WHEELDROPS));
+  CHECK_EQ(subs.stats.restreams, 1);
+
+  /* too many ids for one Stream: group 100 goes out and is what streams */
+  roomba_subscriptions_init(&subs, &cache, &queue, &scheduler);
+  for (uint8_t p = ROOMBA_BUMPS_WHEELDROPS; p <= 50; p++) {
+    if (split(p)) CHECK(roomba_subscribe(&subs, p, 15) >= 0);
+  }
+  CHECK(roomba_subscribe(&subs, 20, 1000) >= 0);
+  roomba_subscriptions_poll(&subs, now += ROOMBA_SLOT_MS);
+  CHECK_EQ(subs.streaming, roomba_packet_mask(ALL_PACKETS));
+  CHECK_EQ(subs.frame_bytes, roomba_stream_frame_size(all, 1));
+
+  /* so packet 20 is never queried as well */
+  for (int i = 0; i < 2 * 1000 / ROOMBA_SLOT_MS; i++) {
+    roomba_subscriptions_poll(&subs, now += ROOMBA_SLOT_MS);
+  }
+  CHECK_EQ(subs.stats.requested_packets, 0);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,36 @@
+#include <string.h>
+
+#include "test.h"
+#include "roomba_tx.h"
+
+int main(void) {
+  ROOMBA_TX tx;
+  uint8_t notes[2 * 17], packets[255];
+
+  memset(notes, 60, sizeof(notes));
+  memset(packets, ROOMBA_VOLTAGE, sizeof(packets));
+  roomba_tx_clear(&tx);
+
+  CHECK(roomba_tx_drive(&tx, -200, ROOMBA_RADIUS_STRAIGHT_POSITIVE));
+  CHECK_EQ(tx.size, 5);
+  CHECK_EQ(tx.data[0], ROOMBA_DRIVE);
+  CHECK_EQ(tx.data[1], 0xFF);
+  CHECK_EQ(tx.data[2], 0x38);
+
+  /* sizes that wrapped a uint8_t used to reserve too little */
+  CHECK(!roomba_tx_packet_list(&tx, ROOMBA_QUERY_LIST, packets, 254));
+  CHECK(!roomba_tx_packet_list(&tx, ROOMBA_STREAM, packets, 255));
+  CHECK(!roomba_tx_song(&tx, 0, notes, 17));
+  CHECK(!roomba_tx_song(&tx, 0, notes, 128));
+  CHECK(!roomba_tx_song(&tx, 0, notes, 0));
+  CHECK_EQ(tx.size, 5);
+
+  CHECK(roomba_tx_song(&tx, 1, notes, 16));
+  CHECK_EQ(tx.size, 5 + 35);
+  CHECK(!roomba_tx_query_list(&tx, packets, ROOMBA_TX_SIZE - tx.size - 1));
+  CHECK(roomba_tx_query_list(&tx, packets, ROOMBA_TX_SIZE - tx.size - 2));
+  CHECK_EQ(tx.size, ROOMBA_TX_SIZE);
+  CHECK(!roomba_tx_opcode(&tx, ROOMBA_START));
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,73 @@
+#include <stdint.h>
+
+#include "test.h"
+#include "roomba_units.h"
+
+int main(void) {
+  ROOMBA_TX tx;
+
+  /* clamped at the limits, both ways and from far outside */
+  CHECK_EQ(roomba_speed(500).mm_s, 500);
+  CHECK_EQ(roomba_speed(501).mm_s, 500);
+  CHECK_EQ(roomba_speed(-500).mm_s, -500);
+  CHECK_EQ(roomba_speed(-501).mm_s, -500);
+  CHECK_EQ(roomba_speed(INT32_MAX).mm_s, 500);
+  CHECK_EQ(roomba_speed(INT32_MIN).mm_s, -500);
+  CHECK_EQ(roomba_speed(0).mm_s, 0);
+  CHECK_EQ(roomba_turn_radius(2001).mm, 2000);
+  CHECK_EQ(roomba_turn_radius(-70000).mm, -2000);
+  CHECK_EQ(roomba_wheel_pwm(256).duty, 255);
+  CHECK_EQ(roomba_wheel_pwm(-255).duty, -255);
+  CHECK_EQ(roomba_wheel_pwm(-65536).duty, -255);
+
+  /* the special radii: turning in place kept, straight only on request */
+  CHECK_EQ(roomba_turn_radius(1).mm, 1);
+  CHECK_EQ(roomba_turn_radius(-1).mm, -1);
+  CHECK_EQ(roomba_turn_radius(ROOMBA_RADIUS_STRAIGHT_POSITIVE).mm, 2000);
+  CHECK_EQ(roomba_turn_radius(-ROOMBA_RADIUS_STRAIGHT_NEGATIVE).mm, -2000);
+  CHECK_EQ((uint16_t)roomba_turn_straight().mm,
+    ROOMBA_RADIUS_STRAIGHT_POSITIVE);
+
+  /* every encoded command is one the OI accepts */
+  roomba_tx_clear(&tx);
+  CHECK(roomba_drive(&tx, roomba_speed(-900), roomba_turn_straight()));
+  CHECK_EQ(tx.size, 5);
+  CHECK_EQ(tx.data[0], ROOMBA_DRIVE);
+  CHECK_EQ(tx.data[1], 0xFE);
+  CHECK_EQ(tx.data[2], 0x0C);
+  CHECK_EQ(tx.data[3], 0x7F);
+  CHECK_EQ(tx.data[4], 0xFF);
+  CHECK(is_valid_roomba_command(tx.data, tx.size));
+
+  roomba_tx_clear(&tx);
+  CHECK(roomba_drive(&tx, roomba_speed(100), roomba_turn_radius(-1)));
+  CHECK_EQ(tx.data[3], 0xFF);
+  CHECK_EQ(tx.data[4], 0xFF);
+  CHECK(is_valid_roomba_command(tx.data, tx.size));
+
+  roomba_tx_clear(&tx);
+  CHECK(roomba_drive(&tx, roomba_speed(100), roomba_turn_radius(-3000)));
+  CHECK_EQ(tx.data[3], 0xF8);
+  CHECK_EQ(tx.data[4], 0x30);
+  CHECK(is_valid_roomba_command(tx.data, tx.size));
+
+  roomba_tx_clear(&tx);
+  CHECK(roomba_drive_direct(&tx, roomba_speed(1000), roomba_speed(-1000)));
+  CHECK_EQ(tx.data[0], ROOMBA_DRIVE_DIRECT);
+  CHECK_EQ(tx.data[1], 0x01);
+  CHECK_EQ(tx.data[2], 0xF4);
+  CHECK_EQ(tx.data[3], 0xFE);
+  CHECK_EQ(tx.data[4], 0x0C);
+  CHECK(is_valid_roomba_command(tx.data, tx.size));
+
+  roomba_tx_clear(&tx);
+  CHECK(roomba_drive_pwm(&tx, roomba_wheel_pwm(300), roomba_wheel_pwm(-300)));
+  CHECK_EQ(tx.data[0], ROOMBA_DRIVE_PWM);
+  CHECK_EQ(tx.data[1], 0x00);
+  CHECK_EQ(tx.data[2], 0xFF);
+  CHECK_EQ(tx.data[3], 0xFF);
+  CHECK_EQ(tx.data[4], 0x01);
+  CHECK(is_valid_roomba_command(tx.data, tx.size));
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,90 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "roomba_writer.h"
+
+#define SONGS 200
+#define NOTES 16
+#define SONG_SIZE (3 + 2 * NOTES)
+
+static int blocked_calls;
+static bool waiting;
+
+static void on_blocked(void *context, bool blocked) {
+  (void)context;
+  blocked_calls++;
+  waiting = blocked;
+}
+
+int main(void) {
+  static uint8_t received[SONGS * SONG_SIZE];
+  uint8_t buffer[4 * SONG_SIZE];
+  uint8_t song[SONG_SIZE];
+  ROOMBA_WRITER writer;
+  size_t size = 0, at = 0;
+  int serial[2], songs = 0, dropped = 0, last = -1;
+  int small = 1;
+
+  /* serial[0] is the port, serial[1] the robot; a small buffer fills fast */
+  CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, serial) == 0);
+  setsockopt(serial[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+  fcntl(serial[0], F_SETFL, fcntl(serial[0], F_GETFL) | O_NONBLOCK);
+  fcntl(serial[1], F_SETFL, fcntl(serial[1], F_GETFL) | O_NONBLOCK);
+  roomba_writer_init(&writer, serial[0], buffer, sizeof(buffer), on_blocked,
+    NULL);
+
+  /* songs numbered in their durations, the robot reads now and then */
+  song[0] = ROOMBA_SONG;
+  song[1] = 0;
+  song[2] = NOTES;
+  for (int i = 0; i < SONGS; i++) {
+    for (int n = 0; n < NOTES; n++) {
+      song[3 + 2 * n] = 60;
+      song[4 + 2 * n] = (uint8_t)i;
+    }
+    if (!roomba_writer_write(&writer, song, sizeof(song))) dropped++;
+    CHECK_EQ(writer.blocked, writer.size > 0);
+    CHECK_EQ(waiting, writer.blocked);
+    if (i % 16 == 15) {
+      ssize_t n = read(serial[1], &received[size], sizeof(received) - size);
+      if (n > 0) size += (size_t)n;
+      /* what EPOLLOUT would do */
+      roomba_writer_flush(&writer);
+    }
+  }
+  for (int i = 0; i < 100 && (writer.size > 0 || i == 0); i++) {
+    ssize_t n = read(serial[1], &received[size], sizeof(received) - size);
+    if (n > 0) size += (size_t)n;
+    roomba_writer_flush(&writer);
+  }
+  for (;;) {
+    ssize_t n = read(serial[1], &received[size], sizeof(received) - size);
+    if (n <= 0) break;
+    size += (size_t)n;
+  }
+  CHECK_EQ(writer.size, 0);
+  CHECK(!waiting);
+  CHECK(blocked_calls >= 2);
+  CHECK(dropped > 0);
+
+  /* nothing but whole songs, in order */
+  while (at < size) {
+    CHECK(size - at >= SONG_SIZE);
+    CHECK(is_valid_roomba_command(&received[at], SONG_SIZE));
+    CHECK(received[at + 4] > last || last < 0);
+    last = received[at + 4];
+    at += SONG_SIZE;
+    songs++;
+    if (test_failures) break;
+  }
+  CHECK_EQ(songs + dropped, SONGS);
+
+  close(serial[0]);
+  close(serial[1]);
+  return TEST_RESULT();
+}